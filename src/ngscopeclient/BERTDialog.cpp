@@ -39,6 +39,7 @@
 #include <cinttypes>
 
 using namespace std;
+using namespace std::chrono_literals;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
@@ -52,6 +53,8 @@ BERTDialog::BERTDialog(shared_ptr<SCPIBERT> bert, shared_ptr<BERTState> state, S
 	, m_tstart(GetTime())
 	, m_bert(bert)
 	, m_state(state)
+	, m_queue(session->GetInstrumentCommandQueue(bert))
+	, m_scheduler(session->GetPollScheduler(bert))
 {
 	RefreshFromHardware();
 }
@@ -92,13 +95,49 @@ void BERTDialog::RefreshFromHardware()
 	m_refclkFrequency = m_bert->GetRefclkOutFrequency();
 }
 
+/**
+	@brief Queues a readback of the refclk output frequency, which depends on the data rate, pattern, and mux setting
+
+	Any readback still in flight is abandoned, since it may have been queued before the latest change.
+ */
+void BERTDialog::ReadBackRefclkFrequency()
+{
+	auto bert = m_bert;
+	m_refclkFrequencyFuture = m_queue->Submit<int64_t>([bert]{ return bert->GetRefclkOutFrequency(); });
+}
+
+/**
+	@brief Applies any readbacks which have completed
+ */
+void BERTDialog::PollReadbacks()
+{
+	if(m_refclkFrequencyFuture.valid() && (m_refclkFrequencyFuture.wait_for(0s) == future_status::ready) )
+		m_refclkFrequency = m_refclkFrequencyFuture.get();
+
+	if(m_txPatternFuture.valid() && (m_txPatternFuture.wait_for(0s) == future_status::ready) )
+	{
+		m_txPattern = m_txPatternFuture.get();
+		m_txPatternText = to_string_hex(m_txPattern);
+	}
+
+	if(m_refclkNamesFuture.valid() && (m_refclkNamesFuture.wait_for(0s) == future_status::ready) )
+		m_refclkNames = m_refclkNamesFuture.get();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Rendering
 
 bool BERTDialog::DoRender()
 {
+	//Keep polling at full rate while we're on screen
+	if(m_scheduler)
+		m_scheduler->NotifyViewed();
+
 	float width = 10 * ImGui::GetFontSize();
 
+	PollReadbacks();
+	auto bert = m_bert;
+
 	//Device information
 	if(ImGui::CollapsingHeader("Info"))
 	{
@@ -131,8 +170,9 @@ bool BERTDialog::DoRender()
 			if(ImGui::InputText("Custom Pattern", &m_txPatternText))
 			{
 				sscanf(m_txPatternText.c_str(), "%" PRIx64, &m_txPattern);
-				m_bert->SetGlobalCustomPattern(m_txPattern);
-				m_refclkFrequency = m_bert->GetRefclkOutFrequency();
+				auto pattern = m_txPattern;
+				m_queue->SubmitWrite("pattern", [bert, pattern]{ bert->SetGlobalCustomPattern(pattern); });
+				ReadBackRefclkFrequency();
 			}
 
 			HelpMarker(to_string(m_bert->GetCustomPatternLength()) +
@@ -153,14 +193,14 @@ bool BERTDialog::DoRender()
 			ImGui::SetNextItemWidth(width);
 			if(Dialog::Combo("Clock Out", m_refclkNames, m_refclkIndex))
 			{
-				m_bert->SetRefclkOutMux(m_refclkIndex);
+				auto index = m_refclkIndex;
+				m_queue->SubmitWrite("refclkmux", [bert, index]{ bert->SetRefclkOutMux(index); });
 
 				//Need to refresh custom pattern here
 				//because ML4039 sets this to 0xaaaa if we select SERDES mode on clock out
-				m_txPattern = m_bert->GetGlobalCustomPattern();
-				m_txPatternText = to_string_hex(m_txPattern);
+				m_txPatternFuture = m_queue->Submit<uint64_t>([bert]{ return bert->GetGlobalCustomPattern(); });
 
-				m_refclkFrequency = m_bert->GetRefclkOutFrequency();
+				ReadBackRefclkFrequency();
 			}
 			HelpMarker("Select which clock to output from the reference clock output port");
 
@@ -189,7 +229,10 @@ bool BERTDialog::DoRender()
 			};
 			int iext = m_bert->GetUseExternalRefclk() ? 1 : 0;
 			if(ImGui::Combo("Clock Source", &iext, items, 2))
-				m_bert->SetUseExternalRefclk(iext == 1);
+			{
+				bool external = (iext == 1);
+				m_queue->SubmitWrite("refclksource", [bert, external]{ bert->SetUseExternalRefclk(external); });
+			}
 		}
 
 		if(!m_bert->IsDataRatePerChannel())
@@ -197,11 +240,13 @@ bool BERTDialog::DoRender()
 			ImGui::SetNextItemWidth(width);
 			if(Dialog::Combo("Data Rate", m_dataRateNames, m_dataRateIndex))
 			{
-				m_bert->SetDataRate(0, m_dataRates[m_dataRateIndex]);
+				auto rate = m_dataRates[m_dataRateIndex];
+				m_queue->SubmitWrite("datarate", [bert, rate]{ bert->SetDataRate(0, rate); });
 
 				//Reload refclk mux setting names
-				m_refclkNames = m_bert->GetRefclkOutMuxNames();
-				m_refclkFrequency = m_bert->GetRefclkOutFrequency();
+				m_refclkNamesFuture = m_queue->Submit<vector<string> >(
+					[bert]{ return bert->GetRefclkOutMuxNames(); });
+				ReadBackRefclkFrequency();
 			}
 			HelpMarker("PHY signaling rate for all transmit and receive ports");
 		}
@@ -215,7 +260,8 @@ bool BERTDialog::DoRender()
 			sa))
 		{
 			m_integrationLength = m_committedIntegrationLength;
-			m_bert->SetBERIntegrationLength(m_integrationLength);
+			auto length = m_integrationLength;
+			m_queue->SubmitWrite("integration", [bert, length]{ bert->SetBERIntegrationLength(length); });
 		}
 		HelpMarker(
 			"Number of UIs to sample for each BER measurement.\n\n"
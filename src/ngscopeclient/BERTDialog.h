@@ -54,6 +54,8 @@ public:
 	void RefreshFromHardware();
 
 protected:
+	void ReadBackRefclkFrequency();
+	void PollReadbacks();
 
 	///@brief Session handle so we can remove the load when closed
 	Session* m_session;
@@ -90,6 +92,21 @@ protected:
 
 	///@brief Calculated refclk out frequency
 	int64_t m_refclkFrequency;
+
+	///@brief Queue for running driver calls in the instrument thread
+	std::shared_ptr<InstrumentCommandQueue> m_queue;
+
+	///@brief Pending readback of m_refclkFrequency after a clock or pattern change
+	std::future<int64_t> m_refclkFrequencyFuture;
+
+	///@brief Pending readback of m_txPattern after a refclk mux change
+	std::future<uint64_t> m_txPatternFuture;
+
+	///@brief Pending readback of m_refclkNames after a data rate change
+	std::future<std::vector<std::string> > m_refclkNamesFuture;
+
+	///@brief Poll rate control for the instrument thread (told when we're on screen)
+	std::shared_ptr<PollScheduler> m_scheduler;
 };
 
 
@@ -319,13 +319,21 @@ bool BERTInputChannelDialog::DoRender()
 		Unit fs(Unit::UNIT_FS);
 		ImGui::SameLine();
 
-		//Scan progress or estimated run time
+		//Scan progress, position in the queue, or estimated run time
+		auto index = m_channel->GetIndex();
+		auto scans = state->m_scanQueue;
 		if(m_channel->IsHBathtubScanInProgress())
 			ImGui::ProgressBar(m_channel->GetScanProgress(), ImVec2(2*width, 0));
+		else if(scans->IsRunning(index, BERTScanQueue::SCAN_HBATHTUB))
+			ImGui::TextUnformatted("Running...");
+		else if(state->m_horzBathtubScanPending[index] || scans->IsQueued(index, BERTScanQueue::SCAN_HBATHTUB))
+			ImGui::TextUnformatted("Queued");
 		else
 			ImGui::Text("Estimated %s", fs.PrettyPrint(m_channel->GetExpectedBathtubCaptureTime(), 5).c_str());
 
-		HelpMarker("Acquire a single horizontal bathtub measurement");
+		HelpMarker(
+			"Acquire a single horizontal bathtub measurement.\n\n"
+			"Scans run in the background, one at a time. Real-time BER keeps updating while they run.");
 
 		if(ImGui::Button("Eye"))
 		{
@@ -337,12 +345,18 @@ bool BERTInputChannelDialog::DoRender()
 		}
 		ImGui::SameLine();
 
-		//Scan progress or estimated run time
+		//Scan progress, position in the queue, or estimated run time
 		if(m_channel->IsEyeScanInProgress())
 			ImGui::ProgressBar(m_channel->GetScanProgress(), ImVec2(2*width, 0));
+		else if(scans->IsRunning(index, BERTScanQueue::SCAN_EYE))
+			ImGui::TextUnformatted("Running...");
+		else if(state->m_eyeScanPending[index] || scans->IsQueued(index, BERTScanQueue::SCAN_EYE))
+			ImGui::TextUnformatted("Queued");
 		else
 			ImGui::Text("Estimated %s", fs.PrettyPrint(m_channel->GetExpectedEyeCaptureTime(), 5).c_str());
-		HelpMarker("Acquire a single eye pattern measurement");
+		HelpMarker(
+			"Acquire a single eye pattern measurement.\n\n"
+			"Scans run in the background, one at a time. Real-time BER keeps updating while they run.");
 
 		//Input path
 		ImGui::SetNextItemWidth(ImGui::GetFontSize() * 10);
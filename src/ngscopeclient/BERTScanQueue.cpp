@@ -0,0 +1,202 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of BERTScanQueue
+ */
+#include "../scopehal/scopehal.h"
+#include "pthread_compat.h"
+#include "BERTScanQueue.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+BERTScanQueue::BERTScanQueue()
+	: m_running(false)
+	, m_current(0, SCAN_EYE)
+	, m_shuttingDown(false)
+{
+}
+
+/**
+	@brief Discards scans which haven't started, and waits for the running one (if any) to finish
+
+	Driver calls can't be interrupted, so this may block for as long as the remaining time of the current scan.
+ */
+BERTScanQueue::~BERTScanQueue()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_pending.clear();
+		m_shuttingDown = true;
+	}
+	m_wake.notify_all();
+
+	if(m_thread)
+		m_thread->join();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queueing
+
+/**
+	@brief Requests a scan
+
+	@param channel	Index of the channel being scanned
+	@param type		Type of scan
+	@param fn		Driver call which performs the scan
+
+	@return True if the scan was queued, false if an identical scan was already waiting to start
+ */
+bool BERTScanQueue::Submit(size_t channel, ScanType type, function<void()> fn)
+{
+	ScanID id(channel, type);
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		//Clicking the button twice shouldn't measure twice
+		for(auto& s : m_pending)
+		{
+			if(s.m_id == id)
+				return false;
+		}
+
+		m_pending.push_back(Scan(id, fn));
+
+		if(!m_thread)
+			m_thread = make_unique<thread>(&BERTScanQueue::WorkerThread, this);
+	}
+
+	m_wake.notify_one();
+	return true;
+}
+
+/**
+	@brief Discards all scans which haven't started yet
+ */
+void BERTScanQueue::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_pending.clear();
+}
+
+/**
+	@brief Checks if a scan is waiting to start (not counting the one running now)
+ */
+bool BERTScanQueue::IsQueued(size_t channel, ScanType type)
+{
+	ScanID id(channel, type);
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& s : m_pending)
+	{
+		if(s.m_id == id)
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Checks if a scan is running right now
+ */
+bool BERTScanQueue::IsRunning(size_t channel, ScanType type)
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_running && (m_current == ScanID(channel, type));
+}
+
+/**
+	@brief Gets the scan running right now
+
+	@return True if a scan is running, false if the worker is idle
+ */
+bool BERTScanQueue::GetRunningScan(ScanID& id)
+{
+	lock_guard<mutex> lock(m_mutex);
+	id = m_current;
+	return m_running;
+}
+
+/**
+	@brief Gets the number of scans waiting to start
+ */
+size_t BERTScanQueue::GetDepth()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_pending.size();
+}
+
+/**
+	@brief Gets (and forgets) the list of scans completed since the last call
+ */
+vector<BERTScanQueue::ScanID> BERTScanQueue::PopCompleted()
+{
+	vector<ScanID> ret;
+	lock_guard<mutex> lock(m_mutex);
+	ret.swap(m_completed);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Execution
+
+void BERTScanQueue::WorkerThread()
+{
+	pthread_setname_np_compat("BERTScanThread");
+
+	unique_lock<mutex> lock(m_mutex);
+	while(true)
+	{
+		m_wake.wait(lock, [&]{ return m_shuttingDown || !m_pending.empty(); });
+		if(m_shuttingDown)
+			break;
+
+		auto scan = m_pending.front();
+		m_pending.pop_front();
+		m_running = true;
+		m_current = scan.m_id;
+
+		//Run the scan without holding the lock so the GUI and instrument threads can keep checking on us,
+		//but do hold the driver lock so nothing else talks to the instrument mid-scan
+		lock.unlock();
+		double start = GetTime();
+		{
+			lock_guard<mutex> driverLock(m_driverMutex);
+			scan.m_fn();
+		}
+		LogTrace("BERT scan on channel %zu took %.3f s\n", scan.m_id.first, GetTime() - start);
+		lock.lock();
+
+		m_running = false;
+		m_completed.push_back(scan.m_id);
+	}
+}
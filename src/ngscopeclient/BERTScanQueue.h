@@ -0,0 +1,142 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of BERTScanQueue
+ */
+#ifndef BERTScanQueue_h
+#define BERTScanQueue_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+	@brief Runs long BERT measurements (eye patterns, bathtub curves) in a worker thread
+
+	A scan can take minutes. Running it in the instrument thread would block that thread, and with it shutdown and
+	queueing of scans on other channels, until the scan finished. Instead the instrument thread submits scans here
+	and keeps looping. Scans run one at a time in submission order, and each one starts as soon as the previous one
+	finishes, so scans requested on several channels run back to back.
+
+	Driver scan calls block until the whole scan is done, and drivers aren't thread safe, so the worker holds the
+	driver mutex (see GetDriverMutex()) for the whole of each scan. Anything else which talks to the instrument must
+	hold it too; the instrument thread try-locks it and defers real-time BER polling and queued dialog commands
+	until the scan is done, rather than blocking. Real-time BER is therefore not updated while a scan runs.
+
+	The driver fills in the channel's data while the scan runs, so it must not be read until the scan completes.
+	The instrument thread calls PopCompleted() each pass to find out which channels have new data.
+ */
+class BERTScanQueue
+{
+public:
+	BERTScanQueue();
+	virtual ~BERTScanQueue();
+
+	enum ScanType
+	{
+		SCAN_HBATHTUB,
+		SCAN_EYE
+	};
+
+	///@brief Identifies a scan: channel index and type
+	typedef std::pair<size_t, ScanType> ScanID;
+
+	bool Submit(size_t channel, ScanType type, std::function<void()> fn);
+	void Clear();
+
+	bool IsQueued(size_t channel, ScanType type);
+	bool IsRunning(size_t channel, ScanType type);
+	bool GetRunningScan(ScanID& id);
+	size_t GetDepth();
+
+	std::vector<ScanID> PopCompleted();
+
+	/**
+		@brief Gets the mutex which must be held around every call to the instrument's driver
+
+		The worker thread holds it for the entire duration of each scan.
+	 */
+	std::mutex& GetDriverMutex()
+	{ return m_driverMutex; }
+
+protected:
+	void WorkerThread();
+
+	///@brief A single scan request
+	class Scan
+	{
+	public:
+		Scan(ScanID id, std::function<void()> fn)
+		: m_id(id)
+		, m_fn(fn)
+		{}
+
+		///@brief Channel and type of scan
+		ScanID m_id;
+
+		///@brief Driver call which performs the scan
+		std::function<void()> m_fn;
+	};
+
+	///@brief Mutex protecting all queue state
+	std::mutex m_mutex;
+
+	///@brief Mutex serializing driver calls between the worker and the instrument thread
+	std::mutex m_driverMutex;
+
+	///@brief Signaled when a scan is queued or we're shutting down
+	std::condition_variable m_wake;
+
+	///@brief Scans waiting to run, oldest first
+	std::deque<Scan> m_pending;
+
+	///@brief True if a scan is currently running
+	bool m_running;
+
+	///@brief The scan currently running (only valid if m_running is true)
+	ScanID m_current;
+
+	///@brief Scans which finished since the last call to PopCompleted()
+	std::vector<ScanID> m_completed;
+
+	///@brief Set to stop the worker thread
+	bool m_shuttingDown;
+
+	///@brief The worker thread (started on first use)
+	std::unique_ptr<std::thread> m_thread;
+};
+
+#endif
@@ -54,12 +54,16 @@ public:
 		}
 
 		m_firstUpdateDone = false;
+		m_scanQueue = std::make_shared<BERTScanQueue>();
 	}
 
 	std::unique_ptr<std::atomic<bool>[]> m_horzBathtubScanPending;
 	std::unique_ptr<std::atomic<bool>[]> m_eyeScanPending;
 
 	std::atomic<bool> m_firstUpdateDone;
+
+	//Eye and bathtub scans in progress or waiting to run
+	std::shared_ptr<BERTScanQueue> m_scanQueue;
 };
 
 #endif
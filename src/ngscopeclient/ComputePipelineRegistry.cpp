@@ -0,0 +1,151 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of ComputePipelineRegistry
+ */
+
+#include "ngscopeclient.h"
+#include "ComputePipelineRegistry.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+ComputePipelineRegistry::ComputePipelineRegistry()
+{
+}
+
+ComputePipelineRegistry::~ComputePipelineRegistry()
+{
+	clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Leasing
+
+/**
+	@brief Gets a pipeline for recording into a command buffer, creating it if necessary
+
+	The pipeline must not be used after Release() is called for the command buffer.
+
+	@param cmdbuf				Command buffer the pipeline will be used in
+	@param shaderPath			Path to the SPIR-V binary
+	@param numSSBOs				Number of storage buffers bound
+	@param pushConstantSize		Size of the push constants, in bytes
+	@param numStorageImages		Number of storage images bound
+	@param numSampledImages		Number of sampled images bound
+ */
+shared_ptr<ComputePipeline> ComputePipelineRegistry::Acquire(
+	vk::raii::CommandBuffer& cmdbuf,
+	const string& shaderPath,
+	size_t numSSBOs,
+	size_t pushConstantSize,
+	size_t numStorageImages,
+	size_t numSampledImages)
+{
+	VkCommandBuffer buf = *cmdbuf;
+	PipelineKey key(shaderPath, numSSBOs, pushConstantSize, numStorageImages, numSampledImages);
+
+	lock_guard<mutex> lock(m_mutex);
+	auto& leases = m_pipelines[key];
+
+	//With push descriptors, everyone recording into the same command buffer can share
+	if(g_hasPushDescriptor)
+	{
+		for(auto& l : leases)
+		{
+			if(l.m_cmdbuf == buf)
+				return l.m_pipeline;
+		}
+	}
+
+	//Otherwise take the first free pipeline
+	for(auto& l : leases)
+	{
+		if(l.m_cmdbuf == VK_NULL_HANDLE)
+		{
+			l.m_cmdbuf = buf;
+			return l.m_pipeline;
+		}
+	}
+
+	//Nothing free, make a new one
+	LogTrace("Creating pipeline %zu for %s\n", leases.size(), shaderPath.c_str());
+	leases.push_back(Lease(make_shared<ComputePipeline>(
+		shaderPath, numSSBOs, pushConstantSize, numStorageImages, numSampledImages)));
+	leases.back().m_cmdbuf = buf;
+	return leases.back().m_pipeline;
+}
+
+/**
+	@brief Returns all pipelines leased to a command buffer
+
+	Call once the command buffer has finished executing.
+ */
+void ComputePipelineRegistry::Release(vk::raii::CommandBuffer& cmdbuf)
+{
+	VkCommandBuffer buf = *cmdbuf;
+
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& it : m_pipelines)
+	{
+		for(auto& l : it.second)
+		{
+			if(l.m_cmdbuf == buf)
+				l.m_cmdbuf = VK_NULL_HANDLE;
+		}
+	}
+}
+
+/**
+	@brief Destroys all pipelines
+
+	Must not be called while any command buffer using them is pending.
+ */
+void ComputePipelineRegistry::clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_pipelines.clear();
+}
+
+/**
+	@brief Gets the total number of pipelines created
+ */
+size_t ComputePipelineRegistry::GetPipelineCount()
+{
+	lock_guard<mutex> lock(m_mutex);
+	size_t count = 0;
+	for(auto& it : m_pipelines)
+		count += it.second.size();
+	return count;
+}
@@ -0,0 +1,110 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of ComputePipelineRegistry
+ */
+#ifndef ComputePipelineRegistry_h
+#define ComputePipelineRegistry_h
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+/**
+	@brief Hands out shared compute pipelines, so that identical pipelines aren't built once per user
+
+	Pipelines are keyed by shader path (which already includes specializations like zero-hold or int64, since those
+	are separate SPIR-V binaries) plus the binding layout.
+
+	A ComputePipeline carries the descriptor bindings for its next dispatch, so a pipeline is leased to one command
+	buffer at a time and returned by Release() once that command buffer has finished executing. If the device supports
+	push descriptors, the bindings are recorded into the command buffer at dispatch time, so every user recording
+	into the same command buffer can share a single pipeline. Otherwise each dispatch in a command buffer needs its
+	own descriptor set, so each Acquire() call gets its own pipeline, and the pool grows to the largest number of
+	simultaneous users seen. Either way, pipelines are reused across frames, and a freshly created channel reuses
+	existing pipelines rather than building its own.
+
+	Vulkan pipeline objects are created through ComputePipeline, which looks up its pipeline cache in
+	g_pipelineCacheMgr by shader name, so compiled pipelines are persisted across runs along with the ImGui cache.
+ */
+class ComputePipelineRegistry
+{
+public:
+	ComputePipelineRegistry();
+	~ComputePipelineRegistry();
+
+	std::shared_ptr<ComputePipeline> Acquire(
+		vk::raii::CommandBuffer& cmdbuf,
+		const std::string& shaderPath,
+		size_t numSSBOs,
+		size_t pushConstantSize,
+		size_t numStorageImages = 0,
+		size_t numSampledImages = 0);
+
+	void Release(vk::raii::CommandBuffer& cmdbuf);
+
+	void clear();
+
+	size_t GetPipelineCount();
+
+protected:
+
+	///@brief Shader path, SSBO count, push constant size, storage image count, sampled image count
+	typedef std::tuple<std::string, size_t, size_t, size_t, size_t> PipelineKey;
+
+	/**
+		@brief One pipeline, and the command buffer currently using it
+	 */
+	class Lease
+	{
+	public:
+		Lease(std::shared_ptr<ComputePipeline> pipe)
+		: m_pipeline(pipe)
+		, m_cmdbuf(VK_NULL_HANDLE)
+		{}
+
+		///@brief The pipeline
+		std::shared_ptr<ComputePipeline> m_pipeline;
+
+		///@brief Command buffer the pipeline is being recorded into (null if free)
+		VkCommandBuffer m_cmdbuf;
+	};
+
+	///@brief Mutex protecting m_pipelines
+	std::mutex m_mutex;
+
+	///@brief All pipelines we've created, by key
+	std::map<PipelineKey, std::vector<Lease>> m_pipelines;
+};
+
+#endif
@@ -109,7 +109,7 @@ CreateFilterBrowser::~CreateFilterBrowser()
  */
 bool CreateFilterBrowser::DoRender()
 {
-	auto& refs = m_session.GetReferenceFilters();
+	auto& categories = m_session.GetFilterCategories();
 
 	//Filter bars
 	ImGui::SetNextItemWidth(8 * ImGui::GetFontSize());
@@ -130,10 +130,10 @@ bool CreateFilterBrowser::DoRender()
 
 		//Hackiness based on manual-wrapping example from the demo
 		float window_visible_x2 = ImGui::GetCursorScreenPos().x + ImGui::GetContentRegionAvail().x;
-		for(auto it : refs)
+		for(auto& it : categories)
 		{
 			//Filter by category
-			if( (cat != Filter::CAT_COUNT) && (cat != it.second->GetCategory()) )
+			if( (cat != Filter::CAT_COUNT) && (cat != it.second) )
 				continue;
 
 			//String filtering
@@ -155,6 +155,7 @@ bool CreateFilterBrowser::DoRender()
 			//Placeholder for the button
 			auto pos = ImGui::GetCursorScreenPos();
 			ImGui::InvisibleButton(it.first.c_str(), buttonsize);
+			bool visible = ImGui::IsItemVisible();
 
 			//Help text
 			if(ImGui::IsItemHovered())
@@ -176,8 +177,15 @@ bool CreateFilterBrowser::DoRender()
 			if(next_button_x2 < window_visible_x2)
 				ImGui::SameLine();
 
+			//Don't create a reference filter (needed for the icon) until the button is scrolled into view
+			if(!visible)
+				continue;
+
 			//Figure out the icon to draw
-			auto icon = m_parent->GetIconForFilter(it.second);
+			string icon;
+			auto ref = m_session.GetReferenceFilter(it.first);
+			if(ref)
+				icon = m_parent->GetIconForFilter(ref);
 
 			//Draw the button
 			ImDrawList* draw_list = ImGui::GetWindowDrawList();
@@ -0,0 +1,553 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of DeskewCorrelator
+ */
+#include "../scopehal/scopehal.h"
+#include "DeskewCorrelator.h"
+#include "../scopehal/VulkanFFTPlan.h"
+
+using namespace std;
+
+///@brief Number of FFT points to transform per batch in Correlate()
+static const size_t g_deskewBatchPoints = 1024 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FFT correlation
+/**
+	@brief Finds the offset between two waveforms with the best cross-correlation
+
+	Either waveform may be uniform or sparse.
+
+	@param pri				Primary (reference) waveform
+	@param sec				Secondary waveform
+	@param maxSkewSamples	Largest offset to consider, in samples of the primary waveform
+	@param cmdBuf			Command buffer for the FFTs
+	@param queue			Queue to submit cmdBuf to
+ */
+DeskewCorrelation DeskewCorrelator::Correlate(
+	WaveformBase* pri,
+	WaveformBase* sec,
+	int64_t maxSkewSamples,
+	vk::raii::CommandBuffer& cmdBuf,
+	shared_ptr<QueueHandle> queue)
+{
+	DeskewCorrelation ret;
+	double start = GetTime();
+
+	int64_t pstart;
+	int64_t pend;
+	int64_t sstart;
+	int64_t send;
+	if(!GetTimeRange(pri, pstart, pend) || !GetTimeRange(sec, sstart, send) || (maxSkewSamples <= 0))
+		return ret;
+
+	//Everything is done on the primary waveform's sample grid
+	int64_t timescale = pri->m_timescale;
+	size_t plen = (pend - pstart + timescale - 1) / timescale;
+
+	//Sparse waveforms with a very fine timescale (e.g. 1 fs per tick) would produce an enormous grid.
+	//Use the direct method instead.
+	if(plen > 4*pri->size() + 1024)
+	{
+		auto spri = dynamic_cast<SparseAnalogWaveform*>(pri);
+		auto ssec = dynamic_cast<SparseAnalogWaveform*>(sec);
+		if(spri && ssec)
+			return CorrelateBruteForce(spri, ssec, maxSkewSamples);
+
+		LogError("Primary waveform timescale is too fine to correlate on its sample grid\n");
+		return ret;
+	}
+
+	//Resample both waveforms onto the grid.
+	//The secondary is padded by maxSkewSamples on each side so every offset has a full window to look at.
+	size_t M = maxSkewSamples;
+	size_t span = 2*M;
+	vector<float> pgrid(plen);
+	vector<float> sgrid(plen + span);
+	size_t pvalidStart;
+	size_t pvalidEnd;
+	size_t svalidStart;
+	size_t svalidEnd;
+	Resample(pri, pstart, timescale, 0, pgrid, pvalidStart, pvalidEnd);
+	Resample(sec, pstart, timescale, -maxSkewSamples, sgrid, svalidStart, svalidEnd);
+
+	//Block size: each block of the primary is correlated against span extra secondary samples, so the FFT must be
+	//bigger than the span. Making it at least twice the span keeps the overhead reasonable.
+	size_t npoints = 4;
+	while(npoints < span + min(plen, span))
+		npoints *= 2;
+	size_t nouts = npoints/2 + 1;
+	size_t blocksize = npoints - span;
+	size_t nblocks = (plen + blocksize - 1) / blocksize;
+
+	//Blocks are transformed in batches of about a million points, which bounds memory use for deep captures
+	size_t batchBlocks = min(nblocks, max<size_t>(1, g_deskewBatchPoints / npoints));
+	VulkanFFTPlan forwardPlan(npoints, nouts, VulkanFFTPlan::DIRECTION_FORWARD, batchBlocks);
+	VulkanFFTPlan reversePlan(npoints, nouts, VulkanFFTPlan::DIRECTION_REVERSE, batchBlocks);
+
+	AcceleratorBuffer<float> pblocks("DeskewCorrelator.pblocks");
+	AcceleratorBuffer<float> sblocks("DeskewCorrelator.sblocks");
+	AcceleratorBuffer<float> pspec("DeskewCorrelator.pspec");
+	AcceleratorBuffer<float> sspec("DeskewCorrelator.sspec");
+	AcceleratorBuffer<float> cross("DeskewCorrelator.cross");
+	AcceleratorBuffer<float> products("DeskewCorrelator.products");
+	for(auto buf : {&pblocks, &sblocks, &pspec, &sspec, &cross, &products})
+	{
+		buf->SetCpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+		buf->SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	}
+	pblocks.resize(batchBlocks * npoints);
+	sblocks.resize(batchBlocks * npoints);
+	pspec.resize(batchBlocks * nouts * 2);
+	sspec.resize(batchBlocks * nouts * 2);
+	cross.resize(batchBlocks * nouts * 2);
+	products.resize(batchBlocks * npoints);
+
+	//Sum of products at each offset
+	vector<double> sums(span, 0);
+	for(size_t firstBlock=0; firstBlock<nblocks; firstBlock += batchBlocks)
+	{
+		//Copy out each primary block (zero padded) and the secondary window it's compared against.
+		//Blocks past the end of the waveform in the last batch are all zero and contribute nothing.
+		pblocks.PrepareForCpuAccess();
+		sblocks.PrepareForCpuAccess();
+		#pragma omp parallel for
+		for(size_t j=0; j<batchBlocks; j++)
+		{
+			size_t base = (firstBlock + j) * blocksize;
+			size_t pcount = (base < plen) ? min(blocksize, plen - base) : 0;
+			size_t scount = (base < sgrid.size()) ? min(npoints, sgrid.size() - base) : 0;
+			float* pout = pblocks.GetCpuPointer() + j*npoints;
+			float* sout = sblocks.GetCpuPointer() + j*npoints;
+			for(size_t i=0; i<npoints; i++)
+			{
+				pout[i] = (i < pcount) ? pgrid[base + i] : 0;
+				sout[i] = (i < scount) ? sgrid[base + i] : 0;
+			}
+		}
+		pblocks.MarkModifiedFromCpu();
+		sblocks.MarkModifiedFromCpu();
+
+		//Transform both
+		cmdBuf.reset();
+		cmdBuf.begin({});
+		forwardPlan.AppendForward(pblocks, pspec, cmdBuf);
+		forwardPlan.AppendForward(sblocks, sspec, cmdBuf);
+		cmdBuf.end();
+		queue->SubmitAndBlock(cmdBuf);
+		pspec.MarkModifiedFromGpu();
+		sspec.MarkModifiedFromGpu();
+
+		//Cross spectrum conj(P) * S, whose inverse transform is the sum of products at each offset
+		pspec.PrepareForCpuAccess();
+		sspec.PrepareForCpuAccess();
+		cross.PrepareForCpuAccess();
+		#pragma omp parallel for
+		for(size_t k=0; k<batchBlocks*nouts; k++)
+		{
+			float pr = pspec[k*2];
+			float pi = pspec[k*2 + 1];
+			float sr = sspec[k*2];
+			float si = sspec[k*2 + 1];
+			cross[k*2]		= pr*sr + pi*si;
+			cross[k*2 + 1]	= pr*si - pi*sr;
+		}
+		cross.MarkModifiedFromCpu();
+
+		cmdBuf.reset();
+		cmdBuf.begin({});
+		reversePlan.AppendReverse(cross, products, cmdBuf);
+		cmdBuf.end();
+		queue->SubmitAndBlock(cmdBuf);
+		products.MarkModifiedFromGpu();
+
+		//Output is real. Offsets past the span wrapped around the end of the block and are discarded.
+		products.PrepareForCpuAccess();
+		for(size_t j=0; j<batchBlocks; j++)
+		{
+			for(size_t k=0; k<span; k++)
+				sums[k] += products[j*npoints + k];
+		}
+	}
+
+	//Normalize by the number of overlapping samples at each offset and find the peak.
+	//The inverse FFT is unnormalized, so also divide out the transform length.
+	vector<float> corr(span, 0);
+	vector<bool> valid(span, false);
+	for(size_t k=0; k<span; k++)
+	{
+		//Primary sample i overlaps secondary grid point i+k
+		int64_t first = max<int64_t>(pvalidStart, (int64_t)svalidStart - (int64_t)k);
+		int64_t last = min<int64_t>(pvalidEnd, (int64_t)svalidEnd - (int64_t)k);
+		if(last <= first)
+			continue;
+
+		corr[k] = sums[k] / npoints / (last - first);
+		valid[k] = true;
+		if(corr[k] > ret.m_correlation)
+		{
+			ret.m_correlation = corr[k];
+			ret.m_offset = (int64_t)k - maxSkewSamples;
+		}
+	}
+
+	//Refine the peak location by fitting a parabola to it and its neighbors
+	size_t peak = ret.m_offset + maxSkewSamples;
+	if( (ret.m_correlation > 0) && (peak > 0) && (peak + 1 < span) && valid[peak-1] && valid[peak+1])
+	{
+		float left = corr[peak - 1];
+		float right = corr[peak + 1];
+		float denom = left - 2*ret.m_correlation + right;
+		if(denom < 0)
+			ret.m_fraction = max(-0.5f, min(0.5f, 0.5f * (left - right) / denom));
+	}
+
+	LogTrace("FFT correlation (%zu points, %zu blocks of %zu in batches of %zu) evaluated in %.3f sec\n",
+		plen, nblocks, npoints, batchBlocks, GetTime() - start);
+
+	return ret;
+}
+
+/**
+	@brief Gets the time span covered by a waveform, in fs relative to the trigger
+
+	@return False if the waveform is empty or not analog
+ */
+bool DeskewCorrelator::GetTimeRange(WaveformBase* wfm, int64_t& tstart, int64_t& tend)
+{
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
+
+	if(uwfm && !uwfm->empty())
+	{
+		tstart = uwfm->m_triggerPhase;
+		tend = uwfm->size() * uwfm->m_timescale + uwfm->m_triggerPhase;
+		return true;
+	}
+	else if(swfm && !swfm->empty())
+	{
+		size_t last = swfm->size() - 1;
+		tstart = swfm->m_offsets[0] * swfm->m_timescale + swfm->m_triggerPhase;
+		tend = (swfm->m_offsets[last] + swfm->m_durations[last]) * swfm->m_timescale + swfm->m_triggerPhase;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+	@brief Samples a waveform on a uniform grid
+
+	Each grid point takes the value of the sample whose span contains that point in time. Points outside the waveform
+	are zero.
+
+	@param wfm			Waveform to sample (uniform or sparse analog, must not be empty)
+	@param t0			Time of grid point zero, in fs
+	@param timescale	Grid spacing, in fs
+	@param jstart		Grid index of out[0] (may be negative)
+	@param out			Output buffer, must already be sized to the desired number of points
+	@param validStart	Index of the first point of out that lies within the waveform
+	@param validEnd		One past the index of the last point of out that lies within the waveform
+ */
+void DeskewCorrelator::Resample(
+	WaveformBase* wfm,
+	int64_t t0,
+	int64_t timescale,
+	int64_t jstart,
+	vector<float>& out,
+	size_t& validStart,
+	size_t& validEnd)
+{
+	int64_t tstart;
+	int64_t tend;
+	GetTimeRange(wfm, tstart, tend);
+
+	//Find the range of grid points inside the waveform (tstart <= t < tend)
+	auto floordiv = [](int64_t a, int64_t b)
+		{ return (a >= 0) ? (a / b) : -((-a + b - 1) / b); };
+	int64_t len = out.size();
+	int64_t first = -floordiv(t0 - tstart, timescale) - jstart;
+	int64_t last = -floordiv(t0 - tend, timescale) - jstart;
+	first = max<int64_t>(0, min(len, first));
+	last = max<int64_t>(first, min(len, last));
+	validStart = first;
+	validEnd = last;
+
+	for(int64_t i=0; i<first; i++)
+		out[i] = 0;
+	for(int64_t i=last; i<len; i++)
+		out[i] = 0;
+
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
+	if(uwfm)
+	{
+		uwfm->PrepareForCpuAccess();
+
+		int64_t wts = uwfm->m_timescale;
+		int64_t wlast = uwfm->size() - 1;
+		int64_t dtFirst = t0 + (jstart + first)*timescale - tstart;
+
+		//Grid lines up with the samples, just copy
+		if( (wts == timescale) && (dtFirst % wts == 0) )
+		{
+			int64_t kFirst = dtFirst / wts;
+			for(int64_t i=first; i<last; i++)
+				out[i] = uwfm->m_samples[min(wlast, kFirst + i - first)];
+		}
+
+		else
+		{
+			#pragma omp parallel for
+			for(int64_t i=first; i<last; i++)
+			{
+				int64_t dt = t0 + (jstart + i)*timescale - tstart;
+				int64_t k = min(wlast, dt / wts);
+				out[i] = uwfm->m_samples[k];
+			}
+		}
+	}
+	else if(swfm)
+	{
+		swfm->PrepareForCpuAccess();
+
+		size_t k = 0;
+		size_t wlast = swfm->size() - 1;
+		int64_t wts = swfm->m_timescale;
+		int64_t phase = swfm->m_triggerPhase;
+		for(int64_t i=first; i<last; i++)
+		{
+			int64_t t = t0 + (jstart + i)*timescale;
+			while( (k < wlast) && ( (swfm->m_offsets[k] + swfm->m_durations[k]) * wts + phase <= t) )
+				k ++;
+			out[i] = swfm->m_samples[k];
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Statistics
+
+/**
+	@brief Gets the median of a set of skew measurements, and a 95% confidence interval for it
+
+	The interval is distribution-free (based on order statistics), so occasional false alignments from a bad
+	acquisition widen it slightly rather than dragging it off. With fewer than about 10 measurements it is simply the
+	full range of the data.
+
+	@param skews	Skew measurements, in any order
+	@param lo		Lower bound of the confidence interval
+	@param hi		Upper bound of the confidence interval
+
+	@return The median skew (zero if there are no measurements)
+ */
+int64_t DeskewCorrelator::GetMedianSkew(vector<int64_t> skews, int64_t& lo, int64_t& hi)
+{
+	lo = 0;
+	hi = 0;
+	if(skews.empty())
+		return 0;
+
+	sort(skews.begin(), skews.end());
+	size_t n = skews.size();
+
+	//Ranks (one based) of the interval bounds are n/2 -/+ 1.96 * sqrt(n)/2, with the upper one offset by one
+	double halfwidth = 0.98 * sqrt(n);
+	int64_t loRank = floor(n/2.0 - halfwidth);
+	int64_t hiRank = ceil(1 + n/2.0 + halfwidth);
+	lo = skews[max<int64_t>(1, loRank) - 1];
+	hi = skews[min<int64_t>(n, hiRank) - 1];
+
+	if(n & 1)
+		return skews[n/2];
+	else
+		return (skews[n/2 - 1] + skews[n/2]) / 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Brute force reference implementations
+
+/**
+	@brief Evaluates the correlation at each offset directly (uniform waveforms, any sample rates)
+ */
+DeskewCorrelation DeskewCorrelator::CorrelateBruteForce(
+	UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec, int64_t maxSkewSamples)
+{
+	DeskewCorrelation ret;
+
+	double start = GetTime();
+
+	ppri->PrepareForCpuAccess();
+	psec->PrepareForCpuAccess();
+
+	int64_t len = ppri->size();
+	size_t slen = psec->size();
+
+	std::mutex cmutex;
+
+	#pragma omp parallel for
+	for(int64_t d = -maxSkewSamples; d < maxSkewSamples; d ++)
+	{
+		//Convert delta from samples of the primary waveform to femtoseconds
+		int64_t deltaFs = ppri->m_timescale * d;
+
+		//Shift by relative trigger phase
+		deltaFs += (ppri->m_triggerPhase - psec->m_triggerPhase);
+
+		//Loop over samples in the primary waveform
+		ssize_t samplesProcessed = 0;
+		size_t isecondary = 0;
+		double correlation = 0;
+		for(size_t i=0; i<(size_t)len; i++)
+		{
+			//Target timestamp in the secondary waveform
+			int64_t target = i * ppri->m_timescale + deltaFs;
+
+			//If off the start of the waveform, skip it
+			if(target < 0)
+				continue;
+
+			uint64_t utarget = target;
+
+			//Skip secondary samples if the current secondary sample ends at or before the primary sample starts
+			bool done = false;
+			while( static_cast<uint64_t>((isecondary + 1) *	psec->m_timescale) <= utarget)
+			{
+				isecondary ++;
+
+				//If off the end of the waveform, stop
+				if(isecondary >= slen)
+				{
+					done = true;
+					break;
+				}
+			}
+			if(done)
+				break;
+
+			//Do the actual cross-correlation
+			correlation += ppri->m_samples[i] * psec->m_samples[isecondary];
+			samplesProcessed ++;
+		}
+
+		double normalizedCorrelation = correlation / samplesProcessed;
+
+		//Update correlation
+		lock_guard<mutex> lock2(cmutex);
+		if(normalizedCorrelation > ret.m_correlation)
+		{
+			ret.m_correlation = normalizedCorrelation;
+			ret.m_offset = d;
+		}
+	}
+
+	double dt = GetTime() - start;
+	LogTrace("Correlation evaluated in %.3f sec\n", dt);
+
+	return ret;
+}
+
+/**
+	@brief Evaluates the correlation at each offset directly (sparse waveforms)
+ */
+DeskewCorrelation DeskewCorrelator::CorrelateBruteForce(
+	SparseAnalogWaveform* ppri, SparseAnalogWaveform* psec, int64_t maxSkewSamples)
+{
+	DeskewCorrelation ret;
+
+	ppri->PrepareForCpuAccess();
+	psec->PrepareForCpuAccess();
+
+	//Calculate cross-correlation between the primary and secondary waveforms at up to +/- half the waveform length
+	int64_t len = ppri->size();
+	size_t slen = psec->size();
+
+	std::mutex cmutex;
+
+	#pragma omp parallel for
+	for(int64_t d = -maxSkewSamples; d < maxSkewSamples; d ++)
+	{
+		//Convert delta from samples of the primary waveform to femtoseconds
+		int64_t deltaFs = ppri->m_timescale * d;
+
+		//Loop over samples in the primary waveform
+		ssize_t samplesProcessed = 0;
+		size_t isecondary = 0;
+		double correlation = 0;
+		for(size_t i=0; i<(size_t)len; i++)
+		{
+			//Timestamp of this sample, in fs
+			int64_t start = ppri->m_offsets[i] * ppri->m_timescale + ppri->m_triggerPhase;
+
+			//Target timestamp in the secondary waveform
+			int64_t target = start + deltaFs;
+
+			//If off the start of the waveform, skip it
+			if(target < 0)
+				continue;
+
+			//Skip secondary samples if the current secondary sample ends at or before the primary sample starts
+			bool done = false;
+			while( (((psec->m_offsets[isecondary] + psec->m_durations[isecondary]) *
+						psec->m_timescale) + psec->m_triggerPhase) <= target)
+			{
+				isecondary ++;
+
+				//If off the end of the waveform, stop
+				if(isecondary >= slen)
+				{
+					done = true;
+					break;
+				}
+			}
+			if(done)
+				break;
+
+			//Do the actual cross-correlation
+			correlation += ppri->m_samples[i] * psec->m_samples[isecondary];
+			samplesProcessed ++;
+		}
+
+		double normalizedCorrelation = correlation / samplesProcessed;
+
+		//Update correlation
+		lock_guard<mutex> lock2(cmutex);
+		if(normalizedCorrelation > ret.m_correlation)
+		{
+			ret.m_correlation = normalizedCorrelation;
+			ret.m_offset = d;
+		}
+	}
+
+	return ret;
+}
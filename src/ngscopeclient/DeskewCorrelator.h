@@ -0,0 +1,103 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of DeskewCorrelator
+ */
+#ifndef DeskewCorrelator_h
+#define DeskewCorrelator_h
+
+/**
+	@brief Result of a cross-correlation search between two waveforms
+ */
+class DeskewCorrelation
+{
+public:
+	DeskewCorrelation()
+	: m_correlation(0)
+	, m_offset(0)
+	, m_fraction(0)
+	{}
+
+	/**
+		@brief Gets the skew corresponding to the correlation peak
+
+		@param timescale	Timescale of the primary waveform, in fs per sample
+	 */
+	int64_t GetSkew(int64_t timescale) const
+	{ return llround((m_offset + m_fraction) * timescale); }
+
+	///@brief Normalized correlation at the peak
+	float m_correlation;
+
+	///@brief Offset of the peak, in samples of the primary waveform
+	int64_t m_offset;
+
+	///@brief Sub-sample refinement of the peak position, in samples of the primary waveform (-0.5 to +0.5)
+	float m_fraction;
+};
+
+/**
+	@brief Cross-correlation of two waveforms to find the skew between them
+
+	The secondary waveform is searched over +/- maxSkewSamples samples of the primary waveform. At each offset the
+	correlation is the mean of the products of overlapping samples, with secondary samples held from the sample
+	covering each point in time.
+
+	Correlate() resamples both waveforms onto the primary's sample grid and computes all offsets at once using
+	overlap-save FFTs (via VulkanFFTPlan), so run time scales with N log N rather than N * maxSkewSamples. The brute
+	force versions evaluate each offset directly on the CPU and are kept as a reference implementation.
+ */
+class DeskewCorrelator
+{
+public:
+	static DeskewCorrelation Correlate(
+		WaveformBase* pri,
+		WaveformBase* sec,
+		int64_t maxSkewSamples,
+		vk::raii::CommandBuffer& cmdBuf,
+		std::shared_ptr<QueueHandle> queue);
+
+	static DeskewCorrelation CorrelateBruteForce(
+		UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec, int64_t maxSkewSamples);
+	static DeskewCorrelation CorrelateBruteForce(
+		SparseAnalogWaveform* ppri, SparseAnalogWaveform* psec, int64_t maxSkewSamples);
+
+	static int64_t GetMedianSkew(std::vector<int64_t> skews, int64_t& lo, int64_t& hi);
+
+protected:
+	static bool GetTimeRange(WaveformBase* wfm, int64_t& tstart, int64_t& tend);
+	static void Resample(
+		WaveformBase* wfm, int64_t t0, int64_t timescale, int64_t jstart, std::vector<float>& out, size_t& validStart,
+		size_t& validEnd);
+};
+
+#endif
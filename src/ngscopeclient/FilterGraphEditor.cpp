@@ -197,6 +197,7 @@ void FilterGraphGroup::MoveBy(ImVec2 displacement)
 FilterGraphEditor::FilterGraphEditor(Session& session, MainWindow* parent)
 	: Dialog("Filter Graph Editor", "Filter Graph Editor", ImVec2(800, 600))
 	, m_session(session)
+	, m_profileMaxTime(0)
 	, m_parent(parent)
 	, m_nextID(1)
 {
@@ -429,6 +430,17 @@ bool FilterGraphEditor::DoRender()
 {
 	bool windowHovered = ImGui::IsWindowHovered();
 
+	//Grab filter profiling results once per frame for the heatmap
+	m_profileStats.clear();
+	m_profileMaxTime = 0;
+	auto& profiler = m_session.GetFilterProfiler();
+	if(profiler.IsEnabled())
+	{
+		m_profileStats = profiler.GetStats();
+		for(auto& it : m_profileStats)
+			m_profileMaxTime = max(m_profileMaxTime, it.second.GetAverage());
+	}
+
 	ax::NodeEditor::SetCurrentEditor(m_context);
 	ax::NodeEditor::Begin("Filter Graph", ImVec2(0, 0));
 
@@ -468,7 +480,7 @@ bool FilterGraphEditor::DoRender()
 		if(ftype)
 		{
 			string fname((char*)ftype->Data, ftype->DataSize);
-			auto cat = m_session.GetReferenceFilter(fname)->GetCategory();
+			auto cat = m_session.GetFilterCategories().at(fname);
 
 			if(ftype->IsDelivery())
 			{
@@ -1419,6 +1431,7 @@ void FilterGraphEditor::HandleLinkCreationRequests(Filter*& fReconfigure)
 						{
 							//Hook it up
 							inputPort.first->SetInput(inputPort.second, stream);
+							m_session.InvalidateFlowGraphIndex();
 
 							//Update names, if needed
 							fReconfigure = dynamic_cast<Filter*>(inputPort.first);
@@ -1615,6 +1628,7 @@ void FilterGraphEditor::CreateChannelMenu()
 			if(ImGui::MenuItem(s.GetName().c_str()))
 			{
 				m_createInput.first->SetInput(m_createInput.second, s);
+				m_session.InvalidateFlowGraphIndex();
 
 				auto trig = dynamic_cast<Trigger*>(m_createInput.first);
 				if(trig)
@@ -1626,13 +1640,13 @@ void FilterGraphEditor::CreateChannelMenu()
 	}
 	if(ImGui::BeginMenu("Create"))
 	{
-		auto& refs = m_parent->GetSession().GetReferenceFilters();
+		auto& session = m_parent->GetSession();
 
 		//Find all filters in this category and sort them alphabetically
 		vector<string> sortedNames;
-		for(auto it : refs)
+		for(auto& it : session.GetFilterCategories())
 		{
-			if(it.second->GetCategory() == Filter::CAT_GENERATION)
+			if(it.second == Filter::CAT_GENERATION)
 				sortedNames.push_back(it.first);
 		}
 		std::sort(sortedNames.begin(), sortedNames.end());
@@ -1640,10 +1654,9 @@ void FilterGraphEditor::CreateChannelMenu()
 		//Do all of the menu items
 		for(auto fname : sortedNames)
 		{
-			auto it = refs.find(fname);
-
 			//For now: don't allow creation of filters that take inputs if going back
-			if(it->second->GetInputCount() != 0)
+			auto ref = session.GetReferenceFilter(fname);
+			if(!ref || (ref->GetInputCount() != 0) )
 				continue;
 
 			if(ImGui::MenuItem(fname.c_str()))
@@ -1659,6 +1672,7 @@ void FilterGraphEditor::CreateChannelMenu()
 
 				//Once the filter exists, hook it up
 				m_createInput.first->SetInput(m_createInput.second, StreamDescriptor(f, 0));
+				m_session.InvalidateFlowGraphIndex();
 
 				auto trig = dynamic_cast<Trigger*>(m_createInput.first);
 				if(trig)
@@ -1708,15 +1722,15 @@ void FilterGraphEditor::FilterMenu(StreamDescriptor stream)
  */
 void FilterGraphEditor::FilterSubmenu(StreamDescriptor stream, const string& name, Filter::Category cat)
 {
-	auto& refs = m_parent->GetSession().GetReferenceFilters();
+	auto& session = m_parent->GetSession();
 
 	if(ImGui::BeginMenu(name.c_str()))
 	{
 		//Find all filters in this category and sort them alphabetically
 		vector<string> sortedNames;
-		for(auto it : refs)
+		for(auto& it : session.GetFilterCategories())
 		{
-			if(it.second->GetCategory() == cat)
+			if(it.second == cat)
 				sortedNames.push_back(it.first);
 		}
 		std::sort(sortedNames.begin(), sortedNames.end());
@@ -1724,17 +1738,20 @@ void FilterGraphEditor::FilterSubmenu(StreamDescriptor stream, const string& nam
 		//Do all of the menu items
 		for(auto fname : sortedNames)
 		{
-			auto it = refs.find(fname);
-			bool valid = false;
-			if(it->second->GetInputCount() == 0)		//No inputs? Always valid
-				valid = true;
-			else
-				valid = it->second->ValidateChannel(0, stream);
-
 			//Hide import filters to avoid cluttering the UI
 			if( (cat == Filter::CAT_GENERATION) && (fname.find("Import") != string::npos))
 				continue;
 
+			//Only entries actually shown need a reference filter
+			auto ref = session.GetReferenceFilter(fname);
+			if(!ref)
+				continue;
+			bool valid = false;
+			if(ref->GetInputCount() == 0)		//No inputs? Always valid
+				valid = true;
+			else
+				valid = ref->ValidateChannel(0, stream);
+
 			if(ImGui::MenuItem(fname.c_str(), nullptr, false, valid))
 			{
 				//Make the filter but don't spawn a properties dialog for it
@@ -1793,6 +1810,7 @@ void FilterGraphEditor::HandleLinkDeletionRequests(Filter*& fReconfigure)
 							group->m_hierInputLinkMap.erase(lid);
 
 							sink.first->SetInput(sink.second, StreamDescriptor(nullptr, 0), true);
+							m_session.InvalidateFlowGraphIndex();
 							fReconfigure = dynamic_cast<Filter*>(sink.first);
 							break;
 						}
@@ -1809,6 +1827,7 @@ void FilterGraphEditor::HandleLinkDeletionRequests(Filter*& fReconfigure)
 				m_linkMap.erase(pins);
 				auto inputPort = m_inputIDMap[CanonicalizePin(pins.second)];
 				inputPort.first->SetInput(inputPort.second, StreamDescriptor(nullptr, 0), true);
+				m_session.InvalidateFlowGraphIndex();
 
 				fReconfigure = dynamic_cast<Filter*>(inputPort.first);
 			}
@@ -2116,6 +2135,15 @@ void FilterGraphEditor::DoNodeForChannel(InstrumentChannel* channel, shared_ptr<
 		m_parent->AddStatusHelp("mouse_lmb_double", "Properties (dialog)");
 		m_parent->AddStatusHelp("mouse_lmb_drag", "Move");
 		m_parent->AddStatusHelp("mouse_rmb", "Properties (popup)");
+
+		//Profiling stats, if we have any
+		auto pit = m_profileStats.find(channel);
+		if(pit != m_profileStats.end())
+		{
+			ax::NodeEditor::Suspend();
+				ProfileTooltip(pit->second);
+			ax::NodeEditor::Resume();
+		}
 	}
 
 	ImGui::PopID();
@@ -2136,6 +2164,15 @@ void FilterGraphEditor::DoNodeForChannel(InstrumentChannel* channel, shared_ptr<
 		headercolor,
 		headerText.c_str());
 
+	//Profiling heatmap: outline the node from green (cheap) to red (slowest filter in the graph)
+	auto pit = m_profileStats.find(channel);
+	if( (pit != m_profileStats.end()) && (m_profileMaxTime > 0) )
+	{
+		float heat = pit->second.GetAverage() / m_profileMaxTime;
+		ImColor heatColor(min(1.0f, 2*heat), min(1.0f, 2*(1 - heat)), 0.0f);
+		bgList->AddRect(pos, pos + size, heatColor, rounding, ImDrawFlags_None, 3);
+	}
+
 	//Draw the force vector
 	if(ImGui::IsKeyDown(ImGuiKey_Q))
 		RenderForceVector(bgList, pos, size, m_nodeForces[id]);
@@ -2182,6 +2219,25 @@ void FilterGraphEditor::RenderForceVector(ImDrawList* list, ImVec2 pos, ImVec2 s
 		width);
 }
 
+/**
+	@brief Shows a tooltip with profiling statistics for a filter
+ */
+void FilterGraphEditor::ProfileTooltip(const FilterProfileStats& stats)
+{
+	Unit fs(Unit::UNIT_FS);
+	Unit counts(Unit::UNIT_COUNTS);
+	Unit bytes(Unit::UNIT_BYTES);
+
+	ImGui::BeginTooltip();
+		ImGui::Text("Last run: %s", fs.PrettyPrint(stats.m_last.m_duration * FS_PER_SECOND).c_str());
+		ImGui::Text("Average: %s", fs.PrettyPrint(stats.GetAverage() * FS_PER_SECOND).c_str());
+		ImGui::Text("Max: %s", fs.PrettyPrint(stats.GetMax() * FS_PER_SECOND).c_str());
+		ImGui::Text("Input samples: %s", counts.PrettyPrint(stats.m_last.m_inputSamples).c_str());
+		ImGui::Text("Output samples: %s", counts.PrettyPrint(stats.m_last.m_outputSamples).c_str());
+		ImGui::Text("Output memory: %s", bytes.PrettyPrint(stats.m_last.m_outputBytes).c_str());
+	ImGui::EndTooltip();
+}
+
 /**
 	@brief Draws an icon showing the function of a node
  */
@@ -2416,11 +2472,10 @@ void FilterGraphEditor::HandleBackgroundContextMenu()
 void FilterGraphEditor::DoAddMenu()
 {
 	//Get all generation filters, sorted alphabetically
-	auto& refs = m_session.GetReferenceFilters();
 	vector<string> sortedNames;
-	for(auto it : refs)
+	for(auto& it : m_session.GetFilterCategories())
 	{
-		if(it.second->GetCategory() == Filter::CAT_GENERATION)
+		if(it.second == Filter::CAT_GENERATION)
 			sortedNames.push_back(it.first);
 	}
 	std::sort(sortedNames.begin(), sortedNames.end());
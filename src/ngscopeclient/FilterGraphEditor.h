@@ -206,6 +206,7 @@ protected:
 	void ClearOldPropertiesDialogs();
 
 	void NodeIcon(InstrumentChannel* chan, ImVec2 iconpos, ImVec2 iconsize, ImDrawList* list);
+	void ProfileTooltip(const FilterProfileStats& stats);
 
 	void FilterMenu(StreamDescriptor src);
 	void FilterSubmenu(StreamDescriptor src, const std::string& name, Filter::Category cat);
@@ -214,6 +215,12 @@ protected:
 	///@brief Session being manipulated
 	Session& m_session;
 
+	///@brief Filter profiling results for this frame (empty if profiling is disabled)
+	std::map<FlowGraphNode*, FilterProfileStats> m_profileStats;
+
+	///@brief Slowest average execution time in m_profileStats, in seconds
+	double m_profileMaxTime;
+
 	///@brief Top level window
 	MainWindow* m_parent;
 
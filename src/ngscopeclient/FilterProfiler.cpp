@@ -0,0 +1,351 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of FilterProfiler
+ */
+#include "ngscopeclient.h"
+#include "FilterProfiler.h"
+
+using namespace std;
+
+///@brief Number of runs to keep per node for rolling statistics
+#define PROFILE_HISTORY_DEPTH 64
+
+static string JsonEscape(const string& str);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FilterProfileStats
+
+/**
+	@brief Records one more execution of the node
+ */
+void FilterProfileStats::Add(const FilterProfileSample& sample)
+{
+	m_last = sample;
+
+	if(m_history.size() < PROFILE_HISTORY_DEPTH)
+		m_history.push_back(sample.m_duration);
+	else
+		m_history[m_next] = sample.m_duration;
+	m_next = (m_next + 1) % PROFILE_HISTORY_DEPTH;
+}
+
+/**
+	@brief Gets the mean execution time over recent runs, in seconds
+ */
+double FilterProfileStats::GetAverage() const
+{
+	if(m_history.empty())
+		return 0;
+
+	double sum = 0;
+	for(auto t : m_history)
+		sum += t;
+	return sum / m_history.size();
+}
+
+/**
+	@brief Gets the worst execution time over recent runs, in seconds
+ */
+double FilterProfileStats::GetMax() const
+{
+	double ret = 0;
+	for(auto t : m_history)
+		ret = max(ret, t);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+FilterProfiler::FilterProfiler()
+	: m_enabled(false)
+	, m_lastRunTime(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Profiling
+
+/**
+	@brief Executes a set of graph nodes one at a time, recording statistics for each
+
+	Must be called with the waveform data mutex held, same as FilterGraphExecutor::RunBlocking().
+ */
+void FilterProfiler::Run(FilterGraphExecutor& executor, const set<FlowGraphNode*>& nodes)
+{
+	//Sort the nodes so everything runs after all of its inputs within the set
+	map<FlowGraphNode*, size_t> pendingInputs;
+	map<FlowGraphNode*, vector<FlowGraphNode*> > consumers;
+	for(auto node : nodes)
+	{
+		size_t count = 0;
+		for(size_t i=0; i<node->GetInputCount(); i++)
+		{
+			auto src = node->GetInput(i).m_channel;
+			if( (src != node) && (nodes.find(src) != nodes.end()) )
+			{
+				consumers[src].push_back(node);
+				count ++;
+			}
+		}
+		pendingInputs[node] = count;
+	}
+
+	vector<FlowGraphNode*> ready;
+	for(auto it : pendingInputs)
+	{
+		if(it.second == 0)
+			ready.push_back(it.first);
+	}
+
+	vector<FlowGraphNode*> order;
+	while(!ready.empty())
+	{
+		auto node = ready.back();
+		ready.pop_back();
+		order.push_back(node);
+
+		for(auto c : consumers[node])
+		{
+			if(--pendingInputs[c] == 0)
+				ready.push_back(c);
+		}
+	}
+
+	//Run each node by itself
+	vector<FilterProfileSample> samples;
+	double tstart = GetTime();
+	for(auto node : order)
+	{
+		set<FlowGraphNode*> single;
+		single.emplace(node);
+
+		double t = GetTime();
+		executor.RunBlocking(single);
+		double dt = GetTime() - t;
+
+		//Only filters actually do anything when executed
+		auto f = dynamic_cast<Filter*>(node);
+		if(!f)
+			continue;
+
+		FilterProfileSample sample;
+		sample.m_name = GetNodeName(node);
+		sample.m_start = t - tstart;
+		sample.m_duration = dt;
+		for(size_t i=0; i<node->GetInputCount(); i++)
+			sample.m_inputSamples += GetSampleCount(node->GetInput(i).GetData());
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+		{
+			auto data = f->GetData(i);
+			sample.m_outputSamples += GetSampleCount(data);
+			sample.m_outputBytes += GetSampleBytes(data);
+		}
+		samples.push_back(sample);
+	}
+
+	//Shouldn't happen, but if there's a cycle let the executor deal with whatever is left
+	if(order.size() != nodes.size())
+	{
+		LogWarning("FilterProfiler: filter graph has a cycle, profiling results will be incomplete\n");
+		set<FlowGraphNode*> remaining;
+		for(auto it : pendingInputs)
+		{
+			if(it.second != 0)
+				remaining.emplace(it.first);
+		}
+		executor.RunBlocking(remaining);
+	}
+	double truntime = GetTime() - tstart;
+
+	//Save results
+	lock_guard<mutex> lock(m_mutex);
+	for(size_t i=0, j=0; i<order.size(); i++)
+	{
+		if(!dynamic_cast<Filter*>(order[i]))
+			continue;
+		m_stats[order[i]].Add(samples[j]);
+		j++;
+	}
+	m_lastRun = move(samples);
+	m_lastRunTime = truntime;
+}
+
+/**
+	@brief Discards all statistics (call when filters are being destroyed en masse)
+ */
+void FilterProfiler::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_stats.clear();
+	m_lastRun.clear();
+	m_lastRunTime = 0;
+}
+
+/**
+	@brief Gets a snapshot of statistics for every profiled node
+
+	Node pointers are only usable as keys: the node may have been deleted since it was last profiled.
+ */
+map<FlowGraphNode*, FilterProfileStats> FilterProfiler::GetStats()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_stats;
+}
+
+/**
+	@brief Gets the wall clock time of the most recent profiled graph run, in seconds
+ */
+double FilterProfiler::GetLastRunTime()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_lastRunTime;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+string FilterProfiler::GetNodeName(FlowGraphNode* node)
+{
+	auto chan = dynamic_cast<InstrumentChannel*>(node);
+	if(chan)
+		return chan->GetDisplayName();
+	return "(unnamed)";
+}
+
+size_t FilterProfiler::GetSampleCount(WaveformBase* wfm)
+{
+	if(!wfm)
+		return 0;
+	return wfm->size();
+}
+
+/**
+	@brief Estimates the size of a waveform's sample buffers
+
+	Analog and digital waveforms are sized exactly. Protocol waveforms store arbitrary symbol types, so they are
+	counted as 8 bytes per sample. Sparse waveforms add 16 bytes per sample for offsets and durations.
+ */
+size_t FilterProfiler::GetSampleBytes(WaveformBase* wfm)
+{
+	if(!wfm)
+		return 0;
+
+	size_t bytesPerSample = 8;
+	if( dynamic_cast<UniformAnalogWaveform*>(wfm) || dynamic_cast<SparseAnalogWaveform*>(wfm) )
+		bytesPerSample = sizeof(float);
+	else if( dynamic_cast<UniformDigitalWaveform*>(wfm) || dynamic_cast<SparseDigitalWaveform*>(wfm) )
+		bytesPerSample = sizeof(bool);
+
+	if(dynamic_cast<SparseWaveformBase*>(wfm))
+		bytesPerSample += 2*sizeof(int64_t);
+
+	return wfm->size() * bytesPerSample;
+}
+
+static string JsonEscape(const string& str)
+{
+	string ret;
+	for(auto c : str)
+	{
+		switch(c)
+		{
+			case '"':
+				ret += "\\\"";
+				break;
+
+			case '\\':
+				ret += "\\\\";
+				break;
+
+			default:
+				if(static_cast<unsigned char>(c) < 0x20)
+				{
+					char tmp[8];
+					snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+					ret += tmp;
+				}
+				else
+					ret += c;
+				break;
+		}
+	}
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Export
+
+/**
+	@brief Writes the most recent profiled graph run as a Chrome trace (chrome://tracing, Perfetto, etc)
+
+	@return True on success, false if the file could not be written or nothing has been profiled yet
+ */
+bool FilterProfiler::ExportChromeTrace(const string& path)
+{
+	vector<FilterProfileSample> samples;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		samples = m_lastRun;
+	}
+	if(samples.empty())
+		return false;
+
+	FILE* fp = fopen(path.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Failed to open %s for writing\n", path.c_str());
+		return false;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for(size_t i=0; i<samples.size(); i++)
+	{
+		auto& s = samples[i];
+		fprintf(fp,
+			"{\"name\":\"%s\",\"cat\":\"filter\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{\"inputSamples\":%zu,\"outputSamples\":%zu,\"outputBytes\":%zu}}%s\n",
+			JsonEscape(s.m_name).c_str(),
+			s.m_start * 1e6,
+			s.m_duration * 1e6,
+			s.m_inputSamples,
+			s.m_outputSamples,
+			s.m_outputBytes,
+			(i+1 < samples.size()) ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+
+	bool ok = (ferror(fp) == 0);
+	fclose(fp);
+	return ok;
+}
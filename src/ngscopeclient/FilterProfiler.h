@@ -0,0 +1,147 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of FilterProfiler
+ */
+#ifndef FilterProfiler_h
+#define FilterProfiler_h
+
+/**
+	@brief Timing and size information for one execution of one graph node
+ */
+class FilterProfileSample
+{
+public:
+	FilterProfileSample()
+	: m_start(0)
+	, m_duration(0)
+	, m_inputSamples(0)
+	, m_outputSamples(0)
+	, m_outputBytes(0)
+	{}
+
+	///@brief Display name of the node at the time it ran
+	std::string m_name;
+
+	///@brief Start time, in seconds since the start of the graph run
+	double m_start;
+
+	///@brief Wall clock execution time, in seconds (includes any GPU work the filter blocked on)
+	double m_duration;
+
+	///@brief Total number of samples across all connected inputs
+	size_t m_inputSamples;
+
+	///@brief Total number of samples across all outputs
+	size_t m_outputSamples;
+
+	///@brief Estimated size of the output sample buffers, in bytes
+	size_t m_outputBytes;
+};
+
+/**
+	@brief Rolling execution statistics for one graph node
+ */
+class FilterProfileStats
+{
+public:
+	FilterProfileStats()
+	: m_next(0)
+	{}
+
+	void Add(const FilterProfileSample& sample);
+
+	double GetAverage() const;
+	double GetMax() const;
+
+	///@brief Most recent execution
+	FilterProfileSample m_last;
+
+	///@brief Recent execution times, in seconds (ring buffer)
+	std::vector<double> m_history;
+
+	///@brief Next slot in m_history to overwrite
+	size_t m_next;
+};
+
+/**
+	@brief Per-node profiling of filter graph execution
+
+	When enabled, Run() executes the requested nodes one at a time in dependency order so that each one's wall time can
+	be attributed to it. This serializes execution, so it is off by default and only turned on while someone is looking
+	at the results.
+ */
+class FilterProfiler
+{
+public:
+	FilterProfiler();
+
+	/**
+		@brief Turns per-node profiling on or off (takes effect on the next graph run)
+	 */
+	void SetEnabled(bool enabled)
+	{ m_enabled = enabled; }
+
+	bool IsEnabled() const
+	{ return m_enabled; }
+
+	void Run(FilterGraphExecutor& executor, const std::set<FlowGraphNode*>& nodes);
+	void Clear();
+
+	std::map<FlowGraphNode*, FilterProfileStats> GetStats();
+	double GetLastRunTime();
+
+	bool ExportChromeTrace(const std::string& path);
+
+	static size_t GetSampleCount(WaveformBase* wfm);
+	static size_t GetSampleBytes(WaveformBase* wfm);
+
+protected:
+	static std::string GetNodeName(FlowGraphNode* node);
+
+	///@brief True if profiling is enabled
+	std::atomic<bool> m_enabled;
+
+	///@brief Mutex protecting everything below
+	std::mutex m_mutex;
+
+	///@brief Rolling statistics for every node that has been profiled
+	std::map<FlowGraphNode*, FilterProfileStats> m_stats;
+
+	///@brief Per-node samples from the most recent graph run, in execution order
+	std::vector<FilterProfileSample> m_lastRun;
+
+	///@brief Wall clock time of the most recent graph run, in seconds
+	double m_lastRunTime;
+};
+
+#endif
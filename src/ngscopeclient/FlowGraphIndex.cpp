@@ -0,0 +1,166 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of FlowGraphIndex
+ */
+#include "../scopehal/scopehal.h"
+#include "FlowGraphIndex.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+FlowGraphIndex::FlowGraphIndex()
+	: m_valid(false)
+	, m_filterCount(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Indexing
+
+/**
+	@brief Rebuilds the consumer lists from scratch
+
+	@param nodes		Every node in the graph (filters plus instrument channels)
+	@param filterCount	Number of filters in existence, used to detect filters created or destroyed behind our back
+ */
+void FlowGraphIndex::Rebuild(const set<FlowGraphNode*>& nodes, size_t filterCount)
+{
+	double tstart = GetTime();
+
+	m_consumers.clear();
+	size_t nedges = 0;
+	for(auto node : nodes)
+	{
+		for(size_t i=0; i<node->GetInputCount(); i++)
+		{
+			auto src = node->GetInput(i).m_channel;
+			if(!src)
+				continue;
+
+			//Filters with several inputs from the same source only need to be listed once
+			auto& consumers = m_consumers[src];
+			if(consumers.empty() || (consumers.back() != node))
+			{
+				consumers.push_back(node);
+				nedges ++;
+			}
+		}
+	}
+
+	m_filterCount = filterCount;
+	m_valid = true;
+
+	LogTrace("Rebuilt flow graph index (%zu nodes, %zu edges) in %.3f ms\n",
+		nodes.size(), nedges, (GetTime() - tstart) * 1000);
+}
+
+/**
+	@brief Finds every node downstream of the given roots
+
+	@param roots	Nodes whose outputs changed
+	@param cone		Set to add downstream nodes to. Roots are not added unless they are themselves downstream of
+					another root.
+ */
+void FlowGraphIndex::GetDownstreamCone(const set<FlowGraphNode*>& roots, set<FlowGraphNode*>& cone) const
+{
+	vector<FlowGraphNode*> pending(roots.begin(), roots.end());
+	while(!pending.empty())
+	{
+		auto node = pending.back();
+		pending.pop_back();
+
+		auto it = m_consumers.find(node);
+		if(it == m_consumers.end())
+			continue;
+
+		for(auto consumer : it->second)
+		{
+			if(cone.emplace(consumer).second)
+				pending.push_back(consumer);
+		}
+	}
+}
+
+/**
+	@brief Finds every node needed to produce a set of outputs
+
+	Doesn't need the index, since it walks inputs rather than consumers.
+
+	@param nodes		Every node which can be evaluated (filters plus instrument channels)
+	@param sinks		Nodes whose outputs are needed
+	@param consumers	Nodes outside the graph which read from it (e.g. triggers). They aren't evaluated, but
+						everything feeding them is.
+
+	@return Every sink in nodes, every node feeding a consumer, and everything upstream of those
+ */
+set<FlowGraphNode*> FlowGraphIndex::GetUpstreamCone(
+	const set<FlowGraphNode*>& nodes,
+	const set<FlowGraphNode*>& sinks,
+	const vector<FlowGraphNode*>& consumers)
+{
+	vector<FlowGraphNode*> pending;
+	for(auto node : sinks)
+	{
+		if(nodes.find(node) != nodes.end())
+			pending.push_back(node);
+	}
+	for(auto node : consumers)
+	{
+		for(size_t i=0; i<node->GetInputCount(); i++)
+		{
+			auto src = node->GetInput(i).m_channel;
+			if(src && (nodes.find(src) != nodes.end()))
+				pending.push_back(src);
+		}
+	}
+
+	set<FlowGraphNode*> cone;
+	while(!pending.empty())
+	{
+		auto node = pending.back();
+		pending.pop_back();
+		if(!cone.emplace(node).second)
+			continue;
+
+		for(size_t i=0; i<node->GetInputCount(); i++)
+		{
+			auto src = node->GetInput(i).m_channel;
+			if(src && (nodes.find(src) != nodes.end()))
+				pending.push_back(src);
+		}
+	}
+
+	return cone;
+}
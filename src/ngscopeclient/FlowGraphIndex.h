@@ -0,0 +1,87 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of FlowGraphIndex
+ */
+#ifndef FlowGraphIndex_h
+#define FlowGraphIndex_h
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/**
+	@brief Cached reverse adjacency of the filter graph
+
+	Maps each node to the nodes consuming its outputs, so the downstream influence cone of a set of dirty nodes can be
+	found by walking forward from them in time proportional to the size of the cone, rather than asking every node in
+	the session whether it is downstream of the dirty set.
+
+	The index does not track edits on its own. Whoever changes the shape of the graph (connecting inputs, creating or
+	deleting filters, adding or removing instruments) must call Invalidate() so the next lookup rebuilds it.
+ */
+class FlowGraphIndex
+{
+public:
+	FlowGraphIndex();
+
+	/**
+		@brief Marks the index as stale so it will be rebuilt before next use
+	 */
+	void Invalidate()
+	{ m_valid = false; }
+
+	bool IsValid(size_t filterCount) const
+	{ return m_valid && (filterCount == m_filterCount); }
+
+	void Rebuild(const std::set<FlowGraphNode*>& nodes, size_t filterCount);
+
+	void GetDownstreamCone(const std::set<FlowGraphNode*>& roots, std::set<FlowGraphNode*>& cone) const;
+
+	static std::set<FlowGraphNode*> GetUpstreamCone(
+		const std::set<FlowGraphNode*>& nodes,
+		const std::set<FlowGraphNode*>& sinks,
+		const std::vector<FlowGraphNode*>& consumers);
+
+protected:
+
+	///@brief Consumers of each node's outputs (every node with at least one input connected to it)
+	std::unordered_map<FlowGraphNode*, std::vector<FlowGraphNode*> > m_consumers;
+
+	///@brief True if m_consumers reflects the current graph
+	bool m_valid;
+
+	///@brief Number of filters in existence when the index was built
+	size_t m_filterCount;
+};
+
+#endif
@@ -37,6 +37,7 @@
 #include "FunctionGeneratorDialog.h"
 
 using namespace std;
+using namespace std::chrono_literals;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
@@ -48,6 +49,7 @@ FunctionGeneratorDialog::FunctionGeneratorDialog(shared_ptr<SCPIFunctionGenerato
 		ImVec2(400, 350))
 	, m_session(session)
 	, m_generator(generator)
+	, m_queue(session->GetInstrumentCommandQueue(generator))
 {
 	Unit hz(Unit::UNIT_HZ);
 	Unit percent(Unit::UNIT_PERCENT);
@@ -108,6 +110,9 @@ FunctionGeneratorDialog::FunctionGeneratorDialog(shared_ptr<SCPIFunctionGenerato
 	m_impedances.push_back(FunctionGenerator::IMPEDANCE_50_OHM);
 	m_impedanceNames.push_back("High-Z");
 	m_impedanceNames.push_back("50Ω");
+
+	m_frequencyFutures.resize(n);
+	m_levelFutures.resize(n);
 }
 
 FunctionGeneratorDialog::~FunctionGeneratorDialog()
@@ -170,34 +175,58 @@ void FunctionGeneratorDialog::DoChannel(size_t i)
 
 	if(ImGui::CollapsingHeader(chname.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
 	{
-		//Check for updates (value changed instrument side since last commit)
-		//TODO: move to background thread? or just rely on clientside caching to make it fast?
-		auto freq = m_generator->GetFunctionChannelFrequency(i);
-		if(freq != m_uiState[i].m_committedFrequency)
+		auto gen = m_generator;
+		auto& state = m_uiState[i];
+
+		//Check for updates (value changed instrument side since last commit).
+		//Only keep one readback in flight so a slow instrument doesn't get buried in queries
+		auto& ffreq = m_frequencyFutures[i];
+		if(ffreq.valid() && (ffreq.wait_for(0s) == future_status::ready) )
+		{
+			auto freq = ffreq.get();
+			if(freq != state.m_committedFrequency)
+			{
+				state.m_committedFrequency = freq;
+				state.m_frequency = hz.PrettyPrint(freq);
+			}
+		}
+		if(!ffreq.valid())
+			ffreq = m_queue->Submit<float>([gen, i]{ return gen->GetFunctionChannelFrequency(i); });
+
+		//Refresh amplitude and offset once an impedance change has gone through
+		auto& flevel = m_levelFutures[i];
+		if(flevel.valid() && (flevel.wait_for(0s) == future_status::ready) )
 		{
-			m_uiState[i].m_committedFrequency = freq;
-			m_uiState[i].m_frequency = hz.PrettyPrint(freq);
+			auto levels = flevel.get();
+			state.m_committedAmplitude = levels.first;
+			state.m_amplitude = volts.PrettyPrint(state.m_committedAmplitude);
+			state.m_committedOffset = levels.second;
+			state.m_offset = volts.PrettyPrint(state.m_committedOffset);
 		}
 
 		ImGui::PushID(chname.c_str());
 
-		if(ImGui::Checkbox("Output Enable", &m_uiState[i].m_outputEnabled))
-			m_generator->SetFunctionChannelActive(i, m_uiState[i].m_outputEnabled);
+		if(ImGui::Checkbox("Output Enable", &state.m_outputEnabled))
+		{
+			bool enable = state.m_outputEnabled;
+			m_queue->SubmitWrite(
+				"enable." + to_string(i), [gen, i, enable]{ gen->SetFunctionChannelActive(i, enable); });
+		}
 		HelpMarker("Turns the output signal from this channel on or off");
 
 		if(m_generator->HasFunctionImpedanceControls(i))
 		{
 			ImGui::SetNextItemWidth(valueWidth);
-			if(Combo("Output Impedance", m_impedanceNames, m_uiState[i].m_impedanceIndex))
+			if(Combo("Output Impedance", m_impedanceNames, state.m_impedanceIndex))
 			{
-				auto& state = m_uiState[i];
-				m_generator->SetFunctionChannelOutputImpedance(i, m_impedances[state.m_impedanceIndex]);
-
 				//Refresh amplitude and offset when changing impedance
-				state.m_committedAmplitude = m_generator->GetFunctionChannelAmplitude(i);
-				state.m_amplitude = volts.PrettyPrint(state.m_committedAmplitude);
-				state.m_committedOffset = m_generator->GetFunctionChannelOffset(i);
-				state.m_offset = volts.PrettyPrint(state.m_committedOffset);
+				auto z = m_impedances[state.m_impedanceIndex];
+				flevel = m_queue->Submit<pair<float, float> >([gen, i, z]
+					{
+						gen->SetFunctionChannelOutputImpedance(i, z);
+						return pair<float, float>(
+							gen->GetFunctionChannelAmplitude(i), gen->GetFunctionChannelOffset(i));
+					});
 			}
 			HelpMarker(
 				"Select the expected load impedance.\n\n"
@@ -207,29 +236,47 @@ void FunctionGeneratorDialog::DoChannel(size_t i)
 		//Amplitude and offset are potentially damaging operations
 		//Require the user to explicitly commit changes before they take effect
 		ImGui::SetNextItemWidth(valueWidth);
-		if(UnitInputWithExplicitApply("Amplitude", m_uiState[i].m_amplitude, m_uiState[i].m_committedAmplitude, volts))
-			m_generator->SetFunctionChannelAmplitude(i, m_uiState[i].m_committedAmplitude);
+		if(UnitInputWithExplicitApply("Amplitude", state.m_amplitude, state.m_committedAmplitude, volts))
+		{
+			float amplitude = state.m_committedAmplitude;
+			m_queue->SubmitWrite(
+				"amplitude." + to_string(i), [gen, i, amplitude]{ gen->SetFunctionChannelAmplitude(i, amplitude); });
+		}
 		HelpMarker("Peak-to-peak amplitude of the generated waveform");
 
 		ImGui::SetNextItemWidth(valueWidth);
-		if(UnitInputWithExplicitApply("Offset", m_uiState[i].m_offset, m_uiState[i].m_committedOffset, volts))
-			m_generator->SetFunctionChannelOffset(i, m_uiState[i].m_committedOffset);
+		if(UnitInputWithExplicitApply("Offset", state.m_offset, state.m_committedOffset, volts))
+		{
+			float offset = state.m_committedOffset;
+			m_queue->SubmitWrite(
+				"offset." + to_string(i), [gen, i, offset]{ gen->SetFunctionChannelOffset(i, offset); });
+		}
 		HelpMarker("DC offset for the waveform above (positive) or below (negative) ground");
 
 		//All other settings apply when user presses enter or focus is lost
 		ImGui::SetNextItemWidth(valueWidth);
-		if(Combo("Waveform", m_uiState[i].m_waveShapeNames, m_uiState[i].m_shapeIndex))
-			m_generator->SetFunctionChannelShape(i, m_uiState[i].m_waveShapes[m_uiState[i].m_shapeIndex]);
+		if(Combo("Waveform", state.m_waveShapeNames, state.m_shapeIndex))
+		{
+			auto shape = state.m_waveShapes[state.m_shapeIndex];
+			m_queue->SubmitWrite("shape." + to_string(i), [gen, i, shape]{ gen->SetFunctionChannelShape(i, shape); });
+		}
 		HelpMarker("Select the type of waveform to generate");
 
 		ImGui::SetNextItemWidth(valueWidth);
-		if(UnitInputWithImplicitApply("Frequency", m_uiState[i].m_frequency, m_uiState[i].m_committedFrequency, hz))
-			m_generator->SetFunctionChannelFrequency(i, m_uiState[i].m_committedFrequency);
+		if(UnitInputWithImplicitApply("Frequency", state.m_frequency, state.m_committedFrequency, hz))
+		{
+			float freq = state.m_committedFrequency;
+			m_queue->SubmitWrite(
+				"frequency." + to_string(i), [gen, i, freq]{ gen->SetFunctionChannelFrequency(i, freq); });
+
+			//Ignore any readback that was queued before the write, it'll have the old value
+			ffreq = future<float>();
+		}
 
 		//Duty cycle controls are not available in all generators
 		if(m_generator->HasFunctionDutyCycleControls(i))
 		{
-			auto waveformType = m_uiState[i].m_waveShapes[m_uiState[i].m_shapeIndex];
+			auto waveformType = state.m_waveShapes[state.m_shapeIndex];
 			bool hasDutyCycle = false;
 			switch(waveformType)
 			{
@@ -245,8 +292,12 @@ void FunctionGeneratorDialog::DoChannel(size_t i)
 			ImGui::SetNextItemWidth(valueWidth);
 			if(!hasDutyCycle)
 				ImGui::BeginDisabled();
-			if(UnitInputWithImplicitApply("Duty Cycle", m_uiState[i].m_dutyCycle, m_uiState[i].m_committedDutyCycle, pct))
-				m_generator->SetFunctionChannelDutyCycle(i, m_uiState[i].m_committedDutyCycle);
+			if(UnitInputWithImplicitApply("Duty Cycle", state.m_dutyCycle, state.m_committedDutyCycle, pct))
+			{
+				float duty = state.m_committedDutyCycle;
+				m_queue->SubmitWrite(
+					"duty." + to_string(i), [gen, i, duty]{ gen->SetFunctionChannelDutyCycle(i, duty); });
+			}
 			if(!hasDutyCycle)
 				ImGui::EndDisabled();
 			HelpMarker("Duty cycle of the waveform, in percent. Not applicable to all waveform types.");
@@ -257,18 +308,20 @@ void FunctionGeneratorDialog::DoChannel(size_t i)
 		if(m_generator->HasFunctionRiseFallTimeControls(i))
 		{
 			ImGui::SetNextItemWidth(valueWidth);
-			if(UnitInputWithImplicitApply("Rise Time", m_uiState[i].m_riseTime, m_uiState[i].m_committedRiseTime, fs))
-				m_generator->SetFunctionChannelRiseTime(i, m_uiState[i].m_committedRiseTime);
+			if(UnitInputWithImplicitApply("Rise Time", state.m_riseTime, state.m_committedRiseTime, fs))
+			{
+				float t = state.m_committedRiseTime;
+				m_queue->SubmitWrite("rise." + to_string(i), [gen, i, t]{ gen->SetFunctionChannelRiseTime(i, t); });
+			}
 
 			ImGui::SetNextItemWidth(valueWidth);
-			if(UnitInputWithImplicitApply("Fall Time", m_uiState[i].m_fallTime, m_uiState[i].m_committedFallTime, fs))
-				m_generator->SetFunctionChannelFallTime(i, m_uiState[i].m_committedFallTime);
+			if(UnitInputWithImplicitApply("Fall Time", state.m_fallTime, state.m_committedFallTime, fs))
+			{
+				float t = state.m_committedFallTime;
+				m_queue->SubmitWrite("fall." + to_string(i), [gen, i, t]{ gen->SetFunctionChannelFallTime(i, t); });
+			}
 		}
 
 		ImGui::PopID();
 	}
-
-	//Push config for dedicated generators
-	if(dynamic_pointer_cast<Oscilloscope>(m_generator) == nullptr)
-		m_generator->GetTransport()->FlushCommandQueue();
 }
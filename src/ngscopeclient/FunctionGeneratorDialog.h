@@ -36,9 +36,10 @@
 #define FunctionGeneratorDialog_h
 
 #include "Dialog.h"
-#include "RollingBuffer.h"
 #include "Session.h"
 
+#include <future>
+
 class FunctionGeneratorChannelUIState
 {
 public:
@@ -98,6 +99,15 @@ protected:
 	///@brief Human readable description of each element in m_impedances
 	std::vector<std::string> m_impedanceNames;
 
+	///@brief Queue for running driver calls in the instrument thread
+	std::shared_ptr<InstrumentCommandQueue> m_queue;
+
+	///@brief Pending readback of each channel's frequency, to catch changes made on the instrument side
+	std::vector<std::future<float> > m_frequencyFutures;
+
+	///@brief Pending readback of each channel's amplitude and offset after an impedance change
+	std::vector<std::future<std::pair<float, float> > > m_levelFutures;
+
 };
 
 
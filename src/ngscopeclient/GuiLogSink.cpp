@@ -1,8 +1,8 @@
 /***********************************************************************************************************************
 *                                                                                                                      *
-* glscopeclient                                                                                                        *
+* ngscopeclient                                                                                                        *
 *                                                                                                                      *
-* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
 * All rights reserved.                                                                                                 *
 *                                                                                                                      *
 * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
@@ -32,18 +32,34 @@
 	@author Andrew D. Zonenberg
 	@brief Implementation of GuiLogSink
  */
-#include "ngscopeclient.h"
+#include "../scopehal/scopehal.h"
 #include "GuiLogSink.h"
 
 using namespace std;
 
+///@brief Number of shards (more than the number of threads which typically log heavily at once)
+static const size_t g_logShardCount = 8;
+
+///@brief Number of threads which have logged so far
+static atomic<uint32_t> g_logThreadCount(0);
+
+///@brief Number of this thread, assigned the first time it logs
+static thread_local uint32_t t_logThread = g_logThreadCount ++;
+
+///@brief Partial line logged by this thread without a trailing newline
+static thread_local string t_unbufferedLine;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-GuiLogSink::GuiLogSink(Severity min_severity)
+GuiLogSink::GuiLogSink(Severity min_severity, size_t shardCapacity)
 	: LogSink(min_severity)
+	, m_shardCapacity(shardCapacity)
+	, m_nextSeq(0)
+	, m_tstart(GetTime())
 {
-
+	for(size_t i=0; i<g_logShardCount; i++)
+		m_shards.push_back(make_unique<Shard>());
 }
 
 GuiLogSink::~GuiLogSink()
@@ -53,9 +69,18 @@ GuiLogSink::~GuiLogSink()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Logging
 
+/**
+	@brief Discards all stored lines
+ */
 void GuiLogSink::Clear()
 {
-	m_lines.clear();
+	for(auto& s : m_shards)
+	{
+		lock_guard<mutex> lock(s->m_mutex);
+		s->m_records.clear();
+		s->m_written = 0;
+		s->m_read = 0;
+	}
 }
 
 void GuiLogSink::Log(Severity severity, const string &msg)
@@ -66,7 +91,7 @@ void GuiLogSink::Log(Severity severity, const string &msg)
 	//Blank lines get special handling
 	if(msg == "\n")
 	{
-		m_lines.push_back("");
+		Append(severity, "");
 		return;
 	}
 
@@ -75,9 +100,9 @@ void GuiLogSink::Log(Severity severity, const string &msg)
 	//No newline? Append to existing buffer
 	if(msg.find('\n') == string::npos)
 	{
-		if(m_unbufferedLine.empty())
-			m_unbufferedLine += indent;
-		m_unbufferedLine += msg;
+		if(t_unbufferedLine.empty())
+			t_unbufferedLine += indent;
+		t_unbufferedLine += msg;
 		return;
 	}
 
@@ -91,15 +116,15 @@ void GuiLogSink::Log(Severity severity, const string &msg)
 			break;
 
 		//If unbuffered line is present, append to it
-		if(!m_unbufferedLine.empty())
+		if(!t_unbufferedLine.empty())
 		{
-			m_lines.push_back(m_unbufferedLine + vec[i]);
-			m_unbufferedLine = "";
+			Append(severity, t_unbufferedLine + vec[i]);
+			t_unbufferedLine = "";
 		}
 
 		//Otherwise append it
 		else
-			m_lines.push_back(indent + vec[i]);
+			Append(severity, indent + vec[i]);
 	}
 }
 
@@ -110,3 +135,79 @@ void GuiLogSink::Log(Severity severity, const char *format, va_list va)
 
 	Log(severity, vstrprintf(format, va));
 }
+
+/**
+	@brief Stores one complete line in the calling thread's shard
+ */
+void GuiLogSink::Append(Severity severity, const string& line)
+{
+	auto& shard = *m_shards[t_logThread % m_shards.size()];
+
+	LogRecord rec;
+	rec.m_timestamp = GetTime();
+	rec.m_severity = severity;
+	rec.m_thread = t_logThread;
+	rec.m_message = line;
+
+	lock_guard<mutex> lock(shard.m_mutex);
+	rec.m_seq = m_nextSeq ++;
+	if(shard.m_records.size() < m_shardCapacity)
+		shard.m_records.push_back(std::move(rec));
+	else
+		shard.m_records[shard.m_written % m_shardCapacity] = std::move(rec);
+	shard.m_written ++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reading
+
+/**
+	@brief Moves lines logged since the last call into a buffer
+
+	Only one thread (normally the GUI thread) may call this. Lines are returned in sequence number order within
+	each call. A line logged by one thread can very occasionally show up one call later than a line another thread
+	logged just after it.
+
+	@param records	Output: new lines (appended)
+
+	@return Number of lines which were overwritten before they could be read
+ */
+size_t GuiLogSink::Drain(vector<LogRecord>& records)
+{
+	size_t lost = 0;
+	size_t first = records.size();
+	for(auto& s : m_shards)
+	{
+		lock_guard<mutex> lock(s->m_mutex);
+
+		//Skip anything already overwritten
+		if( (s->m_written - s->m_read) > m_shardCapacity)
+		{
+			lost += (s->m_written - s->m_read) - m_shardCapacity;
+			s->m_read = s->m_written - m_shardCapacity;
+		}
+
+		for(; s->m_read < s->m_written; s->m_read ++)
+			records.push_back(s->m_records[s->m_read % m_shardCapacity]);
+	}
+
+	//Interleave the shards back into the order lines were logged
+	sort(records.begin() + first, records.end(),
+		[](const LogRecord& a, const LogRecord& b) { return a.m_seq < b.m_seq; });
+
+	return lost;
+}
+
+/**
+	@brief Makes the next Drain() start over from the oldest line still stored
+
+	Used when a new log viewer is opened, so it shows history from before it existed.
+ */
+void GuiLogSink::Rewind()
+{
+	for(auto& s : m_shards)
+	{
+		lock_guard<mutex> lock(s->m_mutex);
+		s->m_read = (s->m_written > m_shardCapacity) ? (s->m_written - m_shardCapacity) : 0;
+	}
+}
@@ -1,8 +1,8 @@
 /***********************************************************************************************************************
 *                                                                                                                      *
-* glscopeclient                                                                                                        *
+* ngscopeclient                                                                                                        *
 *                                                                                                                      *
-* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
 * All rights reserved.                                                                                                 *
 *                                                                                                                      *
 * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
@@ -35,13 +35,48 @@
 #ifndef GuiLogSink_h
 #define GuiLogSink_h
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+	@brief A single line of log output
+ */
+class LogRecord
+{
+public:
+	///@brief Global sequence number, in the order lines were logged
+	uint64_t m_seq;
+
+	///@brief Time the line was logged
+	double m_timestamp;
+
+	///@brief Severity of the message
+	Severity m_severity;
+
+	///@brief Small integer identifying the thread which logged the line (in order of first log message)
+	uint32_t m_thread;
+
+	///@brief Text of the line, without trailing newline
+	std::string m_message;
+};
+
 /**
 	@brief Log sink for displaying logs in the GUI
+
+	Any thread may log. Lines are stored in a fixed number of shards, each a bounded ring buffer with its own lock;
+	each thread always writes to the same shard, so threads logging at the same time rarely contend. Once a shard
+	is full, its oldest lines are overwritten, so memory use is bounded however long the application runs with
+	verbose logging on.
+
+	The GUI thread pulls new lines out with Drain() and keeps its own copy for display.
  */
 class GuiLogSink : public LogSink
 {
 public:
-	GuiLogSink(Severity min_severity = Severity::DEBUG);
+	GuiLogSink(Severity min_severity = Severity::DEBUG, size_t shardCapacity = 65536);
 	virtual ~GuiLogSink() override;
 
 	void Clear();
@@ -49,13 +84,63 @@ public:
 	void Log(Severity severity, const std::string &msg) override;
 	void Log(Severity severity, const char *format, va_list va) override;
 
-	const std::vector<std::string>& GetLines()
-	{ return m_lines; }
+	size_t Drain(std::vector<LogRecord>& records);
+	void Rewind();
+
+	/**
+		@brief Gets the maximum number of lines kept across all shards
+	 */
+	size_t GetCapacity()
+	{ return m_shards.size() * m_shardCapacity; }
+
+	/**
+		@brief Gets the number of lines logged since startup (including ones since overwritten)
+	 */
+	uint64_t GetLineCount()
+	{ return m_nextSeq; }
+
+	/**
+		@brief Gets the time the sink was created, for displaying relative timestamps
+	 */
+	double GetStartTime()
+	{ return m_tstart; }
 
 protected:
-	std::vector<std::string> m_lines;
+	void Append(Severity severity, const std::string& line);
+
+	///@brief One ring buffer of log lines
+	class Shard
+	{
+	public:
+		Shard()
+		: m_written(0)
+		, m_read(0)
+		{}
+
+		///@brief Mutex protecting the shard
+		std::mutex m_mutex;
+
+		///@brief Lines in the shard, indexed by line number modulo capacity (grows up to capacity on demand)
+		std::vector<LogRecord> m_records;
+
+		///@brief Number of lines ever written to this shard
+		uint64_t m_written;
+
+		///@brief Number of lines drained from this shard (or skipped because they were overwritten)
+		uint64_t m_read;
+	};
+
+	///@brief The shards
+	std::vector<std::unique_ptr<Shard> > m_shards;
+
+	///@brief Maximum number of lines in each shard
+	size_t m_shardCapacity;
+
+	///@brief Sequence number for the next line
+	std::atomic<uint64_t> m_nextSeq;
 
-	std::string m_unbufferedLine;
+	///@brief Time the sink was created
+	double m_tstart;
 };
 
 #endif
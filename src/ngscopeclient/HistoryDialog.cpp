@@ -35,6 +35,7 @@
 
 #include "ngscopeclient.h"
 #include "HistoryDialog.h"
+#include "HistoryReprocessor.h"
 #include "MainWindow.h"
 
 using namespace std;
@@ -89,6 +90,9 @@ HistoryDialog::HistoryDialog(HistoryManager& mgr, Session& session, MainWindow&
 
 HistoryDialog::~HistoryDialog()
 {
+	if(m_reprocessor)
+		m_reprocessor->Cancel();
+	m_reprocessor = nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -115,6 +119,40 @@ bool HistoryDialog::DoRender()
 		"Adjust the cap on total history depth, in waveforms.\n"
 		"Large history depths can use significant amounts of RAM with deep memory.");
 
+	//Reprocessing controls
+	if(m_reprocessor && m_reprocessor->IsDone())
+		m_reprocessor = nullptr;
+	if(m_reprocessor)
+	{
+		auto label = to_string(m_reprocessor->GetPointsDone()) + " / " +
+			to_string(m_reprocessor->GetPointCount()) + " points";
+		ImGui::ProgressBar(m_reprocessor->GetProgress(), ImVec2(10*width, 0), label.c_str());
+		ImGui::SameLine();
+		if(ImGui::Button("Cancel"))
+			m_reprocessor->Cancel();
+	}
+	else
+	{
+		if(m_mgr.m_history.empty())
+			ImGui::BeginDisabled();
+		if(ImGui::Button("Reprocess History"))
+			StartReprocessing();
+		if(m_mgr.m_history.empty())
+			ImGui::EndDisabled();
+		HelpMarker(
+			"Run the filter graph over every waveform in history, one at a time, oldest first.\n\n"
+			"Use this after adding a protocol decode or trend filter partway through a session\n"
+			"so its results cover the waveforms captured before it was created.\n"
+			"Each point is processed in turn, so this takes about as long as selecting every point by hand.\n"
+			"The trigger is stopped and can't be rearmed while this runs, and selecting packets in a\n"
+			"protocol analyzer won't jump to their waveform until it finishes.");
+	}
+
+	//Don't allow selecting or deleting history while the reprocessor is walking it
+	bool busy = (m_reprocessor != nullptr);
+	if(busy)
+		ImGui::BeginDisabled();
+
 	if(ImGui::BeginTable("history", 3, flags))
 	{
 		ImGui::TableSetupScrollFreeze(0, 1); //Header row does not scroll
@@ -292,12 +330,29 @@ bool HistoryDialog::DoRender()
 		ImGui::EndTable();
 	}
 
+	if(busy)
+		ImGui::EndDisabled();
+
 	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // UI event handlers
 
+/**
+	@brief Stops the trigger and starts running the filter graph over all of history in the background
+
+	The currently selected point is reloaded once the job finishes.
+ */
+void HistoryDialog::StartReprocessing()
+{
+	m_session.StopTrigger();
+
+	vector<shared_ptr<HistoryPoint> > points(m_mgr.m_history.begin(), m_mgr.m_history.end());
+	m_reprocessor = make_unique<HistoryReprocessor>(m_session, points, m_selectedPoint);
+	m_reprocessor->Start();
+}
+
 /**
 	@brief Applies waveforms from the currently selected history row to the scopes
 
@@ -39,6 +39,7 @@
 #include "Session.h"
 
 class MainWindow;
+class HistoryReprocessor;
 
 /**
 	@brief UI for the history system
@@ -64,7 +65,18 @@ public:
 
 	TimePoint GetSelectedPoint();
 
+	/**
+		@brief Check if history is being reprocessed in the background
+
+		While this is true the reprocessor owns the session's waveforms: nothing else may load history or acquire
+		new waveforms.
+	 */
+	bool IsReprocessing()
+	{ return m_reprocessor != nullptr; }
+
 protected:
+	void StartReprocessing();
+
 	HistoryManager& m_mgr;
 	Session& m_session;
 	MainWindow& m_parent;
@@ -80,6 +92,9 @@ protected:
 
 	///@brief The currently selected marker
 	Marker* m_selectedMarker;
+
+	///@brief Background job re-running the filter graph over history, if one is in progress
+	std::unique_ptr<HistoryReprocessor> m_reprocessor;
 };
 
 #endif
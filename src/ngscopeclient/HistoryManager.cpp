@@ -70,6 +70,32 @@ HistoryPoint::~HistoryPoint()
 				delete wfm;
 		}
 	}
+
+	ClearFilterCache();
+}
+
+/**
+	@brief Gets the total estimated size of our cached filter outputs, in bytes
+ */
+size_t HistoryPoint::GetFilterCacheSize()
+{
+	size_t ret = 0;
+	for(auto& it : m_filterCache)
+		ret += it.second.m_bytes;
+	return ret;
+}
+
+/**
+	@brief Frees all of our cached filter outputs
+ */
+void HistoryPoint::ClearFilterCache()
+{
+	for(auto& it : m_filterCache)
+	{
+		for(auto w : it.second.m_outputs)
+			delete w;
+	}
+	m_filterCache.clear();
 }
 
 /**
@@ -104,6 +130,13 @@ void HistoryPoint::LoadHistoryToSession(Session& session)
 	//We don't want to keep capturing if we're trying to look at a historical waveform. That would be a bit silly.
 	session.StopTrigger();
 
+	//Nobody else can be looking at waveforms while we swap them out
+	lock_guard<shared_mutex> lock(session.GetWaveformDataMutex());
+
+	//Save filter outputs for whatever point is loaded now, so we don't have to recompute them if we come back to it
+	auto& history = session.GetHistory();
+	history.StashFilterOutputs(this);
+
 	//Go over each scope in the session and load the relevant history
 	//We do this rather than just looping over the scopes in the history so that we can handle missing data.
 	auto scopes = session.GetScopes();
@@ -149,6 +182,9 @@ void HistoryPoint::LoadHistoryToSession(Session& session)
 			}
 		}
 	}
+
+	//Put back any filter outputs we saved last time we were loaded, and tell the session not to recompute them
+	session.SetMemoizedFilters(m_time, history.RestoreFilterOutputs(this));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -196,6 +232,9 @@ void HistoryManager::LoadEmptyHistoryToSession(Session& session)
 	//We don't want to keep capturing if we're trying to look at a historical waveform. That would be a bit silly.
 	session.StopTrigger();
 
+	//Nothing was restored, and whatever was restored for the previous point doesn't apply any more
+	session.ClearMemoizedFilters();
+
 	//Set all channels' data to null
 	auto scopes = session.GetScopes();
 	for(auto scope : scopes)
@@ -363,3 +402,236 @@ bool HistoryManager::HasHistory(TimePoint t)
 
 	return false;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Filter output memoization
+
+/**
+	@brief Hashes everything that affects a filter's output other than the input data itself
+
+	This covers the filter type, every parameter, and which streams are connected to each input.
+ */
+uint64_t HistoryManager::GetFilterConfigHash(Filter* f)
+{
+	string config = f->GetProtocolDisplayName();
+	for(auto it = f->GetParamBegin(); it != f->GetParamEnd(); it++)
+		config += "|" + it->first + "=" + it->second.ToString();
+	for(size_t i=0; i<f->GetInputCount(); i++)
+	{
+		auto in = f->GetInput(i);
+		config += "|" + to_string(reinterpret_cast<uintptr_t>(in.m_channel)) + ":" + to_string(in.m_stream);
+	}
+
+	return hash<string>{}(config);
+}
+
+/**
+	@brief Checks if a filter's outputs are a pure function of its inputs and configuration, and safe to cache
+
+	Protocol decoders are excluded because their packets are cached separately by the PacketManager and it expects to
+	see every run. Export filters have side effects. Eye patterns, histograms, averages, waterfalls, trends and other
+	stateful filters accumulate across waveforms, so an old output is not what they would produce now. Scalar outputs
+	aren't stored in a waveform so can't be saved.
+ */
+bool HistoryManager::IsMemoizable(Filter* f)
+{
+	if( (f->GetInputCount() == 0) || (f->GetStreamCount() == 0) )
+		return false;
+	if(dynamic_cast<PacketDecoder*>(f) || dynamic_cast<ExportFilter*>(f) || Session::IsStatefulFilter(f))
+		return false;
+
+	for(size_t i=0; i<f->GetStreamCount(); i++)
+	{
+		if(StreamDescriptor(f, i).GetType() == Stream::STREAM_TYPE_ANALOG_SCALAR)
+			return false;
+	}
+	return true;
+}
+
+/**
+	@brief Detaches current filter outputs and saves them in the history point they were computed from
+
+	Outputs are only saved if every output is timestamped with the same history point, and the filter hasn't been
+	reconfigured since they were computed. Must be called with the waveform data mutex held.
+
+	@param target	The point about to be loaded. Its cache is left alone by the memory budget.
+ */
+void HistoryManager::StashFilterOutputs(HistoryPoint* target)
+{
+	auto filters = Filter::GetAllInstances();
+	for(auto f : filters)
+	{
+		if(!IsMemoizable(f))
+			continue;
+
+		//Make sure the outputs are still up to date with the configuration
+		uint64_t hash = GetFilterConfigHash(f);
+		uint64_t lastRunHash;
+		if(!m_session.GetFilterOutputHash(f, lastRunHash) || (lastRunHash != hash) )
+			continue;
+
+		//Figure out which point they came from
+		FilterOutputCacheEntry entry;
+		entry.m_configHash = hash;
+		bool ok = true;
+		TimePoint t(0, 0);
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+		{
+			auto data = f->GetData(i);
+			if(!data)
+			{
+				ok = false;
+				break;
+			}
+
+			TimePoint tdata(data->m_startTimestamp, data->m_startFemtoseconds);
+			if(i == 0)
+				t = tdata;
+			else if(t != tdata)
+			{
+				ok = false;
+				break;
+			}
+
+			entry.m_outputs.push_back(data);
+			entry.m_bytes += FilterProfiler::GetSampleBytes(data);
+		}
+		if(!ok)
+			continue;
+		auto point = GetHistory(t);
+		if(!point || (point.get() == target) )
+			continue;
+
+		//Take ownership of the outputs. The filter will allocate new ones next time it runs.
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+			f->Detach(i);
+
+		auto it = point->m_filterCache.find(f);
+		if(it != point->m_filterCache.end())
+		{
+			for(auto w : it->second.m_outputs)
+				delete w;
+		}
+		point->m_filterCache[f] = entry;
+	}
+
+	EnforceFilterCacheBudget(target);
+}
+
+/**
+	@brief Frees cached filter outputs, oldest history first, until we're under the configured memory budget
+
+	@param keep	History point whose cache should not be evicted
+ */
+void HistoryManager::EnforceFilterCacheBudget(HistoryPoint* keep)
+{
+	size_t budget = m_session.GetPreferences().GetReal("Miscellaneous.History.filter_cache_size");
+
+	size_t total = 0;
+	for(auto& pt : m_history)
+		total += pt->GetFilterCacheSize();
+
+	for(auto& pt : m_history)
+	{
+		if(total <= budget)
+			break;
+		if(pt.get() == keep)
+			continue;
+
+		size_t size = pt->GetFilterCacheSize();
+		if(size == 0)
+			continue;
+
+		LogTrace("Evicting %zu bytes of cached filter outputs from %s\n", size, pt->m_time.PrettyPrint().c_str());
+		pt->ClearFilterCache();
+		total -= size;
+	}
+}
+
+/**
+	@brief Checks if a filter's cached outputs at a history point are still valid
+
+	They are valid if the configuration hasn't changed and every input is either a scope channel that the point has
+	data for, or another filter with valid cached outputs.
+ */
+bool HistoryManager::IsRestorable(HistoryPoint* point, Filter* f, map<Filter*, bool>& memo)
+{
+	auto mit = memo.find(f);
+	if(mit != memo.end())
+		return mit->second;
+	memo[f] = false;
+
+	auto it = point->m_filterCache.find(f);
+	if(it == point->m_filterCache.end())
+		return false;
+	if(it->second.m_outputs.size() != f->GetStreamCount())
+		return false;
+	if(it->second.m_configHash != GetFilterConfigHash(f))
+		return false;
+
+	for(size_t i=0; i<f->GetInputCount(); i++)
+	{
+		auto in = f->GetInput(i);
+		if(!in.m_channel)
+			continue;
+
+		auto upstream = dynamic_cast<Filter*>(in.m_channel);
+		if(upstream)
+		{
+			if(!IsRestorable(point, upstream, memo))
+				return false;
+			continue;
+		}
+
+		auto ochan = dynamic_cast<OscilloscopeChannel*>(in.m_channel);
+		if(!ochan)
+			return false;
+		bool found = false;
+		for(auto& jt : point->m_history)
+		{
+			if(jt.second.find(in) != jt.second.end())
+			{
+				found = true;
+				break;
+			}
+		}
+		if(!found)
+			return false;
+	}
+
+	memo[f] = true;
+	return true;
+}
+
+/**
+	@brief Loads valid cached filter outputs from a history point back into their filters
+
+	Must be called with the waveform data mutex held, after the point's scope data has been loaded.
+
+	@return Filters that were restored, and the configuration hash their outputs were computed with
+ */
+map<Filter*, uint64_t> HistoryManager::RestoreFilterOutputs(HistoryPoint* point)
+{
+	map<Filter*, uint64_t> restored;
+	if(point->m_filterCache.empty())
+		return restored;
+
+	map<Filter*, bool> memo;
+	auto filters = Filter::GetAllInstances();
+	for(auto f : filters)
+	{
+		if(!IsRestorable(point, f, memo))
+			continue;
+
+		//Hand the waveforms back to the filter (this frees whatever it had before)
+		auto it = point->m_filterCache.find(f);
+		for(size_t i=0; i<it->second.m_outputs.size(); i++)
+			f->SetData(it->second.m_outputs[i], i);
+
+		restored[f] = it->second.m_configHash;
+		point->m_filterCache.erase(it);
+	}
+
+	LogTrace("Restored cached outputs for %zu filters\n", restored.size());
+	return restored;
+}
@@ -40,6 +40,27 @@
 //Waveform history for a single instrument
 typedef std::map<StreamDescriptor, WaveformBase*> WaveformHistory;
 
+/**
+	@brief Saved outputs of one filter at one point in history
+ */
+class FilterOutputCacheEntry
+{
+public:
+	FilterOutputCacheEntry()
+	: m_configHash(0)
+	, m_bytes(0)
+	{}
+
+	///@brief Configuration hash of the filter when the outputs were computed
+	uint64_t m_configHash;
+
+	///@brief Output waveforms, indexed by stream (owned by the cache)
+	std::vector<WaveformBase*> m_outputs;
+
+	///@brief Estimated size of m_outputs, in bytes
+	size_t m_bytes;
+};
+
 /**
 	@brief A single point of waveform history
  */
@@ -63,7 +84,13 @@ public:
 	///@brief Waveform data
 	std::map<std::shared_ptr<Oscilloscope>, WaveformHistory> m_history;
 
+	///@brief Filter outputs computed from this point, saved while another point is loaded
+	std::map<Filter*, FilterOutputCacheEntry> m_filterCache;
+
 	void LoadHistoryToSession(Session& session);
+
+	size_t GetFilterCacheSize();
+	void ClearFilterCache();
 };
 
 /**
@@ -95,6 +122,12 @@ public:
 
 	TimePoint GetMostRecentPoint();
 
+	static uint64_t GetFilterConfigHash(Filter* f);
+	static bool IsMemoizable(Filter* f);
+
+	void StashFilterOutputs(HistoryPoint* target);
+	std::map<Filter*, uint64_t> RestoreFilterOutputs(HistoryPoint* point);
+
 	void clear()
 	{ m_history.clear(); }
 
@@ -104,6 +137,9 @@ public:
 	int m_maxDepth;
 
 protected:
+	bool IsRestorable(HistoryPoint* point, Filter* f, std::map<Filter*, bool>& memo);
+	void EnforceFilterCacheBudget(HistoryPoint* keep);
+
 	Session& m_session;
 };
 
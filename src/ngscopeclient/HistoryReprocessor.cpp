@@ -0,0 +1,126 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of HistoryReprocessor
+ */
+#include "ngscopeclient.h"
+#include "HistoryReprocessor.h"
+#include "Session.h"
+#include "pthread_compat.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Creates a reprocessing job (call Start() to begin)
+
+	@param session		The session to reprocess
+	@param points		History points to run the filter graph over, oldest first
+	@param finalPoint	History point to load once we're done, normally whatever the user had selected
+ */
+HistoryReprocessor::HistoryReprocessor(
+	Session& session,
+	const vector<shared_ptr<HistoryPoint> >& points,
+	shared_ptr<HistoryPoint> finalPoint)
+	: m_session(session)
+	, m_points(points)
+	, m_finalPoint(finalPoint)
+	, m_pointsDone(0)
+	, m_cancel(false)
+	, m_done(false)
+{
+}
+
+HistoryReprocessor::~HistoryReprocessor()
+{
+	if(m_thread)
+	{
+		m_cancel = true;
+		m_thread->join();
+	}
+	m_thread = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Processing
+
+/**
+	@brief Starts the job in a background thread
+ */
+void HistoryReprocessor::Start()
+{
+	m_thread = make_unique<thread>([this]
+		{
+			pthread_setname_np_compat("HistoryReproc");
+			Run();
+		});
+}
+
+/**
+	@brief Thread body: loads and processes each point in turn
+ */
+void HistoryReprocessor::Run()
+{
+	LogTrace("Reprocessing %zu history points\n", m_points.size());
+	double tstart = GetTime();
+
+	for(auto& point : m_points)
+	{
+		if(m_cancel)
+			break;
+
+		//Run everything, even filters nobody is looking at right now, so trends and decodes cover the full history
+		point->LoadHistoryToSession(m_session);
+		m_session.RefreshAllFilters(true);
+		{
+			shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex());
+			m_session.GetMeasurementStatistics().Record(point->m_time);
+		}
+
+		m_pointsDone ++;
+	}
+
+	//Put things back the way they were
+	if(m_finalPoint)
+		m_finalPoint->LoadHistoryToSession(m_session);
+	m_session.RefreshAllFiltersNonblocking();
+
+	LogTrace("Reprocessed %zu of %zu history points in %.3f sec%s\n",
+		m_pointsDone.load(),
+		m_points.size(),
+		GetTime() - tstart,
+		m_cancel ? " (cancelled)" : "");
+
+	m_done = true;
+}
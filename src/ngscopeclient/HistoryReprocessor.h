@@ -0,0 +1,121 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of HistoryReprocessor
+ */
+#ifndef HistoryReprocessor_h
+#define HistoryReprocessor_h
+
+class Session;
+class HistoryPoint;
+
+/**
+	@brief Runs the filter graph over every point in history, oldest first, in the background
+
+	Used after adding a decode or measurement partway through a capture session, so protocol analyzers and trend
+	filters cover the whole history rather than only waveforms acquired after the filter was created.
+
+	Points are loaded and processed one at a time through the session's normal refresh path, so protocol decoders
+	feed their PacketManagers exactly as they would for a live waveform. The waveform data lock is released between
+	points, so the GUI keeps running while the job is in progress.
+
+	This is strictly sequential: filter instances carry per-instance state (trend accumulators, packet lists, GPU
+	buffers), so there are no independent graph contexts to run points on concurrently. The job takes roughly as long
+	as stepping through each point by hand; what it saves is the clicking, not wall clock time.
+ */
+class HistoryReprocessor
+{
+public:
+	HistoryReprocessor(
+		Session& session,
+		const std::vector<std::shared_ptr<HistoryPoint> >& points,
+		std::shared_ptr<HistoryPoint> finalPoint);
+	virtual ~HistoryReprocessor();
+
+	void Start();
+
+	/**
+		@brief Requests that the job stop after the current point
+	 */
+	void Cancel()
+	{ m_cancel = true; }
+
+	/**
+		@brief Returns true once the job has finished (completed or cancelled)
+	 */
+	bool IsDone()
+	{ return m_done.load(); }
+
+	/**
+		@brief Gets the fraction of points processed so far
+	 */
+	float GetProgress()
+	{ return m_points.empty() ? 1 : static_cast<float>(m_pointsDone.load()) / m_points.size(); }
+
+	/**
+		@brief Gets the number of points processed so far
+	 */
+	size_t GetPointsDone()
+	{ return m_pointsDone.load(); }
+
+	/**
+		@brief Gets the number of points to process
+	 */
+	size_t GetPointCount()
+	{ return m_points.size(); }
+
+protected:
+	void Run();
+
+	///@brief The session being reprocessed
+	Session& m_session;
+
+	///@brief Points to process, oldest first
+	std::vector<std::shared_ptr<HistoryPoint> > m_points;
+
+	///@brief Point to leave loaded when we're done (may be null)
+	std::shared_ptr<HistoryPoint> m_finalPoint;
+
+	///@brief Number of points processed so far
+	std::atomic<size_t> m_pointsDone;
+
+	///@brief Set to request cancellation
+	std::atomic<bool> m_cancel;
+
+	///@brief Set when the job has finished
+	std::atomic<bool> m_done;
+
+	///@brief Worker thread
+	std::unique_ptr<std::thread> m_thread;
+};
+
+#endif
@@ -0,0 +1,144 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of InstrumentCommandQueue
+ */
+#include "../scopehal/scopehal.h"
+#include "InstrumentCommandQueue.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+InstrumentCommandQueue::InstrumentCommandQueue()
+	: m_executed(0)
+	, m_coalesced(0)
+{
+}
+
+/**
+	@brief Discards any commands which haven't run yet
+
+	Futures for discarded commands report std::future_errc::broken_promise.
+ */
+InstrumentCommandQueue::~InstrumentCommandQueue()
+{
+	Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queueing
+
+/**
+	@brief Queues a write which only needs its most recent value applied
+
+	If a command with the same key is already waiting, and nothing submitted with Submit() has been queued since
+	then, the pending command is dropped. Either way the write is appended to the queue, so it still runs after
+	every write submitted before it (e.g. A1, B, A2 runs as B, A2, never A2, B).
+
+	@param key	Identifies the setting being written, e.g. "voltage.3" for the voltage of channel 3
+	@param fn	The driver call to make
+ */
+void InstrumentCommandQueue::SubmitWrite(const string& key, function<void()> fn)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	for(auto it = m_commands.rbegin(); it != m_commands.rend(); it++)
+	{
+		//Don't reorder writes across a command that might depend on them
+		if(it->m_key.empty())
+			break;
+
+		if(it->m_key == key)
+		{
+			m_commands.erase(next(it).base());
+			m_coalesced ++;
+			break;
+		}
+	}
+
+	m_commands.push_back(Command(key, fn));
+}
+
+/**
+	@brief Appends a command to the queue
+ */
+void InstrumentCommandQueue::Push(const string& key, function<void()> fn)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_commands.push_back(Command(key, fn));
+}
+
+/**
+	@brief Discards all commands which haven't run yet
+ */
+void InstrumentCommandQueue::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_commands.clear();
+}
+
+/**
+	@brief Gets the number of commands waiting to run
+ */
+size_t InstrumentCommandQueue::GetDepth()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_commands.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Execution
+
+/**
+	@brief Runs all queued commands, in order
+
+	Must only be called from the thread that owns the instrument. Commands submitted while this is running are
+	left for the next call, so a dialog which keeps the queue busy can't starve the rest of the polling loop.
+
+	@return Number of commands executed
+ */
+size_t InstrumentCommandQueue::Service()
+{
+	deque<Command> commands;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		commands.swap(m_commands);
+	}
+
+	for(auto& c : commands)
+		c.m_fn();
+
+	m_executed += commands.size();
+	return commands.size();
+}
@@ -0,0 +1,128 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of InstrumentCommandQueue
+ */
+#ifndef InstrumentCommandQueue_h
+#define InstrumentCommandQueue_h
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+	@brief Queue of driver calls to be executed by an instrument's thread rather than the GUI thread
+
+	Dialogs submit closures which call the driver, and get a std::future back for any result they need. The
+	instrument thread calls Service() each time around its polling loop to run everything that's queued, in
+	submission order.
+
+	Writes which only ever need the most recent value (slider drags, text boxes updated on every keystroke) can be
+	submitted with a key via SubmitWrite(). If a write with the same key is still waiting to run, it's dropped and
+	the new write goes to the tail, so only one round trip is queued and writes to other settings keep their order.
+ */
+class InstrumentCommandQueue
+{
+public:
+	InstrumentCommandQueue();
+	virtual ~InstrumentCommandQueue();
+
+	/**
+		@brief Queues a driver call and returns a future for its result
+
+		Commands submitted this way are never coalesced, and act as a barrier for coalescing of later writes.
+	 */
+	template<class T>
+	std::future<T> Submit(std::function<T()> fn)
+	{
+		auto task = std::make_shared<std::packaged_task<T()> >(fn);
+		auto ret = task->get_future();
+		Push("", [task]() { (*task)(); });
+		return ret;
+	}
+
+	void SubmitWrite(const std::string& key, std::function<void()> fn);
+
+	size_t Service();
+	void Clear();
+
+	size_t GetDepth();
+
+	/**
+		@brief Gets the number of commands executed since the queue was created
+	 */
+	uint64_t GetExecutedCount()
+	{ return m_executed; }
+
+	/**
+		@brief Gets the number of writes dropped because a newer write with the same key replaced them
+	 */
+	uint64_t GetCoalescedCount()
+	{ return m_coalesced; }
+
+protected:
+	void Push(const std::string& key, std::function<void()> fn);
+
+	///@brief A single queued driver call
+	class Command
+	{
+	public:
+		Command(const std::string& key, std::function<void()> fn)
+		: m_key(key)
+		, m_fn(fn)
+		{}
+
+		///@brief Coalescing key (empty if the command must not be coalesced)
+		std::string m_key;
+
+		///@brief The call to make
+		std::function<void()> m_fn;
+	};
+
+	///@brief Mutex protecting m_commands
+	std::mutex m_mutex;
+
+	///@brief Commands waiting to be run, oldest first
+	std::deque<Command> m_commands;
+
+	///@brief Number of commands executed
+	std::atomic<uint64_t> m_executed;
+
+	///@brief Number of writes replaced by a newer write
+	std::atomic<uint64_t> m_coalesced;
+};
+
+#endif
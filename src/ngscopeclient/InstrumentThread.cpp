@@ -64,18 +64,33 @@ void InstrumentThread(InstrumentThreadArgs args)
 	auto meterstate = args.meterstate;
 	auto bertstate = args.bertstate;
 	auto psustate = args.psustate;
+	auto scheduler = args.scheduler;
 
 	while(!*args.shuttingDown)
 	{
-		//Flush any pending commands
-		inst->GetTransport()->FlushCommandQueue();
+		//If a BERT scan is running, the scan thread owns the driver until it finishes.
+		//Leave dialog commands queued (coalescing any repeated writes) and skip polling until then.
+		unique_lock<mutex> driverLock;
+		if(bert)
+			driverLock = unique_lock<mutex>(bertstate->m_scanQueue->GetDriverMutex(), try_to_lock);
+		bool driverBusy = bert && !driverLock.owns_lock();
+
+		//Run anything the GUI asked us to do, then flush any pending commands
+		if(!driverBusy)
+		{
+			args.cmdqueue->Service();
+			inst->GetTransport()->FlushCommandQueue();
+		}
 
 		//Scope processing
 		if(scope)
 		{
 			//If the queue is too big, stop grabbing data
-			size_t npending = scope->GetPendingWaveformCount();
-			if(npending > 5)
+			//(unless the group is configured to drop triggers instead, then make room and keep going)
+			shared_ptr<TriggerGroup> group;
+			if(scope->HasPendingWaveforms())
+				group = session->GetTriggerGroupForScope(scope);
+			if(group && group->IsQueueFull(scope) && !group->TrimPendingWaveforms(scope))
 			{
 				LogTrace("Queue is too big, sleeping\n");
 				this_thread::sleep_for(chrono::milliseconds(5));
@@ -98,12 +113,16 @@ void InstrumentThread(InstrumentThreadArgs args)
 			}
 		}
 
-		//Always acquire data from non-scope instruments
-		else
+		//Poll non-scope instruments (and non-scope functions of scopes) as often as someone needs the data
+		double now = GetTime();
+		bool pollDue = (!scope || psu || load || meter) && !driverBusy && scheduler->IsPollDue(now);
+		bool statusDue = pollDue && scheduler->IsStatusPollDue();
+		bool changed = false;
+		if(pollDue && !scope)
 			inst->AcquireData();
 
 		//Populate scalar channel and do other instrument-specific processing
-		if(psu)
+		if(psu && pollDue)
 		{
 			//Poll status
 			for(size_t i=0; i<psu->GetChannelCount(); i++)
@@ -113,41 +132,60 @@ void InstrumentThread(InstrumentThreadArgs args)
 				if(!pchan)
 					continue;
 
-				psustate->m_channelVoltage[i] = pchan->GetVoltageMeasured();
-				psustate->m_channelCurrent[i] = pchan->GetCurrentMeasured();
-				psustate->m_channelConstantCurrent[i] = psu->IsPowerConstantCurrent(i);
-				psustate->m_channelFuseTripped[i] = psu->GetPowerOvercurrentShutdownTripped(i);
+				float v = pchan->GetVoltageMeasured();
+				float a = pchan->GetCurrentMeasured();
+				changed |= (psustate->m_channelVoltage[i].exchange(v) != v);
+				changed |= (psustate->m_channelCurrent[i].exchange(a) != a);
+				psustate->m_voltageHistory[i]->Push(now, v);
+				psustate->m_currentHistory[i]->Push(now, a);
+
+				//Mode and fault flags change rarely, so query them less often than the measurements
+				if(statusDue)
+				{
+					bool cc = psu->IsPowerConstantCurrent(i);
+					bool tripped = psu->GetPowerOvercurrentShutdownTripped(i);
+					changed |= (psustate->m_channelConstantCurrent[i].exchange(cc) != cc);
+					changed |= (psustate->m_channelFuseTripped[i].exchange(tripped) != tripped);
+				}
 
 				session->MarkChannelDirty(pchan);
 			}
 			psustate->m_firstUpdateDone = true;
 		}
-		if(load)
+		if(load && pollDue)
 		{
 			for(size_t i=0; i<load->GetChannelCount(); i++)
 			{
 				auto lchan = dynamic_cast<LoadChannel*>(load->GetChannel(i));
 
-				loadstate->m_channelVoltage[i] = lchan->GetScalarValue(LoadChannel::STREAM_VOLTAGE_MEASURED);
-				loadstate->m_channelCurrent[i] = lchan->GetScalarValue(LoadChannel::STREAM_CURRENT_MEASURED);
+				float v = lchan->GetScalarValue(LoadChannel::STREAM_VOLTAGE_MEASURED);
+				float a = lchan->GetScalarValue(LoadChannel::STREAM_CURRENT_MEASURED);
+				changed |= (loadstate->m_channelVoltage[i].exchange(v) != v);
+				changed |= (loadstate->m_channelCurrent[i].exchange(a) != a);
+				loadstate->m_voltageHistory[i]->Push(now, v);
+				loadstate->m_currentHistory[i]->Push(now, a);
 
 				session->MarkChannelDirty(lchan);
 			}
 			loadstate->m_firstUpdateDone = true;
 		}
-		if(meter)
+		if(meter && pollDue)
 		{
 			auto chan = dynamic_cast<MultimeterChannel*>(meter->GetChannel(meter->GetCurrentMeterChannel()));
 			if(chan)
 			{
-				meterstate->m_primaryMeasurement = chan->GetPrimaryValue();
-				meterstate->m_secondaryMeasurement = chan->GetSecondaryValue();
+				float pri = chan->GetPrimaryValue();
+				float sec = chan->GetSecondaryValue();
+				changed |= (meterstate->m_primaryMeasurement.exchange(pri) != pri);
+				changed |= (meterstate->m_secondaryMeasurement.exchange(sec) != sec);
+				meterstate->m_primaryHistory->Push(now, pri);
+				meterstate->m_secondaryHistory->Push(now, sec);
 				meterstate->m_firstUpdateDone = true;
 
 				session->MarkChannelDirty(chan);
 			}
 		}
-		if(misc || rfgen || bert)
+		if( (misc || rfgen || bert) && pollDue)
 		{
 			for(size_t i=0; i<inst->GetChannelCount(); i++)
 			{
@@ -155,49 +193,61 @@ void InstrumentThread(InstrumentThreadArgs args)
 				if(chan)
 					session->MarkChannelDirty(chan);
 			}
+
+			//We don't look at BERT readings here, so assume they changed (real time BER is rarely static)
+			if(bert)
+				changed = true;
 		}
+		if(pollDue)
+			scheduler->OnPollComplete(now, GetTime(), changed);
+
 		if(bert)
 		{
-			//Check if we have any pending acquisition requests
+			//Hand any newly requested scans to the scan thread so this loop keeps running while they do
+			auto scans = bertstate->m_scanQueue;
 			for(size_t i=0; i<bert->GetChannelCount(); i++)
 			{
 				if(bertstate->m_horzBathtubScanPending[i].exchange(false))
 				{
 					Unit fs(Unit::UNIT_FS);
-					auto expected = bert->GetExpectedBathtubCaptureTime(i);
-					LogTrace("Starting bathtub scan, expecting to take %s\n", fs.PrettyPrint(expected).c_str());
-
-					double start = GetTime();
-					bert->MeasureHBathtub(i);
-					double dt = (GetTime() - start) * FS_PER_SECOND;
-
-					LogTrace("Scan actually took %s\n", fs.PrettyPrint(dt).c_str());
+					LogTrace("Queueing bathtub scan, expecting to take %s\n",
+						fs.PrettyPrint(bert->GetExpectedBathtubCaptureTime(i)).c_str());
+					scans->Submit(i, BERTScanQueue::SCAN_HBATHTUB, [bert, i]{ bert->MeasureHBathtub(i); });
 				}
 
 				if(bertstate->m_eyeScanPending[i].exchange(false))
 				{
 					Unit fs(Unit::UNIT_FS);
-					auto expected = bert->GetExpectedEyeCaptureTime(i);
-					LogTrace("Starting eye scan, expecting to take %s\n", fs.PrettyPrint(expected).c_str());
-
-					double start = GetTime();
-					bert->MeasureEye(i);
-					double dt = (GetTime() - start) * FS_PER_SECOND;
-
-					LogTrace("Scan actually took %s\n", fs.PrettyPrint(dt).c_str());
+					LogTrace("Queueing eye scan, expecting to take %s\n",
+						fs.PrettyPrint(bert->GetExpectedEyeCaptureTime(i)).c_str());
+					scans->Submit(i, BERTScanQueue::SCAN_EYE, [bert, i]{ bert->MeasureEye(i); });
 				}
 			}
 
+			//Pick up results from finished scans.
+			//The driver writes the channel's data during the scan without any lock we can take, so don't look at it
+			//until the scan is done.
+			for(auto id : scans->PopCompleted())
+				session->MarkChannelDirty(bert->GetChannel(id.first));
+
 			bertstate->m_firstUpdateDone = true;
 		}
 
+		//Let the scan thread start any scan we just queued
+		if(driverLock.owns_lock())
+			driverLock.unlock();
+
 		//TODO: does this make sense to do in the instrument thread?
 		session->RefreshDirtyFiltersNonblocking();
 
-		//Rate limit to 100 Hz to avoid saturating CPU with polls
+		//Run the loop at 100 Hz so queued commands go out promptly, even when the scheduler has slowed polling
 		//(this also provides a yield point for the gui thread to get mutex ownership etc)
 		this_thread::sleep_for(chrono::milliseconds(10));
 	}
 
+	//Don't start any more scans (one already running will finish in the background)
+	if(bertstate)
+		bertstate->m_scanQueue->Clear();
+
 	LogTrace("Shutting down instrument thread\n");
 }
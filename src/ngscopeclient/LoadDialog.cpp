@@ -50,6 +50,8 @@ LoadDialog::LoadDialog(shared_ptr<SCPILoad> load, shared_ptr<LoadState> state, S
 	, m_tstart(GetTime())
 	, m_load(load)
 	, m_state(state)
+	, m_history(state->m_telemetry)
+	, m_scheduler(session->GetPollScheduler(load))
 {
 	//Inputs
 	for(size_t i=0; i<m_load->GetChannelCount(); i++)
@@ -90,6 +92,10 @@ void LoadDialog::RefreshFromHardware()
 
 bool LoadDialog::DoRender()
 {
+	//Keep polling at full rate while we're on screen
+	if(m_scheduler)
+		m_scheduler->NotifyViewed();
+
 	//Device information
 	if(ImGui::CollapsingHeader("Info"))
 	{
@@ -153,6 +159,19 @@ bool LoadDialog::DoRender()
 		}
 	}
 
+	if(ImGui::CollapsingHeader("History"))
+	{
+		vector<shared_ptr<TelemetrySeries> > series;
+		for(size_t i=0; i<m_load->GetChannelCount(); i++)
+		{
+			if( (m_load->GetInstrumentTypesForChannel(i) & Instrument::INST_LOAD) == 0)
+				continue;
+			series.push_back(m_state->m_voltageHistory[i]);
+			series.push_back(m_state->m_currentHistory[i]);
+		}
+		m_history.Render(series);
+	}
+
 	return true;
 }
 
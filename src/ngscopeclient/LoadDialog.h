@@ -37,6 +37,7 @@
 
 #include "Dialog.h"
 #include "Session.h"
+#include "TelemetryView.h"
 
 #include <future>
 
@@ -167,6 +168,12 @@ protected:
 	///@brief Current channel stats, live updated
 	std::shared_ptr<LoadState> m_state;
 
+	///@brief Plots of measured voltage and current
+	TelemetryView m_history;
+
+	///@brief Poll rate control for the instrument thread (told when we're on screen)
+	std::shared_ptr<PollScheduler> m_scheduler;
+
 	///@brief Set of channel names
 	std::vector<std::string> m_channelNames;
 
@@ -1,8 +1,8 @@
 /***********************************************************************************************************************
 *                                                                                                                      *
-* glscopeclient                                                                                                        *
+* ngscopeclient                                                                                                        *
 *                                                                                                                      *
-* Copyright (c) 2012-2023 Andrew D. Zonenberg                                                                          *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
 * All rights reserved.                                                                                                 *
 *                                                                                                                      *
 * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
@@ -41,35 +41,166 @@ using namespace std;
 
 extern GuiLogSink* g_guiLog;
 
+///@brief Names of the severity levels the user can filter by
+static const vector<string> g_logSeverityNames = { "Error", "Warning", "Notice", "Verbose", "Debug" };
+
+///@brief Least severe level shown for each entry of g_logSeverityNames
+static const Severity g_logSeverities[] =
+	{ Severity::ERROR, Severity::WARNING, Severity::NOTICE, Severity::VERBOSE, Severity::DEBUG };
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
 LogViewerDialog::LogViewerDialog(MainWindow* parent)
 	: Dialog("Log Viewer", "Log Viewer", ImVec2(500, 300))
 	, m_parent(parent)
+	, m_firstLine(0)
+	, m_lostLines(0)
+	, m_severityIndex(4)
+	, m_follow(true)
 {
+	//Show everything logged before we were opened too
+	g_guiLog->Rewind();
 }
 
 LogViewerDialog::~LogViewerDialog()
 {
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Filtering
+
+/**
+	@brief Checks if a line passes the severity and text filters
+ */
+bool LogViewerDialog::Matches(const LogRecord& rec)
+{
+	if(rec.m_severity > g_logSeverities[m_severityIndex])
+		return false;
+	if(!m_filterText.empty() && (rec.m_message.find(m_filterText) == string::npos))
+		return false;
+	return true;
+}
+
+/**
+	@brief Re-filters every stored line after the filter settings change
+ */
+void LogViewerDialog::RebuildIndex()
+{
+	m_index.clear();
+	for(size_t i=0; i<m_records.size(); i++)
+	{
+		if(Matches(m_records[i]))
+			m_index.push_back(m_firstLine + i);
+	}
+}
+
+/**
+	@brief Pulls new lines from the log sink, updating the filter index incrementally
+ */
+void LogViewerDialog::PullNewLines()
+{
+	m_newRecords.clear();
+	m_lostLines += g_guiLog->Drain(m_newRecords);
+
+	for(auto& rec : m_newRecords)
+	{
+		if(Matches(rec))
+			m_index.push_back(m_firstLine + m_records.size());
+		m_records.push_back(std::move(rec));
+	}
+
+	//Discard the oldest lines once we hit the same limit as the sink
+	size_t capacity = g_guiLog->GetCapacity();
+	while(m_records.size() > capacity)
+	{
+		m_records.pop_front();
+		m_firstLine ++;
+	}
+	while(!m_index.empty() && (m_index.front() < m_firstLine))
+		m_index.pop_front();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Rendering
 
 bool LogViewerDialog::DoRender()
 {
-	//TODO: filters etc?
+	PullNewLines();
+
+	//Filter controls
+	float width = 10 * ImGui::GetFontSize();
+	ImGui::SetNextItemWidth(width);
+	bool filterChanged = Combo("Severity", g_logSeverityNames, m_severityIndex);
+	HelpMarker("Least severe messages to show");
+
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(width);
+	filterChanged |= ImGui::InputText("Search", &m_filterText);
+	HelpMarker("Only show lines containing this text (case sensitive)");
+
+	if(filterChanged)
+		RebuildIndex();
+
+	ImGui::SameLine();
+	ImGui::Checkbox("Follow", &m_follow);
+	HelpMarker("Keep scrolled to the newest line");
+
+	ImGui::SameLine();
+	if(ImGui::Button("Clear"))
+	{
+		m_firstLine += m_records.size();
+		m_records.clear();
+		m_index.clear();
+	}
+
+	if(m_lostLines)
+	{
+		ImGui::Text("%zu of %zu lines (%" PRIu64 " lost to buffer overflow)",
+			m_index.size(), m_records.size(), m_lostLines);
+	}
+	else
+		ImGui::Text("%zu of %zu lines", m_index.size(), m_records.size());
 
 	ImGui::BeginChild("scrollview", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
 
+	//Only submit the lines which are actually visible
 	ImGui::PushFont(m_parent->GetFontPref("Appearance.General.console_font"));
-	auto& lines = g_guiLog->GetLines();
-	for(auto& line : lines)
-		ImGui::TextUnformatted(line.c_str());
+	ImGuiListClipper clipper;
+	clipper.Begin(m_index.size());
+	char prefix[64];
+	string line;
+	while(clipper.Step())
+	{
+		for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+		{
+			auto& rec = m_records[m_index[i] - m_firstLine];
+
+			//Highlight problems
+			bool colored = true;
+			if(rec.m_severity <= Severity::ERROR)
+				ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0, 0.4, 0.4, 1.0));
+			else if(rec.m_severity == Severity::WARNING)
+				ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0, 0.8, 0.3, 1.0));
+			else
+				colored = false;
+
+			snprintf(prefix, sizeof(prefix), "%10.3f T%-3u ", rec.m_timestamp - g_guiLog->GetStartTime(), rec.m_thread);
+			line = prefix + rec.m_message;
+			ImGui::TextUnformatted(line.c_str());
+
+			if(colored)
+				ImGui::PopStyleColor();
+		}
+	}
 	ImGui::PopFont();
 
-	if(ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+	//Stop following if the user scrolled up, resume once they scroll back to the bottom
+	if(ImGui::GetIO().MouseWheel > 0 && ImGui::IsWindowHovered())
+		m_follow = false;
+	else if(ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+		m_follow = true;
+	if(m_follow)
 		ImGui::SetScrollHereY(1.0f);
 
 	ImGui::EndChild();
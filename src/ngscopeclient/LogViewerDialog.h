@@ -1,8 +1,8 @@
 /***********************************************************************************************************************
 *                                                                                                                      *
-* glscopeclient                                                                                                        *
+* ngscopeclient                                                                                                        *
 *                                                                                                                      *
-* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
 * All rights reserved.                                                                                                 *
 *                                                                                                                      *
 * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
@@ -37,6 +37,8 @@
 
 #include "Dialog.h"
 
+#include <deque>
+
 class MainWindow;
 
 class LogViewerDialog : public Dialog
@@ -48,7 +50,35 @@ public:
 	virtual bool DoRender();
 
 protected:
+	void PullNewLines();
+	bool Matches(const LogRecord& rec);
+	void RebuildIndex();
+
 	MainWindow* m_parent;
+
+	///@brief Lines pulled from the log sink, oldest first (bounded to the sink's capacity)
+	std::deque<LogRecord> m_records;
+
+	///@brief Absolute line number of m_records[0]
+	uint64_t m_firstLine;
+
+	///@brief Absolute line numbers of every line in m_records which passes the current filters
+	std::deque<uint64_t> m_index;
+
+	///@brief Scratch buffer for lines drained from the sink
+	std::vector<LogRecord> m_newRecords;
+
+	///@brief Number of lines overwritten in the sink before we could read them
+	uint64_t m_lostLines;
+
+	///@brief Index of the least severe level to display
+	int m_severityIndex;
+
+	///@brief Substring to search for
+	std::string m_filterText;
+
+	///@brief Keep the view scrolled to the newest line
+	bool m_follow;
 };
 
 #endif
@@ -204,6 +204,9 @@ MainWindow::MainWindow(shared_ptr<QueueHandle> queue)
 	, m_texmgr(queue)
 	, m_needRender(false)
 	, m_toneMapTime(0)
+	, m_nextFrameTime(0)
+	, m_staleFrames(0)
+	, m_drawingStaleWaveforms(false)
 {
 	LoadRecentInstrumentList();
 	LoadRecentFileList();
@@ -233,17 +236,26 @@ MainWindow::MainWindow(shared_ptr<QueueHandle> queue)
 				"MainWindow.m_cmdBuffer"));
 	}
 
-	UpdateFonts();
+	{
+		StartupProfileScope scope("Build font atlas");
+		UpdateFonts();
+	}
 
 	//Load some textures
-	m_toolbarIconSize = 0;
-	LoadToolbarIcons();
-	LoadGradients();
-	m_texmgr.LoadTexture("warning", FindDataFile("icons/48x48/dialog-warning-2.png"));
-	m_texmgr.LoadTexture("visible-spectrum-380nm-750nm",
-		FindDataFile("icons/gradients/visible-spectrum-380nm-750nm.png"));
-	LoadFilterIcons();
-	LoadStatusBarIcons();
+	//(all in one batch so they're decoded in parallel and uploaded together)
+	{
+		StartupProfileScope scope("Load textures");
+		m_texmgr.BeginBatch();
+		m_toolbarIconSize = 0;
+		LoadToolbarIcons();
+		LoadGradients();
+		m_texmgr.LoadTexture("warning", FindDataFile("icons/48x48/dialog-warning-2.png"));
+		m_texmgr.LoadTexture("visible-spectrum-380nm-750nm",
+			FindDataFile("icons/gradients/visible-spectrum-380nm-750nm.png"));
+		LoadFilterIcons();
+		LoadStatusBarIcons();
+		m_texmgr.EndBatch();
+	}
 
 	//Don't move windows when dragging in the body, only the title bar
 	ImGui::GetIO().ConfigWindowsMoveFromTitleBarOnly = true;
@@ -593,6 +605,8 @@ void MainWindow::OnScopeAdded(shared_ptr<Oscilloscope> scope, bool createViews)
 
 void MainWindow::Render()
 {
+	double tstart = GetTime();
+
 	//Shut down session, if requested, before starting the frame
 	if(m_sessionClosing)
 	{
@@ -608,7 +622,47 @@ void MainWindow::Render()
 	//Load all of our fonts
 	UpdateFonts();
 
+	m_drawingStaleWaveforms = false;
 	VulkanWindow::Render();
+
+	RecordFrameTime(tstart);
+	if(m_drawingStaleWaveforms)
+		m_staleFrames ++;
+}
+
+/**
+	@brief Adds the time since tstart to the frame time history
+ */
+void MainWindow::RecordFrameTime(double tstart)
+{
+	const size_t historyDepth = 512;
+
+	int64_t dt = (GetTime() - tstart) * FS_PER_SECOND;
+	if(m_frameTimes.size() < historyDepth)
+		m_frameTimes.push_back(dt);
+	else
+		m_frameTimes[m_nextFrameTime] = dt;
+	m_nextFrameTime = (m_nextFrameTime + 1) % historyDepth;
+}
+
+/**
+	@brief Gets a percentile of recent GUI thread frame times
+
+	Frame time is measured from the start to the end of Render(), so it includes any time the GUI thread spent
+	blocked on locks or waiting for vsync. Every frame in the history was actually drawn, including ones that showed
+	the last published waveforms while the filter graph was running.
+
+	@param percentile	Percentile to look up, 0 to 100
+ */
+int64_t MainWindow::GetFrameTimePercentile(float percentile)
+{
+	if(m_frameTimes.empty())
+		return 0;
+
+	vector<int64_t> sorted = m_frameTimes;
+	size_t i = min(sorted.size() - 1, static_cast<size_t>(percentile * 0.01f * sorted.size()));
+	nth_element(sorted.begin(), sorted.begin() + i, sorted.end());
+	return sorted[i];
 }
 
 void MainWindow::DoRender(vk::raii::CommandBuffer& /*cmdBuf*/)
@@ -616,6 +670,44 @@ void MainWindow::DoRender(vk::raii::CommandBuffer& /*cmdBuf*/)
 
 }
 
+/**
+	@brief Finds every graph node whose output the user can currently see, and passes the list to the session
+
+	Used for demand-driven filter evaluation. Must be called from the GUI thread.
+ */
+void MainWindow::UpdateVisibleSinks()
+{
+	set<FlowGraphNode*> sinks;
+
+	//Everything shown in a plot
+	{
+		lock_guard<recursive_mutex> lock(m_waveformGroupsMutex);
+		for(auto g : m_waveformGroups)
+		{
+			for(auto a : g->GetWaveformAreas())
+			{
+				for(size_t i=0; i<a->GetStreamCount(); i++)
+					sinks.emplace(a->GetStream(i).m_channel);
+			}
+		}
+	}
+
+	//Measurements
+	if(m_measurementsDialog)
+	{
+		for(auto s : m_measurementsDialog->GetStreams())
+			sinks.emplace(s.m_channel);
+	}
+
+	//Protocol analyzers
+	for(auto it : m_protocolAnalyzerDialogs)
+		sinks.emplace(it.first);
+
+	m_session.SetVisibleSinks(
+		sinks,
+		m_session.GetPreferences().GetBool("Miscellaneous.Filter Graph.lazy_evaluation"));
+}
+
 /**
 	@brief Run the tone-mapping shader on all of our waveforms
 
@@ -640,6 +732,23 @@ void MainWindow::ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf)
 
 	m_cmdBuffer->end();
 	m_renderQueue->SubmitAndBlock(*m_cmdBuffer);
+	m_session.GetPipelineRegistry().Release(cmdbuf);
+
+	//The first waveform is only on screen once a displayed channel actually has data, not just an empty plot
+	if(!g_startupProfiler.HasMark("First waveform"))
+	{
+		bool hasData = false;
+		for(auto group : groups)
+		{
+			for(auto area : group->GetWaveformAreas())
+			{
+				for(size_t i=0; i<area->GetStreamCount(); i++)
+					hasData |= (area->GetStream(i).GetData() != nullptr);
+			}
+		}
+		if(hasData)
+			g_startupProfiler.Mark("First waveform");
+	}
 
 	double dt = GetTime() - start;
 	m_toneMapTime = dt * FS_PER_SECOND;
@@ -698,6 +807,9 @@ void MainWindow::RenderUI()
 	//Request a refresh of any dirty filters next frame
 	m_session.RefreshDirtyFiltersNonblocking();
 
+	//Let instruments know who needs their readings
+	m_session.UpdatePollDemand();
+
 	//See if we have new waveform data to look at.
 	//If we got one, highlight the new waveform in history
 	if(m_session.CheckForWaveforms(*m_cmdBuffer))
@@ -720,7 +832,21 @@ void MainWindow::RenderUI()
 
 	//Waveform groups
 	{
-		shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex());
+		//This is not a snapshot of the waveform data: we still need the shared lock to touch it, so we still
+		//contend with anything that holds it exclusively. The epoch only tells us *why* the lock is taken.
+		//If the filter graph is partway through rewriting its outputs, don't wait for it to finish.
+		//Draw the groups from the last published textures instead, without touching any waveform data.
+		//Anyone else holding the lock exclusively only does so briefly, so just spin until they're done.
+		shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex(), defer_lock);
+		while(!lock.try_lock())
+		{
+			if(m_session.IsWaveformEpochInProgress())
+			{
+				m_drawingStaleWaveforms = true;
+				break;
+			}
+			this_thread::sleep_for(chrono::microseconds(100));
+		}
 		lock_guard<recursive_mutex> lock2(m_waveformGroupsMutex);
 
 		for(size_t i=0; i<m_waveformGroups.size(); i++)
@@ -737,6 +863,9 @@ void MainWindow::RenderUI()
 			m_waveformGroups.erase(m_waveformGroups.begin() + m_groupsToClose[i]);
 	}
 
+	//Tell the session what's on screen so hidden filters can be skipped
+	UpdateVisibleSinks();
+
 	//Now that we are not holding the render mutex anymore, it's safe to have the session refresh newly created filters
 	if(!m_pendingChannelDisplayRequests.empty())
 	{
@@ -789,9 +918,11 @@ void MainWindow::RenderUI()
 		RenderFileBrowser();
 
 	//Check if we changed the selected waveform from a protocol analyzer dialog
+	//(ignore it if history is being reprocessed, the reprocessor is loading points into the session itself)
+	bool reprocessing = IsReprocessingHistory();
 	for(auto it : m_protocolAnalyzerDialogs)
 	{
-		if(it.second->PollForSelectionChanges())
+		if(it.second->PollForSelectionChanges() && !reprocessing)
 		{
 			auto tstamp = it.second->GetSelectedWaveformTimestamp();
 			auto& hist = m_session.GetHistory();
@@ -1116,6 +1247,7 @@ void MainWindow::LoadToolbarIcons()
 	string prefix = string("icons/") + to_string(iconSize) + "x" + to_string(iconSize) + "/";
 
 	//Load the icons
+	m_texmgr.BeginBatch();
 	m_texmgr.LoadTexture("clear-sweeps", FindDataFile(prefix + "clear-sweeps.png"));
 	m_texmgr.LoadTexture("fullscreen-enter", FindDataFile(prefix + "fullscreen-enter.png"));
 	m_texmgr.LoadTexture("fullscreen-exit", FindDataFile(prefix + "fullscreen-exit.png"));
@@ -1125,6 +1257,7 @@ void MainWindow::LoadToolbarIcons()
 	m_texmgr.LoadTexture("trigger-force", FindDataFile(prefix + "trigger-single.png"));	//no dedicated icon yet
 	m_texmgr.LoadTexture("trigger-start", FindDataFile(prefix + "trigger-start.png"));
 	m_texmgr.LoadTexture("trigger-stop", FindDataFile(prefix + "trigger-stop.png"));
+	m_texmgr.EndBatch();
 }
 
 /**
@@ -1308,12 +1441,25 @@ void MainWindow::TriggerStopDropdown(float buttonsize)
 	}
 }
 
+/**
+	@brief Check if the history dialog is running the filter graph over history in the background
+ */
+bool MainWindow::IsReprocessingHistory()
+{
+	return m_historyDialog && m_historyDialog->IsReprocessing();
+}
+
 void MainWindow::ToolbarButtons()
 {
 	ImVec2 buttonsize(m_toolbarIconSize, m_toolbarIconSize);
 
 	bool multigroup = (m_session.GetTriggerGroups().size() > 1);
 
+	//Don't let new waveforms in while history is being reprocessed
+	bool reprocessing = IsReprocessingHistory();
+	if(reprocessing)
+		ImGui::BeginDisabled();
+
 	//Trigger button group
 	if(ImGui::ImageButton("trigger-start", GetTexture("trigger-start"), buttonsize))
 		m_session.ArmTrigger(TriggerGroup::TRIGGER_TYPE_NORMAL);
@@ -1354,6 +1500,9 @@ void MainWindow::ToolbarButtons()
 		TriggerStopDropdown(buttonsize.y);
 	}
 
+	if(reprocessing)
+		ImGui::EndDisabled();
+
 	//History selector
 	bool hasHist = (m_historyDialog != nullptr);
 	ImGui::SameLine();
@@ -2158,6 +2307,7 @@ Filter* MainWindow::CreateFilter(
 	//Attempt to hook up first input
 	if(f->ValidateChannel(0, initialStream))
 		f->SetInput(0, initialStream);
+	m_session.InvalidateFlowGraphIndex();
 
 	//Give it an initial name, may change later
 	f->SetDefaultName();
@@ -2389,6 +2539,9 @@ void MainWindow::OnFilterReconfigured(Filter* f)
 		f->ClearSweeps();
 	}
 
+	//Inputs may have been changed
+	m_session.InvalidateFlowGraphIndex();
+
 	//Re-run the filter
 	m_session.RefreshAllFiltersNonblocking();
 
@@ -2475,8 +2628,13 @@ void MainWindow::RenderFileBrowser()
  */
 void MainWindow::DoOpenFile(const string& sessionPath, bool online)
 {
+	StartupProfileScope scope("Load session");
+
 	//Close any existing session
-	CloseSession();
+	{
+		StartupProfileScope closeScope("Close previous session");
+		CloseSession();
+	}
 
 	//Get the data directory for the session
 	string base = sessionPath.substr(0, sessionPath.length() - strlen(".scopesession"));
@@ -2486,7 +2644,10 @@ void MainWindow::DoOpenFile(const string& sessionPath, bool online)
 	try
 	{
 		//Load all YAML
-		m_fileBeingLoaded = YAML::LoadAllFromFile(sessionPath);
+		{
+			StartupProfileScope parseScope("Parse YAML");
+			m_fileBeingLoaded = YAML::LoadAllFromFile(sessionPath);
+		}
 		if(m_fileBeingLoaded.size() != 1)
 		{
 			ShowErrorPopup(
@@ -2565,6 +2726,8 @@ void MainWindow::DoOpenFile(const string& sessionPath, bool online)
  */
 bool MainWindow::PreLoadSessionFromYaml(const YAML::Node& node, const string& dataDir, bool online)
 {
+	StartupProfileScope scope("Preload");
+
 	//Load imgui_node_editor settings first (before creating the session)
 	ifstream ifs(dataDir + "/filtergraph.json");
 	if(ifs)
@@ -2599,6 +2762,8 @@ bool MainWindow::PreLoadSessionFromYaml(const YAML::Node& node, const string& da
  */
 bool MainWindow::LoadSessionFromYaml(const YAML::Node& node, const string& dataDir, bool online)
 {
+	StartupProfileScope scope("Load");
+
 	if(!m_session.LoadFromYaml(node, dataDir, online))
 	{
 		//If loading fails, clean up any incomplete half-loaded stuff that might be in a bad state
@@ -3021,7 +3186,7 @@ bool MainWindow::LoadDialogs(const YAML::Node& node)
 	auto metrics = node["metrics"];
 	if(metrics && metrics.as<bool>())
 	{
-		m_metricsDialog = make_shared<MetricsDialog>(&m_session);
+		m_metricsDialog = make_shared<MetricsDialog>(&m_session, this);
 		AddDialog(m_metricsDialog);
 	}
 
@@ -131,6 +131,8 @@ public:
 	void ShowManageInstruments();
 	void ShowSyncWizard(std::shared_ptr<TriggerGroup> group, std::shared_ptr<Oscilloscope> secondary);
 
+	bool IsReprocessingHistory();
+
 	void OnCursorMoved(int64_t offset);
 
 	void NavigateToTimestamp(
@@ -261,6 +263,7 @@ protected:
 				void DoTriggerDropdown(const char* action, std::shared_ptr<TriggerGroup>& group, bool& all);
 		void DockingArea();
 			void StatusBar(float height);
+		void UpdateVisibleSinks();
 
 	void LoadGradients();
 	void LoadGradient(const std::string& friendlyName, const std::string& internalName);
@@ -411,7 +414,15 @@ protected:
 	// Serialization
 
 	void OnOpenFile(bool online);
+public:
 	void DoOpenFile(const std::string& sessionPath, bool online);
+
+	/**
+		@brief Gets the path of the currently loaded session file (empty if none)
+	 */
+	const std::string& GetSessionFileName() const
+	{ return m_sessionFileName; }
+protected:
 	bool PreLoadSessionFromYaml(const YAML::Node& node, const std::string& dataDir, bool online);
 	bool LoadSessionFromYaml(const YAML::Node& node, const std::string& dataDir, bool online);
 public:
@@ -572,9 +583,36 @@ protected:
 protected:
 	int64_t m_toneMapTime;
 
+	void RecordFrameTime(double tstart);
+
+	///@brief Ring buffer of recent GUI thread frame times, in fs
+	std::vector<int64_t> m_frameTimes;
+
+	///@brief Next slot in m_frameTimes to overwrite
+	size_t m_nextFrameTime;
+
+	///@brief Number of frames drawn from the last published waveforms while the filter graph was running
+	uint64_t m_staleFrames;
+
+	///@brief True if the current frame is drawing the last published waveforms without the waveform data lock
+	bool m_drawingStaleWaveforms;
+
 public:
 	int64_t GetToneMapTime()
 	{ return m_toneMapTime; }
+
+	int64_t GetFrameTimePercentile(float percentile);
+
+	uint64_t GetStaleFrameCount()
+	{ return m_staleFrames; }
+
+	/**
+		@brief Check if waveform groups are being drawn while the filter graph is rewriting its outputs
+
+		If true, waveform data must not be touched. Only the last tone mapped textures are safe to draw.
+	 */
+	bool IsDrawingStaleWaveforms()
+	{ return m_drawingStaleWaveforms; }
 };
 
 #endif
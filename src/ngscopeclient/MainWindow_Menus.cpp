@@ -424,15 +424,13 @@ void MainWindow::AddChannelsMenu()
  */
 void MainWindow::AddImportMenu()
 {
-	auto& refs = m_session.GetReferenceFilters();
-
 	if(ImGui::BeginMenu("Import"))
 	{
 		//Find all filters in this category and sort them alphabetically
 		vector<string> sortedNames;
-		for(auto it : refs)
+		for(auto& it : m_session.GetFilterCategories())
 		{
-			if(it.second->GetCategory() == Filter::CAT_GENERATION)
+			if(it.second == Filter::CAT_GENERATION)
 				sortedNames.push_back(it.first);
 		}
 		std::sort(sortedNames.begin(), sortedNames.end());
@@ -459,15 +457,13 @@ void MainWindow::AddImportMenu()
  */
 void MainWindow::AddGenerateMenu()
 {
-	auto& refs = m_session.GetReferenceFilters();
-
 	if(ImGui::BeginMenu("Generate"))
 	{
 		//Find all filters in this category and sort them alphabetically
 		vector<string> sortedNames;
-		for(auto it : refs)
+		for(auto& it : m_session.GetFilterCategories())
 		{
-			if(it.second->GetCategory() == Filter::CAT_GENERATION)
+			if(it.second == Filter::CAT_GENERATION)
 				sortedNames.push_back(it.first);
 		}
 		std::sort(sortedNames.begin(), sortedNames.end());
@@ -480,7 +476,8 @@ void MainWindow::AddGenerateMenu()
 				continue;
 
 			//Hide filters that have inputs
-			if(refs.find(fname)->second->GetInputCount() != 0)
+			auto ref = m_session.GetReferenceFilter(fname);
+			if(!ref || (ref->GetInputCount() != 0) )
 				continue;
 
 			if(ImGui::MenuItem(fname.c_str()))
@@ -596,7 +593,7 @@ void MainWindow::WindowMenu()
 
 		if(ImGui::MenuItem("Performance Metrics"))
 		{
-			m_metricsDialog = make_shared<MetricsDialog>(&m_session);
+			m_metricsDialog = make_shared<MetricsDialog>(&m_session, this);
 			AddDialog(m_metricsDialog);
 		}
 
@@ -85,7 +85,7 @@ bool ManageInstrumentsDialog::DoRender()
 			"The root instrument of a trigger group must have a trigger-out port.\n"
 			"All instruments in a trigger group should be connected to a common reference clock to avoid skew.");
 
-		if(ImGui::BeginTable("groups", 6, flags))
+		if(ImGui::BeginTable("groups", 8, flags))
 		{
 			TriggerGroupsTable();
 			ImGui::EndTable();
@@ -117,11 +117,30 @@ void ManageInstrumentsDialog::TriggerGroupsTable()
 	ImGui::TableSetupColumn("Serial", ImGuiTableColumnFlags_WidthFixed, 8*width);
 	ImGui::TableSetupColumn("Skew", ImGuiTableColumnFlags_WidthFixed, 8*width);
 	ImGui::TableSetupColumn("Actions", ImGuiTableColumnFlags_WidthFixed, 8*width);
+	ImGui::TableSetupColumn("When behind", ImGuiTableColumnFlags_WidthFixed, 8*width);
+	ImGui::TableSetupColumn("Queue limit", ImGuiTableColumnFlags_WidthFixed, 7*width);
 	ImGui::TableHeadersRow();
 
 	Unit fs(Unit::UNIT_FS);
 
 	auto groups = m_session.GetTriggerGroups();
+
+	//Forget queue limit text for groups that no longer exist
+	for(auto it = m_queueLimitText.begin(); it != m_queueLimitText.end(); )
+	{
+		bool found = false;
+		for(auto group : groups)
+		{
+			if(group.get() == it->first)
+				found = true;
+		}
+
+		if(found)
+			it++;
+		else
+			it = m_queueLimitText.erase(it);
+	}
+
 	for(auto group : groups)
 	{
 		//If we get here, we just deleted the last scope in the group
@@ -269,6 +288,9 @@ void ManageInstrumentsDialog::TriggerGroupsTable()
 				ImGui::TextUnformatted(mockScope->GetSerial().c_str());
 		}
 
+		if(group->HasScopes())
+			AcquisitionPolicyColumns(group);
+
 		//then put all other nodes under it
 		if(rootOpen)
 		{
@@ -351,6 +373,50 @@ void ManageInstrumentsDialog::TriggerGroupsTable()
 	RowForNewGroup();
 }
 
+/**
+	@brief Shows the backpressure settings for a trigger group in the current row
+ */
+void ManageInstrumentsDialog::AcquisitionPolicyColumns(shared_ptr<TriggerGroup> group)
+{
+	if(ImGui::TableSetColumnIndex(6))
+	{
+		static const vector<string> policies =
+		{
+			TriggerGroup::GetPolicyName(TriggerGroup::POLICY_BLOCK),
+			TriggerGroup::GetPolicyName(TriggerGroup::POLICY_DROP_OLDEST),
+			TriggerGroup::GetPolicyName(TriggerGroup::POLICY_DROP_NEWEST)
+		};
+
+		int policy = group->GetAcquisitionPolicy();
+		ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+		if(Combo("##policy", policies, policy))
+			group->SetAcquisitionPolicy(static_cast<TriggerGroup::AcquisitionPolicy>(policy));
+
+		Tooltip(
+			"What to do when waveform processing can't keep up with the instruments in this group.\n\n"
+			"Block: stop pulling data from the instruments until the backlog has been processed.\n"
+			"Drop oldest: keep acquiring, and skip ahead to the most recent waveform, discarding the backlog.\n"
+			"Drop newest: keep acquiring, but finish the current waveform and discard anything that came in\n"
+			"while it was being processed.");
+	}
+
+	if(ImGui::TableSetColumnIndex(7))
+	{
+		Unit bytes(Unit::UNIT_BYTES);
+		int64_t limit = group->GetMaxPendingBytes();
+		if(m_queueLimitText.find(group.get()) == m_queueLimitText.end())
+			m_queueLimitText[group.get()] = bytes.PrettyPrint(limit);
+
+		ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+		if(UnitInputWithImplicitApply("##queuelimit", m_queueLimitText[group.get()], limit, bytes))
+			group->SetMaxPendingBytes(max(limit, (int64_t)0));
+
+		Tooltip(
+			"Maximum amount of waveform data queued for processing from each instrument in this group.\n\n"
+			"At least one waveform is always queued, no matter how large.");
+	}
+}
+
 void ManageInstrumentsDialog::RowForNewGroup()
 {
 	ImGui::PushID("NewGroup");
@@ -48,6 +48,7 @@ public:
 
 protected:
 	void RowForNewGroup();
+	void AcquisitionPolicyColumns(std::shared_ptr<TriggerGroup> group);
 
 	void TriggerGroupsTable();
 	void AllInstrumentsTable();
@@ -56,6 +57,9 @@ protected:
 	MainWindow* m_parent;
 
 	std::shared_ptr<SCPIInstrument> m_selection;
+
+	///@brief Text box content for each trigger group's queue limit
+	std::map<TriggerGroup*, std::string> m_queueLimitText;
 };
 
 class TriggerGroupDragDescriptor
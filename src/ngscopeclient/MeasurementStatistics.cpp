@@ -0,0 +1,449 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of MeasurementStatistics
+ */
+#include "../scopehal/scopehal.h"
+#include "MeasurementStatistics.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// QuantileSketch
+
+QuantileSketch::QuantileSketch()
+{
+	Clear();
+}
+
+/**
+	@brief Discards all values
+ */
+void QuantileSketch::Clear()
+{
+	m_exact.clear();
+	m_binned = false;
+	m_lo = 0;
+	m_width = 0;
+	m_bins.clear();
+	m_count = 0;
+}
+
+/**
+	@brief Adds a value to the sketch (non-finite values are ignored)
+ */
+void QuantileSketch::Add(double v)
+{
+	if(!isfinite(v))
+		return;
+	m_count ++;
+
+	if(!m_binned)
+	{
+		m_exact.push_back(v);
+		if(m_exact.size() >= NUM_BINS)
+			SetRange();
+		return;
+	}
+
+	while(v < m_lo)
+		GrowDown();
+	while(v > m_lo + m_width*NUM_BINS)
+		GrowUp();
+
+	size_t bin = min(static_cast<size_t>( (v - m_lo) / m_width ), NUM_BINS - 1);
+	m_bins[bin] ++;
+}
+
+/**
+	@brief Switches from keeping exact values to binning, with a range covering every value seen so far
+ */
+void QuantileSketch::SetRange()
+{
+	auto range = minmax_element(m_exact.begin(), m_exact.end());
+	double lo = *range.first;
+	double hi = *range.second;
+
+	//Don't let the bins collapse to zero width if every value so far was the same
+	double span = hi - lo;
+	if(span <= 0)
+		span = max(fabs(lo) * 1e-6, 1e-20);
+
+	m_lo = lo;
+	m_width = span / NUM_BINS;
+	m_bins.resize(NUM_BINS);
+	m_binned = true;
+
+	for(auto v : m_exact)
+	{
+		size_t bin = min(static_cast<size_t>( (v - m_lo) / m_width ), NUM_BINS - 1);
+		m_bins[bin] ++;
+	}
+
+	m_exact.clear();
+	m_exact.shrink_to_fit();
+}
+
+/**
+	@brief Doubles the bin width, keeping the lower edge of the range where it is
+ */
+void QuantileSketch::GrowUp()
+{
+	for(size_t i=0; i<NUM_BINS/2; i++)
+		m_bins[i] = m_bins[i*2] + m_bins[i*2 + 1];
+	for(size_t i=NUM_BINS/2; i<NUM_BINS; i++)
+		m_bins[i] = 0;
+	m_width *= 2;
+}
+
+/**
+	@brief Doubles the bin width, keeping the upper edge of the range where it is
+ */
+void QuantileSketch::GrowDown()
+{
+	for(size_t i=NUM_BINS-1; i>=NUM_BINS/2; i--)
+	{
+		size_t j = (i - NUM_BINS/2) * 2;
+		m_bins[i] = m_bins[j] + m_bins[j+1];
+	}
+	for(size_t i=0; i<NUM_BINS/2; i++)
+		m_bins[i] = 0;
+	m_lo -= m_width * NUM_BINS;
+	m_width *= 2;
+}
+
+/**
+	@brief Lower edge of the range covered by the sketch
+ */
+double QuantileSketch::GetLowerBound() const
+{
+	if(m_binned)
+		return m_lo;
+	if(m_exact.empty())
+		return 0;
+	return *min_element(m_exact.begin(), m_exact.end());
+}
+
+/**
+	@brief Upper edge of the range covered by the sketch
+ */
+double QuantileSketch::GetUpperBound() const
+{
+	if(m_binned)
+		return m_lo + m_width*NUM_BINS;
+	if(m_exact.empty())
+		return 0;
+	return *max_element(m_exact.begin(), m_exact.end());
+}
+
+/**
+	@brief Estimates a quantile of the values seen so far
+
+	@param q	Quantile to find, from 0 (minimum) to 1 (maximum)
+ */
+double QuantileSketch::GetQuantile(double q) const
+{
+	if(m_count == 0)
+		return 0;
+	q = min(max(q, 0.0), 1.0);
+
+	//Exact answer if we haven't started binning yet
+	if(!m_binned)
+	{
+		auto sorted = m_exact;
+		sort(sorted.begin(), sorted.end());
+		return sorted[static_cast<size_t>(round(q * (sorted.size() - 1)))];
+	}
+
+	//Find the bin containing the target rank, then interpolate within it
+	double target = q * m_count;
+	double total = 0;
+	for(size_t i=0; i<NUM_BINS; i++)
+	{
+		if(m_bins[i] == 0)
+			continue;
+		if(total + m_bins[i] >= target)
+			return m_lo + m_width * (i + (target - total) / m_bins[i]);
+		total += m_bins[i];
+	}
+	return GetUpperBound();
+}
+
+/**
+	@brief Gets a histogram of the values seen so far, suitable for display
+
+	Bins are spread over the range actually occupied by values, rather than the full range of the sketch.
+
+	@param counts	Number of values in each bin
+	@param nbins	Number of bins to return
+ */
+void QuantileSketch::GetHistogram(vector<float>& counts, size_t nbins) const
+{
+	counts.clear();
+	counts.resize(nbins);
+	if( (m_count == 0) || (nbins == 0) )
+		return;
+
+	if(!m_binned)
+	{
+		double lo = GetLowerBound();
+		double span = max(GetUpperBound() - lo, 1e-20);
+		for(auto v : m_exact)
+			counts[min(static_cast<size_t>( (v - lo) / span * nbins ), nbins - 1)] ++;
+		return;
+	}
+
+	//Trim empty bins off both ends
+	size_t first = 0;
+	while(m_bins[first] == 0)
+		first ++;
+	size_t last = NUM_BINS - 1;
+	while(m_bins[last] == 0)
+		last --;
+
+	size_t used = last - first + 1;
+	for(size_t i=first; i<=last; i++)
+		counts[min((i - first) * nbins / used, nbins - 1)] += m_bins[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MeasurementAccumulator
+
+MeasurementAccumulator::MeasurementAccumulator()
+{
+	Clear();
+}
+
+/**
+	@brief Discards all values
+ */
+void MeasurementAccumulator::Clear()
+{
+	m_count = 0;
+	m_mean = 0;
+	m_m2 = 0;
+	m_min = 0;
+	m_max = 0;
+	m_sketch.Clear();
+}
+
+/**
+	@brief Adds a value (non-finite values are ignored)
+ */
+void MeasurementAccumulator::Add(double v)
+{
+	if(!isfinite(v))
+		return;
+
+	if(m_count == 0)
+	{
+		m_min = v;
+		m_max = v;
+	}
+	else
+	{
+		m_min = min(m_min, v);
+		m_max = max(m_max, v);
+	}
+
+	m_count ++;
+	double delta = v - m_mean;
+	m_mean += delta / m_count;
+	m_m2 += delta * (v - m_mean);
+
+	m_sketch.Add(v);
+}
+
+/**
+	@brief Sample standard deviation of the values seen (zero if there are fewer than two)
+ */
+double MeasurementAccumulator::GetStdDev() const
+{
+	if(m_count < 2)
+		return 0;
+	return sqrt(m_m2 / (m_count - 1));
+}
+
+/**
+	@brief Estimates a quantile of the values seen
+
+	@param q	Quantile to find, from 0 (minimum) to 1 (maximum)
+ */
+double MeasurementAccumulator::GetQuantile(double q) const
+{
+	if(m_count == 0)
+		return 0;
+	return min(max(m_sketch.GetQuantile(q), m_min), m_max);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MeasurementStatistics
+
+MeasurementStatistics::MeasurementStatistics()
+	: m_scoped(false)
+	, m_scopeStart(0, 0)
+	, m_scopeEnd(0, 0)
+{
+}
+
+/**
+	@brief Starts tracking a stream
+ */
+void MeasurementStatistics::AddStream(StreamDescriptor stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_streams[stream];
+}
+
+/**
+	@brief Stops tracking a stream and discards its statistics
+ */
+void MeasurementStatistics::RemoveStream(StreamDescriptor stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_streams.erase(stream);
+}
+
+/**
+	@brief Records the current value of every tracked stream
+
+	Called after the filter graph has run on the acquisition with timestamp t. An acquisition is only counted once
+	per stream, so re-running the filter graph (e.g. when browsing or reprocessing history) doesn't skew the
+	statistics. This holds even for acquisitions whose values have since been dropped from the bounded window of
+	past values, since those are always the oldest.
+
+	@param t	Timestamp of the acquisition the current values were computed from
+ */
+void MeasurementStatistics::Record(TimePoint t)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	bool inScope = m_scoped && InScope(t);
+	for(auto& it : m_streams)
+	{
+		auto& s = it.second;
+		if(s.m_samples.find(t) != s.m_samples.end())
+			continue;
+
+		//Already counted, then dropped from the window
+		if(s.m_evicted && !(s.m_evictedThrough < t))
+			continue;
+
+		auto stream = it.first;
+		double v = stream.GetScalarValue();
+		s.m_samples[t] = v;
+		s.m_all.Add(v);
+		if(inScope)
+			s.m_scoped.Add(v);
+
+		//Forget the oldest values once we have too many (they still count towards the overall statistics)
+		if(s.m_samples.size() > MAX_SAMPLES)
+		{
+			s.m_evicted = true;
+			s.m_evictedThrough = s.m_samples.begin()->first;
+			s.m_samples.erase(s.m_samples.begin());
+		}
+	}
+}
+
+/**
+	@brief Discards all recorded values
+ */
+void MeasurementStatistics::Reset()
+{
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& it : m_streams)
+	{
+		it.second.m_all.Clear();
+		it.second.m_scoped.Clear();
+		it.second.m_samples.clear();
+		it.second.m_evicted = false;
+	}
+}
+
+/**
+	@brief Limits statistics to acquisitions within a range of history
+
+	@param tstart	Timestamp of the first acquisition to include
+	@param tend		Timestamp of the last acquisition to include
+ */
+void MeasurementStatistics::SetScope(TimePoint tstart, TimePoint tend)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if(tend < tstart)
+		swap(tstart, tend);
+	m_scoped = true;
+	m_scopeStart = tstart;
+	m_scopeEnd = tend;
+
+	for(auto& it : m_streams)
+	{
+		auto& s = it.second;
+		s.m_scoped.Clear();
+		for(auto jt = s.m_samples.lower_bound(tstart); (jt != s.m_samples.end()) && !(tend < jt->first); jt++)
+			s.m_scoped.Add(jt->second);
+	}
+}
+
+/**
+	@brief Goes back to statistics over every recorded acquisition
+ */
+void MeasurementStatistics::ClearScope()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_scoped = false;
+	for(auto& it : m_streams)
+		it.second.m_scoped.Clear();
+}
+
+/**
+	@brief Gets a snapshot of the statistics for a stream, within the current scope
+
+	@param stream	The stream to look up
+	@param stats	Statistics for the stream
+
+	@return True if the stream is being tracked, false if not
+ */
+bool MeasurementStatistics::GetStatistics(StreamDescriptor stream, MeasurementAccumulator& stats)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto it = m_streams.find(stream);
+	if(it == m_streams.end())
+		return false;
+
+	if(m_scoped)
+		stats = it->second.m_scoped;
+	else
+		stats = it->second.m_all;
+	return true;
+}
@@ -0,0 +1,229 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of MeasurementStatistics
+ */
+#ifndef MeasurementStatistics_h
+#define MeasurementStatistics_h
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+	@brief Approximate distribution of a stream of values, in constant memory
+
+	The first few values are kept exactly. After that, values are counted in a fixed number of equal width bins.
+	When a value lands outside the range covered by the bins, the range is doubled (merging adjacent pairs of bins)
+	until it fits, so the sketch never needs to see the data twice. Quantiles are accurate to within one bin width,
+	which is 1/NUM_BINS of the range of the data.
+ */
+class QuantileSketch
+{
+public:
+	QuantileSketch();
+
+	void Add(double v);
+	void Clear();
+
+	double GetQuantile(double q) const;
+	double GetLowerBound() const;
+	double GetUpperBound() const;
+	void GetHistogram(std::vector<float>& counts, size_t nbins) const;
+
+	///@brief Number of bins once the range is fixed
+	static const size_t NUM_BINS = 256;
+
+protected:
+	void SetRange();
+	void GrowUp();
+	void GrowDown();
+
+	///@brief Values seen before the range was fixed (empty afterwards)
+	std::vector<double> m_exact;
+
+	///@brief True if the range has been fixed and values are being binned
+	bool m_binned;
+
+	///@brief Value at the lower edge of the first bin
+	double m_lo;
+
+	///@brief Width of each bin
+	double m_width;
+
+	///@brief Number of values in each bin
+	std::vector<uint64_t> m_bins;
+
+	///@brief Total number of values
+	uint64_t m_count;
+};
+
+/**
+	@brief Running statistics for a single stream of values
+
+	Mean and variance are updated incrementally with Welford's algorithm, which is numerically stable even when the
+	mean is large compared to the spread (e.g. a 1 GHz clock with a few ppm of jitter).
+ */
+class MeasurementAccumulator
+{
+public:
+	MeasurementAccumulator();
+
+	void Add(double v);
+	void Clear();
+
+	///@brief Number of values seen
+	uint64_t GetCount() const
+	{ return m_count; }
+
+	///@brief Smallest value seen
+	double GetMin() const
+	{ return m_min; }
+
+	///@brief Largest value seen
+	double GetMax() const
+	{ return m_max; }
+
+	///@brief Mean of all values seen
+	double GetMean() const
+	{ return m_mean; }
+
+	double GetStdDev() const;
+	double GetQuantile(double q) const;
+
+	///@brief Distribution of the values seen
+	const QuantileSketch& GetSketch() const
+	{ return m_sketch; }
+
+protected:
+	///@brief Number of values seen
+	uint64_t m_count;
+
+	///@brief Running mean
+	double m_mean;
+
+	///@brief Running sum of squared differences from the mean
+	double m_m2;
+
+	///@brief Smallest value seen
+	double m_min;
+
+	///@brief Largest value seen
+	double m_max;
+
+	///@brief Distribution of values
+	QuantileSketch m_sketch;
+};
+
+/**
+	@brief Statistics for every scalar measurement being tracked
+ */
+class MeasurementStatistics
+{
+public:
+	MeasurementStatistics();
+
+	void AddStream(StreamDescriptor stream);
+	void RemoveStream(StreamDescriptor stream);
+
+	void Record(TimePoint t);
+	void Reset();
+
+	void SetScope(TimePoint tstart, TimePoint tend);
+	void ClearScope();
+
+	///@brief True if statistics are limited to a range of history
+	bool IsScoped()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_scoped;
+	}
+
+	bool GetStatistics(StreamDescriptor stream, MeasurementAccumulator& stats);
+
+	///@brief Maximum number of past values kept per stream, for re-scoping
+	static const size_t MAX_SAMPLES = 100000;
+
+protected:
+
+	/**
+		@brief Statistics for one stream
+	 */
+	class StreamStatistics
+	{
+	public:
+		StreamStatistics()
+		: m_evicted(false)
+		, m_evictedThrough(0, 0)
+		{}
+
+		///@brief Statistics over every value recorded since the last reset
+		MeasurementAccumulator m_all;
+
+		///@brief Statistics over values within the current scope
+		MeasurementAccumulator m_scoped;
+
+		///@brief Recorded values, indexed by the timestamp of the acquisition they came from
+		std::map<TimePoint, double> m_samples;
+
+		///@brief True if values have been dropped from m_samples to keep it under MAX_SAMPLES
+		bool m_evicted;
+
+		/**
+			@brief Timestamp of the newest value dropped from m_samples
+
+			Everything up to and including this has already been counted in m_all, even though it's no longer in
+			m_samples.
+		 */
+		TimePoint m_evictedThrough;
+	};
+
+	bool InScope(TimePoint t)
+	{ return !(t < m_scopeStart) && !(m_scopeEnd < t); }
+
+	///@brief Mutex protecting all of our state (values are recorded from the GUI and history reprocessing threads)
+	std::mutex m_mutex;
+
+	///@brief Statistics for each stream being tracked
+	std::map<StreamDescriptor, StreamStatistics> m_streams;
+
+	///@brief True if statistics are limited to a range of history
+	bool m_scoped;
+
+	///@brief Start of the scope (inclusive)
+	TimePoint m_scopeStart;
+
+	///@brief End of the scope (inclusive)
+	TimePoint m_scopeEnd;
+};
+
+#endif
@@ -44,14 +44,20 @@ using namespace std;
 MeasurementsDialog::MeasurementsDialog(Session& session)
 	: Dialog("Measurements", "Measurements", ImVec2(300, 400))
 	, m_session(session)
+	, m_scoped(false)
+	, m_scopeStart(0, 0)
+	, m_scopeEnd(0, 0)
 {
 
 }
 
 MeasurementsDialog::~MeasurementsDialog()
 {
+	auto& stats = m_session.GetMeasurementStatistics();
+	stats.ClearScope();
 	for(auto s : m_streams)
 	{
+		stats.RemoveStream(s);
 		auto ochan = dynamic_cast<OscilloscopeChannel*>(s.m_channel);
 		if(ochan)
 			ochan->Release();
@@ -76,11 +82,15 @@ bool MeasurementsDialog::DoRender()
 		ImGuiTableFlags_BordersV |
 		ImGuiTableFlags_ScrollY |
 		ImGuiTableFlags_RowBg |
+		ImGuiTableFlags_Hideable |
 		ImGuiTableFlags_SizingFixedFit;
 
 	float width = ImGui::GetFontSize();
 
-	int ncols = 2;
+	DoScopeControls();
+
+	auto& stats = m_session.GetMeasurementStatistics();
+	int ncols = 9;
 	bool deleteRow = false;
 	size_t rowToDelete = 0;
 	if(ImGui::BeginTable("table", ncols, flags))
@@ -88,6 +98,14 @@ bool MeasurementsDialog::DoRender()
 		ImGui::TableSetupScrollFreeze(0, 1); //Header row does not scroll
 		ImGui::TableSetupColumn("Channel", ImGuiTableColumnFlags_WidthFixed, 15*width);
 		ImGui::TableSetupColumn("Value", ImGuiTableColumnFlags_WidthFixed, 10*width);
+		ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_WidthFixed, 5*width);
+		ImGui::TableSetupColumn("Min", ImGuiTableColumnFlags_WidthFixed, 8*width);
+		ImGui::TableSetupColumn("Mean", ImGuiTableColumnFlags_WidthFixed, 8*width);
+		ImGui::TableSetupColumn("Max", ImGuiTableColumnFlags_WidthFixed, 8*width);
+		ImGui::TableSetupColumn("Std dev", ImGuiTableColumnFlags_WidthFixed, 8*width);
+		ImGui::TableSetupColumn("Median",
+			ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultHide, 8*width);
+		ImGui::TableSetupColumn("Histogram", ImGuiTableColumnFlags_WidthFixed, 8*width);
 		ImGui::TableHeadersRow();
 
 		//TODO: double click value opens properties dialog
@@ -137,9 +155,29 @@ bool MeasurementsDialog::DoRender()
 			}
 
 			ImGui::TableSetColumnIndex(1);
-			auto value = s.GetYAxisUnits().PrettyPrint(s.GetScalarValue());
+			auto unit = s.GetYAxisUnits();
+			auto value = unit.PrettyPrint(s.GetScalarValue());
 			ImGui::TextUnformatted(value.c_str());
 
+			MeasurementAccumulator acc;
+			if(stats.GetStatistics(s, acc) && (acc.GetCount() > 0))
+			{
+				ImGui::TableSetColumnIndex(2);
+				ImGui::Text("%llu", static_cast<unsigned long long>(acc.GetCount()));
+				ImGui::TableSetColumnIndex(3);
+				ImGui::TextUnformatted(unit.PrettyPrint(acc.GetMin()).c_str());
+				ImGui::TableSetColumnIndex(4);
+				ImGui::TextUnformatted(unit.PrettyPrint(acc.GetMean()).c_str());
+				ImGui::TableSetColumnIndex(5);
+				ImGui::TextUnformatted(unit.PrettyPrint(acc.GetMax()).c_str());
+				ImGui::TableSetColumnIndex(6);
+				ImGui::TextUnformatted(unit.PrettyPrint(acc.GetStdDev()).c_str());
+				ImGui::TableSetColumnIndex(7);
+				ImGui::TextUnformatted(unit.PrettyPrint(acc.GetQuantile(0.5)).c_str());
+				ImGui::TableSetColumnIndex(8);
+				DoHistogram(acc, unit);
+			}
+
 			ImGui::PopID();
 		}
 
@@ -190,8 +228,103 @@ bool MeasurementsDialog::DoRender()
 	return true;
 }
 
+/**
+	@brief Runs the controls for resetting statistics and limiting them to a range of history
+ */
+void MeasurementsDialog::DoScopeControls()
+{
+	auto& stats = m_session.GetMeasurementStatistics();
+	auto& history = m_session.GetHistory().m_history;
+
+	if(ImGui::Button("Reset"))
+		stats.Reset();
+	Tooltip("Discard statistics collected so far");
+
+	ImGui::SameLine();
+	if(ImGui::Checkbox("History range", &m_scoped))
+	{
+		//Default to all of the history we currently have
+		if(m_scoped && !history.empty())
+		{
+			m_scopeStart = history.front()->m_time;
+			m_scopeEnd = history.back()->m_time;
+		}
+
+		if(m_scoped)
+			stats.SetScope(m_scopeStart, m_scopeEnd);
+		else
+			stats.ClearScope();
+	}
+	HelpMarker(
+		"Only include acquisitions within a range of history in the statistics.\n\n"
+		"Use Reprocess in the history dialog to add statistics for acquisitions made before a measurement was added.");
+
+	if(!m_scoped)
+		return;
+
+	//Pick the start and end points from the history we have
+	float width = ImGui::GetFontSize();
+	bool changed = false;
+	TimePoint* ends[2] = {&m_scopeStart, &m_scopeEnd};
+	const char* labels[2] = {"From", "To"};
+	for(int i=0; i<2; i++)
+	{
+		ImGui::SetNextItemWidth(12*width);
+		if(ImGui::BeginCombo(labels[i], ends[i]->PrettyPrint().c_str()))
+		{
+			for(auto& point : history)
+			{
+				bool selected = (point->m_time == *ends[i]);
+				if(ImGui::Selectable(point->m_time.PrettyPrint().c_str(), selected))
+				{
+					*ends[i] = point->m_time;
+					changed = true;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		if(i == 0)
+			ImGui::SameLine();
+	}
+
+	if(changed)
+		stats.SetScope(m_scopeStart, m_scopeEnd);
+}
+
+/**
+	@brief Draws a small histogram of a measurement, with quantiles in a tooltip
+ */
+void MeasurementsDialog::DoHistogram(const MeasurementAccumulator& stats, Unit unit)
+{
+	vector<float> counts;
+	stats.GetSketch().GetHistogram(counts, 32);
+	ImGui::PlotHistogram(
+		"###histogram",
+		counts.data(),
+		counts.size(),
+		0,
+		nullptr,
+		0,
+		FLT_MAX,
+		ImVec2(ImGui::GetColumnWidth(), ImGui::GetTextLineHeight()));
+
+	if(ImGui::IsItemHovered(ImGuiHoveredFlags_DelayShort))
+	{
+		ImGui::BeginTooltip();
+		ImGui::Text("Range: %s to %s",
+			unit.PrettyPrint(stats.GetMin()).c_str(),
+			unit.PrettyPrint(stats.GetMax()).c_str());
+		double quantiles[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+		for(auto q : quantiles)
+			ImGui::Text("%2.0f%%: %s", q*100, unit.PrettyPrint(stats.GetQuantile(q)).c_str());
+		ImGui::EndTooltip();
+	}
+}
+
 void MeasurementsDialog::RemoveStream(size_t i)
 {
+	m_session.GetMeasurementStatistics().RemoveStream(m_streams[i]);
+
 	auto ochan = dynamic_cast<OscilloscopeChannel*>(m_streams[i].m_channel);
 	m_streamset.erase(ochan);
 	if(ochan)
@@ -210,6 +343,7 @@ void MeasurementsDialog::AddStream(StreamDescriptor stream)
 
 	m_streams.push_back(stream);
 	m_streamset.emplace(stream);
+	m_session.GetMeasurementStatistics().AddStream(stream);
 
 	auto ochan = dynamic_cast<OscilloscopeChannel*>(stream.m_channel);
 	if(ochan)
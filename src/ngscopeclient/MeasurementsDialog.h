@@ -58,6 +58,8 @@ protected:
 	Session& m_session;
 
 	void RemoveStream(size_t i);
+	void DoScopeControls();
+	void DoHistogram(const MeasurementAccumulator& stats, Unit unit);
 
 	/**
 		@brief Ordered list of streams being displayed, in the order they should be drawn in the table
@@ -68,6 +70,15 @@ protected:
 		@brief Unordered list of streams being displayed, to quickly check if an item is in it
 	 */
 	std::set<StreamDescriptor> m_streamset;
+
+	///@brief True if statistics are limited to a range of history
+	bool m_scoped;
+
+	///@brief First acquisition included in the statistics, if scoped
+	TimePoint m_scopeStart;
+
+	///@brief Last acquisition included in the statistics, if scoped
+	TimePoint m_scopeEnd;
 };
 
 #endif
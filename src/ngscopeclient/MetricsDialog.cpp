@@ -36,15 +36,17 @@
 #include "ngscopeclient.h"
 #include "MetricsDialog.h"
 #include "Session.h"
+#include "MainWindow.h"
 
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-MetricsDialog::MetricsDialog(Session* session)
+MetricsDialog::MetricsDialog(Session* session, MainWindow* parent)
 	: Dialog("Performance Metrics", "Metrics", ImVec2(300, 400))
 	, m_session(session)
+	, m_parent(parent)
 {
 	m_displayRefreshRate = 0;
 
@@ -102,6 +104,37 @@ bool MetricsDialog::DoRender()
 		HelpMarker(
 			"Refresh rate for your monitor. Framerate should ideally be very close to this.");
 
+		ImGui::BeginDisabled();
+			str = fs.PrettyPrint(m_session->GetFrameTimePercentile(50));
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Frame time (p50)", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Median time the GUI thread spent drawing each of the last 512 frames, including vsync waits.");
+
+		ImGui::BeginDisabled();
+			str = fs.PrettyPrint(m_session->GetFrameTimePercentile(99));
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Frame time (p99)", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"99th percentile GUI frame time over the last 512 frames.\n\n"
+			"Spikes here while the median stays low usually mean the GUI thread is stalling on locks held by "
+			"filter graph execution or waveform rendering.");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetStaleFrameCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Stale frames", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of frames drawn while the filter graph was still updating its outputs.\n\n"
+			"These frames show the last published waveforms rather than blocking the GUI thread until the update "
+			"finished. Cursor readouts and tooltips that need waveform data are not updated in them.");
+
 		ImGui::BeginDisabled();
 			str = fs.PrettyPrint(m_session->GetLastWaveformRenderTime());
 			ImGui::SetNextItemWidth(width);
@@ -126,6 +159,16 @@ bool MetricsDialog::DoRender()
 			"does not necessarily execute every frame. When needed, it runs synchronously during frame rendering."
 			);
 
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetPipelineRegistry().GetPipelineCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Compute pipelines", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of compute pipelines created for rasterizing and tone mapping waveforms.\n\n"
+			"Pipelines are shared between all displayed channels which use the same shader.");
+
 
 		ImGui::BeginDisabled();
 			str = counts.PrettyPrint(ImGui::GetIO().MetricsRenderVertices);
@@ -165,6 +208,18 @@ bool MetricsDialog::DoRender()
 		ImGui::EndDisabled();
 
 		HelpMarker("Update time for the last evaluation of the filter graph");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetSkippedFilterCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Skipped filters", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of filters not evaluated by the last full refresh because nothing visible depends on them.\n\n"
+			"Always zero unless \"Only evaluate visible filters\" is turned on in preferences.");
+
+		DoFilterProfile();
 	}
 
 	if(ImGui::CollapsingHeader("Acquisition"))
@@ -182,30 +237,98 @@ bool MetricsDialog::DoRender()
 			"are likely the bottleneck."
 			);
 
-		//Category for each scope
-		auto scopes = m_session->GetScopes();
-		for(auto s : scopes)
+		//Category for each trigger group
+		Unit bytes(Unit::UNIT_BYTES);
+		auto groups = m_session->GetTriggerGroups();
+		for(auto group : groups)
 		{
-			if(ImGui::TreeNode(s->m_nickname.c_str()))
+			if(!group->HasScopes())
+				continue;
+
+			ImGui::PushID(group.get());
+			if(ImGui::TreeNode(group->GetDescription().c_str()))
 			{
 				ImGui::BeginDisabled();
-					str = counts.PrettyPrint(s->GetPendingWaveformCount());
+					str = TriggerGroup::GetPolicyName(group->GetAcquisitionPolicy());
 					ImGui::SetNextItemWidth(width);
-					ImGui::InputText("Pending waveforms", &str);
+					ImGui::InputText("Policy", &str);
 				ImGui::EndDisabled();
 
 				HelpMarker(
-					"Number of waveforms queued for processing.\n\n"
-					"This value should normally be 0 or 1, and is capped at 5.\n"
-					"If it is consistently at or near 5, waveform processing and/or rendering is unable to keep "
-					"up with the instrument."
-					);
+					"What happens when waveform processing falls behind the instruments in this group.\n\n"
+					"Change this in the Manage Instruments dialog.");
+
+				ImGui::BeginDisabled();
+					str = counts.PrettyPrint(group->GetProcessedTriggerCount());
+					ImGui::SetNextItemWidth(width);
+					ImGui::InputText("Processed triggers", &str);
+				ImGui::EndDisabled();
+
+				HelpMarker("Number of triggers pulled from the queue and processed");
+
+				ImGui::BeginDisabled();
+					str = counts.PrettyPrint(group->GetDroppedTriggerCount());
+					ImGui::SetNextItemWidth(width);
+					ImGui::InputText("Dropped triggers", &str);
+				ImGui::EndDisabled();
+
+				HelpMarker(
+					"Number of triggers discarded without processing because the queue was full.\n\n"
+					"Always zero with the \"Block\" policy: instead, the instruments are left waiting until the "
+					"backlog has been processed.");
+
+				//Queue status for each instrument
+				vector<shared_ptr<Oscilloscope> > scopes;
+				scopes.push_back(group->m_primary);
+				for(auto s : group->m_secondaries)
+					scopes.push_back(s);
+
+				for(auto s : scopes)
+				{
+					if(ImGui::TreeNode(s->m_nickname.c_str()))
+					{
+						ImGui::BeginDisabled();
+							str = counts.PrettyPrint(s->GetPendingWaveformCount());
+							ImGui::SetNextItemWidth(width);
+							ImGui::InputText("Pending waveforms", &str);
+						ImGui::EndDisabled();
+
+						HelpMarker(
+							"Number of waveforms queued for processing.\n\n"
+							"This value should normally be 0 or 1.\n"
+							"If it is consistently large, waveform processing and/or rendering is unable to keep "
+							"up with the instrument."
+							);
+
+						ImGui::BeginDisabled();
+							auto pending = group->GetPendingBytes(s);
+							if(pending < 0)
+								str = "(unknown)";
+							else
+								str = bytes.PrettyPrint(pending) + " / " + bytes.PrettyPrint(group->GetMaxPendingBytes());
+							ImGui::SetNextItemWidth(width);
+							ImGui::InputText("Queue size", &str);
+						ImGui::EndDisabled();
+
+						HelpMarker(
+							"Estimated memory used by queued waveforms, and the limit for this trigger group.\n\n"
+							"Once the limit is reached, the group's policy decides what happens to new data.\n"
+							"Unknown until the first waveform from the instrument has been processed."
+							);
+
+						ImGui::TreePop();
+					}
+				}
 
 				ImGui::TreePop();
 			}
+			ImGui::PopID();
 		}
 	}
 
+	if(ImGui::CollapsingHeader("Instrument polling"))
+		DoPollingMetrics();
+
 	//Only show this tab if available
 	if(g_hasMemoryBudget)
 	{
@@ -297,3 +420,225 @@ bool MetricsDialog::DoRender()
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // UI event handlers
+
+/**
+	@brief Per-filter profiling controls and results table
+ */
+void MetricsDialog::DoFilterProfile()
+{
+	auto& profiler = m_session->GetFilterProfiler();
+
+	bool enabled = profiler.IsEnabled();
+	if(ImGui::Checkbox("Per-filter profiling", &enabled))
+		profiler.SetEnabled(enabled);
+
+	HelpMarker(
+		"Time each filter individually and show the results below and as a heatmap in the filter graph editor.\n\n"
+		"While enabled, filters are executed one at a time so their run times can be separated. "
+		"This makes the filter graph slower, so turn it off when you're done.");
+
+	if(!enabled)
+		return;
+
+	ImGui::SameLine();
+	if(ImGui::Button("Export trace...") && !m_traceBrowser)
+	{
+		m_traceBrowser = MakeFileBrowser(
+			m_parent,
+			".",
+			"Export Chrome Trace",
+			"JSON files (*.json)",
+			"*.json",
+			true);
+	}
+	Tooltip("Save the most recent graph run as a trace for chrome://tracing or Perfetto");
+
+	if(m_traceBrowser)
+	{
+		m_traceBrowser->Render();
+
+		if(m_traceBrowser->IsClosedOK())
+		{
+			if(!profiler.ExportChromeTrace(m_traceBrowser->GetFileName()))
+			{
+				m_parent->ShowErrorPopup(
+					"Export failed",
+					"Unable to write the trace file, or no filters have been profiled yet");
+			}
+		}
+
+		if(m_traceBrowser->IsClosed())
+			m_traceBrowser = nullptr;
+	}
+
+	//Flatten stats into rows for sorting
+	auto stats = profiler.GetStats();
+	vector<const FilterProfileStats*> rows;
+	for(auto& it : stats)
+		rows.push_back(&it.second);
+
+	static ImGuiTableFlags flags =
+		ImGuiTableFlags_Resizable |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_BordersV |
+		ImGuiTableFlags_ScrollY |
+		ImGuiTableFlags_RowBg |
+		ImGuiTableFlags_Sortable |
+		ImGuiTableFlags_SizingFixedFit;
+
+	float width = ImGui::GetFontSize();
+	if(!ImGui::BeginTable("profile", 6, flags, ImVec2(0, 15*width)))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1); //Header row does not scroll
+	ImGui::TableSetupColumn("Filter", ImGuiTableColumnFlags_WidthFixed, 10*width);
+	ImGui::TableSetupColumn("Last", ImGuiTableColumnFlags_WidthFixed, 5*width);
+	ImGui::TableSetupColumn("Average",
+		ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending,
+		5*width);
+	ImGui::TableSetupColumn("Max", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 5*width);
+	ImGui::TableSetupColumn("Samples out", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 5*width);
+	ImGui::TableSetupColumn("Memory", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 5*width);
+	ImGui::TableHeadersRow();
+
+	//Sort by whichever column was clicked
+	auto sortSpecs = ImGui::TableGetSortSpecs();
+	if(sortSpecs && (sortSpecs->SpecsCount > 0))
+	{
+		auto col = sortSpecs->Specs[0].ColumnIndex;
+		bool ascending = (sortSpecs->Specs[0].SortDirection == ImGuiSortDirection_Ascending);
+		stable_sort(rows.begin(), rows.end(), [&](const FilterProfileStats* a, const FilterProfileStats* b)
+			{
+				double va = 0;
+				double vb = 0;
+				switch(col)
+				{
+					case 0:
+						return ascending ? (a->m_last.m_name < b->m_last.m_name) : (a->m_last.m_name > b->m_last.m_name);
+					case 1:
+						va = a->m_last.m_duration;
+						vb = b->m_last.m_duration;
+						break;
+					case 2:
+						va = a->GetAverage();
+						vb = b->GetAverage();
+						break;
+					case 3:
+						va = a->GetMax();
+						vb = b->GetMax();
+						break;
+					case 4:
+						va = a->m_last.m_outputSamples;
+						vb = b->m_last.m_outputSamples;
+						break;
+					default:
+						va = a->m_last.m_outputBytes;
+						vb = b->m_last.m_outputBytes;
+						break;
+				}
+				return ascending ? (va < vb) : (va > vb);
+			});
+	}
+
+	Unit fs(Unit::UNIT_FS);
+	Unit counts(Unit::UNIT_COUNTS);
+	Unit bytes(Unit::UNIT_BYTES);
+	for(auto row : rows)
+	{
+		ImGui::TableNextRow(ImGuiTableRowFlags_None);
+
+		ImGui::TableSetColumnIndex(0);
+		ImGui::TextUnformatted(row->m_last.m_name.c_str());
+		if(ImGui::IsItemHovered())
+		{
+			ImGui::BeginTooltip();
+			ImGui::Text("Input samples: %s", counts.PrettyPrint(row->m_last.m_inputSamples).c_str());
+			ImGui::EndTooltip();
+		}
+
+		ImGui::TableSetColumnIndex(1);
+		ImGui::TextUnformatted(fs.PrettyPrint(row->m_last.m_duration * FS_PER_SECOND).c_str());
+
+		ImGui::TableSetColumnIndex(2);
+		ImGui::TextUnformatted(fs.PrettyPrint(row->GetAverage() * FS_PER_SECOND).c_str());
+
+		ImGui::TableSetColumnIndex(3);
+		ImGui::TextUnformatted(fs.PrettyPrint(row->GetMax() * FS_PER_SECOND).c_str());
+
+		ImGui::TableSetColumnIndex(4);
+		ImGui::TextUnformatted(counts.PrettyPrint(row->m_last.m_outputSamples).c_str());
+
+		ImGui::TableSetColumnIndex(5);
+		ImGui::TextUnformatted(bytes.PrettyPrint(row->m_last.m_outputBytes).c_str());
+	}
+
+	ImGui::EndTable();
+}
+
+/**
+	@brief Shows how often each non-scope instrument is being polled, and how long polls take
+ */
+void MetricsDialog::DoPollingMetrics()
+{
+	HelpMarker(
+		"Instruments are polled at full rate while their dialog is open, or while their data is used by a filter, "
+		"displayed, or logged.\n"
+		"Otherwise they're polled slowly in the background.\n\n"
+		"In both cases, polling slows down while readings aren't changing.");
+
+	static ImGuiTableFlags flags =
+		ImGuiTableFlags_Resizable |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_BordersV |
+		ImGuiTableFlags_RowBg |
+		ImGuiTableFlags_SizingFixedFit;
+
+	float width = ImGui::GetFontSize();
+	if(!ImGui::BeginTable("polling", 6, flags))
+		return;
+
+	ImGui::TableSetupColumn("Instrument", ImGuiTableColumnFlags_WidthFixed, 10*width);
+	ImGui::TableSetupColumn("Demand", ImGuiTableColumnFlags_WidthFixed, 4*width);
+	ImGui::TableSetupColumn("Interval", ImGuiTableColumnFlags_WidthFixed, 5*width);
+	ImGui::TableSetupColumn("Rate", ImGuiTableColumnFlags_WidthFixed, 5*width);
+	ImGui::TableSetupColumn("Latency", ImGuiTableColumnFlags_WidthFixed, 5*width);
+	ImGui::TableSetupColumn("Average", ImGuiTableColumnFlags_WidthFixed, 5*width);
+	ImGui::TableHeadersRow();
+
+	Unit fs(Unit::UNIT_FS);
+	Unit hz(Unit::UNIT_HZ);
+	double now = GetTime();
+	auto instruments = m_session->GetPolledInstruments();
+	for(auto inst : instruments)
+	{
+		//Scopes are polled for triggers, not by the scheduler
+		if(dynamic_pointer_cast<Oscilloscope>(inst))
+			continue;
+
+		auto scheduler = m_session->GetPollScheduler(inst);
+		if(!scheduler)
+			continue;
+
+		ImGui::TableNextRow(ImGuiTableRowFlags_None);
+
+		ImGui::TableSetColumnIndex(0);
+		ImGui::TextUnformatted(inst->m_nickname.c_str());
+
+		ImGui::TableSetColumnIndex(1);
+		ImGui::TextUnformatted(scheduler->IsActive(now) ? "Active" : "Idle");
+
+		ImGui::TableSetColumnIndex(2);
+		ImGui::TextUnformatted(fs.PrettyPrint(scheduler->GetInterval(now) * FS_PER_SECOND).c_str());
+
+		ImGui::TableSetColumnIndex(3);
+		ImGui::TextUnformatted(hz.PrettyPrint(scheduler->GetPollRate()).c_str());
+
+		ImGui::TableSetColumnIndex(4);
+		ImGui::TextUnformatted(fs.PrettyPrint(scheduler->GetLatency() * FS_PER_SECOND).c_str());
+
+		ImGui::TableSetColumnIndex(5);
+		ImGui::TextUnformatted(fs.PrettyPrint(scheduler->GetAverageLatency() * FS_PER_SECOND).c_str());
+	}
+
+	ImGui::EndTable();
+}
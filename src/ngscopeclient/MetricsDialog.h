@@ -36,18 +36,28 @@
 #define MetricsDialog_h
 
 #include "Dialog.h"
+#include "FileBrowser.h"
 
 class MetricsDialog : public Dialog
 {
 public:
-	MetricsDialog(Session* session);
+	MetricsDialog(Session* session, MainWindow* parent);
 	virtual ~MetricsDialog();
 
 	virtual bool DoRender();
 
 protected:
+	void DoFilterProfile();
+	void DoPollingMetrics();
+
 	Session* m_session;
 
+	///@brief Top level window, for file dialogs
+	MainWindow* m_parent;
+
+	///@brief File browser for exporting Chrome traces
+	std::shared_ptr<FileBrowser> m_traceBrowser;
+
 	int m_displayRefreshRate;
 };
 
@@ -37,6 +37,7 @@
 #include "MultimeterDialog.h"
 
 using namespace std;
+using namespace std::chrono_literals;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
@@ -52,6 +53,9 @@ MultimeterDialog::MultimeterDialog(shared_ptr<SCPIMultimeter> meter, shared_ptr<
 	, m_state(state)
 	, m_selectedChannel(m_meter->GetCurrentMeterChannel())
 	, m_autorange(m_meter->GetMeterAutoRange())
+	, m_queue(session->GetInstrumentCommandQueue(meter))
+	, m_history(state->m_telemetry)
+	, m_scheduler(session->GetPollScheduler(meter))
 {
 	m_meter->StartMeter();
 
@@ -76,7 +80,7 @@ MultimeterDialog::MultimeterDialog(shared_ptr<SCPIMultimeter> meter, shared_ptr<
 	}
 
 	//Secondary operating modes
-	RefreshSecondaryModeList();
+	RefreshSecondaryModeList(m_meter->GetSecondaryMeasurementTypes(), m_meter->GetSecondaryMeterMode());
 }
 
 MultimeterDialog::~MultimeterDialog()
@@ -89,6 +93,10 @@ MultimeterDialog::~MultimeterDialog()
 
 bool MultimeterDialog::DoRender()
 {
+	//Keep polling at full rate while we're on screen
+	if(m_scheduler)
+		m_scheduler->NotifyViewed();
+
 	float valueWidth = 10 * ImGui::GetFontSize();
 
 	//Device information
@@ -134,10 +142,21 @@ bool MultimeterDialog::DoRender()
 	auto primaryMode = m_meter->ModeToText(m_meter->GetMeterMode());
 	auto secondaryMode = m_meter->ModeToText(m_meter->GetSecondaryMeterMode());
 
+	//Pick up the new secondary mode list once the meter has switched primary modes
+	if(m_secondaryModeFuture.valid() && (m_secondaryModeFuture.wait_for(0s) == future_status::ready) )
+	{
+		auto modes = m_secondaryModeFuture.get();
+		RefreshSecondaryModeList(modes.first, modes.second);
+	}
+
+	auto meter = m_meter;
 	if(ImGui::CollapsingHeader("Configuration", ImGuiTreeNodeFlags_DefaultOpen))
 	{
 		if(ImGui::Checkbox("Autorange", &m_autorange))
-			m_meter->SetMeterAutoRange(m_autorange);
+		{
+			bool autorange = m_autorange;
+			m_queue->SubmitWrite("autorange", [meter, autorange]{ meter->SetMeterAutoRange(autorange); });
+		}
 		HelpMarker("Enables automatic selection of meter scale ranges.");
 
 		//Channel selector (hide if we have only one channel)
@@ -145,7 +164,10 @@ bool MultimeterDialog::DoRender()
 		{
 			ImGui::SetNextItemWidth(valueWidth);
 			if(Combo("Channel", m_channelNames, m_selectedChannel))
-				m_meter->SetCurrentMeterChannel(m_selectedChannel);
+			{
+				int chan = m_selectedChannel;
+				m_queue->SubmitWrite("channel", [meter, chan]{ meter->SetCurrentMeterChannel(chan); });
+			}
 
 			HelpMarker("Select which input channel is being monitored.");
 		}
@@ -157,12 +179,17 @@ bool MultimeterDialog::DoRender()
 		HelpMarker("Select the type of measurement to make.");
 
 		//Secondary operating mode selector
-		if(m_secondaryModeNames.empty())
+		//(disabled while we're waiting to hear which modes are valid after a primary mode change)
+		bool noSecondary = m_secondaryModeNames.empty() || m_secondaryModeFuture.valid();
+		if(noSecondary)
 			ImGui::BeginDisabled();
 		ImGui::SetNextItemWidth(valueWidth);
 		if(Combo("Secondary Mode", m_secondaryModeNames, m_secondaryModeSelector))
-			m_meter->SetSecondaryMeterMode(m_secondaryModes[m_secondaryModeSelector]);
-		if(m_secondaryModeNames.empty())
+		{
+			auto mode = m_secondaryModes[m_secondaryModeSelector];
+			m_queue->SubmitWrite("secondarymode", [meter, mode]{ meter->SetSecondaryMeterMode(mode); });
+		}
+		if(noSecondary)
 			ImGui::EndDisabled();
 
 		HelpMarker(
@@ -199,26 +226,57 @@ bool MultimeterDialog::DoRender()
 		}
 	}
 
+	//Restart history if the meter is now measuring something else
+	auto priUnit = m_meter->GetMeterUnit();
+	if(m_state->m_primaryHistory->GetUnit().GetType() != priUnit.GetType())
+	{
+		m_state->m_primaryHistory->Clear();
+		m_state->m_primaryHistory->SetUnit(priUnit);
+	}
+	auto secUnit = m_meter->GetSecondaryMeterUnit();
+	if(m_state->m_secondaryHistory->GetUnit().GetType() != secUnit.GetType())
+	{
+		m_state->m_secondaryHistory->Clear();
+		m_state->m_secondaryHistory->SetUnit(secUnit);
+	}
+
+	if(ImGui::CollapsingHeader("History"))
+	{
+		vector<shared_ptr<TelemetrySeries> > series = { m_state->m_primaryHistory };
+		if(hasSecondary)
+			series.push_back(m_state->m_secondaryHistory);
+		m_history.Render(series);
+	}
+
 	return true;
 }
 
 void MultimeterDialog::OnPrimaryModeChanged()
 {
-	//Push the new mode to the meter
-	m_meter->SetMeterMode(m_primaryModes[m_primaryModeSelector]);
-
-	//Redo the list of available secondary meter modes
-	RefreshSecondaryModeList();
+	//Push the new mode to the meter, then find out what secondary modes are available in it.
+	//The list is refreshed in DoRender() once the meter responds
+	auto meter = m_meter;
+	auto mode = m_primaryModes[m_primaryModeSelector];
+	m_secondaryModeFuture = m_queue->Submit<pair<unsigned int, Multimeter::MeasurementTypes> >([meter, mode]
+		{
+			meter->SetMeterMode(mode);
+			return pair<unsigned int, Multimeter::MeasurementTypes>(
+				meter->GetSecondaryMeasurementTypes(), meter->GetSecondaryMeterMode());
+		});
 }
 
-void MultimeterDialog::RefreshSecondaryModeList()
+/**
+	@brief Redo the list of available secondary meter modes
+
+	@param modemask	Bitmask of secondary modes valid in the current primary mode
+	@param secmode	Currently selected secondary mode
+ */
+void MultimeterDialog::RefreshSecondaryModeList(unsigned int modemask, Multimeter::MeasurementTypes secmode)
 {
 	m_secondaryModes.clear();
 	m_secondaryModeNames.clear();
 	m_secondaryModeSelector = -1;
 
-	auto modemask = m_meter->GetSecondaryMeasurementTypes();
-	auto secmode = m_meter->GetSecondaryMeterMode();
 	for(unsigned int i=0; i<32; i++)
 	{
 		auto mode = static_cast<Multimeter::MeasurementTypes>(1 << i);
@@ -37,6 +37,9 @@
 
 #include "Dialog.h"
 #include "Session.h"
+#include "TelemetryView.h"
+
+#include <future>
 
 class MultimeterDialog : public Dialog
 {
@@ -51,7 +54,7 @@ public:
 
 protected:
 	void OnPrimaryModeChanged();
-	void RefreshSecondaryModeList();
+	void RefreshSecondaryModeList(unsigned int modemask, Multimeter::MeasurementTypes secmode);
 
 	///@brief Session handle so we can remove the PSU when closed
 	Session* m_session;
@@ -91,6 +94,18 @@ protected:
 
 	///@brief Autorange enable flag
 	bool m_autorange;
+
+	///@brief Queue for running driver calls in the instrument thread
+	std::shared_ptr<InstrumentCommandQueue> m_queue;
+
+	///@brief Available and current secondary modes, being read back after a primary mode change
+	std::future<std::pair<unsigned int, Multimeter::MeasurementTypes> > m_secondaryModeFuture;
+
+	///@brief Plots of primary and secondary measurements
+	TelemetryView m_history;
+
+	///@brief Poll rate control for the instrument thread (told when we're on screen)
+	std::shared_ptr<PollScheduler> m_scheduler;
 };
 
 
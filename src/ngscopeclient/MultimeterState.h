@@ -47,11 +47,17 @@ public:
 		m_primaryMeasurement = 0;
 		m_secondaryMeasurement = 0;
 		m_firstUpdateDone = false;
+		m_telemetry = std::make_shared<TelemetryRecorder>();
 	}
 
 	std::atomic<float> m_primaryMeasurement;
 	std::atomic<float> m_secondaryMeasurement;
 	std::atomic<bool> m_firstUpdateDone;
+
+	//History of measured values (series are created by Session::AddInstrument)
+	std::shared_ptr<TelemetryRecorder> m_telemetry;
+	std::shared_ptr<TelemetrySeries> m_primaryHistory;
+	std::shared_ptr<TelemetrySeries> m_secondaryHistory;
 };
 
 #endif
@@ -0,0 +1,508 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of PacketExporter
+ */
+#include "ngscopeclient.h"
+#include "PacketExporter.h"
+#include "pthread_compat.h"
+
+using namespace std;
+
+///@brief Number of top level packets to format per block
+#define PACKETS_PER_EXPORT_BLOCK 1024
+
+//pcapng block types and options
+#define PCAPNG_BLOCK_SHB				0x0a0d0d0a
+#define PCAPNG_BLOCK_IDB				0x00000001
+#define PCAPNG_BLOCK_EPB				0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC			0x1a2b3c4d
+#define PCAPNG_OPT_ENDOFOPT				0
+#define PCAPNG_OPT_COMMENT				1
+#define PCAPNG_OPT_SHB_USERAPPL			4
+#define PCAPNG_OPT_IF_NAME				2
+#define PCAPNG_OPT_IF_TSRESOL			9
+#define PCAPNG_OPT_IF_TSOFFSET			14
+
+/**
+	@brief Link type for exported packets.
+
+	Decoded packets don't carry enough information to reconstruct the original on-the-wire framing for most
+	protocols, so we use the first user-defined DLT and attach the decoded header fields to each packet as a comment.
+ */
+#define PCAPNG_LINKTYPE_USER0			147
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PacketExporter::PacketExporter(
+	PacketDecoder* filter,
+	shared_ptr<PacketManager> mgr,
+	const string& path,
+	Format format)
+	: m_filter(filter)
+	, m_mgr(mgr)
+	, m_path(path)
+	, m_format(format)
+	, m_showData(filter->GetShowDataColumn())
+	, m_totalPackets(0)
+	, m_packetsDone(0)
+	, m_cancel(false)
+	, m_done(false)
+	, m_ok(false)
+	, m_pcapngBaseSec(0)
+	, m_pcapngDigits(9)
+	, m_pcapngFsPerTick(1000000)
+{
+	//Hold a reference open to the filter so it doesn't disappear on us
+	m_filter->AddRef();
+
+	m_headers = m_filter->GetHeaders();
+}
+
+PacketExporter::~PacketExporter()
+{
+	if(m_thread)
+	{
+		m_cancel = true;
+		m_thread->join();
+	}
+	m_thread = nullptr;
+
+	m_filter->Release();
+}
+
+/**
+	@brief Guesses the output format from a file name
+ */
+PacketExporter::Format PacketExporter::GuessFormat(const string& path)
+{
+	auto ext = path.rfind('.');
+	if( (ext != string::npos) && (path.substr(ext) == ".pcapng") )
+		return FORMAT_PCAPNG;
+	return FORMAT_CSV;
+}
+
+/**
+	@brief Gets the fraction of the export which has completed
+ */
+float PacketExporter::GetProgress()
+{
+	if(m_done)
+		return 1;
+	if(m_totalPackets == 0)
+		return 0;
+	return m_packetsDone * 1.0f / m_totalPackets;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Export logic
+
+/**
+	@brief Runs the export in a background thread
+ */
+void PacketExporter::Start()
+{
+	m_thread = make_unique<thread>([this]
+	{
+		pthread_setname_np_compat("PacketExport");
+		Run();
+	});
+}
+
+/**
+	@brief Runs the export in the calling thread
+
+	@return True on success, false on failure or cancellation
+ */
+bool PacketExporter::Run()
+{
+	LogTrace("Exporting packets from %s to %s\n", m_filter->GetDisplayName().c_str(), m_path.c_str());
+
+	FILE* fp = fopen(m_path.c_str(), "wb");
+	if(!fp)
+	{
+		m_error = string("Couldn't open \"") + m_path + "\" for writing";
+		m_done = true;
+		return false;
+	}
+
+	//Make a list of waveforms to export. The map is sorted so these are already in order.
+	vector<TimePoint> times;
+	{
+		lock_guard<recursive_mutex> lock(m_mgr->GetMutex());
+		auto& packets = m_mgr->GetFilteredPackets();
+		size_t total = 0;
+		for(auto& it : packets)
+		{
+			times.push_back(it.first);
+			total += it.second.size();
+		}
+		m_totalPackets = total;
+	}
+
+	string buf;
+	if(m_format == FORMAT_PCAPNG)
+		FormatPcapngHeader(buf, times);
+	else
+		FormatCSVHeader(buf);
+
+	bool ok = true;
+	for(auto t : times)
+	{
+		//Packets are located by index rather than iterator because we drop the lock between blocks
+		size_t i = 0;
+		bool waveformDone = false;
+		while(!waveformDone && !m_cancel)
+		{
+			size_t npackets = 0;
+			{
+				lock_guard<recursive_mutex> lock(m_mgr->GetMutex());
+
+				//Waveform may have been removed from history since we started
+				auto& filtered = m_mgr->GetFilteredPackets();
+				auto it = filtered.find(t);
+				if(it == filtered.end())
+					break;
+				auto& packets = it->second;
+
+				size_t end = min(i + PACKETS_PER_EXPORT_BLOCK, packets.size());
+				for(; i<end; i++)
+				{
+					auto p = packets[i];
+					auto children = m_mgr->GetFilteredChildPackets(p);
+
+					if(m_format == FORMAT_PCAPNG)
+					{
+						//pcapng has no concept of hierarchy, so export the children of merged packets if we have them
+						if(children.empty())
+							FormatPcapngPacket(buf, t, p);
+						for(auto c : children)
+							FormatPcapngPacket(buf, t, c);
+					}
+					else
+					{
+						FormatCSVRow(buf, t, p, 0);
+						for(auto c : children)
+							FormatCSVRow(buf, t, c, 1);
+					}
+					npackets ++;
+				}
+
+				waveformDone = (i >= packets.size());
+			}
+
+			//Write outside the lock
+			if(fwrite(buf.c_str(), 1, buf.length(), fp) != buf.length())
+			{
+				m_error = string("Failed to write to \"") + m_path + "\"";
+				ok = false;
+				break;
+			}
+			buf.clear();
+
+			m_packetsDone += npackets;
+		}
+
+		if(!ok || m_cancel)
+			break;
+	}
+
+	//Flush any headers left over if there were no packets at all
+	if(ok && !buf.empty())
+	{
+		if(fwrite(buf.c_str(), 1, buf.length(), fp) != buf.length())
+		{
+			m_error = string("Failed to write to \"") + m_path + "\"";
+			ok = false;
+		}
+	}
+
+	if(fclose(fp) != 0)
+	{
+		m_error = string("Failed to write to \"") + m_path + "\"";
+		ok = false;
+	}
+
+	//Don't leave a truncated file behind if the user gave up on it
+	if(m_cancel && ok)
+	{
+		m_error = "Export cancelled";
+		ok = false;
+		remove(m_path.c_str());
+	}
+
+	LogTrace("Export %s after %zu packets\n", ok ? "complete" : "failed", m_packetsDone.load());
+
+	m_ok = ok;
+	m_done = true;
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CSV output
+
+void PacketExporter::FormatCSVHeader(string& buf)
+{
+	buf += "Timestamp,Offset (fs),Length (fs),Level";
+	for(auto& h : m_headers)
+	{
+		buf += ',';
+		AppendCSVField(buf, h);
+	}
+	if(m_showData)
+		buf += ",Data";
+	buf += "\n";
+}
+
+/**
+	@brief Formats a single packet as a CSV row
+
+	@param buf		Output buffer
+	@param stamp	Timestamp of the waveform the packet came from
+	@param pack		The packet
+	@param level	0 for top level packets, 1 for children of a merged packet
+ */
+void PacketExporter::FormatCSVRow(string& buf, TimePoint stamp, Packet* pack, int level)
+{
+	AppendCSVField(buf, GetPacketTime(stamp, pack).PrettyPrint());
+
+	buf += ',';
+	buf += to_string(pack->m_offset);
+	buf += ',';
+	buf += to_string(pack->m_len);
+	buf += ',';
+	buf += to_string(level);
+
+	for(auto& h : m_headers)
+	{
+		buf += ',';
+		auto it = pack->m_headers.find(h);
+		if(it != pack->m_headers.end())
+			AppendCSVField(buf, it->second);
+	}
+
+	if(m_showData)
+	{
+		buf += ',';
+
+		char tmp[4];
+		for(size_t i=0; i<pack->m_data.size(); i++)
+		{
+			snprintf(tmp, sizeof(tmp), "%02x", pack->m_data[i]);
+			buf += tmp;
+		}
+	}
+
+	buf += "\n";
+}
+
+/**
+	@brief Gets the absolute start time of a packet, carrying whole seconds out of the femtoseconds field
+ */
+TimePoint PacketExporter::GetPacketTime(TimePoint stamp, Packet* pack)
+{
+	const int64_t fsPerSecond = FS_PER_SECOND;
+
+	int64_t sec = stamp.GetSec();
+	int64_t fs = stamp.GetFs() + pack->m_offset;
+
+	sec += fs / fsPerSecond;
+	fs %= fsPerSecond;
+	if(fs < 0)
+	{
+		fs += fsPerSecond;
+		sec --;
+	}
+
+	return TimePoint(sec, fs);
+}
+
+/**
+	@brief Appends a field to a CSV row, quoting it if needed
+ */
+void PacketExporter::AppendCSVField(string& buf, const string& field)
+{
+	if(field.find_first_of(",\"\r\n") == string::npos)
+	{
+		buf += field;
+		return;
+	}
+
+	buf += '\"';
+	for(auto c : field)
+	{
+		if(c == '\"')
+			buf += '\"';
+		buf += c;
+	}
+	buf += '\"';
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// pcapng output
+
+/**
+	@brief Writes the section header and interface description blocks
+
+	Timestamps are 64 bit counts of ticks, which can't hold femtoseconds since the epoch. Instead the interface
+	description sets an offset (in whole seconds) just before the first waveform, and the resolution is the finest
+	power of ten (femtoseconds at best) at which the whole export still fits. That keeps full femtosecond resolution
+	for any export spanning up to about five hours.
+
+	@param buf		Buffer to append to
+	@param times	Timestamps of the waveforms to be exported, in order
+ */
+void PacketExporter::FormatPcapngHeader(string& buf, const vector<TimePoint>& times)
+{
+	//Allow a second of slack either side for packets offset before or after their waveform's timestamp
+	m_pcapngBaseSec = 0;
+	uint64_t span = 2;
+	if(!times.empty())
+	{
+		m_pcapngBaseSec = times.front().GetSec() - 1;
+		span = times.back().GetSec() - m_pcapngBaseSec + 2;
+	}
+	m_pcapngDigits = 15;
+	m_pcapngFsPerTick = 1;
+	uint64_t ticksPerSec = static_cast<uint64_t>(FS_PER_SECOND);
+	while( (m_pcapngDigits > 0) && (span > UINT64_MAX / ticksPerSec) )
+	{
+		m_pcapngDigits --;
+		m_pcapngFsPerTick *= 10;
+		ticksPerSec /= 10;
+	}
+	LogTrace("pcapng timestamp resolution 1e-%d s\n", m_pcapngDigits);
+
+	//Section header
+	size_t start = buf.length();
+	AppendU32(buf, PCAPNG_BLOCK_SHB);
+	AppendU32(buf, 0);
+	AppendU32(buf, PCAPNG_BYTE_ORDER_MAGIC);
+	AppendU16(buf, 1);
+	AppendU16(buf, 0);
+	AppendU32(buf, 0xffffffff);		//section length not specified
+	AppendU32(buf, 0xffffffff);
+	AppendPcapngOption(buf, PCAPNG_OPT_SHB_USERAPPL, "ngscopeclient");
+	AppendU32(buf, PCAPNG_OPT_ENDOFOPT);
+	PatchBlockLength(buf, start);
+
+	//Interface description: one interface, timestamps relative to the base second
+	start = buf.length();
+	AppendU32(buf, PCAPNG_BLOCK_IDB);
+	AppendU32(buf, 0);
+	AppendU16(buf, PCAPNG_LINKTYPE_USER0);
+	AppendU16(buf, 0);
+	AppendU32(buf, 0);				//no snap length limit
+	AppendPcapngOption(buf, PCAPNG_OPT_IF_NAME, m_filter->GetDisplayName());
+	AppendPcapngOption(buf, PCAPNG_OPT_IF_TSRESOL, string(1, m_pcapngDigits));
+	AppendPcapngOption(buf, PCAPNG_OPT_IF_TSOFFSET,
+		string(reinterpret_cast<const char*>(&m_pcapngBaseSec), sizeof(m_pcapngBaseSec)));
+	AppendU32(buf, PCAPNG_OPT_ENDOFOPT);
+	PatchBlockLength(buf, start);
+}
+
+/**
+	@brief Formats a single packet as an enhanced packet block
+ */
+void PacketExporter::FormatPcapngPacket(string& buf, TimePoint stamp, Packet* pack)
+{
+	const int64_t fsPerSecond = FS_PER_SECOND;
+
+	auto t = GetPacketTime(stamp, pack);
+	uint64_t ticks =
+		static_cast<uint64_t>(t.GetSec() - m_pcapngBaseSec) * static_cast<uint64_t>(fsPerSecond / m_pcapngFsPerTick) +
+		static_cast<uint64_t>(t.GetFs() / m_pcapngFsPerTick);
+
+	size_t start = buf.length();
+	AppendU32(buf, PCAPNG_BLOCK_EPB);
+	AppendU32(buf, 0);
+	AppendU32(buf, 0);				//interface ID
+	AppendU32(buf, ticks >> 32);
+	AppendU32(buf, ticks & 0xffffffff);
+	AppendU32(buf, pack->m_data.size());
+	AppendU32(buf, pack->m_data.size());
+	buf.append(reinterpret_cast<const char*>(pack->m_data.data()), pack->m_data.size());
+	while(buf.length() & 3)
+		buf += '\0';
+
+	//Decoded header fields go in the comment
+	string comment;
+	for(auto& h : m_headers)
+	{
+		auto it = pack->m_headers.find(h);
+		if( (it == pack->m_headers.end()) || it->second.empty())
+			continue;
+		if(!comment.empty())
+			comment += ", ";
+		comment += h + ": " + it->second;
+	}
+	if(!comment.empty())
+	{
+		AppendPcapngOption(buf, PCAPNG_OPT_COMMENT, comment);
+		AppendU32(buf, PCAPNG_OPT_ENDOFOPT);
+	}
+
+	PatchBlockLength(buf, start);
+}
+
+/**
+	@brief Appends a TLV option, padded to a 32-bit boundary
+ */
+void PacketExporter::AppendPcapngOption(string& buf, uint16_t code, const string& value)
+{
+	AppendU16(buf, code);
+	AppendU16(buf, value.length());
+	buf += value;
+	while(buf.length() & 3)
+		buf += '\0';
+}
+
+/**
+	@brief Appends the trailing block length and fills in the leading one
+ */
+void PacketExporter::PatchBlockLength(string& buf, size_t blockStart)
+{
+	uint32_t len = buf.length() - blockStart + 4;
+	AppendU32(buf, len);
+	memcpy(&buf[blockStart + 4], &len, sizeof(len));
+}
+
+void PacketExporter::AppendU16(string& buf, uint16_t value)
+{
+	buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PacketExporter::AppendU32(string& buf, uint32_t value)
+{
+	buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
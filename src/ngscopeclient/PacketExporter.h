@@ -0,0 +1,163 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of PacketExporter
+ */
+#ifndef PacketExporter_h
+#define PacketExporter_h
+
+#include "PacketManager.h"
+
+/**
+	@brief Streams the filtered packets of a PacketManager to a file
+
+	Packets are walked in display order and written out a block at a time, so memory usage is bounded regardless of
+	how much history is being exported. The packet manager's mutex is only held while formatting each block, so the
+	GUI stays responsive while a long export runs in the background.
+ */
+class PacketExporter
+{
+public:
+
+	enum Format
+	{
+		FORMAT_CSV,
+		FORMAT_PCAPNG
+	};
+
+	PacketExporter(
+		PacketDecoder* filter,
+		std::shared_ptr<PacketManager> mgr,
+		const std::string& path,
+		Format format);
+	virtual ~PacketExporter();
+
+	void Start();
+	bool Run();
+
+	/**
+		@brief Requests that a running export stop at the next block boundary
+	 */
+	void Cancel()
+	{ m_cancel = true; }
+
+	/**
+		@brief Returns true once the export has finished (successfully or not)
+	 */
+	bool IsDone()
+	{ return m_done.load(); }
+
+	/**
+		@brief Returns true if the export finished successfully. Only valid once IsDone() returns true.
+	 */
+	bool Succeeded()
+	{ return m_ok; }
+
+	/**
+		@brief Returns true if the export was stopped by Cancel() rather than failing on its own
+	 */
+	bool WasCancelled()
+	{ return m_cancel.load() && !m_ok; }
+
+	/**
+		@brief Gets the error message for a failed export. Only valid once IsDone() returns true.
+	 */
+	const std::string& GetError()
+	{ return m_error; }
+
+	float GetProgress();
+
+	static Format GuessFormat(const std::string& path);
+
+protected:
+	void FormatCSVHeader(std::string& buf);
+	void FormatCSVRow(std::string& buf, TimePoint stamp, Packet* pack, int level);
+	static TimePoint GetPacketTime(TimePoint stamp, Packet* pack);
+	void FormatPcapngHeader(std::string& buf, const std::vector<TimePoint>& times);
+	void FormatPcapngPacket(std::string& buf, TimePoint stamp, Packet* pack);
+
+	static void AppendCSVField(std::string& buf, const std::string& field);
+	static void AppendPcapngOption(std::string& buf, uint16_t code, const std::string& value);
+	static void AppendU16(std::string& buf, uint16_t value);
+	static void AppendU32(std::string& buf, uint32_t value);
+	static void PatchBlockLength(std::string& buf, size_t blockStart);
+
+	///@brief The filter whose packets we're exporting
+	PacketDecoder* m_filter;
+
+	///@brief Packet manager holding the packets
+	std::shared_ptr<PacketManager> m_mgr;
+
+	///@brief Path to the output file
+	std::string m_path;
+
+	///@brief Output file format
+	Format m_format;
+
+	///@brief Protocol headers (snapshotted at start so the column set doesn't change mid-export)
+	std::vector<std::string> m_headers;
+
+	///@brief True if packet payloads should be exported
+	bool m_showData;
+
+	///@brief Number of top level packets to export
+	std::atomic<size_t> m_totalPackets;
+
+	///@brief Number of top level packets exported so far
+	std::atomic<size_t> m_packetsDone;
+
+	///@brief Set to request cancellation
+	std::atomic<bool> m_cancel;
+
+	///@brief Set when the export has finished
+	std::atomic<bool> m_done;
+
+	///@brief True if the export succeeded
+	bool m_ok;
+
+	///@brief Error message if the export failed
+	std::string m_error;
+
+	///@brief pcapng timestamps count from the start of this second (since the epoch)
+	int64_t m_pcapngBaseSec;
+
+	///@brief pcapng timestamp resolution, in decimal digits after the second
+	int m_pcapngDigits;
+
+	///@brief Femtoseconds per pcapng timestamp tick
+	int64_t m_pcapngFsPerTick;
+
+	///@brief Worker thread, if running in the background
+	std::unique_ptr<std::thread> m_thread;
+};
+
+#endif
@@ -43,13 +43,19 @@ using namespace std;
 
 PacketManager::PacketManager(PacketDecoder* pd, Session& session)
 	: m_session(session)
+	, m_searchIndex(m_mutex)
 	, m_filter(pd)
+	, m_rowsGeneration(0)
 {
 
 }
 
 PacketManager::~PacketManager()
 {
+	//Stop indexing before we start deleting packets out from under the index
+	m_searchIndex.Shutdown();
+	m_searchIndex.Clear();
+
 	for(auto& it : m_packets)
 	{
 		for(auto p : it.second)
@@ -60,6 +66,7 @@ PacketManager::~PacketManager()
 	}
 	m_packets.clear();
 	m_childPackets.clear();
+	m_childStorage.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -73,6 +80,7 @@ void PacketManager::RefreshRows()
 
 	//Clear all existing row state
 	m_rows.clear();
+	m_rowsGeneration ++;
 
 	//Make a list of waveform timestamps and make sure we display them in order
 	vector<TimePoint> times;
@@ -115,7 +123,7 @@ void PacketManager::RefreshRows()
 			}
 
 			//See if we have child packets
-			auto children = m_filteredChildPackets[pack];
+			auto children = GetFilteredChildPackets(pack);
 
 			//Add an entry for the top level
 			RowData dat(wavetime, pack);
@@ -192,54 +200,60 @@ void PacketManager::Update()
 	{
 		lock_guard<recursive_mutex> lock(m_mutex);
 
-		auto& outpackets = m_packets[time];
-		outpackets.clear();
+		double tstart = GetTime();
 
 		auto& packets = m_filter->GetPackets();
 		auto npackets = packets.size();
-		Packet* parentOfGroup = nullptr;
-		Packet* firstChildPacketOfGroup = nullptr;
-		Packet* lastPacket = nullptr;
-		for(size_t i=0; i<npackets; i++)
+
+		//Find all of the merge groups up front
+		vector<pair<size_t, size_t> > groups;
+		FindMergeGroups(packets, groups);
+
+		//Children are stored contiguously, so size the buffer once up front.
+		//This guarantees pointers into it remain valid as we add groups.
+		size_t nchildren = 0;
+		for(auto& g : groups)
+			nchildren += g.second - g.first;
+
+		auto& children = m_childStorage[time];
+		children.clear();
+		children.reserve(nchildren);
+
+		auto& outpackets = m_packets[time];
+		outpackets.clear();
+		outpackets.reserve(npackets - nchildren + groups.size());
+
+		//Copy runs of unmerged packets directly, and create a summary packet for each group
+		size_t i = 0;
+		for(auto& g : groups)
 		{
-			auto p = packets[i];
-
-			//See if we should start a new merge group
-			bool starting_new_group;
-			if(i+1 >= npackets)									//No next packet to merge with
-				starting_new_group = false;
-			else if(!m_filter->CanMerge(p, p, packets[i+1]))	//This packet isn't compatible with the next
-				starting_new_group = false;
-			else if(firstChildPacketOfGroup == nullptr)			//If we get here, we're merging. But are we already?
-				starting_new_group = true;
-			else												//Already in a group, but it's not the same as the new one
-				starting_new_group = !m_filter->CanMerge(firstChildPacketOfGroup, lastPacket, p);
-
-			if(starting_new_group)
-			{
-				//Create the summary packet
-				firstChildPacketOfGroup = p;
-				parentOfGroup = m_filter->CreateMergedHeader(p, i);
-				outpackets.push_back(parentOfGroup);
-			}
+			outpackets.insert(outpackets.end(), packets.begin() + i, packets.begin() + g.first);
 
-			//End a merge group
-			else if( (firstChildPacketOfGroup != nullptr) && !m_filter->CanMerge(firstChildPacketOfGroup, lastPacket, p) )
-			{
-				firstChildPacketOfGroup = nullptr;
-				parentOfGroup = nullptr;
-			}
+			auto parent = m_filter->CreateMergedHeader(packets[g.first], g.first);
+			outpackets.push_back(parent);
 
-			//If we're a child of an group, add under the parent node
-			if(parentOfGroup)
-				m_childPackets[parentOfGroup].push_back(p);
+			size_t base = children.size();
+			children.insert(children.end(), packets.begin() + g.first, packets.begin() + g.second);
+			m_childPackets[parent] = PacketSpan(children.data() + base, children.data() + children.size());
 
-			//Otherwise add at the top level
-			else
-				outpackets.push_back(p);
+			i = g.second;
+		}
+		outpackets.insert(outpackets.end(), packets.begin() + i, packets.end());
+
+		LogTrace("Merged %zu packets into %zu rows (%zu groups) in %.3f ms\n",
+			npackets, outpackets.size(), groups.size(), (GetTime() - tstart) * 1000);
 
-			lastPacket = p;
+		//Hand the packets off to the search index, in the same order they're displayed
+		vector<Packet*> indexPackets;
+		indexPackets.reserve(npackets);
+		for(auto p : outpackets)
+		{
+			indexPackets.push_back(p);
+
+			auto c = GetChildPackets(p);
+			indexPackets.insert(indexPackets.end(), c.begin(), c.end());
 		}
+		m_searchIndex.AddWaveform(time, indexPackets);
 	}
 	m_filter->DetachPackets();
 
@@ -247,16 +261,33 @@ void PacketManager::Update()
 	FilterPackets();
 }
 
+/**
+	@brief Finds runs of consecutive packets that should be merged (see FindPacketMergeGroups())
+ */
+void PacketManager::FindMergeGroups(const vector<Packet*>& packets, vector<pair<size_t, size_t> >& groups)
+{
+	FindPacketMergeGroups(
+		packets,
+		[this](Packet* first, Packet* prev, Packet* next)
+		{ return m_filter->CanMerge(first, prev, next); },
+		groups);
+}
+
 /**
 	@brief Run the filter expression against the packets
  */
 void PacketManager::FilterPackets()
 {
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	m_filteredChildPackets.clear();
+	m_filteredChildStorage.clear();
+
 	//If we do NOT have a filter, early out: just copy stuff
+	//(GetFilteredChildPackets() uses the unfiltered children directly in this case)
 	if(m_filterExpression == nullptr)
 	{
 		m_filteredPackets = m_packets;
-		m_filteredChildPackets = m_childPackets;
 
 		//but still refresh the set of rows being displayed
 		RefreshRows();
@@ -266,17 +297,21 @@ void PacketManager::FilterPackets()
 
 	//We have a filter! Start out by clearing output, then we can re-add the ones that match
 	m_filteredPackets.clear();
-	m_filteredChildPackets.clear();
 
 	//Check all top level packets against the filter
-	for(auto it : m_packets)
+	vector<tuple<Packet*, size_t, size_t> > ranges;
+	for(auto& it : m_packets)
 	{
 		auto timestamp = it.first;
 		auto& packets = it.second;
+		auto& storage = m_filteredChildStorage[timestamp];
+
+		ranges.clear();
 		for(auto p : packets)
 		{
 			//If no children, just check the top level packet for a match
-			if(m_childPackets[p].empty())
+			auto children = GetChildPackets(p);
+			if(children.empty())
 			{
 				if(m_filterExpression->Match(p))
 					m_filteredPackets[timestamp].push_back(p);
@@ -286,25 +321,68 @@ void PacketManager::FilterPackets()
 			//Check them for matches, and add the parent if any child matches
 			else
 			{
-				bool anyChildMatched = false;
-				for(auto c : m_childPackets[p])
+				size_t start = storage.size();
+				for(auto c : children)
 				{
 					if(m_filterExpression->Match(c))
-					{
-						m_filteredChildPackets[p].push_back(c);
-						anyChildMatched = true;
-					}
+						storage.push_back(c);
 				}
-				if(anyChildMatched)
+				if(storage.size() > start)
+				{
 					m_filteredPackets[timestamp].push_back(p);
+					ranges.push_back(tuple<Packet*, size_t, size_t>(p, start, storage.size()));
+				}
 			}
 		}
+
+		//Storage for this waveform is final now, so we can safely point into it
+		for(auto& r : ranges)
+		{
+			m_filteredChildPackets[get<0>(r)] =
+				PacketSpan(storage.data() + get<1>(r), storage.data() + get<2>(r));
+		}
 	}
 
 	//Refresh the set of rows being displayed
 	RefreshRows();
 }
 
+/**
+	@brief Finds every packet in one waveform that can be shown in the table under the current filter expression
+
+	@param t		Timestamp of the waveform
+	@param parents	Filled with each displayable packet, mapped to its merged parent (nullptr if top level)
+ */
+void PacketManager::GetDisplayedPackets(TimePoint t, unordered_map<Packet*, Packet*>& parents)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	parents.clear();
+	auto it = m_filteredPackets.find(t);
+	if(it == m_filteredPackets.end())
+		return;
+
+	for(auto p : it->second)
+	{
+		parents[p] = nullptr;
+		for(auto c : GetFilteredChildPackets(p))
+			parents[c] = p;
+	}
+}
+
+/**
+	@brief Opens a merged packet's tree node so its children get rows in the table
+ */
+void PacketManager::RevealPacket(Packet* parent)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	if(IsChildOpen(parent))
+		return;
+	SetChildOpen(parent, true);
+	RefreshRows();
+}
+
 /**
 	@brief Removes all history from the specified timestamp
  */
@@ -312,15 +390,22 @@ void PacketManager::RemoveHistoryFrom(TimePoint timestamp)
 {
 	lock_guard<recursive_mutex> lock(m_mutex);
 
-	auto& packets = m_packets[timestamp];
-	for(auto p : packets)
+	m_searchIndex.RemoveWaveform(timestamp);
+
+	auto it = m_packets.find(timestamp);
+	if(it != m_packets.end())
 	{
-		RemoveChildHistoryFrom(p);
-		delete p;
+		for(auto p : it->second)
+		{
+			RemoveChildHistoryFrom(p);
+			delete p;
+		}
+		m_packets.erase(it);
 	}
-	m_packets.erase(timestamp);
+	m_childStorage.erase(timestamp);
 
 	m_filteredPackets.erase(timestamp);
+	m_filteredChildStorage.erase(timestamp);
 
 	//update the list of displayed rows so we don't have anything left pointing to stale packets
 	RefreshRows();
@@ -330,10 +415,13 @@ void PacketManager::RemoveChildHistoryFrom(Packet* pack)
 {
 	//For now, we can only have one level of hierarchy
 	//so no need to check for children of children
-	auto& children = m_childPackets[pack];
-	for(auto p : children)
-		delete p;
-	m_childPackets.erase(pack);
+	auto it = m_childPackets.find(pack);
+	if(it != m_childPackets.end())
+	{
+		for(auto p : it->second)
+			delete p;
+		m_childPackets.erase(it);
+	}
 	m_filteredChildPackets.erase(pack);
 	m_lastChildOpen.erase(pack);
 }
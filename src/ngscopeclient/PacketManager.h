@@ -37,6 +37,8 @@
 
 #include "../../lib/scopehal/PacketDecoder.h"
 #include "Marker.h"
+#include "PacketSearchIndex.h"
+#include "PacketMergeGroups.h"
 
 class Session;
 
@@ -86,6 +88,42 @@ public:
 	Marker m_marker;
 };
 
+/**
+	@brief A contiguous, non-owning range of packets (used for the children of a merged packet)
+ */
+class PacketSpan
+{
+public:
+	PacketSpan()
+	: m_begin(nullptr)
+	, m_end(nullptr)
+	{}
+
+	PacketSpan(Packet* const* begin, Packet* const* end)
+	: m_begin(begin)
+	, m_end(end)
+	{}
+
+	Packet* const* begin() const
+	{ return m_begin; }
+
+	Packet* const* end() const
+	{ return m_end; }
+
+	size_t size() const
+	{ return m_end - m_begin; }
+
+	bool empty() const
+	{ return m_begin == m_end; }
+
+	Packet* operator[](size_t i) const
+	{ return m_begin[i]; }
+
+protected:
+	Packet* const* m_begin;
+	Packet* const* m_end;
+};
+
 class ProtocolDisplayFilter;
 
 class ProtocolDisplayFilterClause
@@ -160,26 +198,49 @@ public:
 	const std::map<TimePoint, std::vector<Packet*> >& GetPackets()
 	{ return m_packets; }
 
-	const std::vector<Packet*>& GetChildPackets(Packet* pack)
-	{ return m_childPackets[pack]; }
+	/**
+		@brief Gets the children of a merged packet (empty if the packet has no children)
+	 */
+	PacketSpan GetChildPackets(Packet* pack)
+	{
+		auto it = m_childPackets.find(pack);
+		if(it == m_childPackets.end())
+			return PacketSpan();
+		return it->second;
+	}
 
 	const std::map<TimePoint, std::vector<Packet*> >& GetFilteredPackets()
 	{ return m_filteredPackets; }
 
-	const std::vector<Packet*>& GetFilteredChildPackets(Packet* pack)
-	{ return m_filteredChildPackets[pack]; }
+	/**
+		@brief Gets the children of a merged packet which passed the current filter expression
+	 */
+	PacketSpan GetFilteredChildPackets(Packet* pack)
+	{
+		//No filter expression? Every child passes
+		auto& children = m_filterExpression ? m_filteredChildPackets : m_childPackets;
+
+		auto it = children.find(pack);
+		if(it == children.end())
+			return PacketSpan();
+		return it->second;
+	}
 
 	/**
 		@brief Sets the current filter expression
 	 */
 	void SetDisplayFilter(std::shared_ptr<ProtocolDisplayFilter> filter)
 	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
 		m_filterExpression = filter;
 		FilterPackets();
 	}
 
 	void FilterPackets();
 
+	void GetDisplayedPackets(TimePoint t, std::unordered_map<Packet*, Packet*>& parents);
+	void RevealPacket(Packet* parent);
+
 	bool IsChildOpen(Packet* pack)
 	{ return m_lastChildOpen[pack]; }
 
@@ -189,10 +250,26 @@ public:
 	std::vector<RowData>& GetRows()
 	{ return m_rows; }
 
+	/**
+		@brief Gets a counter which changes every time the rows are rebuilt
+
+		Anything cached about which packets are displayed (filter, waveforms added or removed) is stale once this
+		changes.
+	 */
+	uint64_t GetRowsGeneration()
+	{ return m_rowsGeneration; }
+
 	void OnMarkerChanged();
 
+	/**
+		@brief Gets the search index for our packets (must hold the mutex while using it)
+	 */
+	PacketSearchIndex& GetSearchIndex()
+	{ return m_searchIndex; }
+
 protected:
 	void RemoveChildHistoryFrom(Packet* pack);
+	void FindMergeGroups(const std::vector<Packet*>& packets, std::vector<std::pair<size_t, size_t> >& groups);
 
 	///@brief Parent session object
 	Session& m_session;
@@ -200,20 +277,29 @@ protected:
 	///@brief Mutex controlling access to m_packets
 	std::recursive_mutex m_mutex;
 
+	///@brief Full-text index of packet headers and data
+	PacketSearchIndex m_searchIndex;
+
 	///@brief The filter we're managing
 	PacketDecoder* m_filter;
 
 	///@brief Our saved packet data
 	std::map<TimePoint, std::vector<Packet*> > m_packets;
 
-	///@brief Merged child packets
-	std::map<Packet*, std::vector<Packet*> > m_childPackets;
+	///@brief Merged child packets for each waveform, in original order, so each merge group is contiguous
+	std::map<TimePoint, std::vector<Packet*> > m_childStorage;
+
+	///@brief Merged child packets of each parent (pointing into m_childStorage)
+	std::map<Packet*, PacketSpan> m_childPackets;
 
 	///@brief Subset of m_packets that passed the current filter expression
 	std::map<TimePoint, std::vector<Packet*> > m_filteredPackets;
 
-	///@brief Subset of m_filteredChildPackets that passed the current filter expression
-	std::map<Packet*, std::vector<Packet*> > m_filteredChildPackets;
+	///@brief Child packets that passed the current filter expression, stored contiguously like m_childStorage
+	std::map<TimePoint, std::vector<Packet*> > m_filteredChildStorage;
+
+	///@brief Subset of m_childPackets that passed the current filter expression (pointing into m_filteredChildStorage)
+	std::map<Packet*, PacketSpan> m_filteredChildPackets;
 
 	///@brief Cache key for the current waveform
 	WaveformCacheKey m_cachekey;
@@ -227,6 +313,9 @@ protected:
 	///@brief The set of rows that are to be displayed, based on current tree expansion and filter state
 	std::vector<RowData> m_rows;
 
+	///@brief Number of times RefreshRows() has been called
+	uint64_t m_rowsGeneration;
+
 	///@brief Map of packets to child-open flags from last frame
 	std::map<Packet*, bool> m_lastChildOpen;
 };
@@ -0,0 +1,81 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Merge group detection for protocol analyzer packets
+ */
+#ifndef PacketMergeGroups_h
+#define PacketMergeGroups_h
+
+#include <utility>
+#include <vector>
+
+/**
+	@brief Finds runs of consecutive packets that should be merged, in a single pass
+
+	Each packet is checked against the group it might join exactly once, rather than re-checking group membership
+	from both ends.
+
+	This is a template over the packet type and merge test so the grouping can be tested and benchmarked without a
+	real PacketDecoder.
+
+	@param packets	Packets from the filter
+	@param canMerge	Called as canMerge(firstOfGroup, previous, next), like PacketDecoder::CanMerge()
+	@param groups	Output list of [start, end) index ranges, one per group of two or more packets
+ */
+template<class T, class MergeTest>
+void FindPacketMergeGroups(
+	const std::vector<T>& packets,
+	MergeTest canMerge,
+	std::vector<std::pair<size_t, size_t> >& groups)
+{
+	size_t npackets = packets.size();
+	size_t i = 0;
+	while(i+1 < npackets)
+	{
+		//Not compatible with the next packet? Stays at top level
+		if(!canMerge(packets[i], packets[i], packets[i+1]))
+		{
+			i++;
+			continue;
+		}
+
+		//Extend the group as far as it will go
+		size_t end = i+2;
+		while( (end < npackets) && canMerge(packets[i], packets[end-1], packets[end]) )
+			end ++;
+
+		groups.push_back(std::pair<size_t, size_t>(i, end));
+		i = end;
+	}
+}
+
+#endif
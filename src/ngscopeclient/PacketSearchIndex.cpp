@@ -0,0 +1,472 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of PacketSearchIndex
+ */
+#include "ngscopeclient.h"
+#include "PacketSearchIndex.h"
+#include "pthread_compat.h"
+
+using namespace std;
+
+///@brief Maximum number of packets to index before releasing the packet mutex
+#define PACKETS_PER_INDEX_BLOCK 4096
+
+static uint32_t MakeGram(const uint8_t* p);
+static void AddGrams(
+	unordered_map<uint32_t, vector<uint32_t> >& table,
+	const uint8_t* p,
+	size_t len,
+	uint32_t index);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PacketSearchIndex::PacketSearchIndex(recursive_mutex& mutex)
+	: m_mutex(mutex)
+	, m_generation(1)
+	, m_cachedGeneration(0)
+	, m_shuttingDown(false)
+{
+	m_thread = make_unique<thread>(&PacketSearchIndex::IndexThread, this);
+}
+
+PacketSearchIndex::~PacketSearchIndex()
+{
+	Shutdown();
+}
+
+/**
+	@brief Stops the indexing thread
+
+	Must be called before the packets being indexed are deleted, and without the packet mutex held.
+ */
+void PacketSearchIndex::Shutdown()
+{
+	if(m_thread)
+	{
+		m_shuttingDown = true;
+		m_workEvent.Signal();
+		m_thread->join();
+	}
+	m_thread = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Index maintenance
+
+/**
+	@brief Adds a newly arrived waveform's packets to the index
+
+	Any previous index for the same timestamp is replaced. The packets are searchable immediately; the trigram tables
+	are built in the background.
+
+	@param t		Timestamp of the waveform
+	@param packets	All packets in the waveform, in display order
+ */
+void PacketSearchIndex::AddWaveform(TimePoint t, const vector<Packet*>& packets)
+{
+	m_waveforms[t] = make_shared<PacketSearchWaveformIndex>(packets);
+	m_generation ++;
+
+	m_workEvent.Signal();
+}
+
+/**
+	@brief Removes a waveform's packets from the index (must be called before they're deleted)
+ */
+void PacketSearchIndex::RemoveWaveform(TimePoint t)
+{
+	if(m_waveforms.erase(t))
+		m_generation ++;
+}
+
+/**
+	@brief Removes everything from the index
+ */
+void PacketSearchIndex::Clear()
+{
+	m_waveforms.clear();
+	m_generation ++;
+}
+
+/**
+	@brief Returns true if there are packets that have not yet been added to the trigram tables
+ */
+bool PacketSearchIndex::IsIndexing()
+{
+	for(auto& it : m_waveforms)
+	{
+		if(it.second->m_indexedCount < it.second->m_packets.size())
+			return true;
+	}
+	return false;
+}
+
+void PacketSearchIndex::IndexThread()
+{
+	pthread_setname_np_compat("PacketIndex");
+
+	while(!m_shuttingDown)
+	{
+		m_workEvent.Block();
+
+		//Work in small blocks so the GUI thread never has to wait on us for long
+		while(!m_shuttingDown)
+		{
+			lock_guard<recursive_mutex> lock(m_mutex);
+
+			PacketSearchWaveformIndex* next = nullptr;
+			for(auto& it : m_waveforms)
+			{
+				if(it.second->m_indexedCount < it.second->m_packets.size())
+				{
+					next = it.second.get();
+					break;
+				}
+			}
+			if(!next)
+				break;
+
+			IndexPackets(*next, PACKETS_PER_INDEX_BLOCK);
+		}
+	}
+}
+
+/**
+	@brief Adds up to the next count not-yet-indexed packets of a waveform to its trigram tables
+ */
+void PacketSearchIndex::IndexPackets(PacketSearchWaveformIndex& index, size_t count)
+{
+	size_t end = min(index.m_indexedCount + count, index.m_packets.size());
+	for(size_t i=index.m_indexedCount; i<end; i++)
+	{
+		auto p = index.m_packets[i];
+
+		for(auto& it : p->m_headers)
+			AddGrams(index.m_textGrams, reinterpret_cast<const uint8_t*>(it.second.c_str()), it.second.length(), i);
+
+		AddGrams(index.m_dataGrams, p->m_data.data(), p->m_data.size(), i);
+	}
+	index.m_indexedCount = end;
+}
+
+/**
+	@brief Packs three consecutive bytes into a trigram key
+ */
+static uint32_t MakeGram(const uint8_t* p)
+{
+	return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+/**
+	@brief Adds every trigram of a byte string to a table, pointing at the given packet index
+
+	Packets are always indexed in increasing order, so duplicates can only ever be at the end of a posting list.
+ */
+static void AddGrams(
+	unordered_map<uint32_t, vector<uint32_t> >& table,
+	const uint8_t* p,
+	size_t len,
+	uint32_t index)
+{
+	for(size_t i=0; i+2 < len; i++)
+	{
+		auto& postings = table[MakeGram(p + i)];
+		if(postings.empty() || (postings.back() != index))
+			postings.push_back(index);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queries
+
+/**
+	@brief Finds all packets matching a query
+
+	Results are sorted by waveform timestamp, then display order within the waveform. They are cached until either
+	the query or the set of packets changes, so calling this every frame is cheap.
+ */
+const vector<PacketSearchHit>& PacketSearchIndex::Search(const PacketSearchQuery& query)
+{
+	if( (query == m_cachedQuery) && (m_generation == m_cachedGeneration) )
+		return m_cachedHits;
+
+	m_cachedQuery = query;
+	m_cachedGeneration = m_generation;
+	m_cachedHits.clear();
+
+	//Figure out the byte string we're looking for
+	vector<uint8_t> needle;
+	if(query.m_field == PacketSearchQuery::FIELD_DATA)
+	{
+		if(!ParseHexBytes(query.m_text, needle))
+			return m_cachedHits;
+	}
+	else
+		needle.assign(query.m_text.begin(), query.m_text.end());
+	if(needle.empty())
+		return m_cachedHits;
+
+	//Trigrams of the search string (none if it's too short, in which case we fall back to a linear scan)
+	vector<uint32_t> grams;
+	for(size_t i=0; i+2 < needle.size(); i++)
+		grams.push_back(MakeGram(&needle[i]));
+	sort(grams.begin(), grams.end());
+	grams.erase(unique(grams.begin(), grams.end()), grams.end());
+
+	vector<const vector<uint32_t>*> lists;
+	vector<uint32_t> candidates;
+	vector<uint32_t> tmp;
+	for(auto& it : m_waveforms)
+	{
+		auto& wfm = *it.second;
+		size_t firstUnindexed = 0;
+
+		if(!grams.empty())
+		{
+			auto& table = (query.m_field == PacketSearchQuery::FIELD_DATA) ? wfm.m_dataGrams : wfm.m_textGrams;
+
+			//Look up posting lists for every trigram. If any is missing, no indexed packet can match
+			lists.clear();
+			for(auto g : grams)
+			{
+				auto jt = table.find(g);
+				if(jt == table.end())
+				{
+					lists.clear();
+					break;
+				}
+				lists.push_back(&jt->second);
+			}
+
+			//Intersect, smallest list first to keep the working set small
+			if(!lists.empty())
+			{
+				sort(lists.begin(), lists.end(),
+					[](const vector<uint32_t>* a, const vector<uint32_t>* b) { return a->size() < b->size(); });
+
+				candidates = *lists[0];
+				for(size_t j=1; (j < lists.size()) && !candidates.empty(); j++)
+				{
+					tmp.clear();
+					set_intersection(
+						candidates.begin(), candidates.end(),
+						lists[j]->begin(), lists[j]->end(),
+						back_inserter(tmp));
+					candidates.swap(tmp);
+				}
+
+				//Trigram hits are necessary but not sufficient, verify against the real packet
+				for(auto i : candidates)
+				{
+					if(Matches(wfm.m_packets[i], query, needle))
+						m_cachedHits.push_back(PacketSearchHit(it.first, i, wfm.m_packets[i]));
+				}
+			}
+
+			firstUnindexed = wfm.m_indexedCount;
+		}
+
+		//Anything the index doesn't cover yet gets checked the slow way
+		for(size_t i=firstUnindexed; i<wfm.m_packets.size(); i++)
+		{
+			if(Matches(wfm.m_packets[i], query, needle))
+				m_cachedHits.push_back(PacketSearchHit(it.first, i, wfm.m_packets[i]));
+		}
+	}
+
+	return m_cachedHits;
+}
+
+/**
+	@brief Finds the next (or previous) match relative to a given packet, wrapping around at either end
+
+	@param query	The search to run
+	@param stamp	Timestamp of the waveform containing the current packet
+	@param current	The current packet (if null, search starts from the beginning of the waveform)
+	@param reverse	True to search backwards
+	@param accept	If set, hits for which this returns false are skipped (e.g. packets hidden by a display filter)
+ */
+optional<PacketSearchHit> PacketSearchIndex::FindNext(
+	const PacketSearchQuery& query,
+	TimePoint stamp,
+	Packet* current,
+	bool reverse,
+	const function<bool(const PacketSearchHit&)>& accept)
+{
+	auto& hits = Search(query);
+	if(hits.empty())
+		return {};
+
+	//Figure out where we are now
+	uint32_t index = 0;
+	bool found = false;
+	auto it = m_waveforms.find(stamp);
+	if(current && (it != m_waveforms.end()) )
+	{
+		auto& packets = it->second->m_packets;
+		auto jt = find(packets.begin(), packets.end(), current);
+		if(jt != packets.end())
+		{
+			index = jt - packets.begin();
+			found = true;
+		}
+	}
+	PacketSearchHit here(stamp, index, current);
+
+	size_t nhits = hits.size();
+	size_t pos;
+	if(reverse)
+	{
+		auto jt = lower_bound(hits.begin(), hits.end(), here);
+		if(jt == hits.begin())
+			pos = nhits - 1;
+		else
+			pos = (jt - hits.begin()) - 1;
+	}
+	else
+	{
+		//If the current packet is itself a hit, skip it
+		auto jt = found ? upper_bound(hits.begin(), hits.end(), here) : lower_bound(hits.begin(), hits.end(), here);
+		if(jt == hits.end())
+			pos = 0;
+		else
+			pos = jt - hits.begin();
+	}
+
+	//Walk from there (wrapping around) until we find a hit the caller will take
+	for(size_t i=0; i<nhits; i++)
+	{
+		if(!accept || accept(hits[pos]))
+			return hits[pos];
+
+		if(reverse)
+			pos = (pos == 0) ? (nhits - 1) : (pos - 1);
+		else
+			pos = (pos + 1) % nhits;
+	}
+	return {};
+}
+
+/**
+	@brief Parses a string of hex bytes, e.g. "DE AD BE EF", "deadbeef" or "0xdead 0xbeef"
+
+	@return	True if the string was well formed
+ */
+bool PacketSearchIndex::ParseHexBytes(const string& str, vector<uint8_t>& bytes)
+{
+	bytes.clear();
+
+	size_t i = 0;
+	while(i < str.length())
+	{
+		//Skip whitespace between tokens
+		if(isspace(str[i]))
+		{
+			i++;
+			continue;
+		}
+
+		//Optional 0x prefix on each token
+		if( (str[i] == '0') && (i+1 < str.length()) && (tolower(str[i+1]) == 'x') )
+			i += 2;
+
+		//Token body must be an even number of hex digits
+		size_t start = i;
+		while( (i < str.length()) && isxdigit(str[i]) )
+			i++;
+		size_t len = i - start;
+		if( (len == 0) || (len & 1) )
+			return false;
+		if( (i < str.length()) && !isspace(str[i]) )
+			return false;
+
+		for(size_t j=start; j<i; j += 2)
+			bytes.push_back(stoul(str.substr(j, 2), nullptr, 16));
+	}
+
+	return !bytes.empty();
+}
+
+/**
+	@brief Checks whether a single packet matches a query
+ */
+bool PacketSearchIndex::Matches(const Packet* pack, const PacketSearchQuery& query, const vector<uint8_t>& needle)
+{
+	switch(query.m_field)
+	{
+		case PacketSearchQuery::FIELD_DATA:
+			return MatchBytes(pack->m_data.data(), pack->m_data.size(), needle, query.m_mode);
+
+		case PacketSearchQuery::FIELD_HEADER:
+			{
+				auto it = pack->m_headers.find(query.m_header);
+				if(it == pack->m_headers.end())
+					return false;
+				return MatchBytes(
+					reinterpret_cast<const uint8_t*>(it->second.c_str()), it->second.length(), needle, query.m_mode);
+			}
+
+		case PacketSearchQuery::FIELD_ANY_HEADER:
+		default:
+			for(auto& it : pack->m_headers)
+			{
+				if(MatchBytes(
+					reinterpret_cast<const uint8_t*>(it.second.c_str()), it.second.length(), needle, query.m_mode))
+				{
+					return true;
+				}
+			}
+			return false;
+	}
+}
+
+bool PacketSearchIndex::MatchBytes(
+	const uint8_t* haystack,
+	size_t len,
+	const vector<uint8_t>& needle,
+	PacketSearchQuery::MatchMode mode)
+{
+	switch(mode)
+	{
+		case PacketSearchQuery::MATCH_EQUALS:
+			return (len == needle.size()) && (memcmp(haystack, needle.data(), len) == 0);
+
+		case PacketSearchQuery::MATCH_STARTSWITH:
+			return (len >= needle.size()) && (memcmp(haystack, needle.data(), needle.size()) == 0);
+
+		case PacketSearchQuery::MATCH_CONTAINS:
+		default:
+			return search(haystack, haystack + len, needle.begin(), needle.end()) != (haystack + len);
+	}
+}
@@ -0,0 +1,223 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of PacketSearchIndex
+ */
+#ifndef PacketSearchIndex_h
+#define PacketSearchIndex_h
+
+#include "../../lib/scopehal/PacketDecoder.h"
+#include "Event.h"
+
+#include <functional>
+
+/**
+	@brief A single search result: one packet within a waveform
+ */
+class PacketSearchHit
+{
+public:
+	PacketSearchHit(TimePoint t, uint32_t index, Packet* p)
+	: m_stamp(t)
+	, m_index(index)
+	, m_packet(p)
+	{}
+
+	bool operator<(const PacketSearchHit& rhs) const
+	{
+		if(m_stamp != rhs.m_stamp)
+			return m_stamp < rhs.m_stamp;
+		return m_index < rhs.m_index;
+	}
+
+	///@brief Timestamp of the waveform the packet came from
+	TimePoint m_stamp;
+
+	///@brief Position of the packet within the waveform, in display order (parents followed by their children)
+	uint32_t m_index;
+
+	///@brief The packet itself
+	Packet* m_packet;
+};
+
+/**
+	@brief Description of a search to run against a PacketSearchIndex
+ */
+class PacketSearchQuery
+{
+public:
+	PacketSearchQuery()
+	: m_field(FIELD_ANY_HEADER)
+	, m_mode(MATCH_CONTAINS)
+	{}
+
+	bool operator==(const PacketSearchQuery& rhs) const
+	{
+		return
+			(m_text == rhs.m_text) &&
+			(m_field == rhs.m_field) &&
+			(m_header == rhs.m_header) &&
+			(m_mode == rhs.m_mode);
+	}
+
+	bool operator!=(const PacketSearchQuery& rhs) const
+	{ return !(*this == rhs); }
+
+	///@brief The text to search for (hex bytes if searching packet data)
+	std::string m_text;
+
+	///@brief Which part of the packet to look in
+	enum SearchField
+	{
+		FIELD_ANY_HEADER,
+		FIELD_HEADER,
+		FIELD_DATA
+	} m_field;
+
+	///@brief Name of the header to look in, if m_field is FIELD_HEADER
+	std::string m_header;
+
+	///@brief How the search text has to match the field
+	enum MatchMode
+	{
+		MATCH_CONTAINS,
+		MATCH_STARTSWITH,
+		MATCH_EQUALS
+	} m_mode;
+};
+
+/**
+	@brief Trigram index for a single waveform's worth of packets
+ */
+class PacketSearchWaveformIndex
+{
+public:
+	PacketSearchWaveformIndex(const std::vector<Packet*>& packets)
+	: m_packets(packets)
+	, m_indexedCount(0)
+	{}
+
+	///@brief All packets in this waveform, in display order
+	std::vector<Packet*> m_packets;
+
+	///@brief Number of packets (from the start of m_packets) which have been added to the trigram tables
+	size_t m_indexedCount;
+
+	///@brief Map of header text trigrams to (sorted) indexes of packets containing them
+	std::unordered_map<uint32_t, std::vector<uint32_t> > m_textGrams;
+
+	///@brief Map of data byte trigrams to (sorted) indexes of packets containing them
+	std::unordered_map<uint32_t, std::vector<uint32_t> > m_dataGrams;
+};
+
+/**
+	@brief Searchable index of all packets held by a PacketManager
+
+	Header text and payload bytes of each packet are broken into trigrams, each of which maps to a posting list of
+	packets containing it. A query intersects the posting lists for the trigrams in the search string, then verifies
+	the (usually very small) set of candidates against the actual packet contents.
+
+	The trigram tables are built by a background thread so that ingesting a new waveform doesn't stall the caller.
+	Packets that have not been indexed yet are still searched, just by a linear scan, so results are always exact.
+
+	All public methods except the constructor and destructor must be called with the owning PacketManager's mutex
+	held; the indexing thread takes the same mutex while it works so packets can't be deleted out from under it.
+ */
+class PacketSearchIndex
+{
+public:
+	PacketSearchIndex(std::recursive_mutex& mutex);
+	virtual ~PacketSearchIndex();
+
+	void Shutdown();
+
+	void AddWaveform(TimePoint t, const std::vector<Packet*>& packets);
+	void RemoveWaveform(TimePoint t);
+	void Clear();
+
+	const std::vector<PacketSearchHit>& Search(const PacketSearchQuery& query);
+
+	std::optional<PacketSearchHit> FindNext(
+		const PacketSearchQuery& query,
+		TimePoint stamp,
+		Packet* current,
+		bool reverse,
+		const std::function<bool(const PacketSearchHit&)>& accept = nullptr);
+
+	bool IsIndexing();
+
+	static bool ParseHexBytes(const std::string& str, std::vector<uint8_t>& bytes);
+
+protected:
+	void IndexThread();
+	void IndexPackets(PacketSearchWaveformIndex& index, size_t count);
+
+	static bool Matches(
+		const Packet* pack,
+		const PacketSearchQuery& query,
+		const std::vector<uint8_t>& needle);
+
+	static bool MatchBytes(
+		const uint8_t* haystack,
+		size_t len,
+		const std::vector<uint8_t>& needle,
+		PacketSearchQuery::MatchMode mode);
+
+	///@brief Mutex of the owning PacketManager, protecting both the packets and the index
+	std::recursive_mutex& m_mutex;
+
+	///@brief Per-waveform indexes
+	std::map<TimePoint, std::shared_ptr<PacketSearchWaveformIndex> > m_waveforms;
+
+	///@brief Incremented every time the set of indexed packets changes
+	uint64_t m_generation;
+
+	///@brief The most recently executed query
+	PacketSearchQuery m_cachedQuery;
+
+	///@brief Generation at which m_cachedHits was computed
+	uint64_t m_cachedGeneration;
+
+	///@brief Results of the most recently executed query
+	std::vector<PacketSearchHit> m_cachedHits;
+
+	///@brief Signaled when new packets are available to index
+	Event m_workEvent;
+
+	///@brief Set to terminate the indexing thread
+	std::atomic<bool> m_shuttingDown;
+
+	///@brief Thread for building trigram tables in the background
+	std::unique_ptr<std::thread> m_thread;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of PollScheduler
+ */
+#include "ngscopeclient.h"
+#include "PollScheduler.h"
+
+using namespace std;
+
+///@brief An instrument is considered to be on screen for this long (in seconds) after its dialog was last rendered
+static const double g_viewedTimeout = 1.0;
+
+///@brief Multiplier applied to the idle poll interval for each consecutive poll returning unchanged values
+static const double g_unchangedBackoff = 1.5;
+
+///@brief Upper limit on the idle poll interval after backing off, in seconds
+static const double g_maxBackoffInterval = 4;
+
+///@brief Status (constant current, overcurrent trip, etc) is only queried once this many polls
+static const unsigned int g_statusPollDivider = 4;
+
+PollScheduler::PollScheduler(double activeInterval, double idleInterval)
+	: m_activeInterval(activeInterval)
+	, m_idleInterval(idleInterval)
+	, m_lastViewed(0)
+	, m_consumed(false)
+	, m_lastPoll(0)
+	, m_unchangedPolls(0)
+	, m_pollsSinceStatus(0)
+	, m_latency(0)
+	, m_averageLatency(0)
+	, m_pollRate(0)
+	, m_pollCount(0)
+	, m_rateWindowStart(GetTime())
+	, m_rateWindowPolls(0)
+{
+}
+
+/**
+	@brief Checks if anyone is currently interested in data from the instrument
+ */
+bool PollScheduler::IsActive(double now)
+{
+	return m_consumed || ( (now - m_lastViewed) < g_viewedTimeout);
+}
+
+/**
+	@brief Gets the current interval between polls, including backoff, in seconds
+
+	Active instruments are always polled at the full rate, since a steady reading is still data somebody is
+	plotting or logging.
+ */
+double PollScheduler::GetInterval(double now)
+{
+	if(IsActive(now))
+		return m_activeInterval;
+
+	double limit = max(m_idleInterval, g_maxBackoffInterval);
+	return min(m_idleInterval * pow(g_unchangedBackoff, m_unchangedPolls), limit);
+}
+
+/**
+	@brief Checks if it's time to poll the instrument again
+
+	Demand changes take effect immediately: if an idle instrument becomes active, the next call returns true
+	as soon as the active interval has passed since the last poll.
+ */
+bool PollScheduler::IsPollDue(double now)
+{
+	return (now - m_lastPoll) >= GetInterval(now);
+}
+
+/**
+	@brief Checks if this poll should also query slow-changing status flags
+
+	Must be called exactly once per poll, after IsPollDue() returns true. The first poll always includes status.
+ */
+bool PollScheduler::IsStatusPollDue()
+{
+	if(m_pollsSinceStatus == 0)
+	{
+		m_pollsSinceStatus = g_statusPollDivider - 1;
+		return true;
+	}
+
+	m_pollsSinceStatus --;
+	return false;
+}
+
+/**
+	@brief Records the outcome of a poll
+
+	@param start	Time the poll started
+	@param end		Time the poll finished
+	@param changed	True if any value read differed from the previous poll
+ */
+void PollScheduler::OnPollComplete(double start, double end, bool changed)
+{
+	m_lastPoll = start;
+
+	//Back off while idle and nothing is changing, but don't let the counter grow without bound
+	if(changed || IsActive(end))
+		m_unchangedPolls = 0;
+	else if(m_idleInterval * pow(g_unchangedBackoff, m_unchangedPolls) < g_maxBackoffInterval)
+		m_unchangedPolls ++;
+
+	double dt = end - start;
+	m_latency = dt;
+	if(m_pollCount == 0)
+		m_averageLatency = dt;
+	else
+		m_averageLatency = m_averageLatency * 0.9 + dt * 0.1;
+	m_pollCount ++;
+
+	//Update measured poll rate once a second
+	m_rateWindowPolls ++;
+	double window = end - m_rateWindowStart;
+	if(window >= 1)
+	{
+		m_pollRate = m_rateWindowPolls / window;
+		m_rateWindowStart = end;
+		m_rateWindowPolls = 0;
+	}
+}
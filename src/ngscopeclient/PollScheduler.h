@@ -0,0 +1,148 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of PollScheduler
+ */
+#ifndef PollScheduler_h
+#define PollScheduler_h
+
+#include <atomic>
+#include <mutex>
+
+/**
+	@brief Decides how often an instrument thread should poll a non-scope instrument
+
+	The poll rate adapts to demand:
+	* The instrument is "active" if a dialog showing it was rendered recently, or something else needs its data
+	  (a filter or measurement consuming one of its channels, or telemetry being logged to disk). Active
+	  instruments are always polled at the full rate, even if the readings are steady.
+	* Otherwise the instrument is "idle" and polled slowly, just often enough to keep status and history current.
+	  Consecutive idle polls which return exactly the same values back off exponentially (up to a few seconds),
+	  and any change, or the instrument becoming active, snaps back to the base interval.
+
+	Demand is reported from the GUI thread. IsPollDue() and OnPollComplete() are called from the instrument thread.
+ */
+class PollScheduler
+{
+public:
+	PollScheduler(double activeInterval, double idleInterval);
+
+	//GUI thread API
+
+	/**
+		@brief Reports that a dialog for this instrument was just rendered
+	 */
+	void NotifyViewed()
+	{ m_lastViewed = GetTime(); }
+
+	/**
+		@brief Sets whether anything other than a dialog currently needs data from this instrument
+	 */
+	void SetConsumed(bool consumed)
+	{ m_consumed = consumed; }
+
+	//Instrument thread API
+	bool IsPollDue(double now);
+	bool IsStatusPollDue();
+	void OnPollComplete(double start, double end, bool changed);
+
+	//Metrics
+	bool IsActive(double now);
+	double GetInterval(double now);
+
+	/**
+		@brief Gets the time taken by the most recent poll, in seconds
+	 */
+	double GetLatency()
+	{ return m_latency; }
+
+	/**
+		@brief Gets the average time taken by recent polls, in seconds
+	 */
+	double GetAverageLatency()
+	{ return m_averageLatency; }
+
+	/**
+		@brief Gets the number of polls completed in the last full second
+	 */
+	double GetPollRate()
+	{ return m_pollRate; }
+
+	/**
+		@brief Gets the number of polls completed since the instrument was connected
+	 */
+	uint64_t GetPollCount()
+	{ return m_pollCount; }
+
+protected:
+
+	///@brief Interval between polls when active, in seconds
+	double m_activeInterval;
+
+	///@brief Interval between polls when idle, in seconds
+	double m_idleInterval;
+
+	///@brief Time a dialog for the instrument was last rendered
+	std::atomic<double> m_lastViewed;
+
+	///@brief True if a filter, measurement, or log is consuming data from the instrument
+	std::atomic<bool> m_consumed;
+
+	///@brief Time the last poll started
+	double m_lastPoll;
+
+	///@brief Number of consecutive idle polls which returned unchanged values
+	unsigned int m_unchangedPolls;
+
+	///@brief Number of polls since the last status poll
+	unsigned int m_pollsSinceStatus;
+
+	///@brief Duration of the last poll, in seconds
+	std::atomic<double> m_latency;
+
+	///@brief Exponential moving average of poll duration, in seconds
+	std::atomic<double> m_averageLatency;
+
+	///@brief Polls per second, averaged over the last rate window
+	std::atomic<double> m_pollRate;
+
+	///@brief Total number of polls
+	std::atomic<uint64_t> m_pollCount;
+
+	///@brief Start of the current rate measurement window
+	double m_rateWindowStart;
+
+	///@brief Number of polls in the current rate measurement window
+	uint64_t m_rateWindowPolls;
+};
+
+#endif
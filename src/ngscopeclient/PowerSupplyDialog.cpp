@@ -55,6 +55,9 @@ PowerSupplyDialog::PowerSupplyDialog(
 	, m_tstart(GetTime())
 	, m_psu(psu)
 	, m_state(state)
+	, m_queue(session->GetInstrumentCommandQueue(psu))
+	, m_history(state->m_telemetry)
+	, m_scheduler(session->GetPollScheduler(psu))
 {
 	AsyncLoadState();
 }
@@ -78,24 +81,34 @@ void PowerSupplyDialog::AsyncLoadState()
 	m_channelUIState.clear();
 	m_channelUIState.resize(m_psu->GetChannelCount());
 
-	//Do the async load
+	//Do the async load in the instrument thread
 	m_futureUIState.clear();
 	shared_ptr<SCPIPowerSupply> psu = m_psu;
 	for(size_t i=0; i<m_psu->GetChannelCount(); i++)
 	{
 		//Add placeholders for non-power channels
-		//TODO: can we avoid spawning a thread here pointlessly?
 		if( (m_psu->GetInstrumentTypesForChannel(i) & Instrument::INST_PSU) == 0)
-			m_futureUIState.push_back(async(launch::async, [/*psu, i*/]{ PowerSupplyChannelUIState dummy; return dummy; }));
+		{
+			promise<PowerSupplyChannelUIState> dummy;
+			dummy.set_value(PowerSupplyChannelUIState());
+			m_futureUIState.push_back(dummy.get_future());
+		}
 
 		//Actual power channels get async load
 		else
-			m_futureUIState.push_back(async(launch::async, [psu, i]{ return PowerSupplyChannelUIState(psu, i); }));
+		{
+			m_futureUIState.push_back(m_queue->Submit<PowerSupplyChannelUIState>(
+				[psu, i]{ return PowerSupplyChannelUIState(psu, i); }));
+		}
 	}
 }
 
 bool PowerSupplyDialog::DoRender()
 {
+	//Keep polling at full rate while we're on screen
+	if(m_scheduler)
+		m_scheduler->NotifyViewed();
+
 	//Device information
 	if(ImGui::CollapsingHeader("Info"))
 	{
@@ -125,7 +138,11 @@ bool PowerSupplyDialog::DoRender()
 		if(ImGui::CollapsingHeader("Global", ImGuiTreeNodeFlags_DefaultOpen))
 		{
 			if(ImGui::Checkbox("Output Enable", &m_masterEnable))
-				m_psu->SetMasterPowerEnable(m_masterEnable);
+			{
+				auto psu = m_psu;
+				bool enable = m_masterEnable;
+				m_queue->SubmitWrite("master", [psu, enable]{ psu->SetMasterPowerEnable(enable); });
+			}
 
 			HelpMarker(
 				"Top level output enable, gating all outputs from the PSU.\n"
@@ -141,7 +158,7 @@ bool PowerSupplyDialog::DoRender()
 		for(size_t i=0; i<m_futureUIState.size(); i++)
 		{
 			//Already loaded? No action needed
-			if(m_channelUIState[i].m_setVoltage != "")
+			if(!m_futureUIState[i].valid())
 				continue;
 
 			//Not ready? Keep waiting
@@ -171,6 +188,19 @@ bool PowerSupplyDialog::DoRender()
 		ChannelSettings(i, m_state->m_channelVoltage[i].load(), m_state->m_channelCurrent[i].load(), t);
 	}
 
+	if(ImGui::CollapsingHeader("History"))
+	{
+		vector<shared_ptr<TelemetrySeries> > series;
+		for(size_t i=0; i<m_psu->GetChannelCount(); i++)
+		{
+			if( (m_psu->GetInstrumentTypesForChannel(i) & Instrument::INST_PSU) == 0)
+				continue;
+			series.push_back(m_state->m_voltageHistory[i]);
+			series.push_back(m_state->m_currentHistory[i]);
+		}
+		m_history.Render(series);
+	}
+
 	return true;
 }
 
@@ -199,10 +229,15 @@ void PowerSupplyDialog::ChannelSettings(int i, float v, float a, float etime)
 		bool shdn = m_state->m_channelFuseTripped[i].load();
 		bool cc = m_state->m_channelConstantCurrent[i].load();
 
+		auto psu = m_psu;
 		if(m_psu->SupportsIndividualOutputSwitching())
 		{
 			if(ImGui::Checkbox("Output Enable", &m_channelUIState[i].m_outputEnabled))
-				m_psu->SetPowerChannelActive(i, m_channelUIState[i].m_outputEnabled);
+			{
+				bool enable = m_channelUIState[i].m_outputEnabled;
+				m_queue->SubmitWrite(
+					"enable." + to_string(i), [psu, i, enable]{ psu->SetPowerChannelActive(i, enable); });
+			}
 			if(shdn)
 			{
 				//TODO: preference for configuring this?
@@ -230,7 +265,12 @@ void PowerSupplyDialog::ChannelSettings(int i, float v, float a, float etime)
 				if(ocp)
 				{
 					if(ImGui::Checkbox("Overcurrent Shutdown", &m_channelUIState[i].m_overcurrentShutdownEnabled))
-						m_psu->SetPowerOvercurrentShutdownEnabled(i, m_channelUIState[i].m_overcurrentShutdownEnabled);
+					{
+						bool enable = m_channelUIState[i].m_overcurrentShutdownEnabled;
+						m_queue->SubmitWrite(
+							"ocp." + to_string(i),
+							[psu, i, enable]{ psu->SetPowerOvercurrentShutdownEnabled(i, enable); });
+					}
 					HelpMarker(
 						"When enabled, the channel will shut down on overcurrent rather than switching to constant current mode.\n"
 						"\n"
@@ -241,7 +281,11 @@ void PowerSupplyDialog::ChannelSettings(int i, float v, float a, float etime)
 				if(ss)
 				{
 					if(ImGui::Checkbox("Soft Start", &m_channelUIState[i].m_softStartEnabled))
-						m_psu->SetSoftStartEnabled(i, m_channelUIState[i].m_softStartEnabled);
+					{
+						bool enable = m_channelUIState[i].m_softStartEnabled;
+						m_queue->SubmitWrite(
+							"softstart." + to_string(i), [psu, i, enable]{ psu->SetSoftStartEnabled(i, enable); });
+					}
 
 					HelpMarker(
 						"Deliberately limit the rise time of the output in order to reduce inrush current when driving "
@@ -251,7 +295,9 @@ void PowerSupplyDialog::ChannelSettings(int i, float v, float a, float etime)
 					if(UnitInputWithExplicitApply(
 						"Ramp time", m_channelUIState[i].m_setSSRamp, m_channelUIState[i].m_committedSSRamp, fs))
 					{
-						m_psu->SetSoftStartRampTime(i, m_channelUIState[i].m_committedSSRamp);
+						int64_t ramp = m_channelUIState[i].m_committedSSRamp;
+						m_queue->SubmitWrite(
+							"ramp." + to_string(i), [psu, i, ramp]{ psu->SetSoftStartRampTime(i, ramp); });
 					}
 					HelpMarker(
 						"Transition time between off and on state when using soft start\n\n"
@@ -275,7 +321,9 @@ void PowerSupplyDialog::ChannelSettings(int i, float v, float a, float etime)
 				if(UnitInputWithExplicitApply(
 					"Voltage", m_channelUIState[i].m_setVoltage, m_channelUIState[i].m_committedSetVoltage, volts))
 				{
-					m_psu->SetPowerVoltage(i, m_channelUIState[i].m_committedSetVoltage);
+					float setpoint = m_channelUIState[i].m_committedSetVoltage;
+					m_queue->SubmitWrite(
+						"voltage." + to_string(i), [psu, i, setpoint]{ psu->SetPowerVoltage(i, setpoint); });
 				}
 				HelpMarker("Target voltage to be supplied to the load.\n\nChanges are not pushed to hardware until you click Apply.");
 
@@ -283,7 +331,9 @@ void PowerSupplyDialog::ChannelSettings(int i, float v, float a, float etime)
 				if(UnitInputWithExplicitApply(
 					"Current", m_channelUIState[i].m_setCurrent, m_channelUIState[i].m_committedSetCurrent, amps))
 				{
-					m_psu->SetPowerCurrent(i, m_channelUIState[i].m_committedSetCurrent);
+					float setpoint = m_channelUIState[i].m_committedSetCurrent;
+					m_queue->SubmitWrite(
+						"current." + to_string(i), [psu, i, setpoint]{ psu->SetPowerCurrent(i, setpoint); });
 				}
 				HelpMarker("Maximum current to be supplied to the load.\n\nChanges are not pushed to hardware until you click Apply.");
 
@@ -37,6 +37,7 @@
 
 #include "Dialog.h"
 #include "Session.h"
+#include "TelemetryView.h"
 
 #include <future>
 
@@ -119,11 +120,20 @@ protected:
 	///@brief Current channel stats, live updated
 	std::shared_ptr<PowerSupplyState> m_state;
 
+	///@brief Queue for running driver calls in the instrument thread
+	std::shared_ptr<InstrumentCommandQueue> m_queue;
+
 	//Future channel state during loading
 	std::vector<std::future<PowerSupplyChannelUIState> > m_futureUIState;
 
 	///@brief Channel state for the UI
 	std::vector<PowerSupplyChannelUIState> m_channelUIState;
+
+	///@brief Plots of measured voltage and current
+	TelemetryView m_history;
+
+	///@brief Poll rate control for the instrument thread (told when we're on screen)
+	std::shared_ptr<PollScheduler> m_scheduler;
 };
 
 #endif
@@ -58,6 +58,7 @@ public:
 		}
 
 		m_firstUpdateDone = false;
+		m_telemetry = std::make_shared<TelemetryRecorder>();
 	}
 
 	std::unique_ptr<std::atomic<float>[]> m_channelVoltage;
@@ -66,6 +67,11 @@ public:
 	std::unique_ptr<std::atomic<bool>[]> m_channelFuseTripped;
 
 	std::atomic<bool> m_firstUpdateDone;
+
+	//History of measured values, one series per channel (created by Session::AddInstrument)
+	std::shared_ptr<TelemetryRecorder> m_telemetry;
+	std::vector<std::shared_ptr<TelemetrySeries> > m_voltageHistory;
+	std::vector<std::shared_ptr<TelemetrySeries> > m_currentHistory;
 };
 
 #endif
@@ -47,6 +47,7 @@ public:
     PreferenceManager()
         : m_treeRoot{ "" }
     {
+        StartupProfileScope scope("Load preferences");
         DeterminePath();
         InitializeDefaults();
         LoadPreferences();
@@ -411,6 +411,30 @@ void PreferenceManager::InitializeDefaults()
 			.Unit(Unit::UNIT_COUNTS));
 
 	auto& misc = this->m_treeRoot.AddCategory("Miscellaneous");
+		auto& mgraph = misc.AddCategory("Filter Graph");
+			mgraph.AddPreference(
+				Preference::Bool("lazy_evaluation", false)
+				.Label("Only evaluate visible filters")
+				.Description(
+					"Skip filters whose outputs are not displayed anywhere (plots, measurements, protocol analyzers)\n"
+					"and do not feed anything that is.\n\n"
+					"Skipped filters are computed on demand as soon as they are displayed.\n"
+					"Protocol decoders, export filters, filters driving triggers or instrument inputs, and\n"
+					"filters which accumulate across waveforms (eye patterns, histograms, averages, etc.)\n"
+					"always run.")
+				);
+
+		auto& history = misc.AddCategory("History");
+			history.AddPreference(
+				Preference::Real("filter_cache_size", 1024.0 * 1024 * 1024)
+				.Label("Filter output cache size")
+				.Unit(Unit::UNIT_BYTES)
+				.Description(
+					"Maximum memory used to keep filter outputs for history points other than the one being viewed.\n\n"
+					"Returning to a cached point restores its filter outputs instead of recomputing them.\n"
+					"Older points are evicted first once the limit is reached.")
+				);
+
 		auto& menus = misc.AddCategory("Menus");
 			menus.AddPreference(
 				Preference::Int("recent_instrument_count", 20)
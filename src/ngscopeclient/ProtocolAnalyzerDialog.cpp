@@ -59,6 +59,12 @@ ProtocolAnalyzerDialog::ProtocolAnalyzerDialog(
 	, m_needToScrollToSelectedPacket(false)
 	, m_firstDataBlockOfFrame(true)
 	, m_bytesPerLine(1)
+	, m_searchField(0)
+	, m_searchMode(PacketSearchQuery::MATCH_CONTAINS)
+	, m_displayedGeneration(0)
+	, m_hitCountTotal(SIZE_MAX)
+	, m_visibleHits(0)
+	, m_exportFormat(PacketExporter::FORMAT_CSV)
 {
 	//Hold a reference open to the filter so it doesn't disappear on us
 	m_filter->AddRef();
@@ -66,6 +72,9 @@ ProtocolAnalyzerDialog::ProtocolAnalyzerDialog(
 
 ProtocolAnalyzerDialog::~ProtocolAnalyzerDialog()
 {
+	//Stop any export in progress before we let go of the filter
+	m_exporter = nullptr;
+
 	m_filter->Release();
 }
 
@@ -166,6 +175,9 @@ bool ProtocolAnalyzerDialog::DoRender()
 		ImGui::EndTooltip();
 	}
 
+	//Search for packets
+	DoSearchBar(cols);
+
 	//Output format for data column
 	//If this is changed force a refresh
 	bool forceRefresh = false;
@@ -174,8 +186,12 @@ bool ProtocolAnalyzerDialog::DoRender()
 		ImGui::SetNextItemWidth(10 * width);
 		if(ImGui::Combo("Data Format", (int*)&m_dataFormat, "Hex\0ASCII\0Hexdump\0"))
 			forceRefresh = true;
+		ImGui::SameLine();
 	}
 
+	//Export to file
+	DoExportControls();
+
 	//Do an update cycle to make sure any recently acquired packets are captured
 	m_mgr->Update();
 
@@ -277,6 +293,8 @@ bool ProtocolAnalyzerDialog::DoRender()
 				bool open = false;
 				if(hasChildren)
 				{
+					//Keep the tree node in sync with the manager, which may have opened it for a search hit
+					ImGui::SetNextItemOpen(m_mgr->IsChildOpen(pack));
 					open = ImGui::TreeNodeEx("##tree", ImGuiTreeNodeFlags_OpenOnArrow);
 
 					if(m_mgr->IsChildOpen(pack) != open)
@@ -390,8 +408,8 @@ bool ProtocolAnalyzerDialog::DoRender()
 				m_selectedPacket->m_offset,
 				[](const RowData& data, double f)
 					{ return f > (data.m_packet? data.m_packet->m_offset : data.m_marker.m_offset); });
-			auto& row = *sit;
-			ImGui::SetScrollFromPosY(ImGui::GetCursorStartPos().y + row.m_totalHeight);
+			if(sit != rows.end())
+				ImGui::SetScrollFromPosY(ImGui::GetCursorStartPos().y + sit->m_totalHeight);
 
 			m_needToScrollToSelectedPacket = false;
 		}
@@ -424,6 +442,251 @@ bool ProtocolAnalyzerDialog::DoRender()
 	return true;
 }
 
+/**
+	@brief Handles the search controls
+ */
+void ProtocolAnalyzerDialog::DoSearchBar(const vector<string>& cols)
+{
+	float width = ImGui::GetFontSize();
+
+	//List of fields we can search
+	string fields = "All headers";
+	fields += '\0';
+	for(auto c : cols)
+	{
+		fields += c;
+		fields += '\0';
+	}
+	int datafield = cols.size() + 1;
+	if(m_filter->GetShowDataColumn())
+	{
+		fields += "Data (hex)";
+		fields += '\0';
+	}
+	else if(m_searchField >= datafield)
+		m_searchField = 0;
+
+	ImGui::SetNextItemWidth(8 * width);
+	ImGui::Combo("##searchfield", &m_searchField, fields.c_str());
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(6 * width);
+	ImGui::Combo("##searchmode", &m_searchMode, "contains\0starts with\0equals\0");
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(15 * width);
+	bool enter = ImGui::InputTextWithHint(
+		"##search", "Search", &m_searchText, ImGuiInputTextFlags_EnterReturnsTrue);
+	if(enter)
+		ImGui::SetKeyboardFocusHere(-1);
+	if(ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+	{
+		ImGui::SetTooltip(
+			"Enter to find next, shift-enter to find previous.\n"
+			"When searching data, enter bytes in hex (e.g. \"DE AD BE EF\").");
+	}
+	ImGui::SameLine();
+	bool prev = ImGui::ArrowButton("##prev", ImGuiDir_Up);
+	ImGui::SameLine();
+	bool next = ImGui::ArrowButton("##next", ImGuiDir_Down);
+
+	if(m_searchText.empty())
+		return;
+
+	auto query = GetSearchQuery(cols);
+
+	lock_guard<recursive_mutex> lock(m_mgr->GetMutex());
+	auto& index = m_mgr->GetSearchIndex();
+	auto& hits = index.Search(query);
+
+	//Hits include packets hidden by the display filter, which have no row to select.
+	//Only count the ones the user can actually navigate to, and say how many others there are.
+	if(m_displayedGeneration != m_mgr->GetRowsGeneration())
+	{
+		m_displayedPackets.clear();
+		m_displayedGeneration = m_mgr->GetRowsGeneration();
+		m_hitCountTotal = SIZE_MAX;
+	}
+	if( (query != m_hitCountQuery) || (hits.size() != m_hitCountTotal) )
+	{
+		m_visibleHits = 0;
+		Packet* parent;
+		for(auto& hit : hits)
+		{
+			if(IsHitDisplayed(hit, parent))
+				m_visibleHits ++;
+		}
+		m_hitCountQuery = query;
+		m_hitCountTotal = hits.size();
+	}
+
+	ImGui::SameLine();
+	string count = to_string(m_visibleHits) + " hits";
+	if(m_visibleHits != hits.size())
+		count += " (" + to_string(hits.size() - m_visibleHits) + " hidden)";
+	if(index.IsIndexing())
+		count += " (indexing)";
+	ImGui::TextUnformatted(count.c_str());
+
+	if(enter && ImGui::GetIO().KeyShift)
+		prev = true;
+	if(enter || next || prev)
+	{
+		Packet* parent = nullptr;
+		auto accept = [&](const PacketSearchHit& hit)
+			{ return IsHitDisplayed(hit, parent); };
+
+		auto hit = index.FindNext(query, m_lastSelectedWaveform, m_selectedPacket, prev, accept);
+		if(hit)
+		{
+			//If it's a child of a collapsed parent, expand the parent first so the row exists
+			IsHitDisplayed(*hit, parent);
+			if(parent)
+				m_mgr->RevealPacket(parent);
+
+			SelectPacket(hit->m_stamp, hit->m_packet);
+		}
+	}
+}
+
+/**
+	@brief Checks if a search hit has a row in the table (i.e. it passed the display filter)
+
+	The set of displayed packets is built one waveform at a time, only as searches reach it, and kept until the
+	packet manager rebuilds its rows.
+
+	@param hit		The hit to check
+	@param parent	Set to the hit's parent packet if it's a merged child, or null if it's a top level packet
+
+	@return True if the packet is displayed
+ */
+bool ProtocolAnalyzerDialog::IsHitDisplayed(const PacketSearchHit& hit, Packet*& parent)
+{
+	auto it = m_displayedPackets.find(hit.m_stamp);
+	if(it == m_displayedPackets.end())
+	{
+		it = m_displayedPackets.emplace(hit.m_stamp, unordered_map<Packet*, Packet*>()).first;
+		m_mgr->GetDisplayedPackets(hit.m_stamp, it->second);
+	}
+
+	auto jt = it->second.find(hit.m_packet);
+	if(jt == it->second.end())
+	{
+		parent = nullptr;
+		return false;
+	}
+	parent = jt->second;
+	return true;
+}
+
+/**
+	@brief Builds a search query from the current state of the search controls
+ */
+PacketSearchQuery ProtocolAnalyzerDialog::GetSearchQuery(const vector<string>& cols)
+{
+	PacketSearchQuery query;
+	query.m_text = m_searchText;
+	query.m_mode = static_cast<PacketSearchQuery::MatchMode>(m_searchMode);
+
+	if(m_searchField == 0)
+		query.m_field = PacketSearchQuery::FIELD_ANY_HEADER;
+	else if(m_searchField <= (int)cols.size())
+	{
+		query.m_field = PacketSearchQuery::FIELD_HEADER;
+		query.m_header = cols[m_searchField - 1];
+	}
+	else
+		query.m_field = PacketSearchQuery::FIELD_DATA;
+
+	return query;
+}
+
+/**
+	@brief Selects a packet, scrolls to it, and moves the waveform view to show it
+ */
+void ProtocolAnalyzerDialog::SelectPacket(TimePoint stamp, Packet* pack)
+{
+	m_selectedPacket = pack;
+	m_needToScrollToSelectedPacket = true;
+
+	if( (m_lastSelectedWaveform != TimePoint(0, 0)) && (m_lastSelectedWaveform != stamp) )
+		m_waveformChanged = true;
+	m_lastSelectedWaveform = stamp;
+
+	m_parent.NavigateToTimestamp(pack->m_offset, pack->m_len, StreamDescriptor(m_filter, 0));
+}
+
+/**
+	@brief Handles the export button, file browser and progress display
+ */
+void ProtocolAnalyzerDialog::DoExportControls()
+{
+	float width = ImGui::GetFontSize();
+
+	//Export in progress: show progress and allow cancellation
+	if(m_exporter)
+	{
+		if(m_exporter->IsDone())
+		{
+			if(!m_exporter->Succeeded() && !m_exporter->WasCancelled())
+				ShowErrorPopup("Export failed", m_exporter->GetError());
+			m_exporter = nullptr;
+		}
+		else
+		{
+			ImGui::ProgressBar(m_exporter->GetProgress(), ImVec2(10*width, 0));
+			ImGui::SameLine();
+			if(ImGui::Button("Cancel"))
+				m_exporter->Cancel();
+			return;
+		}
+	}
+
+	ImGui::SetNextItemWidth(6 * width);
+	ImGui::Combo("##exportformat", &m_exportFormat, "CSV\0pcapng\0");
+	ImGui::SameLine();
+	if(ImGui::Button("Export...") && !m_exportBrowser)
+	{
+		if(m_exportFormat == PacketExporter::FORMAT_PCAPNG)
+		{
+			m_exportBrowser = MakeFileBrowser(
+				&m_parent,
+				".",
+				"Export Packets",
+				"pcapng files (*.pcapng)",
+				"*.pcapng",
+				true);
+		}
+		else
+		{
+			m_exportBrowser = MakeFileBrowser(
+				&m_parent,
+				".",
+				"Export Packets",
+				"CSV files (*.csv)",
+				"*.csv",
+				true);
+		}
+	}
+	Tooltip("Export all packets matching the current filter expression");
+
+	if(m_exportBrowser)
+	{
+		m_exportBrowser->Render();
+
+		if(m_exportBrowser->IsClosedOK())
+		{
+			m_exporter = make_unique<PacketExporter>(
+				m_filter,
+				m_mgr,
+				m_exportBrowser->GetFileName(),
+				static_cast<PacketExporter::Format>(m_exportFormat));
+			m_exporter->Start();
+		}
+
+		if(m_exportBrowser->IsClosed())
+			m_exportBrowser = nullptr;
+	}
+}
+
 /**
 	@brief Handles the "data" column for packets
  */
@@ -640,7 +903,7 @@ void ProtocolAnalyzerDialog::OnCursorMoved(int64_t offset)
 	for(auto p : packets)
 	{
 		//Check child packets first
-		auto& children = m_mgr->GetFilteredChildPackets(p);
+		auto children = m_mgr->GetFilteredChildPackets(p);
 		for(auto c : children)
 		{
 			if(offset > (c->m_offset + c->m_len) )
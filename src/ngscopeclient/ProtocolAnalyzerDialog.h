@@ -36,6 +36,8 @@
 #define ProtocolAnalyzerDialog_h
 
 #include "Dialog.h"
+#include "FileBrowser.h"
+#include "PacketExporter.h"
 #include "Session.h"
 
 #include "../scopehal/PacketDecoder.h"
@@ -111,6 +113,11 @@ protected:
 	bool m_needToScrollToSelectedPacket;
 
 	void DoDataColumn(Packet* pack, ImFont* dataFont, std::vector<RowData>& rows, size_t nrow);
+	void DoSearchBar(const std::vector<std::string>& cols);
+	PacketSearchQuery GetSearchQuery(const std::vector<std::string>& cols);
+	void SelectPacket(TimePoint stamp, Packet* pack);
+	bool IsHitDisplayed(const PacketSearchHit& hit, Packet*& parent);
+	void DoExportControls();
 
 	///@brief True the first time DoDataColumn() is called in a given frame
 	bool m_firstDataBlockOfFrame;
@@ -123,6 +130,39 @@ protected:
 
 	///@brief Filter expression we're actually using
 	std::string m_committedFilterExpression;
+
+	///@brief Text we're searching for
+	std::string m_searchText;
+
+	///@brief Field to search: 0 = all headers, 1...n = a single header, n+1 = data
+	int m_searchField;
+
+	///@brief How the search text must match (PacketSearchQuery::MatchMode)
+	int m_searchMode;
+
+	///@brief Displayed packets (mapped to their parent, or null) of each waveform the search has looked at
+	std::map<TimePoint, std::unordered_map<Packet*, Packet*> > m_displayedPackets;
+
+	///@brief Rows generation of the packet manager when m_displayedPackets was filled
+	uint64_t m_displayedGeneration;
+
+	///@brief Query the visible hit count was computed for
+	PacketSearchQuery m_hitCountQuery;
+
+	///@brief Total number of hits when the visible hit count was computed
+	size_t m_hitCountTotal;
+
+	///@brief Number of hits which are displayed (not hidden by the display filter)
+	size_t m_visibleHits;
+
+	///@brief Selected export format (PacketExporter::Format)
+	int m_exportFormat;
+
+	///@brief File browser for choosing the export path
+	std::shared_ptr<FileBrowser> m_exportBrowser;
+
+	///@brief Export currently in progress, if any
+	std::unique_ptr<PacketExporter> m_exporter;
 };
 
 #endif
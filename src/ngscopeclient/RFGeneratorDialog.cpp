@@ -37,6 +37,7 @@
 #include "RFGeneratorDialog.h"
 
 using namespace std;
+using namespace std::chrono_literals;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // RFGeneratorChannelUIState
@@ -156,27 +157,35 @@ RFGeneratorDialog::RFGeneratorDialog(
 		ImVec2(400, 350))
 	, m_session(session)
 	, m_generator(generator)
+	, m_queue(session->GetInstrumentCommandQueue(generator))
 {
-	Unit hz(Unit::UNIT_HZ);
-	Unit dbm(Unit::UNIT_DBM);
-
-	double start = GetTime();
-
 	RefreshFromHardware();
-
-	LogDebug("Intial UI state loaded in %.2f ms\n", (GetTime() - start) * 1000);
 }
 
 RFGeneratorDialog::~RFGeneratorDialog()
 {
 }
 
+/**
+	@brief Reloads the UI state from the instrument
+
+	This takes a lot of round trips, so it's done in the instrument thread. The current state (if any) stays on
+	screen until the new state is ready.
+ */
 void RFGeneratorDialog::RefreshFromHardware()
 {
-	m_uiState.clear();
+	auto gen = m_generator;
+	m_uiStateFuture = m_queue->Submit<vector<RFGeneratorChannelUIState> >([gen]
+		{
+			double start = GetTime();
 
-	for(size_t i=0; i<m_generator->GetChannelCount(); i++)
-		m_uiState.push_back(RFGeneratorChannelUIState(m_generator, i));
+			vector<RFGeneratorChannelUIState> state;
+			for(size_t i=0; i<gen->GetChannelCount(); i++)
+				state.push_back(RFGeneratorChannelUIState(gen, i));
+
+			LogDebug("UI state loaded in %.2f ms\n", (GetTime() - start) * 1000);
+			return state;
+		});
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -207,6 +216,16 @@ bool RFGeneratorDialog::DoRender()
 		ImGui::EndDisabled();
 	}
 
+	//Pick up newly loaded state
+	if(m_uiStateFuture.valid() && (m_uiStateFuture.wait_for(0s) == future_status::ready) )
+		m_uiState = m_uiStateFuture.get();
+
+	if(m_uiState.empty())
+	{
+		ImGui::TextUnformatted("Loading...");
+		return true;
+	}
+
 	for(size_t i=0; i<m_generator->GetChannelCount(); i++)
 		DoChannel(i);
 
@@ -233,12 +252,17 @@ void RFGeneratorDialog::DoChannel(size_t i)
 	Unit hz(Unit::UNIT_HZ);
 	Unit dbm(Unit::UNIT_DBM);
 
+	auto gen = m_generator;
 	if(ImGui::CollapsingHeader(chname.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
 	{
 		ImGui::PushID(chname.c_str());
 
 		if(ImGui::Checkbox("Output Enable", &m_uiState[i].m_outputEnabled))
-			m_generator->SetChannelOutputEnable(i, m_uiState[i].m_outputEnabled);
+		{
+			auto value = m_uiState[i].m_outputEnabled;
+			m_queue->SubmitWrite(
+				"ChannelOutputEnable." + to_string(i), [gen, i, value]{ gen->SetChannelOutputEnable(i, value); });
+		}
 		HelpMarker("Turns the RF signal from this channel on or off");
 
 		string f = hz.PrettyPrint(chan->GetFrequency());
@@ -263,7 +287,11 @@ void RFGeneratorDialog::DoChannel(size_t i)
 			//Require the user to explicitly commit changes before it takes effect
 			ImGui::SetNextItemWidth(valueWidth);
 			if(UnitInputWithExplicitApply("Level", m_uiState[i].m_level, m_uiState[i].m_committedLevel, dbm))
-				m_generator->SetChannelOutputPower(i, m_uiState[i].m_committedLevel);
+			{
+				auto value = m_uiState[i].m_committedLevel;
+				m_queue->SubmitWrite(
+					"ChannelOutputPower." + to_string(i), [gen, i, value]{ gen->SetChannelOutputPower(i, value); });
+			}
 			HelpMarker("Power level of the generated waveform");
 		}
 
@@ -281,7 +309,12 @@ void RFGeneratorDialog::DoChannel(size_t i)
 		{
 			ImGui::SetNextItemWidth(valueWidth);
 			if(UnitInputWithImplicitApply("Frequency", m_uiState[i].m_frequency, m_uiState[i].m_committedFrequency, hz))
-				m_generator->SetChannelCenterFrequency(i, m_uiState[i].m_committedFrequency);
+			{
+				auto value = m_uiState[i].m_committedFrequency;
+				m_queue->SubmitWrite(
+					"ChannelCenterFrequency." + to_string(i),
+					[gen, i, value]{ gen->SetChannelCenterFrequency(i, value); });
+			}
 
 			HelpMarker("Carrier frequency of the generated waveform.");
 		}
@@ -294,42 +327,66 @@ void RFGeneratorDialog::DoChannel(size_t i)
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(Combo("Mode", m_uiState[i].m_sweepTypeNames, m_uiState[i].m_sweepType))
-					m_generator->SetSweepType(i, m_uiState[i].m_sweepTypes[m_uiState[i].m_sweepType]);
+				{
+					auto value = m_uiState[i].m_sweepTypes[m_uiState[i].m_sweepType];
+					m_queue->SubmitWrite("SweepType." + to_string(i), [gen, i, value]{ gen->SetSweepType(i, value); });
+				}
 				HelpMarker("Choose whether to sweep frequency, power, both, or neither.");
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(UnitInputWithImplicitApply("Dwell Time",
 					m_uiState[i].m_sweepDwellTime, m_uiState[i].m_committedSweepDwellTime, fs))
 				{
-					m_generator->SetSweepDwellTime(i, m_uiState[i].m_committedSweepDwellTime);
+					auto value = m_uiState[i].m_committedSweepDwellTime;
+					m_queue->SubmitWrite(
+						"SweepDwellTime." + to_string(i), [gen, i, value]{ gen->SetSweepDwellTime(i, value); });
 				}
 				HelpMarker("Time to stay at each frequency before moving to the next.");
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(IntInputWithImplicitApply("Points", m_uiState[i].m_sweepPoints, m_uiState[i].m_committedSweepPoints))
-					m_generator->SetSweepPoints(i, m_uiState[i].m_committedSweepPoints);
+				{
+					auto value = m_uiState[i].m_committedSweepPoints;
+					m_queue->SubmitWrite(
+						"SweepPoints." + to_string(i), [gen, i, value]{ gen->SetSweepPoints(i, value); });
+				}
 				HelpMarker("Number of steps in the sweep.");
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(Combo("Shape", m_uiState[i].m_sweepShapeNames, m_uiState[i].m_sweepShape))
-					m_generator->SetSweepShape(i, m_uiState[i].m_sweepShapes[m_uiState[i].m_sweepShape]);
+				{
+					auto value = m_uiState[i].m_sweepShapes[m_uiState[i].m_sweepShape];
+					m_queue->SubmitWrite(
+						"SweepShape." + to_string(i), [gen, i, value]{ gen->SetSweepShape(i, value); });
+				}
 				HelpMarker("Select the shape of the sweep waveform (triangle or sawtooth).");
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(Combo("Spacing", m_uiState[i].m_sweepSpaceNames, m_uiState[i].m_sweepSpacing))
-					m_generator->SetSweepSpacing(i, m_uiState[i].m_sweepSpaceTypes[m_uiState[i].m_sweepSpacing]);
+				{
+					auto value = m_uiState[i].m_sweepSpaceTypes[m_uiState[i].m_sweepSpacing];
+					m_queue->SubmitWrite(
+						"SweepSpacing." + to_string(i), [gen, i, value]{ gen->SetSweepSpacing(i, value); });
+				}
 				HelpMarker("Specify how to divide the sweep range into points (linear or logarithmic spacing).");
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(Combo("Direction", m_uiState[i].m_sweepDirectionNames, m_uiState[i].m_sweepDirection))
-					m_generator->SetSweepDirection(i, m_uiState[i].m_sweepDirections[m_uiState[i].m_sweepDirection]);
+				{
+					auto value = m_uiState[i].m_sweepDirections[m_uiState[i].m_sweepDirection];
+					m_queue->SubmitWrite(
+						"SweepDirection." + to_string(i), [gen, i, value]{ gen->SetSweepDirection(i, value); });
+				}
 				HelpMarker("Allows the direction of the sweep to be reversed.");
 
 				ImGui::SetNextItemWidth(valueWidth);
 				if(UnitInputWithImplicitApply("Start Frequency",
 					m_uiState[i].m_sweepStart, m_uiState[i].m_committedSweepStart, hz))
 				{
-					m_generator->SetSweepStartFrequency(i, m_uiState[i].m_committedSweepStart);
+					auto value = m_uiState[i].m_committedSweepStart;
+					m_queue->SubmitWrite(
+						"SweepStartFrequency." + to_string(i),
+						[gen, i, value]{ gen->SetSweepStartFrequency(i, value); });
 				}
 				HelpMarker("Initial value for frequency sweeps. Ignored if not sweeping frequency.");
 
@@ -337,7 +394,9 @@ void RFGeneratorDialog::DoChannel(size_t i)
 				if(UnitInputWithExplicitApply("Start Level",
 					m_uiState[i].m_sweepStartLevel, m_uiState[i].m_committedSweepStartLevel, dbm))
 				{
-					m_generator->SetSweepStartLevel(i, m_uiState[i].m_committedSweepStartLevel);
+					auto value = m_uiState[i].m_committedSweepStartLevel;
+					m_queue->SubmitWrite(
+						"SweepStartLevel." + to_string(i), [gen, i, value]{ gen->SetSweepStartLevel(i, value); });
 				}
 				HelpMarker("Initial value for power sweeps. Ignored if not sweeping power.");
 
@@ -345,7 +404,9 @@ void RFGeneratorDialog::DoChannel(size_t i)
 				if(UnitInputWithImplicitApply("Stop Frequency",
 					m_uiState[i].m_sweepStop, m_uiState[i].m_committedSweepStop, hz))
 				{
-					m_generator->SetSweepStopFrequency(i, m_uiState[i].m_committedSweepStop);
+					auto value = m_uiState[i].m_committedSweepStop;
+					m_queue->SubmitWrite(
+						"SweepStopFrequency." + to_string(i), [gen, i, value]{ gen->SetSweepStopFrequency(i, value); });
 				}
 				HelpMarker("Ending value for frequency sweeps. Ignored if not sweeping frequency.");
 
@@ -353,7 +414,9 @@ void RFGeneratorDialog::DoChannel(size_t i)
 				if(UnitInputWithExplicitApply("Stop Level",
 					m_uiState[i].m_sweepStopLevel, m_uiState[i].m_committedSweepStopLevel, dbm))
 				{
-					m_generator->SetSweepStopLevel(i, m_uiState[i].m_committedSweepStopLevel);
+					auto value = m_uiState[i].m_committedSweepStopLevel;
+					m_queue->SubmitWrite(
+						"SweepStopLevel." + to_string(i), [gen, i, value]{ gen->SetSweepStopLevel(i, value); });
 				}
 				HelpMarker("Ending value for power sweeps. Ignored if not sweeping power.");
 
@@ -367,7 +430,12 @@ void RFGeneratorDialog::DoChannel(size_t i)
 			if(ImGui::TreeNode("Analog Modulation"))
 			{
 				if(ImGui::Checkbox("Modulation Enable", &m_uiState[i].m_analogModEnabled))
-					m_generator->SetAnalogModulationEnable(i, m_uiState[i].m_analogModEnabled);
+				{
+					auto value = m_uiState[i].m_analogModEnabled;
+					m_queue->SubmitWrite(
+						"AnalogModulationEnable." + to_string(i),
+						[gen, i, value]{ gen->SetAnalogModulationEnable(i, value); });
+				}
 				HelpMarker("Turn analog modulation on or off");
 
 				if(!m_uiState[i].m_analogModEnabled)
@@ -380,7 +448,11 @@ void RFGeneratorDialog::DoChannel(size_t i)
 				if(ImGui::TreeNode("FM"))
 				{
 					if(ImGui::Checkbox("FM Enable", &m_uiState[i].m_fmEnabled))
-						m_generator->SetAnalogFMEnable(i, m_uiState[i].m_fmEnabled);
+					{
+						auto value = m_uiState[i].m_fmEnabled;
+						m_queue->SubmitWrite(
+							"AnalogFMEnable." + to_string(i), [gen, i, value]{ gen->SetAnalogFMEnable(i, value); });
+					}
 					HelpMarker("Turn analog frequency modulation on or off");
 
 					if(!m_uiState[i].m_fmEnabled)
@@ -388,14 +460,22 @@ void RFGeneratorDialog::DoChannel(size_t i)
 
 					ImGui::SetNextItemWidth(valueWidth);
 					if(Combo("Waveform", m_uiState[i].m_fmWaveShapeNames, m_uiState[i].m_fmWaveShape))
-						m_generator->SetAnalogFMWaveShape(i, m_uiState[i].m_fmWaveShapes[m_uiState[i].m_fmWaveShape]);
+					{
+						auto value = m_uiState[i].m_fmWaveShapes[m_uiState[i].m_fmWaveShape];
+						m_queue->SubmitWrite(
+							"AnalogFMWaveShape." + to_string(i),
+							[gen, i, value]{ gen->SetAnalogFMWaveShape(i, value); });
+					}
 					HelpMarker("Shape of the baseband modulation waveform");
 
 					ImGui::SetNextItemWidth(valueWidth);
 					if(UnitInputWithImplicitApply("Deviation",
 						m_uiState[i].m_fmDeviation, m_uiState[i].m_committedFmDeviation, hz))
 					{
-						m_generator->SetAnalogFMDeviation(i, m_uiState[i].m_committedFmDeviation);
+						auto value = m_uiState[i].m_committedFmDeviation;
+						m_queue->SubmitWrite(
+							"AnalogFMDeviation." + to_string(i),
+							[gen, i, value]{ gen->SetAnalogFMDeviation(i, value); });
 					}
 					HelpMarker("Modulation depth for analog FM");
 
@@ -403,7 +483,10 @@ void RFGeneratorDialog::DoChannel(size_t i)
 					if(UnitInputWithImplicitApply("Frequency",
 						m_uiState[i].m_fmFrequency, m_uiState[i].m_committedFmFrequency, hz))
 					{
-						m_generator->SetAnalogFMFrequency(i, m_uiState[i].m_committedFmFrequency);
+						auto value = m_uiState[i].m_committedFmFrequency;
+						m_queue->SubmitWrite(
+							"AnalogFMFrequency." + to_string(i),
+							[gen, i, value]{ gen->SetAnalogFMFrequency(i, value); });
 					}
 					HelpMarker("Baseband frequency for analog FM");
 
@@ -36,9 +36,10 @@
 #define RFGeneratorDialog_h
 
 #include "Dialog.h"
-#include "RollingBuffer.h"
 #include "Session.h"
 
+#include <future>
+
 class RFGeneratorChannelUIState
 {
 public:
@@ -133,6 +134,11 @@ protected:
 	///@brief UI state for each channel
 	std::vector<RFGeneratorChannelUIState> m_uiState;
 
+	///@brief Queue for running driver calls in the instrument thread
+	std::shared_ptr<InstrumentCommandQueue> m_queue;
+
+	///@brief UI state being loaded from the instrument
+	std::future<std::vector<RFGeneratorChannelUIState> > m_uiStateFuture;
 };
 
 
@@ -40,6 +40,9 @@
 using namespace std;
 using namespace std::chrono_literals;
 
+///@brief Maximum number of lines kept in the console output
+static const size_t g_maxConsoleLines = 10000;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
@@ -50,7 +53,10 @@ SCPIConsoleDialog::SCPIConsoleDialog(MainWindow* parent, shared_ptr<SCPIInstrume
 		ImVec2(500, 300))
 	, m_parent(parent)
 	, m_inst(inst)
-	, m_commandPending(false)
+	, m_queue(parent->GetSession().GetInstrumentCommandQueue(inst))
+	, m_follow(true)
+	, m_scriptMode(false)
+	, m_pipelineDepth(8)
 {
 }
 
@@ -59,69 +65,321 @@ SCPIConsoleDialog::~SCPIConsoleDialog()
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Rendering
+// Command execution
 
-bool SCPIConsoleDialog::DoRender()
+/**
+	@brief Checks if a command is a query (so a reply is expected)
+
+	Only the command header (everything before the first whitespace) is considered, so a '?' inside a parameter,
+	such as a quoted string, doesn't count.
+ */
+bool SCPIConsoleDialog::IsQuery(const string& command)
 {
-	auto csize = ImGui::GetContentRegionAvail();
+	auto cmd = Trim(command);
+	auto header = cmd.substr(0, cmd.find_first_of(" \t"));
+	return !header.empty() && (header.back() == '?');
+}
+
+/**
+	@brief Sends a batch of commands, keeping up to a fixed number of queries in flight
+
+	Commands are written to the transport back to back without waiting for replies. Replies come back in the order
+	the queries were sent, so each one read is matched to the oldest query still outstanding. Once "window" queries
+	are outstanding, we read a reply before sending anything else so the instrument's input buffer can't overflow.
+
+	The transport is locked for the whole script, so no other traffic can get between a query and its reply.
+
+	If a query times out, we can no longer tell which reply belongs to which query. The script is aborted at that
+	point: nothing more is sent, and any replies still on their way are flushed.
+
+	Must be called from the thread which owns the instrument.
+
+	@param transport	Transport to send the commands over
+	@param commands		Commands to send, in order
+	@param window		Maximum number of queries awaiting a reply at once (1 sends each query and waits for it)
 
-	//Check for results of pending commands
-	if(m_commandPending)
+	@return Result of each command, in the same order as the commands
+ */
+vector<SCPIConsoleResult> SCPIConsoleDialog::RunScript(
+	SCPITransport* transport,
+	const vector<string>& commands,
+	size_t window)
+{
+	window = max(window, (size_t)1);
+
+	lock_guard<recursive_mutex> lock(transport->GetMutex());
+
+	//Anything the driver had queued up goes out first, so its replies don't get mixed up with ours
+	transport->FlushCommandQueue();
+
+	vector<SCPIConsoleResult> results(commands.size());
+	vector<double> sendTimes(commands.size());
+	deque<size_t> outstanding;
+	bool timedOut = false;
+
+	auto readOldest = [&]()
+	{
+		size_t i = outstanding.front();
+		outstanding.pop_front();
+		results[i].m_reply = Trim(transport->ReadReply());
+		results[i].m_latency = GetTime() - sendTimes[i];
+		results[i].m_completed = true;
+		if(results[i].m_reply.empty())
+			timedOut = true;
+	};
+
+	for(size_t i=0; i<commands.size(); i++)
+	{
+		auto& r = results[i];
+		r.m_command = commands[i];
+		r.m_isQuery = IsQuery(commands[i]);
+		r.m_completed = false;
+		r.m_latency = 0;
+	}
+
+	for(size_t i=0; i<commands.size(); i++)
 	{
-		if(m_commandReturnValue.wait_for(0s) == future_status::ready)
+		if(outstanding.size() >= window)
 		{
-			auto str = m_commandReturnValue.get();
-			if(Trim(str).empty())
-				m_output.push_back("Request timed out.");
+			readOldest();
+			if(timedOut)
+				break;
+		}
+
+		auto& r = results[i];
+		sendTimes[i] = GetTime();
+		transport->SendCommand(commands[i]);
+		if(r.m_isQuery)
+			outstanding.push_back(i);
+		else
+		{
+			r.m_latency = GetTime() - sendTimes[i];
+			r.m_completed = true;
+		}
+	}
+
+	while(!outstanding.empty() && !timedOut)
+		readOldest();
+
+	//Replies to queries still outstanding can't be matched up any more, so throw them away
+	if(timedOut)
+		transport->FlushRXBuffer();
+
+	return results;
+}
+
+/**
+	@brief Runs commands in the instrument thread, showing the results once they're all done
+
+	@param commands		Commands to send
+	@param pipelined	True to send them as a script (pipelined), false to send them one at a time
+ */
+void SCPIConsoleDialog::Submit(const vector<string>& commands, bool pipelined)
+{
+	auto inst = m_inst;
+	size_t window = pipelined ? m_pipelineDepth : 1;
+	function<vector<SCPIConsoleResult>()> fn = [inst, commands, window]
+		{ return RunScript(inst->GetTransport(), commands, window); };
+
+	if(m_queue)
+		m_pending.push_back(m_queue->Submit(fn));
+	else
+		m_pending.push_back(async(launch::async, fn));
+}
+
+/**
+	@brief Moves results of completed commands into the output, in submission order
+ */
+void SCPIConsoleDialog::PollResults()
+{
+	Unit fs(Unit::UNIT_FS);
+	while(!m_pending.empty() && (m_pending.front().wait_for(0s) == future_status::ready))
+	{
+		auto results = m_pending.front().get();
+		m_pending.pop_front();
+
+		double total = 0;
+		double worst = 0;
+		size_t queries = 0;
+		size_t incomplete = 0;
+		for(auto& r : results)
+		{
+			if(!r.m_completed)
+			{
+				incomplete ++;
+				continue;
+			}
+			if(!r.m_isQuery)
+				continue;
+			if(r.m_reply.empty())
+				AddOutput(SCPIConsoleLine(r.m_command + ": Request timed out.", r.m_latency));
+			else if(results.size() > 1)
+				AddOutput(SCPIConsoleLine(r.m_command + ": " + r.m_reply, r.m_latency));
 			else
-				m_output.push_back(str);
-			m_commandPending = false;
+				AddOutput(SCPIConsoleLine(r.m_reply, r.m_latency));
+
+			total += r.m_latency;
+			worst = max(worst, r.m_latency);
+			queries ++;
+		}
+
+		//Summarize scripts
+		if(results.size() > 1)
+		{
+			m_scriptStats = to_string(results.size()) + " commands, " + to_string(queries) + " queries";
+			if(queries)
+			{
+				m_scriptStats +=
+					", mean query latency " + fs.PrettyPrint(total / queries * FS_PER_SECOND) +
+					", max " + fs.PrettyPrint(worst * FS_PER_SECOND);
+			}
+			if(incomplete)
+				m_scriptStats += ", aborted after timeout with " + to_string(incomplete) + " commands not completed";
+			AddOutput(SCPIConsoleLine("# " + m_scriptStats));
 		}
 	}
+}
 
-	//Scroll area for console output is full window minus command box
-	ImVec2 scrollarea(csize.x, csize.y - 1.5*ImGui::GetTextLineHeightWithSpacing());
-	ImGui::BeginChild("scrollview", scrollarea, false, ImGuiWindowFlags_HorizontalScrollbar);
-		ImGui::PushFont(m_parent->GetFontPref("Appearance.General.console_font"));
-		for(auto& line : m_output)
-			ImGui::TextUnformatted(line.c_str());
-		ImGui::PopFont();
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering
 
-		if(ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
-			ImGui::SetScrollHereY(1.0f);
-	ImGui::EndChild();
+/**
+	@brief Adds a line to the output, discarding the oldest line if full
+ */
+void SCPIConsoleDialog::AddOutput(const SCPIConsoleLine& line)
+{
+	m_output.push_back(line);
+	while(m_output.size() > g_maxConsoleLines)
+		m_output.pop_front();
+}
+
+bool SCPIConsoleDialog::DoRender()
+{
+	PollResults();
+
+	if(ImGui::Checkbox("Script", &m_scriptMode))
+		m_follow = true;
+	HelpMarker(
+		"Send many commands at once.\n\n"
+		"Commands are sent back to back, with several queries in flight at a time, and each reply is shown with "
+		"its round trip latency. If a query times out, the rest of the script is abandoned.\n"
+		"Blank lines and lines starting with # are ignored.");
+	if(!m_pending.empty())
+	{
+		ImGui::SameLine();
+		ImGui::Text("%zu pending", m_pending.size());
+	}
+
+	if(m_scriptMode)
+		RenderScript();
+
+	//Scroll area for console output is full window minus command box
+	auto csize = ImGui::GetContentRegionAvail();
+	RenderOutput(ImVec2(csize.x, csize.y - 1.5*ImGui::GetTextLineHeightWithSpacing()));
 
 	//Command input box
+	//(replies are matched up in order, so there's no need to wait for one before sending the next command)
 	ImGui::SetNextItemWidth(csize.x);
-	bool pending = m_commandPending;
-	if(pending)
-		ImGui::BeginDisabled();
 	if(ImGui::InputText("Command", &m_command, ImGuiInputTextFlags_EnterReturnsTrue))
 	{
 		//Show command immediately
-		m_output.push_back(string("> ") + m_command);
-
-		//Push command to the instrument immediately
-		auto trans = m_inst->GetTransport();
-		if(m_command.find('?') == string::npos)
-			trans->SendCommandQueued(m_command);
-
-		//Commands are sent immediately, but reply is deferred to avoid blocking the UI
-		else
-		{
-			m_commandPending = true;
-			string cmd = m_command;
-			m_commandReturnValue = async(launch::async, [cmd, trans]{ return trans->SendCommandQueuedWithReply(cmd); });
-		}
+		AddOutput(SCPIConsoleLine(string("> ") + m_command));
+		m_follow = true;
 
+		Submit({m_command}, false);
 		m_command = "";
 
 		//Re-set focus back into the box
 		//because imgui defaults to unfocusing once it's closed
 		ImGui::SetKeyboardFocusHere(-1);
 	}
-	if(pending)
-		ImGui::EndDisabled();
 
 	return true;
 }
+
+/**
+	@brief Renders the output area, only submitting the lines which are visible
+ */
+void SCPIConsoleDialog::RenderOutput(ImVec2 size)
+{
+	Unit fs(Unit::UNIT_FS);
+
+	ImGui::BeginChild("scrollview", size, false, ImGuiWindowFlags_HorizontalScrollbar);
+		ImGui::PushFont(m_parent->GetFontPref("Appearance.General.console_font"));
+
+		//Latency column is wide enough for "999.999 ms"
+		float latencyWidth = ImGui::CalcTextSize("999.999 ms ").x;
+
+		ImGuiListClipper clipper;
+		clipper.Begin(m_output.size());
+		while(clipper.Step())
+		{
+			for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+			{
+				auto& line = m_output[i];
+				float x = ImGui::GetCursorPosX();
+				if(line.m_latency >= 0)
+				{
+					ImGui::TextDisabled("%s", fs.PrettyPrint(line.m_latency * FS_PER_SECOND, 4).c_str());
+					ImGui::SameLine();
+				}
+				ImGui::SetCursorPosX(x + latencyWidth);
+				ImGui::TextUnformatted(line.m_text.c_str());
+			}
+		}
+		ImGui::PopFont();
+
+		//Stop following if the user scrolled up, resume once they scroll back to the bottom
+		if( (ImGui::GetIO().MouseWheel > 0) && ImGui::IsWindowHovered())
+			m_follow = false;
+		else if(ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+			m_follow = true;
+		if(m_follow)
+			ImGui::SetScrollHereY(1.0f);
+	ImGui::EndChild();
+}
+
+/**
+	@brief Renders the script editor and its controls
+ */
+void SCPIConsoleDialog::RenderScript()
+{
+	float width = ImGui::GetContentRegionAvail().x;
+	ImGui::InputTextMultiline("###script", &m_script, ImVec2(width, 8 * ImGui::GetTextLineHeightWithSpacing()));
+
+	ImGui::SetNextItemWidth(5 * ImGui::GetFontSize());
+	if(ImGui::InputInt("Pipeline depth", &m_pipelineDepth))
+		m_pipelineDepth = max(m_pipelineDepth, 1);
+	HelpMarker(
+		"Maximum number of queries sent before reading the first reply.\n\n"
+		"Higher values hide more network latency, but some instruments drop commands if their input buffer "
+		"overflows. Set to 1 to send each query and wait for its reply before sending anything else.");
+
+	ImGui::SameLine();
+	if(ImGui::Button("Run"))
+	{
+		vector<string> commands;
+		for(auto& line : explode(m_script, '\n'))
+		{
+			auto cmd = Trim(line);
+			if(cmd.empty() || (cmd[0] == '#'))
+				continue;
+			commands.push_back(cmd);
+		}
+
+		if(!commands.empty())
+		{
+			AddOutput(SCPIConsoleLine("# Running script (" + to_string(commands.size()) + " commands)"));
+			for(auto& cmd : commands)
+				AddOutput(SCPIConsoleLine("> " + cmd));
+			m_follow = true;
+			Submit(commands, true);
+		}
+	}
+
+	if(!m_scriptStats.empty())
+	{
+		ImGui::SameLine();
+		ImGui::TextUnformatted(m_scriptStats.c_str());
+	}
+}
@@ -36,12 +36,58 @@
 #define SCPIConsoleDialog_h
 
 #include "Dialog.h"
+#include <deque>
 #include <future>
 
 class MainWindow;
 
+/**
+	@brief Outcome of one command sent from the console
+ */
+class SCPIConsoleResult
+{
+public:
+	///@brief The command as sent
+	std::string m_command;
+
+	///@brief Reply to the command (empty for commands which aren't queries)
+	std::string m_reply;
+
+	///@brief True if the command was a query, so a reply was expected
+	bool m_isQuery;
+
+	///@brief True if the command was sent and (for queries) a reply read, false if the script was aborted first
+	bool m_completed;
+
+	///@brief Time from sending the command to receiving the reply (or sending the command, if not a query)
+	double m_latency;
+};
+
+/**
+	@brief One line of console output
+ */
+class SCPIConsoleLine
+{
+public:
+	SCPIConsoleLine(const std::string& text, double latency = -1)
+	: m_text(text)
+	, m_latency(latency)
+	{}
+
+	///@brief Text of the line
+	std::string m_text;
+
+	///@brief Round trip time to display next to the line, in seconds (negative if none)
+	double m_latency;
+};
+
 /**
 	@brief SCPI console for debugging drivers
+
+	Commands typed one at a time are sent as soon as they're entered, without waiting for replies to earlier
+	queries. Scripts are sent as a batch, pipelined through the transport with several queries in flight at once.
+	Either way, commands run in the instrument's own thread (through its command queue) so they don't interleave
+	with polling traffic, and every reply is shown with its round trip time.
  */
 class SCPIConsoleDialog : public Dialog
 {
@@ -54,16 +100,48 @@ public:
 	std::shared_ptr<SCPIInstrument> GetInstrument()
 	{ return m_inst; }
 
+	static bool IsQuery(const std::string& command);
+	static std::vector<SCPIConsoleResult> RunScript(
+		SCPITransport* transport,
+		const std::vector<std::string>& commands,
+		size_t window);
+
 protected:
+	void Submit(const std::vector<std::string>& commands, bool pipelined);
+	void PollResults();
+	void AddOutput(const SCPIConsoleLine& line);
+	void RenderOutput(ImVec2 size);
+	void RenderScript();
+
 	MainWindow* m_parent;
 	std::shared_ptr<SCPIInstrument> m_inst;
 
-	std::vector<std::string> m_output;
+	///@brief Queue for running commands in the instrument thread (null if the instrument has no thread)
+	std::shared_ptr<InstrumentCommandQueue> m_queue;
+
+	///@brief Console output, oldest first (bounded)
+	std::deque<SCPIConsoleLine> m_output;
 
+	///@brief Keep the output scrolled to the newest line
+	bool m_follow;
+
+	///@brief Command being typed
 	std::string m_command;
 
-	bool m_commandPending;
-	std::future<std::string> m_commandReturnValue;
+	///@brief Results of commands and scripts which haven't completed yet, oldest first
+	std::deque<std::future<std::vector<SCPIConsoleResult> > > m_pending;
+
+	///@brief True if the script editor is shown
+	bool m_scriptMode;
+
+	///@brief Text of the script
+	std::string m_script;
+
+	///@brief Maximum number of queries in flight at once when running a script
+	int m_pipelineDepth;
+
+	///@brief Summary of the last script run
+	std::string m_scriptStats;
 };
 
 #endif
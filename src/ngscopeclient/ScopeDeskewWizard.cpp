@@ -36,6 +36,7 @@
 #include "ngscopeclient.h"
 #include "ScopeDeskewWizard.h"
 #include "MainWindow.h"
+#include "DeskewCorrelator.h"
 
 #include <cinttypes>
 
@@ -80,6 +81,10 @@ ScopeDeskewWizard::ScopeDeskewWizard(
 	, m_lastTriggerFs(0)
 	, m_bestCorrelation(0)
 	, m_bestCorrelationOffset(0)
+	, m_tolerance(10000)
+	, m_skewLow(0)
+	, m_skewHigh(0)
+	, m_correlationTimescale(0)
 	, m_maxSkewSamples(30000)
 	, m_medianSkew(0)
 	, m_queue(g_vkQueueManager->GetComputeQueue("ScopeDeskewWizard.queue"))
@@ -121,12 +126,17 @@ ScopeDeskewWizard::ScopeDeskewWizard(
 
 	m_gpuCorrelationAvailable = g_hasShaderInt64;
 
+	m_toleranceText = Unit(Unit::UNIT_FS).PrettyPrint(m_tolerance);
+
 	//Clear out any existing skew calibration
 	m_session.SetDeskew(m_secondary, 0);
 }
 
 ScopeDeskewWizard::~ScopeDeskewWizard()
 {
+	//Don't tear down the Vulkan resources out from under a correlation that's still running
+	if(m_correlationFuture.valid())
+		m_correlationFuture.wait();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -270,6 +280,13 @@ bool ScopeDeskewWizard::DoRender()
 			ImGui::Checkbox("Use external reference on primary", &m_useExtRefPrimary);
 			ImGui::Checkbox("Use external reference on secondary", &m_useExtRefSecondary);
 
+			ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+			UnitInputWithImplicitApply("Tolerance", m_toleranceText, m_tolerance, Unit(Unit::UNIT_FS));
+			HelpMarker(
+				"Keep acquiring until the skew is known to within this much (95% confidence).\n\n"
+				"Smaller values need more acquisitions. Noisy or low-rate captures may not reach a very tight\n"
+				"tolerance, in which case the wizard stops after a fixed number of acquisitions.");
+
 			if(ImGui::Button("Start"))
 			{
 				LogTrace("Starting\n");
@@ -356,27 +373,135 @@ void ScopeDeskewWizard::ChannelSelector(const char* name, shared_ptr<Oscilloscop
 		stream = streams[0];
 }
 
+///@brief Minimum number of good measurements before we consider stopping
+static const size_t g_minDeskewMeasurements = 5;
+
+///@brief Give up on converging after this many acquisitions
+static const int g_maxDeskewAcquisitions = 50;
+
 void ScopeDeskewWizard::DoMainProcessingFlow()
 {
-	const int nWaveforms = 10;
-
 	ImGui::PushFont(m_parent->GetFontPref("Appearance.General.title_font"));
 	ImGui::TextUnformatted("Calibration Measurements");
 	ImGui::PopFont();
 	ImGui::Separator();
 
-	//Draw progress table
+	DoProgressTable();
+
+	Unit fs(Unit::UNIT_FS);
+	if(!m_skews.empty())
+	{
+		ImGui::Text("Estimate: %s (95%% confidence %s to %s, target +/- %s)",
+			fs.PrettyPrint(m_medianSkew).c_str(),
+			fs.PrettyPrint(m_skewLow).c_str(),
+			fs.PrettyPrint(m_skewHigh).c_str(),
+			fs.PrettyPrint(m_tolerance).c_str());
+	}
+
+	//Correlation runs in the background, overlapped with the next acquisition
+	if(m_correlationFuture.valid() && (m_correlationFuture.wait_for(0s) == future_status::ready) )
+		OnCorrelationComplete();
+
+	switch(m_state)
+	{
+		case STATE_ACQUIRE:
+			{
+				//Only one correlation in flight at a time.
+				//If a new waveform shows up before the last one is done, leave it until we're ready for it.
+				//(We won't have re-armed yet, so it can't be overwritten.)
+				if(m_correlationFuture.valid())
+					break;
+
+				//Exclusive lock since copying the waveforms may need to pull them back from the GPU
+				lock_guard<shared_mutex> lock(m_session.GetWaveformDataMutex());
+
+				//Make sure we have a waveform
+				auto data = m_primaryStream.GetData();
+				if(!data)
+					return;
+
+				//If it's the same timestamp we're looking at stale data, nothing to do
+				if( (m_lastTriggerTimestamp == data->m_startTimestamp) &&
+					(m_lastTriggerFs == data->m_startFemtoseconds) )
+				{
+					return;
+				}
+
+				//New measurement! Record the timestamp
+				m_lastTriggerTimestamp = data->m_startTimestamp;
+				m_lastTriggerFs = data->m_startFemtoseconds;
+
+				OnAcquisitionComplete();
+			}
+			break;
+
+		case STATE_CORRELATE:
+			//Done acquiring, wait for the last correlation to finish
+			if(!m_correlationFuture.valid())
+			{
+				if(IsConverged())
+					LogTrace("Skew converged after %d acquisitions\n", m_measureCycle);
+				else
+					LogTrace("Skew did not converge after %d acquisitions\n", m_measureCycle);
+				m_state = STATE_DONE;
+			}
+			break;
+
+		case STATE_DONE:
+			{
+				//Nothing to apply if no acquisition ever correlated
+				bool failed = m_skews.empty();
+				if(failed)
+				{
+					ImGui::TextWrapped(
+						"Error: none of the %d acquisitions produced a valid correlation, so no skew was calculated. "
+						"Check that both channels see the calibration signal.",
+						m_measureCycle);
+				}
+				else
+				{
+					ImGui::TextWrapped("Calculated skew: %s", fs.PrettyPrint(m_medianSkew).c_str());
+					if(!IsConverged())
+					{
+						ImGui::TextWrapped(
+							"Warning: the measurements did not converge to the requested tolerance after %d "
+							"acquisitions. Check the calibration signal and cabling, or use a larger tolerance.",
+							m_measureCycle);
+					}
+				}
+
+				ImGui::BeginDisabled(failed);
+				if(ImGui::Button("Apply"))
+				{
+					m_session.SetDeskew(m_secondary, m_medianSkew);
+					m_state = STATE_CLOSE;
+				}
+				ImGui::EndDisabled();
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/**
+	@brief Draws the table of measurements taken so far
+ */
+void ScopeDeskewWizard::DoProgressTable()
+{
 	ImGuiTableFlags flags =
 		ImGuiTableFlags_Resizable |
 		ImGuiTableFlags_BordersOuter |
 		ImGuiTableFlags_BordersV |
 		ImGuiTableFlags_RowBg |
 		ImGuiTableFlags_SizingFixedFit |
-		ImGuiTableFlags_NoKeepColumnsVisible;
+		ImGuiTableFlags_NoKeepColumnsVisible |
+		ImGuiTableFlags_ScrollY;
 
-	if(ImGui::BeginTable("groups", 4, flags))
+	float width = ImGui::GetFontSize();
+	if(ImGui::BeginTable("groups", 4, flags, ImVec2(0, 12*width)))
 	{
-		float width = ImGui::GetFontSize();
 		ImGui::TableSetupScrollFreeze(0, 1); //Header row does not scroll
 		ImGui::TableSetupColumn("Acquire", ImGuiTableColumnFlags_WidthFixed, 6*width);
 		ImGui::TableSetupColumn("Correlate", ImGuiTableColumnFlags_WidthFixed, 6*width);
@@ -387,7 +512,7 @@ void ScopeDeskewWizard::DoMainProcessingFlow()
 		Unit fs(Unit::UNIT_FS);
 
 		//Past measurements
-		for(int i=0; i<m_measureCycle; i++)
+		for(size_t i=0; i<m_skews.size(); i++)
 		{
 			ImGui::PushID(i);
 			ImGui::TableNextRow(ImGuiTableRowFlags_None);
@@ -407,41 +532,31 @@ void ScopeDeskewWizard::DoMainProcessingFlow()
 			ImGui::PopID();
 		}
 
-		//Current measurement
-		if(m_state != STATE_DONE)
+		//Measurement being correlated
+		if(m_correlationFuture.valid())
 		{
-			ImGui::PushID(m_measureCycle);
 			ImGui::TableNextRow(ImGuiTableRowFlags_None);
 
 			ImGui::TableSetColumnIndex(0);
-			if(m_state == STATE_ACQUIRE)
-				ImGui::TextUnformatted("Acquiring");
-			else
-				ImGui::TextUnformatted("Done");
+			ImGui::TextUnformatted("Done");
 
 			ImGui::TableSetColumnIndex(1);
-			if(m_state == STATE_CORRELATE)
-				ImGui::TextUnformatted("Calculating");
-			else
-				ImGui::TextUnformatted("Pending");
+			ImGui::TextUnformatted("Calculating");
 
 			ImGui::TableSetColumnIndex(2);
 			ImGui::TextUnformatted("--");
 
 			ImGui::TableSetColumnIndex(3);
 			ImGui::TextUnformatted("--");
-
-			ImGui::PopID();
 		}
 
-		//Future measurements
-		for(int i=m_measureCycle+1; i<nWaveforms; i++)
+		//Measurement being acquired
+		if(m_state == STATE_ACQUIRE)
 		{
-			ImGui::PushID(i);
 			ImGui::TableNextRow(ImGuiTableRowFlags_None);
 
 			ImGui::TableSetColumnIndex(0);
-			ImGui::TextUnformatted("Pending");
+			ImGui::TextUnformatted("Acquiring");
 
 			ImGui::TableSetColumnIndex(1);
 			ImGui::TextUnformatted("Pending");
@@ -451,105 +566,134 @@ void ScopeDeskewWizard::DoMainProcessingFlow()
 
 			ImGui::TableSetColumnIndex(3);
 			ImGui::TextUnformatted("--");
-
-			ImGui::PopID();
 		}
 
 		ImGui::EndTable();
 	}
+}
 
-	switch(m_state)
+/**
+	@brief Handles a new waveform: starts correlating it in the background and arms for the next one
+ */
+void ScopeDeskewWizard::OnAcquisitionComplete()
+{
+	m_measureCycle ++;
+	LogTrace("Acquired waveform %d, starting correlation\n", m_measureCycle);
+
+	//Take copies of the waveforms so the next acquisition can't replace them while we're working.
+	//Caller holds the waveform data lock exclusively.
+	auto pri = CopyWaveform(m_primaryStream.GetData());
+	auto sec = CopyWaveform(m_secondaryStream.GetData());
+	if(!pri || !sec)
 	{
-		case STATE_ACQUIRE:
-			{
-				shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex());
-
-				//Make sure we have a waveform
-				auto data = m_primaryStream.GetData();
-				if(!data)
-					return;
-
-				//If it's the same timestamp we're looking at stale data, nothing to do
-				if( (m_lastTriggerTimestamp == data->m_startTimestamp) &&
-					(m_lastTriggerFs == data->m_startFemtoseconds) )
-				{
-					return;
-				}
+		LogError("Cannot correlate non-analog waveforms\n");
+		m_state = STATE_DONE;
+		return;
+	}
+	m_correlationTimescale = pri->m_timescale;
+	m_correlationFuture = async(launch::async, [this, pri, sec]{ return DoCorrelation(pri, sec); });
 
-				//New measurement! Record the timestamp
-				m_lastTriggerTimestamp = data->m_startTimestamp;
-				m_lastTriggerFs = data->m_startFemtoseconds;
+	//Overlap the next acquisition with this correlation, unless we already have enough data
+	if(IsConverged() || (m_measureCycle >= g_maxDeskewAcquisitions) )
+		m_state = STATE_CORRELATE;
+	else
+	{
+		LogTrace("Acquiring next waveform\n");
+		m_group->Arm(TriggerGroup::TRIGGER_TYPE_SINGLE);
+	}
+}
 
-				//We're now ready to do the correlation
-				LogTrace("Acquired waveform %d, starting correlation\n", m_measureCycle);
-				StartCorrelation();
-				m_state = STATE_CORRELATE;
-			}
-			break;
+/**
+	@brief Collects the result of a background correlation and updates the skew estimate
+ */
+void ScopeDeskewWizard::OnCorrelationComplete()
+{
+	auto result = m_correlationFuture.get();
 
-		case STATE_CORRELATE:
-			{
-				//TODO: check if the correlation is done
+	int64_t skew = result.GetSkew(m_correlationTimescale);
+	Unit fs(Unit::UNIT_FS);
+	LogTrace("Best correlation = %f (delta = %" PRId64 " %+.3f / %s)\n",
+		result.m_correlation, result.m_offset, result.m_fraction, fs.PrettyPrint(skew).c_str());
 
-				m_measureCycle ++;
+	//If we got a correlation of zero (TODO: why would this be?) then don't use it.
+	//We keep acquiring anyway so another waveform will take its place.
+	if(result.m_correlation < 1e-8)
+		return;
 
-				//Done with acquisition?
-				if(m_measureCycle >= nWaveforms)
-				{
-					//Calculate median skew
-					//(this assumes 10 total acquisitions)
-					sort(m_skews.begin(), m_skews.end());
-					m_medianSkew = (m_skews[4] + m_skews[5]) / 2;
+	m_correlations.push_back(result.m_correlation);
+	m_skews.push_back(skew);
+	m_medianSkew = DeskewCorrelator::GetMedianSkew(m_skews, m_skewLow, m_skewHigh);
 
-					m_state = STATE_DONE;
-					return;
-				}
+	//If we just converged, we can stop acquiring. Any acquisition already in progress is discarded.
+	if( (m_state == STATE_ACQUIRE) && IsConverged() )
+		m_state = STATE_CORRELATE;
+}
 
-				//Ready to grab next waveform
-				LogTrace("Acquiring next waveform\n");
-				m_group->Arm(TriggerGroup::TRIGGER_TYPE_SINGLE);
-				m_state = STATE_ACQUIRE;
-			}
-			break;
+/**
+	@brief Checks if the skew estimate is good enough to stop
+ */
+bool ScopeDeskewWizard::IsConverged()
+{
+	if(m_skews.size() < g_minDeskewMeasurements)
+		return false;
+	return (m_skewHigh - m_skewLow) <= 2*m_tolerance;
+}
 
-		case STATE_DONE:
-			{
-				Unit fs(Unit::UNIT_FS);
-				ImGui::TextWrapped("Calculated skew: %s", fs.PrettyPrint(m_medianSkew).c_str());
+/**
+	@brief Makes a private copy of an analog waveform
 
-				if(ImGui::Button("Apply"))
-				{
-					m_session.SetDeskew(m_secondary, m_medianSkew);
-					m_state = STATE_CLOSE;
-				}
-			}
-			break;
+	@return The copy, or null if the waveform is not analog
+ */
+shared_ptr<WaveformBase> ScopeDeskewWizard::CopyWaveform(WaveformBase* wfm)
+{
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
 
-		default:
-			break;
+	shared_ptr<WaveformBase> ret;
+	if(uwfm)
+	{
+		auto copy = make_shared<UniformAnalogWaveform>();
+		uwfm->PrepareForCpuAccess();
+		copy->Resize(uwfm->size());
+		memcpy(copy->m_samples.GetCpuPointer(), uwfm->m_samples.GetCpuPointer(), uwfm->size() * sizeof(float));
+		copy->MarkModifiedFromCpu();
+		ret = copy;
+	}
+	else if(swfm)
+	{
+		auto copy = make_shared<SparseAnalogWaveform>();
+		swfm->PrepareForCpuAccess();
+		size_t len = swfm->size();
+		copy->Resize(len);
+		memcpy(copy->m_offsets.GetCpuPointer(), swfm->m_offsets.GetCpuPointer(), len * sizeof(int64_t));
+		memcpy(copy->m_durations.GetCpuPointer(), swfm->m_durations.GetCpuPointer(), len * sizeof(int64_t));
+		memcpy(copy->m_samples.GetCpuPointer(), swfm->m_samples.GetCpuPointer(), len * sizeof(float));
+		copy->MarkModifiedFromCpu();
+		ret = copy;
 	}
+	else
+		return nullptr;
+
+	ret->m_timescale = wfm->m_timescale;
+	ret->m_triggerPhase = wfm->m_triggerPhase;
+	ret->m_startTimestamp = wfm->m_startTimestamp;
+	ret->m_startFemtoseconds = wfm->m_startFemtoseconds;
+	return ret;
 }
 
-void ScopeDeskewWizard::StartCorrelation()
+/**
+	@brief Correlates one pair of waveforms (runs in a worker thread)
+ */
+DeskewCorrelation ScopeDeskewWizard::DoCorrelation(shared_ptr<WaveformBase> pri, shared_ptr<WaveformBase> sec)
 {
-	auto pri = m_primaryStream.GetData();
-	auto sec = m_secondaryStream.GetData();
-
-	auto upri = dynamic_cast<UniformAnalogWaveform*>(pri);
-	auto usec = dynamic_cast<UniformAnalogWaveform*>(sec);
-
-	auto spri = dynamic_cast<SparseAnalogWaveform*>(pri);
-	auto ssec = dynamic_cast<SparseAnalogWaveform*>(sec);
+	auto upri = dynamic_cast<UniformAnalogWaveform*>(pri.get());
+	auto usec = dynamic_cast<UniformAnalogWaveform*>(sec.get());
 
 	//Optimized path (if both waveforms are dense packed)
-	if(upri && usec)
+	if(upri && usec && m_gpuCorrelationAvailable)
 	{
-		//Fall back to software implementation
-		if(!m_gpuCorrelationAvailable)
-			DoProcessWaveformUniformUnequalRate(upri, usec);
-
 		//If sample rates are equal we can simplify things a lot
-		else if(upri->m_timescale == usec->m_timescale)
+		if(upri->m_timescale == usec->m_timescale)
 			DoProcessWaveformUniformEqualRateVulkan(upri, usec);
 		/*
 		//Also special-case 2:1 sample rate ratio (primary 2x speed of secondary)
@@ -566,99 +710,16 @@ void ScopeDeskewWizard::StartCorrelation()
 		//Unequal sample rates, more math needed
 		else
 			DoProcessWaveformUniformUnequalRateVulkan(upri, usec);
-	}
 
-	//Fallback path (if at least one waveform is not dense packed)
-	else if(spri && ssec)
-		DoProcessWaveformSparse(spri, ssec);
-
-	else
-	{
-		LogError("Mixed sparse and uniform waveforms not implemented\n");
-		return;
+		DeskewCorrelation ret;
+		ret.m_correlation = m_bestCorrelation;
+		ret.m_offset = m_bestCorrelationOffset;
+		return ret;
 	}
 
-	//Collect the skew from this round
-	int64_t skew = m_bestCorrelationOffset * pri->m_timescale;
-	Unit fs(Unit::UNIT_FS);
-	LogTrace("Bxest correlation = %f (delta = %" PRId64 " / %s)\n",
-		m_bestCorrelation, m_bestCorrelationOffset, fs.PrettyPrint(skew).c_str());
-
-	//If we got a correlation of zero (TODO: why would this be?) then retry
-	if(m_bestCorrelation < 1e-8)
-		m_measureCycle --;
+	//FFT path (no int64 shader support, or at least one waveform is not dense packed)
 	else
-	{
-		m_correlations.push_back(m_bestCorrelation);
-		m_skews.push_back(skew);
-	}
-}
-
-void ScopeDeskewWizard::DoProcessWaveformSparse(SparseAnalogWaveform* ppri, SparseAnalogWaveform* psec)
-{
-	shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex());
-
-	//Calculate cross-correlation between the primary and secondary waveforms at up to +/- half the waveform length
-	int64_t len = ppri->size();
-	size_t slen = psec->size();
-
-	std::mutex cmutex;
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Convert delta from samples of the primary waveform to femtoseconds
-		int64_t deltaFs = ppri->m_timescale * d;
-
-		//Loop over samples in the primary waveform
-		//TODO: Can we AVX this?
-		ssize_t samplesProcessed = 0;
-		size_t isecondary = 0;
-		double correlation = 0;
-		for(size_t i=0; i<(size_t)len; i++)
-		{
-			//Timestamp of this sample, in fs
-			int64_t start = ppri->m_offsets[i] * ppri->m_timescale + ppri->m_triggerPhase;
-
-			//Target timestamp in the secondary waveform
-			int64_t target = start + deltaFs;
-
-			//If off the start of the waveform, skip it
-			if(target < 0)
-				continue;
-
-			//Skip secondary samples if the current secondary sample ends before the primary sample starts
-			bool done = false;
-			while( (((psec->m_offsets[isecondary] + psec->m_durations[isecondary]) *
-						psec->m_timescale) + psec->m_triggerPhase) < target)
-			{
-				isecondary ++;
-
-				//If off the end of the waveform, stop
-				if(isecondary >= slen)
-				{
-					done = true;
-					break;
-				}
-			}
-			if(done)
-				break;
-
-			//Do the actual cross-correlation
-			correlation += ppri->m_samples[i] * psec->m_samples[isecondary];
-			samplesProcessed ++;
-		}
-
-		double normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock2(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
+		return DeskewCorrelator::Correlate(pri.get(), sec.get(), m_maxSkewSamples, m_cmdBuf, m_queue);
 }
 
 /*
@@ -766,76 +827,6 @@ void ScopeSyncWizard::DoProcessWaveformDensePackedEqualRateGeneric()
 	}
 }
 */
-void ScopeDeskewWizard::DoProcessWaveformUniformUnequalRate(UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec)
-{
-	shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex());
-
-	double start = GetTime();
-
-	int64_t len = ppri->size();
-	size_t slen = psec->size();
-
-	std::mutex cmutex;
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Convert delta from samples of the primary waveform to femtoseconds
-		int64_t deltaFs = ppri->m_timescale * d;
-
-		//Shift by relative trigger phase
-		deltaFs += (ppri->m_triggerPhase - psec->m_triggerPhase);
-
-		//Loop over samples in the primary waveform
-		ssize_t samplesProcessed = 0;
-		size_t isecondary = 0;
-		double correlation = 0;
-		for(size_t i=0; i<(size_t)len; i++)
-		{
-			//Target timestamp in the secondary waveform
-			int64_t target = i * ppri->m_timescale + deltaFs;
-
-			//If off the start of the waveform, skip it
-			if(target < 0)
-				continue;
-
-			uint64_t utarget = target;
-
-			//Skip secondary samples if the current secondary sample ends before the primary sample starts
-			bool done = false;
-			while( static_cast<uint64_t>((isecondary + 1) *	psec->m_timescale) < utarget)
-			{
-				isecondary ++;
-
-				//If off the end of the waveform, stop
-				if(isecondary >= slen)
-				{
-					done = true;
-					break;
-				}
-			}
-			if(done)
-				break;
-
-			//Do the actual cross-correlation
-			correlation += ppri->m_samples[i] * psec->m_samples[isecondary];
-			samplesProcessed ++;
-		}
-
-		double normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock2(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-
-	double dt = GetTime() - start;
-	LogTrace("Correlation evaluated in %.3f sec\n", dt);
-}
 
 void ScopeDeskewWizard::DoProcessWaveformUniform4xRateVulkan(
 	UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec)
@@ -37,6 +37,9 @@
 
 #include "Dialog.h"
 #include "Session.h"
+#include "DeskewCorrelator.h"
+
+#include <future>
 
 class UniformCrossCorrelateArgs
 {
@@ -69,13 +72,16 @@ public:
 
 protected:
 	void DoMainProcessingFlow();
-	void StartCorrelation();
-	void DoProcessWaveformUniformUnequalRate(UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec);
+	void DoProgressTable();
+	void OnAcquisitionComplete();
+	void OnCorrelationComplete();
+	bool IsConverged();
+	DeskewCorrelation DoCorrelation(std::shared_ptr<WaveformBase> pri, std::shared_ptr<WaveformBase> sec);
+	static std::shared_ptr<WaveformBase> CopyWaveform(WaveformBase* wfm);
 	void DoProcessWaveformUniform4xRateVulkan(UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec);
 	void DoProcessWaveformUniformUnequalRateVulkan(UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec);
 	void DoProcessWaveformUniformEqualRateVulkan(UniformAnalogWaveform* ppri, UniformAnalogWaveform* psec);
 	void PostprocessVulkanCorrelation();
-	void DoProcessWaveformSparse(SparseAnalogWaveform* ppri, SparseAnalogWaveform* psec);
 	void ChannelSelector(const char* name, std::shared_ptr<Oscilloscope> scope, StreamDescriptor& stream);
 
 	enum state_t
@@ -112,6 +118,24 @@ protected:
 	std::vector<float> m_correlations;
 	std::vector<int64_t> m_skews;
 
+	///@brief Stop once the 95% confidence interval on the median skew is within +/- this much
+	int64_t m_tolerance;
+
+	///@brief Text version of m_tolerance for the input box
+	std::string m_toleranceText;
+
+	///@brief Lower bound of the confidence interval on the median skew
+	int64_t m_skewLow;
+
+	///@brief Upper bound of the confidence interval on the median skew
+	int64_t m_skewHigh;
+
+	///@brief Correlation running in the background on the most recent acquisition
+	std::future<DeskewCorrelation> m_correlationFuture;
+
+	///@brief Timescale of the primary waveform being correlated in the background
+	int64_t m_correlationTimescale;
+
 	//Best results found from the current waveform
 	float m_bestCorrelation;
 	int64_t m_bestCorrelationOffset;
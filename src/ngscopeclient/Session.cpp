@@ -49,7 +49,16 @@
 #include "../scopehal/SiglentSCPIOscilloscope.h"
 #include "../scopehal/RigolOscilloscope.h"
 #include "../scopehal/MockOscilloscope.h"
+#include "../scopeprotocols/AverageFilter.h"
+#include "../scopeprotocols/ConstellationFilter.h"
+#include "../scopeprotocols/EnvelopeFilter.h"
 #include "../scopeprotocols/EyePattern.h"
+#include "../scopeprotocols/HistogramFilter.h"
+#include "../scopeprotocols/MaximumFilter.h"
+#include "../scopeprotocols/MemoryFilter.h"
+#include "../scopeprotocols/MinimumFilter.h"
+#include "../scopeprotocols/TrendFilter.h"
+#include "../scopeprotocols/Waterfall.h"
 
 #include <fstream>
 #include <cinttypes>
@@ -78,20 +87,35 @@ using namespace std;
 
 Session::Session(MainWindow* wnd)
 	: m_fileLoadVersion(0)
+	, m_waveformEpoch(0)
 	, m_mainWindow(wnd)
 	, m_shuttingDown(false)
 	, m_modifiedSinceLastSave(false)
+	, m_lastPollDemandUpdate(0)
 	, m_tArm(0)
 	, m_tPrimaryTrigger(0)
 	, m_triggerArmed(false)
 	, m_triggerOneShot(false)
 	, m_graphExecutor(/*8*/1)
 	, m_lastFilterGraphExecTime(0)
+	, m_memoizedPoint(0, 0)
+	, m_memoizedGeneration(0)
+	, m_outputHashGeneration(0)
+	, m_lazyFilterEvaluation(false)
+	, m_skippedFilterCount(0)
+	, m_flowGraphIndexStale(true)
+	, m_flowGraphGeneration(0)
 	, m_history(*this)
 	, m_multiScope(false)
 	, m_nextMarkerNum(1)
+	, m_filterTypeCount(0)
+	, m_filterCategoriesComplete(false)
 {
-	CreateReferenceFilters();
+	//Reference filters aren't created until something needs them, since constructing every filter is slow
+	vector<string> filterNames;
+	Filter::EnumProtocols(filterNames);
+	m_filterTypeCount = filterNames.size();
+	LogDebug("Deferring creation of %zu reference filters until first use\n", m_filterTypeCount);
 
 	SCPIOscilloscope::EnumDrivers(m_driverNamesByType["oscilloscope"]);
 	SCPIPowerSupply::EnumDrivers(m_driverNamesByType["psu"]);
@@ -209,6 +233,7 @@ void Session::Clear()
 	//This ordering is important since waveforms removed from history get pushed into the WaveformPool of the scopes,
 	//so the scopes must not have been destroyed yet.
 	m_history.clear();
+	m_measurementStats.Reset();
 
 	m_oscilloscopes.clear();
 	m_psus.clear();
@@ -237,6 +262,16 @@ void Session::Clear()
 	m_triggerOneShot = false;
 	m_multiScope = false;
 	m_hoverTime = {};
+	InvalidateFlowGraphIndex();
+	m_filterProfiler.Clear();
+	m_filterOutputHashes.clear();
+	m_memoizedFilters.clear();
+	{
+		lock_guard<mutex> lock(m_visibleSinksMutex);
+		m_visibleSinks.clear();
+		m_skippedFilters.clear();
+		m_skippedFilterCount = 0;
+	}
 }
 
 vector<TimePoint> Session::GetMarkerTimes()
@@ -335,18 +370,30 @@ bool Session::LoadFromYaml(const YAML::Node& node, const string& dataDir, bool o
 	LogTrace("Loading saved session from YAML node\n");
 	LogIndenter li;
 
-	if(!LoadInstruments(m_fileLoadVersion, node["instruments"], online))
-		return false;
-	if(!LoadFilters(m_fileLoadVersion, node["decodes"]))
-		return false;
-	if(!LoadInstrumentInputs(m_fileLoadVersion, node["instruments"]))
-		return false;
-	if(!m_mainWindow->LoadUIConfiguration(m_fileLoadVersion, node["ui_config"]))
-		return false;
+	{
+		StartupProfileScope scope("Instruments");
+		if(!LoadInstruments(m_fileLoadVersion, node["instruments"], online))
+			return false;
+	}
+	{
+		StartupProfileScope scope("Filters");
+		if(!LoadFilters(m_fileLoadVersion, node["decodes"]))
+			return false;
+		if(!LoadInstrumentInputs(m_fileLoadVersion, node["instruments"]))
+			return false;
+	}
+	{
+		StartupProfileScope scope("UI configuration");
+		if(!m_mainWindow->LoadUIConfiguration(m_fileLoadVersion, node["ui_config"]))
+			return false;
+	}
 	if(!LoadTriggerGroups(node["triggergroups"]))
 		return false;
-	if(!LoadWaveformData(m_fileLoadVersion, dataDir))
-		return false;
+	{
+		StartupProfileScope scope("Waveform data");
+		if(!LoadWaveformData(m_fileLoadVersion, dataDir))
+			return false;
+	}
 
 	//Markers
 	auto markers = node["ui_config"]["markers"];
@@ -1826,6 +1873,14 @@ bool Session::LoadTriggerGroups(const YAML::Node& node)
 		//Make all non-filter groups default
 		else
 			group->m_default = group->HasScopes();
+
+		//Backpressure settings (older files don't have them, keep defaults)
+		auto pnode = gnode["acquisitionpolicy"];
+		if(pnode)
+			group->SetAcquisitionPolicy(TriggerGroup::GetPolicyByName(pnode.as<string>()));
+		auto bnode = gnode["maxpendingbytes"];
+		if(bnode)
+			group->SetMaxPendingBytes(bnode.as<int64_t>());
 	}
 
 	//Check all pausable filters and see if they are in a group
@@ -1938,6 +1993,7 @@ bool Session::LoadFilters(int /*version*/, const YAML::Node& node)
 			filter->LoadInputs(dnode, m_idtable);
 	}
 
+	InvalidateFlowGraphIndex();
 	return true;
 }
 
@@ -1970,6 +2026,7 @@ bool Session::LoadInstrumentInputs(int /*version*/, const YAML::Node& node)
 		}
 	}
 
+	InvalidateFlowGraphIndex();
 	return true;
 }
 
@@ -2074,6 +2131,8 @@ YAML::Node Session::SerializeTriggerGroups()
 		node[string("group") + to_string(gid)] = gnode;
 
 		gnode["default"] = group->m_default;
+		gnode["acquisitionpolicy"] = TriggerGroup::GetPolicyName(group->GetAcquisitionPolicy());
+		gnode["maxpendingbytes"] = group->GetMaxPendingBytes();
 	}
 
 	return node;
@@ -2597,6 +2656,49 @@ bool Session::IsSecondaryOfMultiScopeGroup(shared_ptr<Oscilloscope> scope)
 	return false;
 }
 
+/**
+	@brief Gets the queue used to run driver calls for an instrument in its own thread
+
+	Only call from the GUI thread (the list of connected instruments is not otherwise locked).
+
+	@return The queue, or nullptr if the instrument doesn't have a polling thread
+ */
+shared_ptr<InstrumentCommandQueue> Session::GetInstrumentCommandQueue(shared_ptr<Instrument> inst)
+{
+	auto it = m_instrumentStates.find(inst);
+	if(it == m_instrumentStates.end())
+		return nullptr;
+	return it->second->m_commandQueue;
+}
+
+/**
+	@brief Gets the scheduler controlling how often an instrument's thread polls it
+
+	Only call from the GUI thread.
+
+	@return The scheduler, or nullptr if the instrument doesn't have a polling thread
+ */
+shared_ptr<PollScheduler> Session::GetPollScheduler(shared_ptr<Instrument> inst)
+{
+	auto it = m_instrumentStates.find(inst);
+	if(it == m_instrumentStates.end())
+		return nullptr;
+	return it->second->m_pollScheduler;
+}
+
+/**
+	@brief Gets every instrument which has a polling thread
+
+	Only call from the GUI thread.
+ */
+vector<shared_ptr<Instrument> > Session::GetPolledInstruments()
+{
+	vector<shared_ptr<Instrument> > ret;
+	for(auto& it : m_instrumentStates)
+		ret.push_back(it.first);
+	return ret;
+}
+
 /**
 	@brief Gets the trigger group that contains a specified scope
  */
@@ -2767,6 +2869,7 @@ void Session::CreateAndAddInstrument(const string& driver, SCPITransport* transp
 void Session::AddInstrument(shared_ptr<Instrument> inst, bool createDialogs)
 {
 	m_modifiedSinceLastSave = true;
+	InvalidateFlowGraphIndex();
 
 	lock_guard<mutex> lock(m_scopeMutex);
 
@@ -2785,18 +2888,36 @@ void Session::AddInstrument(shared_ptr<Instrument> inst, bool createDialogs)
 	if(psu && (types & Instrument::INST_PSU) )
 	{
 		auto state = make_shared<PowerSupplyState>(psu->GetChannelCount());
+		for(size_t i=0; i<psu->GetChannelCount(); i++)
+		{
+			auto name = psu->GetChannel(i)->GetDisplayName();
+			state->m_voltageHistory.push_back(
+				state->m_telemetry->AddSeries(name + " voltage", Unit(Unit::UNIT_VOLTS)));
+			state->m_currentHistory.push_back(
+				state->m_telemetry->AddSeries(name + " current", Unit(Unit::UNIT_AMPS)));
+		}
 		m_psus[psu] = state;
 		args.psustate = state;
 	}
 	if(meter && (types & Instrument::INST_DMM) )
 	{
 		auto state = make_shared<MultimeterState>();
+		state->m_primaryHistory = state->m_telemetry->AddSeries("Primary", meter->GetMeterUnit());
+		state->m_secondaryHistory = state->m_telemetry->AddSeries("Secondary", meter->GetSecondaryMeterUnit());
 		m_meters[meter] = state;
 		args.meterstate = state;
 	}
 	if(load && (types & Instrument::INST_LOAD) )
 	{
 		auto state = make_shared<LoadState>(load->GetChannelCount());
+		for(size_t i=0; i<load->GetChannelCount(); i++)
+		{
+			auto name = load->GetChannel(i)->GetDisplayName();
+			state->m_voltageHistory.push_back(
+				state->m_telemetry->AddSeries(name + " voltage", Unit(Unit::UNIT_VOLTS)));
+			state->m_currentHistory.push_back(
+				state->m_telemetry->AddSeries(name + " current", Unit(Unit::UNIT_AMPS)));
+		}
 		m_loads[load] = state;
 		args.loadstate = state;
 	}
@@ -2856,6 +2977,7 @@ void Session::AddInstrument(shared_ptr<Instrument> inst, bool createDialogs)
 void Session::RemoveInstrument(shared_ptr<Instrument> inst)
 {
 	m_modifiedSinceLastSave = true;
+	InvalidateFlowGraphIndex();
 
 	//Remove instrument-specific state
 	auto psu = dynamic_pointer_cast<SCPIPowerSupply>(inst);
@@ -3083,10 +3205,11 @@ void Session::DownloadWaveforms()
 	//Get the data from each  trigger group
 	for(auto group : m_triggerGroups)
 	{
-		if(!group->CheckForPendingWaveforms())
+		if(!group->DownloadWaveforms())
 			continue;
 
-		group->DownloadWaveforms();
+		//New data replaces whatever history point was loaded, so outputs restored from it are no longer current
+		ClearMemoizedFilters();
 
 		//This scope has recently triggered and should be added to history
 		{
@@ -3134,6 +3257,9 @@ bool Session::CheckForWaveforms(vk::raii::CommandBuffer& cmdbuf)
 			m_recentlyTriggeredGroups.clear();
 
 			m_history.AddHistory(scopes);
+
+			//Filters have already run on the new data, so scalar measurements are current
+			m_measurementStats.Record(m_history.GetMostRecentPoint());
 		}
 
 		//Tone-map all of our waveforms
@@ -3199,6 +3325,79 @@ void Session::RefreshDirtyFiltersNonblocking()
 	g_partialRefilterRequestedEvent.Signal();
 }
 
+/**
+	@brief Tells each instrument's poll scheduler whether anything besides its dialog needs its data
+
+	An instrument is in demand if a filter (including trend filters) takes one of its channels as input, one of
+	its channels is displayed somewhere, or its telemetry is being logged to disk.
+
+	Called once per frame from the GUI thread. Walking the filter graph isn't free, so this only does anything a
+	few times a second.
+ */
+void Session::UpdatePollDemand()
+{
+	double now = GetTime();
+	if( (now - m_lastPollDemandUpdate) < 0.25)
+		return;
+	m_lastPollDemandUpdate = now;
+
+	//Find every channel feeding a filter or being displayed
+	set<InstrumentChannel*> consumed;
+	{
+		lock_guard<mutex> lock(m_filterUpdatingMutex);
+		auto filters = Filter::GetAllInstances();
+		for(auto f : filters)
+		{
+			for(size_t i=0; i<f->GetInputCount(); i++)
+			{
+				auto chan = f->GetInput(i).m_channel;
+				if(chan)
+					consumed.emplace(chan);
+			}
+		}
+	}
+	{
+		lock_guard<mutex> lock(m_visibleSinksMutex);
+		for(auto node : m_visibleSinks)
+		{
+			auto chan = dynamic_cast<InstrumentChannel*>(node);
+			if(chan)
+				consumed.emplace(chan);
+		}
+	}
+
+	//Logging to disk needs full rate data
+	set<Instrument*> logging;
+	{
+		lock_guard<mutex> lock(m_scopeMutex);
+		for(auto& it : m_psus)
+		{
+			if(it.second->m_telemetry->IsLogging())
+				logging.emplace(it.first.get());
+		}
+		for(auto& it : m_meters)
+		{
+			if(it.second->m_telemetry->IsLogging())
+				logging.emplace(it.first.get());
+		}
+		for(auto& it : m_loads)
+		{
+			if(it.second->m_telemetry->IsLogging())
+				logging.emplace(it.first.get());
+		}
+	}
+
+	for(auto& it : m_instrumentStates)
+	{
+		auto inst = it.first;
+		bool inUse = (logging.find(inst.get()) != logging.end());
+		for(size_t i=0; (i<inst->GetChannelCount()) && !inUse; i++)
+			inUse = (consumed.find(inst->GetChannel(i)) != consumed.end());
+
+		it.second->m_pollScheduler->SetConsumed(inUse);
+	}
+}
+
 /**
 	@brief Gets all of our graph nodes (filters plus instrument channels)
  */
@@ -3224,23 +3423,275 @@ set<FlowGraphNode*> Session::GetAllGraphNodes()
 	return nodes;
 }
 
-void Session::RefreshAllFilters()
+/**
+	@brief Refresh all filters
+
+	@param allFilters	True to run every filter even if demand-driven evaluation would skip it
+ */
+void Session::RefreshAllFilters(bool allFilters)
 {
 	double tstart = GetTime();
 
 	auto nodes = GetAllGraphNodes();
 
+	//In demand-driven mode, only run what's needed for the outputs we can see
+	{
+		lock_guard<mutex> lock(m_visibleSinksMutex);
+		m_skippedFilters.clear();
+		if(m_lazyFilterEvaluation && !allFilters)
+		{
+			auto visible = GetVisibleFilterCone(nodes);
+			for(auto node : nodes)
+			{
+				if(dynamic_cast<Filter*>(node) && (visible.find(node) == visible.end()))
+					m_skippedFilters.emplace(node);
+			}
+			nodes = visible;
+		}
+		m_skippedFilterCount = m_skippedFilters.size();
+	}
+
 	{
 		//Must lock mutexes in this order to avoid deadlock
 		lock_guard<shared_mutex> lock(m_waveformDataMutex);
 		//shared_lock<shared_mutex> lock3(g_vulkanActivityMutex);
-		m_graphExecutor.RunBlocking(nodes);
+		BeginWaveformEpoch();
+		RunFilterGraph(nodes);
 		UpdatePacketManagers(nodes);
+		PublishWaveformEpoch();
 	}
 
 	m_lastFilterGraphExecTime = (GetTime() - tstart) * FS_PER_SECOND;
 }
 
+/**
+	@brief Executes a set of filter graph nodes, profiling each one if the profiler is enabled
+
+	Must be called with the waveform data mutex held.
+ */
+void Session::RunFilterGraph(const set<FlowGraphNode*>& nodes)
+{
+	//Forget the last run's configuration of any filter which has since been deleted, so a new filter allocated at
+	//the same address can't inherit it
+	uint64_t generation = m_flowGraphGeneration;
+	bool pruneHashes = (m_outputHashGeneration != generation);
+	set<Filter*> filters;
+	if(pruneHashes || !m_memoizedFilters.empty())
+		filters = Filter::GetAllInstances();
+	if(pruneHashes)
+	{
+		for(auto it = m_filterOutputHashes.begin(); it != m_filterOutputHashes.end(); )
+		{
+			if(filters.find(it->first) == filters.end())
+				it = m_filterOutputHashes.erase(it);
+			else
+				it++;
+		}
+		m_outputHashGeneration = generation;
+	}
+
+	//Skip filters whose outputs were just restored from history, unless they've been reconfigured since.
+	//Restored outputs only stand in for the first run after the point was loaded. Filters not in that run (skipped
+	//as hidden, or outside a partial refresh) compute their outputs normally next time, since by then the session
+	//may have moved on to new data. If the graph has changed at all since the point was loaded, don't trust any of
+	//them: the filters may be gone.
+	set<FlowGraphNode*> memoNodes;
+	const set<FlowGraphNode*>* pnodes = &nodes;
+	if(!m_memoizedFilters.empty())
+	{
+		if(m_memoizedGeneration == generation)
+		{
+			memoNodes = nodes;
+			for(auto it : m_memoizedFilters)
+			{
+				if( (filters.find(it.first) == filters.end()) || (nodes.find(it.first) == nodes.end()) )
+					continue;
+				if(HistoryManager::GetFilterConfigHash(it.first) == it.second)
+					memoNodes.erase(it.first);
+			}
+
+			LogTrace("Skipping %zu memoized filters from %s\n",
+				nodes.size() - memoNodes.size(), m_memoizedPoint.PrettyPrint().c_str());
+			pnodes = &memoNodes;
+		}
+		m_memoizedFilters.clear();
+	}
+
+	if(m_filterProfiler.IsEnabled())
+		m_filterProfiler.Run(m_graphExecutor, *pnodes);
+	else
+		m_graphExecutor.RunBlocking(*pnodes);
+
+	//Remember which configuration the outputs were computed with, so they can be saved in history later
+	for(auto node : *pnodes)
+	{
+		auto f = dynamic_cast<Filter*>(node);
+		if(f && HistoryManager::IsMemoizable(f))
+			m_filterOutputHashes[f] = HistoryManager::GetFilterConfigHash(f);
+	}
+}
+
+/**
+	@brief Checks if a filter accumulates state across waveforms
+
+	The output of these filters depends on every waveform they've seen so far (or, for memories, on when the user
+	last saved one), not just the current inputs. They have to see every run and an old output can't stand in for
+	a new one.
+ */
+bool Session::IsStatefulFilter(Filter* f)
+{
+	return
+		dynamic_cast<EyePattern*>(f) ||
+		dynamic_cast<ConstellationFilter*>(f) ||
+		dynamic_cast<Waterfall*>(f) ||
+		dynamic_cast<HistogramFilter*>(f) ||
+		dynamic_cast<AverageFilter*>(f) ||
+		dynamic_cast<EnvelopeFilter*>(f) ||
+		dynamic_cast<MaximumFilter*>(f) ||
+		dynamic_cast<MinimumFilter*>(f) ||
+		dynamic_cast<MemoryFilter*>(f) ||
+		dynamic_cast<TrendFilter*>(f);
+}
+
+/**
+	@brief Finds the graph nodes needed to produce everything currently visible
+
+	Must be called with m_visibleSinksMutex held.
+
+	@param nodes	All nodes in the graph
+
+	@return Every visible sink plus its upstream cone. Nodes with side effects (protocol decoders, which feed the
+			packet history; export filters; instrument channels with inputs, such as BERT or function generator
+			outputs driven from a filter) are always treated as visible. So are stateful filters, since skipping a
+			waveform would leave a gap in what they accumulate, and anything feeding a scope's trigger.
+ */
+set<FlowGraphNode*> Session::GetVisibleFilterCone(const set<FlowGraphNode*>& nodes)
+{
+	set<FlowGraphNode*> sinks = m_visibleSinks;
+	for(auto node : nodes)
+	{
+		if(dynamic_cast<PacketDecoder*>(node) || dynamic_cast<ExportFilter*>(node))
+			sinks.emplace(node);
+		else if(IsStatefulFilter(dynamic_cast<Filter*>(node)))
+			sinks.emplace(node);
+		else if(!dynamic_cast<Filter*>(node) && (node->GetInputCount() != 0))
+			sinks.emplace(node);
+	}
+
+	//Triggers aren't evaluated as part of the graph, but whatever they're watching has to be
+	vector<FlowGraphNode*> consumers;
+	for(auto scope : GetScopes())
+	{
+		auto trig = scope->GetTrigger();
+		if(trig)
+			consumers.push_back(trig);
+	}
+
+	return FlowGraphIndex::GetUpstreamCone(nodes, sinks, consumers);
+}
+
+/**
+	@brief Updates the set of graph nodes whose outputs are displayed, for demand-driven filter evaluation
+
+	If a filter skipped by the last refresh just became visible (or lazy evaluation was turned off), its outputs are
+	stale, so request a refresh to compute them.
+
+	@param sinks	Nodes whose outputs are displayed
+	@param lazy		True to skip filters not feeding anything in sinks
+ */
+void Session::SetVisibleSinks(const set<FlowGraphNode*>& sinks, bool lazy)
+{
+	bool refresh = false;
+	{
+		lock_guard<mutex> lock(m_visibleSinksMutex);
+		if( (lazy == m_lazyFilterEvaluation) && (sinks == m_visibleSinks) )
+			return;
+
+		m_lazyFilterEvaluation = lazy;
+		m_visibleSinks = sinks;
+
+		if(!m_skippedFilters.empty())
+		{
+			if(!lazy)
+				refresh = true;
+			for(auto s : sinks)
+			{
+				if(m_skippedFilters.find(s) != m_skippedFilters.end())
+				{
+					refresh = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if(refresh)
+		RefreshAllFiltersNonblocking();
+}
+
+/**
+	@brief Gets the configuration hash a filter's current outputs were computed with
+
+	Must be called with the waveform data mutex held.
+
+	@return False if the filter hasn't been run since the session was loaded
+ */
+bool Session::GetFilterOutputHash(Filter* f, uint64_t& hash)
+{
+	auto it = m_filterOutputHashes.find(f);
+	if(it == m_filterOutputHashes.end())
+		return false;
+	hash = it->second;
+	return true;
+}
+
+/**
+	@brief Tells the next filter graph run that these filters' outputs were restored from history and are up to date
+
+	Must be called with the waveform data mutex held.
+
+	@param t		The history point which was just loaded
+	@param filters	Filters whose outputs were restored, and the configuration hash they were computed with
+ */
+void Session::SetMemoizedFilters(TimePoint t, const map<Filter*, uint64_t>& filters)
+{
+	m_memoizedFilters = filters;
+	m_memoizedPoint = t;
+	m_memoizedGeneration = m_flowGraphGeneration;
+	for(auto it : filters)
+		m_filterOutputHashes[it.first] = it.second;
+}
+
+/**
+	@brief Forgets any restored filter outputs, because the session has moved off the history point they came from
+
+	Must be called with the waveform data mutex held.
+ */
+void Session::ClearMemoizedFilters()
+{
+	m_memoizedFilters.clear();
+}
+
+/**
+	@brief Marks the start of a new waveform data epoch
+
+	Must be called with the waveform data mutex held exclusively, so epochs from different threads never interleave.
+ */
+void Session::BeginWaveformEpoch()
+{
+	m_waveformEpoch ++;
+}
+
+/**
+	@brief Publishes the waveform data epoch started by BeginWaveformEpoch()
+
+	Must be called before releasing the waveform data mutex.
+ */
+void Session::PublishWaveformEpoch()
+{
+	m_waveformEpoch ++;
+}
+
 /**
 	@brief Refresh dirty filters (and anything in their downstream influence cone)
 
@@ -3249,21 +3700,22 @@ void Session::RefreshAllFilters()
 bool Session::RefreshDirtyFilters()
 {
 	set<FlowGraphNode*> nodesToUpdate;
+	map<Filter*, pair<size_t, size_t> > resizes;
 
 	{
 		lock_guard<mutex> lock(m_dirtyChannelsMutex);
 		if(m_dirtyChannels.empty())
 			return false;
 
-		//Start with all nodes
-		auto nodes = GetAllGraphNodes();
+		resizes.swap(m_pendingFilterResizes);
 
-		//Check each one to see if it needs updating
-		for(auto f : nodes)
-		{
-			if(f->IsDownstreamOf(m_dirtyChannels))
-				nodesToUpdate.emplace(f);
-		}
+		//Rebuild the graph index if anything changed shape since last time
+		auto nfilters = Filter::GetNumInstances();
+		if(m_flowGraphIndexStale.exchange(false) || !m_flowGraphIndex.IsValid(nfilters))
+			m_flowGraphIndex.Rebuild(GetAllGraphNodes(), nfilters);
+
+		//Everything downstream of a dirty node needs updating
+		m_flowGraphIndex.GetDownstreamCone(m_dirtyChannels, nodesToUpdate);
 
 		//The filter itself needs to be updated too
 		for(auto node : m_dirtyChannels)
@@ -3286,8 +3738,11 @@ bool Session::RefreshDirtyFilters()
 		//Must lock mutexes in this order to avoid deadlock
 		lock_guard<shared_mutex> lock(m_waveformDataMutex);
 		shared_lock<shared_mutex> lock3(g_vulkanActivityMutex);
-		m_graphExecutor.RunBlocking(nodesToUpdate);
+		BeginWaveformEpoch();
+		ApplyPendingFilterResizes(resizes);
+		RunFilterGraph(nodesToUpdate);
 		UpdatePacketManagers(nodesToUpdate);
+		PublishWaveformEpoch();
 	}
 
 	m_lastFilterGraphExecTime = (GetTime() - tstart) * FS_PER_SECOND;
@@ -3295,6 +3750,57 @@ bool Session::RefreshDirtyFilters()
 	return true;
 }
 
+/**
+	@brief Applies output resolution changes queued by QueueFilterResize()
+
+	Must be called from the waveform thread with the waveform data mutex held exclusively, so that nothing is reading
+	the old filter output while it's being reallocated.
+
+	@param resizes	Map of filters to new (width, height)
+ */
+void Session::ApplyPendingFilterResizes(map<Filter*, pair<size_t, size_t> >& resizes)
+{
+	if(resizes.empty())
+		return;
+
+	//The filter may have been deleted (if the view was closed) since the resize was requested
+	auto filters = Filter::GetAllInstances();
+
+	for(auto it : resizes)
+	{
+		if(filters.find(it.first) == filters.end())
+			continue;
+
+		auto waterfall = dynamic_cast<Waterfall*>(it.first);
+		auto constellation = dynamic_cast<ConstellationFilter*>(it.first);
+
+		if(waterfall)
+		{
+			LogTrace("Resizing waterfall %s to height %zu\n", waterfall->GetDisplayName().c_str(), it.second.second);
+			waterfall->SetHeight(it.second.second);
+		}
+		else if(constellation)
+		{
+			LogTrace("Resizing constellation %s to %zu x %zu\n",
+				constellation->GetDisplayName().c_str(), it.second.first, it.second.second);
+			constellation->SetWidth(it.second.first);
+			constellation->SetHeight(it.second.second);
+		}
+	}
+}
+
+/**
+	@brief Flags the cached filter graph topology as stale
+
+	Must be called after anything that changes the shape of the graph: connecting or disconnecting filter inputs,
+	creating or deleting filters, or adding or removing instruments.
+ */
+void Session::InvalidateFlowGraphIndex()
+{
+	m_flowGraphIndexStale = true;
+	m_flowGraphGeneration ++;
+}
+
 /**
 	@brief Flags a single channel as dirty (updated outside of a global trigger event)
  */
@@ -3304,6 +3810,27 @@ void Session::MarkChannelDirty(InstrumentChannel* chan)
 	m_dirtyChannels.emplace(chan);
 }
 
+/**
+	@brief Requests a change to the output resolution of a waterfall or constellation filter
+
+	The resize is applied by the waveform thread at the start of the next partial refresh, immediately before the
+	filter is re-run. Repeated requests for the same filter before then are coalesced, and only the last one is used.
+
+	@param f		The filter to resize
+	@param width	New output width, in pixels (ignored for waterfalls)
+	@param height	New output height, in pixels
+ */
+void Session::QueueFilterResize(Filter* f, size_t width, size_t height)
+{
+	{
+		lock_guard<mutex> lock(m_dirtyChannelsMutex);
+		m_pendingFilterResizes[f] = pair<size_t, size_t>(width, height);
+		m_dirtyChannels.emplace(f);
+	}
+
+	g_partialRefilterRequestedEvent.Signal();
+}
+
 /**
 	@brief Clear state on all of our filters
  */
@@ -3378,6 +3905,24 @@ int64_t Session::GetToneMapTime()
 	return m_mainWindow->GetToneMapTime();
 }
 
+/**
+	@brief Gets a percentile of recent GUI thread frame times
+
+	@param percentile	Percentile to look up, 0 to 100
+ */
+int64_t Session::GetFrameTimePercentile(float percentile)
+{
+	return m_mainWindow->GetFrameTimePercentile(percentile);
+}
+
+/**
+	@brief Gets the number of frames the GUI thread drew from the last published waveforms during a graph run
+ */
+uint64_t Session::GetStaleFrameCount()
+{
+	return m_mainWindow->GetStaleFrameCount();
+}
+
 void Session::RenderWaveformTextures(vk::raii::CommandBuffer& cmdbuf, vector<shared_ptr<DisplayedChannel> >& channels)
 {
 	m_mainWindow->RenderWaveformTextures(cmdbuf, channels);
@@ -3387,23 +3932,118 @@ void Session::RenderWaveformTextures(vk::raii::CommandBuffer& cmdbuf, vector<sha
 // Reference filters
 
 /**
-	@brief Creates one filter of each known type to use as a reference for what inputs are legal to use to a new filter
+	@brief Gets the reference instance of a given filter, creating it if necessary
+
+	Safe to call from any thread.
+
+	@return The filter, or nullptr if there's no filter type by that name
+ */
+Filter* Session::GetReferenceFilter(const string& name)
+{
+	lock_guard<mutex> lock(m_referenceFilterMutex);
+
+	auto it = m_referenceFilters.find(name);
+	if(it != m_referenceFilters.end())
+		return it->second;
+
+	double start = GetTime();
+	auto f = Filter::CreateFilter(name.c_str(), "");
+	if(!f)
+		return nullptr;
+	f->HideFromList();
+	m_referenceFilters[name] = f;
+
+	LogTrace("Created reference filter \"%s\" in %.2f ms (%zu of %zu types now resident)\n",
+		name.c_str(), (GetTime() - start) * 1000, m_referenceFilters.size(), m_filterTypeCount);
+	return f;
+}
+
+/**
+	@brief Gets the category of every filter type, without keeping a reference filter for each one
+
+	A filter's category is only available from an instance of it, so the first time a type is seen, one is created
+	just long enough to ask. The results are cached in the config directory, so later runs only construct types
+	which are new since the cache was written. Menus can then list every type, and only create reference filters
+	for the entries they actually show.
+
+	The returned map is never modified once this has been called, so it's safe to iterate from any thread.
  */
-void Session::CreateReferenceFilters()
+const map<string, Filter::Category>& Session::GetFilterCategories()
 {
+	lock_guard<mutex> lock(m_referenceFilterMutex);
+	if(m_filterCategoriesComplete)
+		return m_filterCategories;
+
+	StartupProfileScope scope("Index filter categories");
 	double start = GetTime();
 
+	//Load the cache, ignoring it if it was written by a build with a different set of categories
+	auto path = m_preferences.GetConfigDirectory() + "/filtercategories.yml";
+	map<string, Filter::Category> cached;
+	try
+	{
+		auto docs = YAML::LoadAllFromFile(path);
+		if(!docs.empty() && (docs[0]["categorycount"].as<int>() == Filter::CAT_COUNT) )
+		{
+			for(auto it : docs[0]["filters"])
+				cached[it.first.as<string>()] = static_cast<Filter::Category>(it.second.as<int>());
+		}
+	}
+	catch(const YAML::Exception& ex)
+	{
+		LogDebug("No usable filter category cache (%s)\n", ex.what());
+	}
+
 	vector<string> names;
 	Filter::EnumProtocols(names);
+	size_t probed = 0;
+	for(auto& n : names)
+	{
+		auto it = cached.find(n);
+		if(it != cached.end())
+		{
+			m_filterCategories[n] = it->second;
+			continue;
+		}
 
-	for(auto n : names)
+		//Use the reference filter if we already have one, otherwise make a throwaway instance
+		auto rit = m_referenceFilters.find(n);
+		if(rit != m_referenceFilters.end())
+			m_filterCategories[n] = rit->second->GetCategory();
+		else
+		{
+			auto f = Filter::CreateFilter(n.c_str(), "");
+			if(!f)
+				continue;
+			f->HideFromList();
+			m_filterCategories[n] = f->GetCategory();
+			delete f;
+		}
+		probed ++;
+	}
+	m_filterCategoriesComplete = true;
+
+	//Save the cache if we learned anything new
+	if(probed)
 	{
-		auto f = Filter::CreateFilter(n.c_str(), "");;
-		f->HideFromList();
-		m_referenceFilters[n] = f;
+		FILE* fp = fopen(path.c_str(), "w");
+		if(fp)
+		{
+			fprintf(fp, "categorycount: %d\n", static_cast<int>(Filter::CAT_COUNT));
+			fprintf(fp, "filters:\n");
+			for(auto& it : m_filterCategories)
+				fprintf(fp, "    \"%s\": %d\n", it.first.c_str(), static_cast<int>(it.second));
+			fclose(fp);
+		}
+		else
+			LogWarning("Unable to write filter category cache %s\n", path.c_str());
 	}
 
-	LogTrace("Created %zu reference filters in %.2f ms\n", m_referenceFilters.size(), (GetTime() - start) * 1000);
+	LogDebug("Indexed %zu filter categories (%zu cached, %zu constructed) in %.2f ms, %zu reference filters resident\n",
+		m_filterCategories.size(), m_filterCategories.size() - probed, probed, (GetTime() - start) * 1000,
+		m_referenceFilters.size());
+
+	return m_filterCategories;
 }
 
 /**
@@ -3414,6 +4054,7 @@ void Session::CreateReferenceFilters()
  */
 void Session::DestroyReferenceFilters()
 {
+	lock_guard<mutex> lock(m_referenceFilterMutex);
 	for(auto it : m_referenceFilters)
 		delete it.second;
 	m_referenceFilters.clear();
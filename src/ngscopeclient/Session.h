@@ -40,7 +40,11 @@ class WaveformArea;
 class DisplayedChannel;
 
 #include "../xptools/HzClock.h"
+#include "ComputePipelineRegistry.h"
+#include "FilterProfiler.h"
+#include "FlowGraphIndex.h"
 #include "HistoryManager.h"
+#include "MeasurementStatistics.h"
 #include "PacketManager.h"
 #include "PreferenceManager.h"
 #include "Marker.h"
@@ -56,7 +60,16 @@ public:
 	InstrumentConnectionState(InstrumentThreadArgs args)
 	{
 		m_shuttingDown = false;
+		m_commandQueue = std::make_shared<InstrumentCommandQueue>();
+
+		//PSU, DMM, and load readings are polled at up to 100 Hz, everything else at 10 Hz. Idle instruments at 1 Hz.
+		bool telemetry = args.psustate || args.meterstate || args.loadstate;
+		m_pollScheduler = std::make_shared<PollScheduler>(
+			telemetry ? (1.0 / TelemetryRecorder::MAX_SAMPLE_RATE) : 0.1, 1.0);
+
 		args.shuttingDown = &m_shuttingDown;
+		args.cmdqueue = m_commandQueue;
+		args.scheduler = m_pollScheduler;
 		m_thread = std::make_unique<std::thread>(InstrumentThread, args);
 	}
 
@@ -79,6 +92,12 @@ public:
 
 	///@brief Thread for polling the instrument
 	std::unique_ptr<std::thread> m_thread;
+
+	///@brief Driver calls waiting to be run by m_thread
+	std::shared_ptr<InstrumentCommandQueue> m_commandQueue;
+
+	///@brief Poll rate control for m_thread
+	std::shared_ptr<PollScheduler> m_pollScheduler;
 };
 
 /**
@@ -98,13 +117,30 @@ public:
 	bool HasOnlineScopes();
 	void DownloadWaveforms();
 	bool CheckForWaveforms(vk::raii::CommandBuffer& cmdbuf);
-	void RefreshAllFilters();
+	void RefreshAllFilters(bool allFilters = false);
 	void RefreshAllFiltersNonblocking();
 	void RefreshDirtyFiltersNonblocking();
+	void UpdatePollDemand();
 	bool RefreshDirtyFilters();
 	void FlushConfigCache();
 
 	void MarkChannelDirty(InstrumentChannel* chan);
+	void QueueFilterResize(Filter* f, size_t width, size_t height);
+	void InvalidateFlowGraphIndex();
+
+	void SetVisibleSinks(const std::set<FlowGraphNode*>& sinks, bool lazy);
+
+	static bool IsStatefulFilter(Filter* f);
+
+	/**
+		@brief Gets the number of filters skipped by the last full filter graph refresh
+	 */
+	size_t GetSkippedFilterCount()
+	{ return m_skippedFilterCount.load(); }
+
+	bool GetFilterOutputHash(Filter* f, uint64_t& hash);
+	void SetMemoizedFilters(TimePoint t, const std::map<Filter*, uint64_t>& filters);
+	void ClearMemoizedFilters();
 
 	void RenderWaveformTextures(
 		vk::raii::CommandBuffer& cmdbuf,
@@ -168,6 +204,8 @@ public:
 	bool IsChannelBeingDragged();
 
 	int64_t GetToneMapTime();
+	int64_t GetFrameTimePercentile(float percentile);
+	uint64_t GetStaleFrameCount();
 
 	/**
 		@brief Gets the last execution time of the filter graph
@@ -175,6 +213,12 @@ public:
 	int64_t GetFilterGraphExecTime()
 	{ return m_lastFilterGraphExecTime.load(); }
 
+	/**
+		@brief Gets the per-filter execution profiler
+	 */
+	FilterProfiler& GetFilterProfiler()
+	{ return m_filterProfiler; }
+
 	/**
 		@brief Gets the last run time of the waveform rendering shaders
 	 */
@@ -238,12 +282,45 @@ public:
 	std::shared_mutex& GetWaveformDataMutex()
 	{ return m_waveformDataMutex; }
 
+	/**
+		@brief Gets the current waveform data epoch
+
+		The epoch is odd while the filter graph is rewriting its outputs under the waveform data mutex, and even
+		once the new outputs have been published.
+
+		There is only one copy of the waveform data, so the epoch doesn't make it safe to read without the mutex.
+		It lets the renderer tell a long filter graph run apart from a brief lock by someone else, and fall back to
+		the last tone mapped textures instead of waiting.
+	 */
+	uint64_t GetWaveformEpoch()
+	{ return m_waveformEpoch.load(); }
+
+	/**
+		@brief Check if the filter graph is currently rewriting its outputs
+
+		Anything taking the waveform data mutex now will block until the new epoch is published.
+	 */
+	bool IsWaveformEpochInProgress()
+	{ return (m_waveformEpoch.load() & 1) != 0; }
+
 	/**
 		@brief Get our history manager
 	 */
 	HistoryManager& GetHistory()
 	{ return m_history; }
 
+	/**
+		@brief Get the registry of shared compute pipelines for waveform rendering
+	 */
+	ComputePipelineRegistry& GetPipelineRegistry()
+	{ return m_pipelineRegistry; }
+
+	/**
+		@brief Get statistics for scalar measurements
+	 */
+	MeasurementStatistics& GetMeasurementStatistics()
+	{ return m_measurementStats; }
+
 	/**
 		@brief Adds a marker
 	 */
@@ -294,6 +371,10 @@ public:
 	bool IsPrimaryOfMultiScopeGroup(std::shared_ptr<Oscilloscope> scope);
 	bool IsSecondaryOfMultiScopeGroup(std::shared_ptr<Oscilloscope> scope);
 
+	std::shared_ptr<InstrumentCommandQueue> GetInstrumentCommandQueue(std::shared_ptr<Instrument> inst);
+	std::shared_ptr<PollScheduler> GetPollScheduler(std::shared_ptr<Instrument> inst);
+	std::vector<std::shared_ptr<Instrument> > GetPolledInstruments();
+
 	std::shared_ptr<TriggerGroup> GetTriggerGroupForScope(std::shared_ptr<Oscilloscope> scope);
 	std::shared_ptr<TriggerGroup> GetTriggerGroupForFilter(PausableFilter* filter);
 
@@ -315,6 +396,8 @@ public:
 	void OnMarkerChanged();
 
 protected:
+	void RunFilterGraph(const std::set<FlowGraphNode*>& nodes);
+	std::set<FlowGraphNode*> GetVisibleFilterCone(const std::set<FlowGraphNode*>& nodes);
 	void UpdatePacketManagers(const std::set<FlowGraphNode*>& nodes);
 
 	std::string GetRegisteredTypeOfDriver(const std::string& drivername);
@@ -366,6 +449,12 @@ protected:
 	///@brief Mutex for controlling access to waveform data
 	std::shared_mutex m_waveformDataMutex;
 
+	void BeginWaveformEpoch();
+	void PublishWaveformEpoch();
+
+	///@brief Waveform data epoch (odd while filter outputs are being rewritten, even once published)
+	std::atomic<uint64_t> m_waveformEpoch;
+
 	///@brief Mutex for controlling access to filter graph
 	std::mutex m_filterUpdatingMutex;
 
@@ -405,6 +494,9 @@ protected:
 	///@brief Worker threads and other bookkeeping metadata for instruments
 	std::map<std::shared_ptr<Instrument>, std::shared_ptr<InstrumentConnectionState> > m_instrumentStates;
 
+	///@brief Time UpdatePollDemand() last scanned the filter graph
+	double m_lastPollDemandUpdate;
+
 	///@brief Processing thread for waveform data
 	std::unique_ptr<std::thread> m_waveformThread;
 
@@ -435,6 +527,48 @@ protected:
 	///@brief Time spent on the last filter graph execution
 	std::atomic<int64_t> m_lastFilterGraphExecTime;
 
+	///@brief Configuration hash of each memoizable filter as of its last run (protected by m_waveformDataMutex)
+	std::map<Filter*, uint64_t> m_filterOutputHashes;
+
+	///@brief Filters whose outputs were restored from history and can skip the next run (protected by m_waveformDataMutex)
+	std::map<Filter*, uint64_t> m_memoizedFilters;
+
+	///@brief History point the outputs in m_memoizedFilters were restored from
+	TimePoint m_memoizedPoint;
+
+	///@brief Value of m_flowGraphGeneration when m_memoizedFilters was set
+	uint64_t m_memoizedGeneration;
+
+	///@brief Value of m_flowGraphGeneration when m_filterOutputHashes was last pruned of deleted filters
+	uint64_t m_outputHashGeneration;
+
+	///@brief Mutex protecting m_visibleSinks, m_lazyFilterEvaluation, and m_skippedFilters
+	std::mutex m_visibleSinksMutex;
+
+	///@brief Graph nodes whose outputs are currently displayed somewhere
+	std::set<FlowGraphNode*> m_visibleSinks;
+
+	///@brief True if only filters feeding m_visibleSinks should be run by full refreshes
+	bool m_lazyFilterEvaluation;
+
+	///@brief Filters skipped by the last full refresh, whose outputs are now out of date
+	std::set<FlowGraphNode*> m_skippedFilters;
+
+	///@brief Size of m_skippedFilters, for metrics
+	std::atomic<size_t> m_skippedFilterCount;
+
+	///@brief Per-filter execution statistics (only collected while enabled)
+	FilterProfiler m_filterProfiler;
+
+	///@brief Set when the filter graph topology may have changed and m_flowGraphIndex needs a rebuild
+	std::atomic<bool> m_flowGraphIndexStale;
+
+	///@brief Incremented every time the filter graph topology may have changed (filters created or deleted etc)
+	std::atomic<uint64_t> m_flowGraphGeneration;
+
+	///@brief Cached consumer lists for finding the downstream cone of dirty channels (protected by m_dirtyChannelsMutex)
+	FlowGraphIndex m_flowGraphIndex;
+
 	///@brief Mutex for controlling access to performance counters
 	std::mutex m_perfClockMutex;
 
@@ -444,6 +578,12 @@ protected:
 	///@brief Historical waveform data
 	HistoryManager m_history;
 
+	///@brief Statistics for scalar measurements, updated once per acquisition
+	MeasurementStatistics m_measurementStats;
+
+	///@brief Compute pipelines shared by all displayed channels
+	ComputePipelineRegistry m_pipelineRegistry;
+
 	///@brief Mutex for controlling access to m_packetmgrs
 	std::mutex m_packetMgrMutex;
 
@@ -471,9 +611,14 @@ protected:
 	///@brief Set of dirty channels
 	std::set<FlowGraphNode*> m_dirtyChannels;
 
-	///@brief Mutex controlling access to m_dirtyChannels
+	///@brief Mutex controlling access to m_dirtyChannels and m_pendingFilterResizes
 	std::mutex m_dirtyChannelsMutex;
 
+	///@brief Output resolution changes to apply to filters before the next partial refresh
+	std::map<Filter*, std::pair<size_t, size_t> > m_pendingFilterResizes;
+
+	void ApplyPendingFilterResizes(std::map<Filter*, std::pair<size_t, size_t> >& resizes);
+
 public:
 
 	/**
@@ -528,14 +673,8 @@ public:
 
 public:
 
-	/**
-		@brief Gets the reference instance of a given filter
-	 */
-	Filter* GetReferenceFilter(const std::string& name)
-	{ return m_referenceFilters[name]; }
-
-	const std::map<std::string, Filter*>& GetReferenceFilters()
-	{ return m_referenceFilters; }
+	Filter* GetReferenceFilter(const std::string& name);
+	const std::map<std::string, Filter::Category>& GetFilterCategories();
 
 	///@brief Get all of the drivers of a given type
 	const std::vector<std::string>& GetDriverNamesForType(const std::string& type)
@@ -547,11 +686,23 @@ public:
 		const std::string& nickname);
 
 protected:
-	void CreateReferenceFilters();
 	void DestroyReferenceFilters();
 
+	///@brief Mutex protecting m_referenceFilters, m_filterCategories, and m_filterCategoriesComplete
+	std::mutex m_referenceFilterMutex;
+
+	///@brief Reference filters created so far, by filter type
 	std::map<std::string, Filter*> m_referenceFilters;
 
+	///@brief Number of registered filter types
+	size_t m_filterTypeCount;
+
+	///@brief True once m_filterCategories covers every filter type (it's not modified after that)
+	bool m_filterCategoriesComplete;
+
+	///@brief Category of each filter type
+	std::map<std::string, Filter::Category> m_filterCategories;
+
 	///@brief Map of "type" to drivername[]
 	std::map<std::string, std::vector<std::string> > m_driverNamesByType;
 };
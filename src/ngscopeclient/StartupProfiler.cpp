@@ -0,0 +1,267 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of StartupProfiler
+ */
+#include "../scopehal/scopehal.h"
+#include "StartupProfiler.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Creates a profiler
+
+	@param maxPhases	Maximum number of phases to record
+ */
+StartupProfiler::StartupProfiler(size_t maxPhases)
+	: m_startTime(0)
+	, m_printOnComplete(false)
+	, m_maxPhases(maxPhases)
+	, m_droppedPhases(0)
+{
+}
+
+/**
+	@brief Sets the zero point for all phase start times and milestones
+
+	Should be called as early as possible in main().
+ */
+void StartupProfiler::Start()
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+	m_startTime = GetTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Recording
+
+/**
+	@brief Gets the time since Start(), in seconds
+ */
+double StartupProfiler::GetElapsed()
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+	return GetTime() - m_startTime;
+}
+
+/**
+	@brief Starts a new phase, nested inside whatever phase the calling thread currently has open
+
+	@return ID of the phase, to pass to End(), or SIZE_MAX if the phase wasn't recorded because the cap was reached
+ */
+size_t StartupProfiler::Begin(const string& name)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	if(m_phases.size() >= m_maxPhases)
+	{
+		if(m_droppedPhases == 0)
+			LogDebug("Startup profiler has recorded %zu phases, not recording any more\n", m_phases.size());
+		m_droppedPhases ++;
+		return SIZE_MAX;
+	}
+
+	auto& stack = m_openPhases[this_thread::get_id()];
+	size_t parent = stack.empty() ? SIZE_MAX : stack.back();
+
+	size_t id = m_phases.size();
+	m_phases.push_back(StartupPhase(name, parent, stack.size(), GetTime() - m_startTime));
+	stack.push_back(id);
+	return id;
+}
+
+/**
+	@brief Ends a phase previously started by Begin()
+
+	Any phases nested inside it which are still open on the same thread are ended too.
+ */
+void StartupProfiler::End(size_t id)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	if(id >= m_phases.size())
+		return;
+
+	double now = GetTime() - m_startTime;
+	auto& stack = m_openPhases[this_thread::get_id()];
+	if(find(stack.begin(), stack.end(), id) == stack.end())
+	{
+		//Not open on this thread (already ended, or ended from a different thread than it started on)
+		if(m_phases[id].m_duration < 0)
+			m_phases[id].m_duration = now - m_phases[id].m_start;
+	}
+	else
+	{
+		while(!stack.empty())
+		{
+			size_t top = stack.back();
+			stack.pop_back();
+
+			auto& phase = m_phases[top];
+			phase.m_duration = now - phase.m_start;
+			LogDebug("Startup phase \"%s\" took %.2f ms\n", phase.m_name.c_str(), phase.m_duration * 1000);
+
+			if(top == id)
+				break;
+		}
+	}
+	if(stack.empty())
+		m_openPhases.erase(this_thread::get_id());
+
+	if(m_printOnComplete && (m_phases[id].m_parent == SIZE_MAX) )
+		Print(stdout, id);
+}
+
+/**
+	@brief Records the first time a milestone was reached (later calls with the same name are ignored)
+ */
+void StartupProfiler::Mark(const string& name)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	if(m_marks.find(name) != m_marks.end())
+		return;
+
+	double t = GetTime() - m_startTime;
+	m_marks[name] = t;
+	LogDebug("Reached \"%s\" at %.2f ms\n", name.c_str(), t * 1000);
+}
+
+/**
+	@brief Checks if a milestone has been reached yet
+ */
+bool StartupProfiler::HasMark(const string& name)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+	return m_marks.find(name) != m_marks.end();
+}
+
+/**
+	@brief Gets the time a milestone was first reached, in seconds since Start(), or negative if it hasn't been yet
+ */
+double StartupProfiler::GetMark(const string& name)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	auto it = m_marks.find(name);
+	if(it == m_marks.end())
+		return -1;
+	return it->second;
+}
+
+/**
+	@brief Gets a copy of every phase recorded so far
+ */
+vector<StartupPhase> StartupProfiler::GetPhases()
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+	return m_phases;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reporting
+
+/**
+	@brief Prints a phase and everything nested inside it as an indented table
+ */
+void StartupProfiler::Print(FILE* fp, size_t root)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	if(root >= m_phases.size())
+		return;
+
+	fprintf(fp, "%-50s %10s %9s\n", "Phase", "Time (ms)", "% parent");
+	PrintPhase(fp, root);
+	fflush(fp);
+}
+
+/**
+	@brief Prints one line of the table for a phase, then recurses into its children
+ */
+void StartupProfiler::PrintPhase(FILE* fp, size_t id)
+{
+	auto& phase = m_phases[id];
+
+	string name = string(phase.m_depth * 2, ' ') + phase.m_name;
+	if(phase.m_duration < 0)
+		fprintf(fp, "%-50s %10s\n", name.c_str(), "(running)");
+	else if( (phase.m_parent == SIZE_MAX) || (m_phases[phase.m_parent].m_duration <= 0) )
+		fprintf(fp, "%-50s %10.2f\n", name.c_str(), phase.m_duration * 1000);
+	else
+	{
+		fprintf(fp, "%-50s %10.2f %8.1f%%\n",
+			name.c_str(),
+			phase.m_duration * 1000,
+			phase.m_duration * 100 / m_phases[phase.m_parent].m_duration);
+	}
+
+	//Children always start after their parent, so only look at later phases
+	for(size_t i=id+1; i<m_phases.size(); i++)
+	{
+		if(m_phases[i].m_parent == id)
+			PrintPhase(fp, i);
+	}
+}
+
+/**
+	@brief Prints every milestone reached so far, in the order they were reached
+ */
+void StartupProfiler::PrintMarks(FILE* fp)
+{
+	lock_guard<recursive_mutex> lock(m_mutex);
+
+	vector<pair<double, string>> marks;
+	for(auto it : m_marks)
+		marks.push_back(pair<double, string>(it.second, it.first));
+	sort(marks.begin(), marks.end());
+
+	for(auto& m : marks)
+		fprintf(fp, "%-50s %10.2f\n", m.second.c_str(), m.first * 1000);
+	fflush(fp);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// StartupProfileScope
+
+StartupProfileScope::StartupProfileScope(const string& name)
+{
+	m_id = g_startupProfiler.Begin(name);
+}
+
+StartupProfileScope::~StartupProfileScope()
+{
+	g_startupProfiler.End(m_id);
+}
@@ -0,0 +1,166 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of StartupProfiler
+ */
+#ifndef StartupProfiler_h
+#define StartupProfiler_h
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+	@brief One timed phase of startup (or of loading a session)
+ */
+class StartupPhase
+{
+public:
+	StartupPhase(const std::string& name, size_t parent, size_t depth, double start)
+	: m_name(name)
+	, m_parent(parent)
+	, m_depth(depth)
+	, m_start(start)
+	, m_duration(-1)
+	{}
+
+	///@brief Human readable name of the phase
+	std::string m_name;
+
+	///@brief Index of the enclosing phase, or SIZE_MAX for a top level phase
+	size_t m_parent;
+
+	///@brief Nesting depth (0 for a top level phase)
+	size_t m_depth;
+
+	///@brief Start time, in seconds since StartupProfiler::Start()
+	double m_start;
+
+	///@brief Wall clock duration in seconds, or negative if the phase hasn't ended yet
+	double m_duration;
+};
+
+/**
+	@brief Hierarchical wall clock timing of application startup and session loading
+
+	Phases are opened and closed in LIFO order on each thread, so nesting is inferred from whatever phase the calling
+	thread already has open. Recording is always on since it only costs a few timestamps; the summary is only printed
+	(when each top level phase completes) if requested with --startup-profile or --benchmark.
+
+	Named milestones ("first frame", "first waveform") are recorded once, the first time they're reached.
+
+	Loading a session records a few more phases each time, so the number of phases kept is capped to stop a long
+	running process from growing the list forever. Once the cap is reached, new phases are counted but not recorded.
+ */
+class StartupProfiler
+{
+public:
+	StartupProfiler(size_t maxPhases = 4096);
+
+	void Start();
+
+	/**
+		@brief Prints each top level phase, with all of its children, as soon as it completes
+	 */
+	void SetPrintOnComplete(bool print)
+	{ m_printOnComplete = print; }
+
+	size_t Begin(const std::string& name);
+	void End(size_t id);
+
+	void Mark(const std::string& name);
+	bool HasMark(const std::string& name);
+	double GetMark(const std::string& name);
+
+	double GetElapsed();
+
+	std::vector<StartupPhase> GetPhases();
+
+	/**
+		@brief Gets the number of phases which weren't recorded because the cap had been reached
+	 */
+	size_t GetDroppedPhaseCount()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return m_droppedPhases;
+	}
+
+	void Print(FILE* fp, size_t root);
+	void PrintMarks(FILE* fp);
+
+protected:
+	void PrintPhase(FILE* fp, size_t id);
+
+	///@brief Mutex protecting everything below
+	std::recursive_mutex m_mutex;
+
+	///@brief Time Start() was called, as returned by GetTime()
+	double m_startTime;
+
+	///@brief If true, print each top level phase once it ends
+	bool m_printOnComplete;
+
+	///@brief Every phase recorded so far, in the order they started
+	std::vector<StartupPhase> m_phases;
+
+	///@brief Maximum number of phases to keep in m_phases
+	size_t m_maxPhases;
+
+	///@brief Number of phases started after m_phases was full
+	size_t m_droppedPhases;
+
+	///@brief Currently open phases on each thread, innermost last
+	std::map<std::thread::id, std::vector<size_t>> m_openPhases;
+
+	///@brief Milestones reached so far, in seconds since Start()
+	std::map<std::string, double> m_marks;
+};
+
+/**
+	@brief Times the enclosing scope as one startup phase
+ */
+class StartupProfileScope
+{
+public:
+	StartupProfileScope(const std::string& name);
+	~StartupProfileScope();
+
+protected:
+	///@brief Index of our phase in the profiler
+	size_t m_id;
+};
+
+extern StartupProfiler g_startupProfiler;
+
+#endif
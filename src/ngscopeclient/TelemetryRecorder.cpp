@@ -0,0 +1,389 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of TelemetrySeries and TelemetryRecorder
+ */
+#include "ngscopeclient.h"
+#include "TelemetryRecorder.h"
+
+using namespace std;
+
+///@brief Interval between drains by the writer thread, in milliseconds
+static const int g_telemetryDrainInterval = 50;
+
+///@brief Length of time the ring buffer must be able to hold at the maximum sample rate, in seconds
+static const double g_telemetryRingWindow = 2;
+
+///@brief Number of buckets in each tier merged into one bucket of the next tier
+static const size_t g_telemetryDecimation = 16;
+
+///@brief Number of tiers (raw samples, then 16x, 256x, 4096x decimated)
+static const size_t g_telemetryTiers = 4;
+
+/**
+	@brief Maximum length of each tier
+
+	At 100 Hz this keeps about 11 minutes of raw samples, 3 hours at 16x, 2 days at 256x, and a month at 4096x.
+ */
+static const size_t g_telemetryTierSize = 65536;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TelemetryBucket
+
+/**
+	@brief Extends this bucket to also summarize a later bucket
+ */
+void TelemetryBucket::Merge(const TelemetryBucket& rhs)
+{
+	if(m_count == 0)
+	{
+		*this = rhs;
+		return;
+	}
+
+	m_tend = rhs.m_tend;
+	m_min = min(m_min, rhs.m_min);
+	m_max = max(m_max, rhs.m_max);
+	m_sum += rhs.m_sum;
+	m_count += rhs.m_count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TelemetrySeries
+
+/**
+	@brief Creates a series
+
+	@param name		Display name
+	@param unit		Unit of the sample values
+	@param ringSize	Number of samples the ring buffer can hold before Push() starts dropping them (power of two)
+ */
+TelemetrySeries::TelemetrySeries(const string& name, Unit unit, size_t ringSize)
+	: m_name(name)
+	, m_unit(unit)
+	, m_ring(ringSize)
+	, m_writeIndex(0)
+	, m_readIndex(0)
+	, m_dropped(0)
+	, m_tiers(g_telemetryTiers)
+	, m_partial(g_telemetryTiers)
+	, m_partialCount(g_telemetryTiers, 0)
+	, m_truncated(g_telemetryTiers, false)
+{
+}
+
+/**
+	@brief Adds a new sample
+
+	Called from the instrument thread only. Never blocks; if the consumer has fallen so far behind that the ring is
+	full, the sample is dropped.
+
+	@param t	Timestamp, in seconds
+	@param v	Sample value
+ */
+void TelemetrySeries::Push(double t, float v)
+{
+	auto w = m_writeIndex.load(memory_order_relaxed);
+	auto r = m_readIndex.load(memory_order_acquire);
+	if( (w - r) >= m_ring.size())
+	{
+		m_dropped ++;
+		return;
+	}
+
+	m_ring[w & (m_ring.size() - 1)] = TelemetrySample(t, v);
+	m_writeIndex.store(w + 1, memory_order_release);
+}
+
+/**
+	@brief Moves all pending samples from the ring buffer into history
+
+	@param raw	Output: the samples drained, oldest first (for logging)
+ */
+void TelemetrySeries::Drain(vector<TelemetrySample>& raw)
+{
+	raw.clear();
+
+	lock_guard<mutex> lock(m_historyMutex);
+	auto r = m_readIndex.load(memory_order_relaxed);
+	auto w = m_writeIndex.load(memory_order_acquire);
+	for(; r != w; r++)
+	{
+		auto& sample = m_ring[r & (m_ring.size() - 1)];
+		raw.push_back(sample);
+		m_latest = TelemetryBucket(sample.m_t, sample.m_v);
+		Append(0, m_latest);
+	}
+	m_readIndex.store(r, memory_order_release);
+}
+
+/**
+	@brief Appends a bucket to a tier, rolling it up into the coarser tiers as needed
+ */
+void TelemetrySeries::Append(size_t tier, const TelemetryBucket& b)
+{
+	auto& buckets = m_tiers[tier];
+	buckets.push_back(b);
+	if(buckets.size() > g_telemetryTierSize)
+	{
+		buckets.pop_front();
+		m_truncated[tier] = true;
+	}
+
+	size_t next = tier + 1;
+	if(next >= m_tiers.size())
+		return;
+
+	m_partial[next].Merge(b);
+	m_partialCount[next] ++;
+	if(m_partialCount[next] == g_telemetryDecimation)
+	{
+		Append(next, m_partial[next]);
+		m_partial[next] = TelemetryBucket();
+		m_partialCount[next] = 0;
+	}
+}
+
+/**
+	@brief Discards all history, including samples not yet drained
+ */
+void TelemetrySeries::Clear()
+{
+	lock_guard<mutex> lock(m_historyMutex);
+	m_readIndex.store(m_writeIndex.load(memory_order_acquire), memory_order_release);
+
+	for(size_t i=0; i<m_tiers.size(); i++)
+	{
+		m_tiers[i].clear();
+		m_partial[i] = TelemetryBucket();
+		m_partialCount[i] = 0;
+		m_truncated[i] = false;
+	}
+	m_latest = TelemetryBucket();
+}
+
+double TelemetrySeries::GetStartTime()
+{
+	lock_guard<mutex> lock(m_historyMutex);
+
+	//Coarsest tier goes back the furthest
+	for(ssize_t i = m_tiers.size() - 1; i >= 0; i--)
+	{
+		if(!m_tiers[i].empty())
+			return m_tiers[i].front().m_tstart;
+	}
+	return m_latest.m_tstart;
+}
+
+/**
+	@brief Gets a summary of history over a time range, suitable for plotting
+
+	Uses the finest tier which has data back to tstart and needs no more than maxBuckets buckets for the range. If
+	even the coarsest tier needs too many buckets, adjacent ones are merged.
+
+	@param tstart		Start of the range, in seconds
+	@param tend			End of the range, in seconds
+	@param maxBuckets	Maximum number of buckets to return (typically the plot width in pixels)
+	@param out			Output: buckets overlapping the range, oldest first
+ */
+void TelemetrySeries::Query(double tstart, double tend, size_t maxBuckets, vector<TelemetryBucket>& out)
+{
+	out.clear();
+	if(maxBuckets == 0)
+		return;
+
+	lock_guard<mutex> lock(m_historyMutex);
+
+	auto endsBefore = [](const TelemetryBucket& b, double t) { return b.m_tend < t; };
+	auto startsAfter = [](double t, const TelemetryBucket& b) { return t < b.m_tstart; };
+
+	for(size_t tier=0; tier<m_tiers.size(); tier++)
+	{
+		auto& buckets = m_tiers[tier];
+		bool last = (tier + 1 == m_tiers.size());
+
+		//Skip tiers which have already discarded part of the range
+		if(!last && m_truncated[tier] && !buckets.empty() && (buckets.front().m_tstart > tstart))
+			continue;
+
+		auto first = lower_bound(buckets.begin(), buckets.end(), tstart, endsBefore);
+		auto end = upper_bound(first, buckets.end(), tend, startsAfter);
+		size_t count = end - first;
+
+		//The partial bucket holds the newest data not yet rolled up into this tier
+		bool usePartial = (m_partialCount[tier] != 0) && (m_partial[tier].m_tstart <= tend);
+		if(usePartial)
+			count ++;
+
+		if( (count > maxBuckets) && !last)
+			continue;
+
+		//Merge adjacent buckets if there are still too many
+		size_t stride = (count + maxBuckets - 1) / maxBuckets;
+		TelemetryBucket acc;
+		size_t nacc = 0;
+		for(auto it = first; it != end; it++)
+		{
+			acc.Merge(*it);
+			if(++nacc == stride)
+			{
+				out.push_back(acc);
+				acc = TelemetryBucket();
+				nacc = 0;
+			}
+		}
+		if(usePartial)
+			acc.Merge(m_partial[tier]);
+		if(acc.m_count)
+			out.push_back(acc);
+		return;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TelemetryRecorder
+
+TelemetryRecorder::TelemetryRecorder()
+	: m_logfile(nullptr)
+	, m_shuttingDown(false)
+{
+	m_thread = make_unique<thread>(&TelemetryRecorder::WriterThread, this);
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+	m_shuttingDown = true;
+	m_thread->join();
+	m_thread = nullptr;
+
+	StopLogging();
+}
+
+/**
+	@brief Creates a new series
+
+	Must be called before the instrument thread starts pushing samples.
+ */
+shared_ptr<TelemetrySeries> TelemetryRecorder::AddSeries(const string& name, Unit unit)
+{
+	//Size the ring to hold a couple of seconds at full rate, which is plenty of slack for the writer thread
+	size_t ringSize = 64;
+	while(ringSize < MAX_SAMPLE_RATE * g_telemetryRingWindow)
+		ringSize *= 2;
+
+	auto series = make_shared<TelemetrySeries>(name, unit, ringSize);
+
+	lock_guard<mutex> lock(m_mutex);
+	m_series.push_back(series);
+	return series;
+}
+
+/**
+	@brief Thread body: drains every series into history at a fixed interval, until the recorder is destroyed
+ */
+void TelemetryRecorder::WriterThread()
+{
+	pthread_setname_np_compat("TelemetryWriter");
+
+	while(!m_shuttingDown)
+	{
+		this_thread::sleep_for(chrono::milliseconds(g_telemetryDrainInterval));
+		Flush();
+	}
+
+	//Don't lose anything pushed since the last pass
+	Flush();
+}
+
+/**
+	@brief Drains every series into history, and appends new samples to the log file if one is open
+ */
+void TelemetryRecorder::Flush()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	bool wrote = false;
+	for(auto& s : m_series)
+	{
+		s->Drain(m_drained);
+
+		if(m_logfile)
+		{
+			auto& name = s->GetName();
+			for(auto& sample : m_drained)
+				fprintf(m_logfile, "%.6f,%s,%.9g\n", sample.m_t, name.c_str(), sample.m_v);
+			wrote |= !m_drained.empty();
+		}
+	}
+
+	if(wrote)
+		fflush(m_logfile);
+}
+
+/**
+	@brief Starts appending every new sample to a CSV file
+
+	If the file already exists, samples are added to the end of it.
+
+	@return True on success, false if the file couldn't be opened
+ */
+bool TelemetryRecorder::StartLogging(const string& path)
+{
+	StopLogging();
+
+	lock_guard<mutex> lock(m_mutex);
+	m_logfile = fopen(path.c_str(), "a");
+	if(!m_logfile)
+	{
+		LogError("Failed to open telemetry log %s\n", path.c_str());
+		return false;
+	}
+	m_logPath = path;
+
+	//Write the header if this is a new file
+	fseek(m_logfile, 0, SEEK_END);
+	if(ftell(m_logfile) == 0)
+		fprintf(m_logfile, "time,series,value\n");
+
+	return true;
+}
+
+/**
+	@brief Closes the log file, if one is open
+ */
+void TelemetryRecorder::StopLogging()
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(m_logfile)
+		fclose(m_logfile);
+	m_logfile = nullptr;
+}
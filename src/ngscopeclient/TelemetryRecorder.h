@@ -0,0 +1,266 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of TelemetrySeries and TelemetryRecorder
+ */
+#ifndef TelemetryRecorder_h
+#define TelemetryRecorder_h
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+	@brief A single raw telemetry sample, as queued by the instrument thread
+ */
+class TelemetrySample
+{
+public:
+	TelemetrySample()
+	: m_t(0)
+	, m_v(0)
+	{}
+
+	TelemetrySample(double t, float v)
+	: m_t(t)
+	, m_v(v)
+	{}
+
+	///@brief Timestamp, in seconds
+	double m_t;
+
+	///@brief Sample value
+	float m_v;
+};
+
+/**
+	@brief Summary of one or more consecutive telemetry samples
+ */
+class TelemetryBucket
+{
+public:
+	TelemetryBucket()
+	: m_tstart(0)
+	, m_tend(0)
+	, m_min(0)
+	, m_max(0)
+	, m_sum(0)
+	, m_count(0)
+	{}
+
+	TelemetryBucket(double t, float v)
+	: m_tstart(t)
+	, m_tend(t)
+	, m_min(v)
+	, m_max(v)
+	, m_sum(v)
+	, m_count(1)
+	{}
+
+	void Merge(const TelemetryBucket& rhs);
+
+	float GetMean() const
+	{ return m_count ? (m_sum / m_count) : 0; }
+
+	///@brief Timestamp of the first sample, in seconds
+	double m_tstart;
+
+	///@brief Timestamp of the last sample, in seconds
+	double m_tend;
+
+	///@brief Smallest sample value
+	float m_min;
+
+	///@brief Largest sample value
+	float m_max;
+
+	///@brief Sum of all sample values
+	double m_sum;
+
+	///@brief Number of samples summarized
+	uint64_t m_count;
+};
+
+/**
+	@brief History of a single scalar value (PSU channel voltage, DMM reading, etc) polled from an instrument
+
+	Samples are pushed by the instrument thread into a lock-free single-producer single-consumer ring buffer, which
+	only needs to be big enough to cover a few drain intervals at the instrument's poll rate. The recorder's writer
+	thread periodically calls Drain() to move them into a set of tiers: tier 0 holds raw samples, and each bucket in
+	tier N summarizes g_telemetryDecimation buckets of tier N-1 with min/max/mean. Every tier has a bounded length, so
+	memory use stays constant no matter how long the recording runs, and any time span can be plotted from the finest
+	tier covering it without touching more than a screen's worth of buckets.
+
+	Push() may only be called from the instrument thread. Everything else may be called from any thread, and is
+	serialized by m_historyMutex.
+ */
+class TelemetrySeries
+{
+public:
+	TelemetrySeries(const std::string& name, Unit unit, size_t ringSize);
+
+	void Push(double t, float v);
+
+	void Drain(std::vector<TelemetrySample>& raw);
+	void Clear();
+
+	void Query(double tstart, double tend, size_t maxBuckets, std::vector<TelemetryBucket>& out);
+
+	const std::string& GetName()
+	{ return m_name; }
+
+	Unit GetUnit()
+	{ return m_unit; }
+
+	void SetUnit(Unit unit)
+	{ m_unit = unit; }
+
+	/**
+		@brief Gets the timestamp of the oldest sample still in history, or zero if there is none
+	 */
+	double GetStartTime();
+
+	/**
+		@brief Gets the most recent sample, or an empty bucket if there is none
+	 */
+	TelemetryBucket GetLatest()
+	{
+		std::lock_guard<std::mutex> lock(m_historyMutex);
+		return m_latest;
+	}
+
+	/**
+		@brief Gets the number of samples lost because the ring buffer was full when they were pushed
+	 */
+	uint64_t GetDroppedCount()
+	{ return m_dropped; }
+
+protected:
+	void Append(size_t tier, const TelemetryBucket& b);
+
+	///@brief Display name of the series
+	std::string m_name;
+
+	///@brief Unit of the sample values
+	Unit m_unit;
+
+	///@brief Ring buffer of samples not yet drained (power of two size)
+	std::vector<TelemetrySample> m_ring;
+
+	///@brief Total number of samples ever pushed into m_ring (written only by the producer)
+	std::atomic<uint64_t> m_writeIndex;
+
+	///@brief Total number of samples ever drained from m_ring (written only by the consumer)
+	std::atomic<uint64_t> m_readIndex;
+
+	///@brief Number of samples dropped due to a full ring
+	std::atomic<uint64_t> m_dropped;
+
+	///@brief Mutex protecting the consumer side of m_ring and everything below it
+	std::mutex m_historyMutex;
+
+	///@brief Downsampled history, finest tier first
+	std::vector<std::deque<TelemetryBucket> > m_tiers;
+
+	///@brief Bucket of each tier still being filled from the tier below
+	std::vector<TelemetryBucket> m_partial;
+
+	///@brief Number of buckets merged into each partial bucket so far
+	std::vector<size_t> m_partialCount;
+
+	///@brief True if the oldest bucket of a tier has ever been discarded
+	std::vector<bool> m_truncated;
+
+	///@brief Most recent sample drained
+	TelemetryBucket m_latest;
+};
+
+/**
+	@brief All of the telemetry series for one instrument, plus an optional append-only log file
+
+	A writer thread drains every series twenty times a second and appends the new samples to the log file, so
+	history and logging keep up even when the GUI isn't rendering (e.g. the window is minimized).
+ */
+class TelemetryRecorder
+{
+public:
+	TelemetryRecorder();
+	virtual ~TelemetryRecorder();
+
+	///@brief Fastest rate at which telemetry instruments are polled, in Hz
+	static constexpr double MAX_SAMPLE_RATE = 100;
+
+	std::shared_ptr<TelemetrySeries> AddSeries(const std::string& name, Unit unit);
+
+	const std::vector<std::shared_ptr<TelemetrySeries> >& GetSeries()
+	{ return m_series; }
+
+	bool StartLogging(const std::string& path);
+	void StopLogging();
+
+	bool IsLogging()
+	{ return m_logfile != nullptr; }
+
+	const std::string& GetLogPath()
+	{ return m_logPath; }
+
+protected:
+	void WriterThread();
+	void Flush();
+
+	///@brief Mutex protecting m_series, m_logfile, m_logPath, and m_drained
+	std::mutex m_mutex;
+
+	///@brief Series owned by this recorder
+	std::vector<std::shared_ptr<TelemetrySeries> > m_series;
+
+	///@brief CSV file samples are appended to as they're drained (null if not logging)
+	FILE* m_logfile;
+
+	///@brief Path of the log file
+	std::string m_logPath;
+
+	///@brief Scratch buffer for samples drained from a series
+	std::vector<TelemetrySample> m_drained;
+
+	///@brief Set to stop the writer thread
+	std::atomic<bool> m_shuttingDown;
+
+	///@brief Thread which drains the series and writes the log file
+	std::unique_ptr<std::thread> m_thread;
+};
+
+#endif
@@ -0,0 +1,204 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of TelemetryView
+ */
+#include "ngscopeclient.h"
+#include "TelemetryView.h"
+#include "Dialog.h"
+
+using namespace std;
+
+///@brief Names of the time spans the user can choose from
+static const vector<string> g_telemetrySpanNames =
+	{ "10 s", "1 min", "10 min", "1 hour", "8 hours", "24 hours", "All" };
+
+///@brief Length of each time span, in seconds (zero means everything in history)
+static const double g_telemetrySpans[] = { 10, 60, 600, 3600, 8 * 3600, 24 * 3600, 0 };
+
+TelemetryView::TelemetryView(shared_ptr<TelemetryRecorder> recorder)
+	: m_recorder(recorder)
+	, m_spanIndex(1)
+{
+}
+
+/**
+	@brief Renders the span selector and log controls, followed by one plot per series
+
+	@param series	Series to plot (may be a subset of the recorder's series)
+ */
+void TelemetryView::Render(const vector<shared_ptr<TelemetrySeries> >& series)
+{
+	float width = 10 * ImGui::GetFontSize();
+
+	ImGui::SetNextItemWidth(width);
+	Dialog::Combo("Time span", g_telemetrySpanNames, m_spanIndex);
+	Dialog::HelpMarker("Length of history to display in the plots below");
+
+	RenderLogControls();
+
+	double tend = GetTime();
+	double tstart = tend - g_telemetrySpans[m_spanIndex];
+	for(auto& s : series)
+	{
+		if(g_telemetrySpans[m_spanIndex] == 0)
+			tstart = s->GetStartTime();
+		Plot(s, tstart, tend);
+	}
+}
+
+/**
+	@brief Renders controls for logging all series to a CSV file
+ */
+void TelemetryView::RenderLogControls()
+{
+	float width = 10 * ImGui::GetFontSize();
+
+	if(m_recorder->IsLogging())
+	{
+		ImGui::TextUnformatted(("Logging to " + m_recorder->GetLogPath()).c_str());
+		ImGui::SameLine();
+		if(ImGui::Button("Stop logging"))
+			m_recorder->StopLogging();
+	}
+	else
+	{
+		ImGui::SetNextItemWidth(width);
+		ImGui::InputText("Log file", &m_logPath);
+		ImGui::SameLine();
+		ImGui::BeginDisabled(m_logPath.empty());
+		if(ImGui::Button("Start logging"))
+			m_recorder->StartLogging(m_logPath);
+		ImGui::EndDisabled();
+		Dialog::HelpMarker(
+			"Append every new reading to a CSV file",
+			{
+				"One line per sample with timestamp (seconds since the epoch), series name, and value",
+				"If the file already exists, new readings are added to the end"
+			});
+	}
+}
+
+/**
+	@brief Draws a strip chart of one series
+
+	Each bucket is drawn as a min/max band with its mean as a line through it, so short spikes stay visible no
+	matter how far the view is zoomed out.
+ */
+void TelemetryView::Plot(shared_ptr<TelemetrySeries> series, double tstart, double tend)
+{
+	auto unit = series->GetUnit();
+	auto latest = series->GetLatest();
+	string label = series->GetName();
+	if(latest.m_count)
+		label += ": " + unit.PrettyPrint(latest.m_min);
+	ImGui::TextUnformatted(label.c_str());
+
+	float height = 4 * ImGui::GetFontSize();
+	float width = ImGui::GetContentRegionAvail().x;
+	if(width < 1)
+		return;
+	ImVec2 pos = ImGui::GetCursorScreenPos();
+	ImVec2 size(width, height);
+	ImGui::InvisibleButton(series->GetName().c_str(), size);
+	bool hovered = ImGui::IsItemHovered();
+
+	auto list = ImGui::GetWindowDrawList();
+	list->AddRectFilled(pos, pos + size, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+	if(tend <= tstart)
+		return;
+	series->Query(tstart, tend, static_cast<size_t>(width), m_buckets);
+	if(m_buckets.empty())
+		return;
+
+	//Autoscale vertically
+	float vmin = m_buckets[0].m_min;
+	float vmax = m_buckets[0].m_max;
+	for(auto& b : m_buckets)
+	{
+		vmin = min(vmin, b.m_min);
+		vmax = max(vmax, b.m_max);
+	}
+	float vrange = vmax - vmin;
+	if(vrange <= 0)
+		vrange = max(fabs(vmax), 1e-6f);
+	vmin -= vrange * 0.05;
+	vmax += vrange * 0.05;
+	vrange = vmax - vmin;
+
+	auto xpos = [&](double t) { return pos.x + static_cast<float>((t - tstart) / (tend - tstart)) * width; };
+	auto ypos = [&](float v) { return pos.y + height - (v - vmin) / vrange * height; };
+
+	//Min/max envelope, then mean
+	auto bandColor = ImGui::GetColorU32(ImGuiCol_PlotLines, 0.35);
+	auto lineColor = ImGui::GetColorU32(ImGuiCol_PlotLines);
+	list->PushClipRect(pos, pos + size, true);
+	vector<ImVec2> means;
+	means.reserve(m_buckets.size());
+	for(auto& b : m_buckets)
+	{
+		float x0 = xpos(b.m_tstart);
+		float x1 = max(xpos(b.m_tend), x0 + 1);
+		list->AddRectFilled(ImVec2(x0, ypos(b.m_max)), ImVec2(x1, ypos(b.m_min) + 1), bandColor);
+		means.push_back(ImVec2((x0 + x1) / 2, ypos(b.GetMean())));
+	}
+	list->AddPolyline(means.data(), means.size(), lineColor, 0, 1);
+	list->PopClipRect();
+
+	//Scale labels
+	auto textColor = ImGui::GetColorU32(ImGuiCol_Text);
+	list->AddText(pos, textColor, unit.PrettyPrint(vmax).c_str());
+	list->AddText(ImVec2(pos.x, pos.y + height - ImGui::GetFontSize()), textColor, unit.PrettyPrint(vmin).c_str());
+
+	//Show the bucket under the mouse
+	if(hovered)
+	{
+		double t = tstart + (ImGui::GetIO().MousePos.x - pos.x) / width * (tend - tstart);
+		auto it = lower_bound(m_buckets.begin(), m_buckets.end(), t,
+			[](const TelemetryBucket& b, double time) { return b.m_tend < time; });
+		if(it != m_buckets.end())
+		{
+			Unit fs(Unit::UNIT_FS);
+			string tip = fs.PrettyPrint((tend - t) * FS_PER_SECOND) + " ago\n";
+			if(it->m_count == 1)
+				tip += unit.PrettyPrint(it->m_min);
+			else
+			{
+				tip += "Min: " + unit.PrettyPrint(it->m_min) + "\n";
+				tip += "Mean: " + unit.PrettyPrint(it->GetMean()) + "\n";
+				tip += "Max: " + unit.PrettyPrint(it->m_max);
+			}
+			ImGui::SetTooltip("%s", tip.c_str());
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of TelemetryView
+ */
+#ifndef TelemetryView_h
+#define TelemetryView_h
+
+/**
+	@brief Strip chart plots of a TelemetryRecorder's history, plus controls for logging it to disk
+
+	Embedded in instrument dialogs (power supply, multimeter, load).
+ */
+class TelemetryView
+{
+public:
+	TelemetryView(std::shared_ptr<TelemetryRecorder> recorder);
+
+	void Render(const std::vector<std::shared_ptr<TelemetrySeries> >& series);
+
+protected:
+	void RenderLogControls();
+	void Plot(std::shared_ptr<TelemetrySeries> series, double tstart, double tend);
+
+	///@brief The recorder we're displaying
+	std::shared_ptr<TelemetryRecorder> m_recorder;
+
+	///@brief Index of the selected time span
+	int m_spanIndex;
+
+	///@brief Path for the log file (uncommitted)
+	std::string m_logPath;
+
+	///@brief Scratch buffer for query results
+	std::vector<TelemetryBucket> m_buckets;
+};
+
+#endif
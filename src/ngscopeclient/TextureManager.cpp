@@ -182,6 +182,45 @@ Texture::Texture(
 	SetName(name);
 }
 
+/**
+	@brief Creates a texture in memory allocated by the caller
+
+	The caller is responsible for uploading content and transitioning the image to eShaderReadOnlyOptimal before the
+	texture is drawn.
+
+	@param image	The image, not yet bound to memory
+	@param memory	Device memory to bind the image to
+	@param offset	Offset of the image within memory
+	@param mgr		The texture manager
+	@param name		Name for debug tools
+ */
+Texture::Texture(
+	vk::raii::Image&& image,
+	shared_ptr<vk::raii::DeviceMemory> memory,
+	vk::DeviceSize offset,
+	TextureManager* mgr,
+	const string& name)
+	: m_image(std::move(image))
+	, m_deviceMemory(memory)
+{
+	m_image.bindMemory(**m_deviceMemory, offset);
+
+	//Make a view for the image
+	vk::ImageViewCreateInfo vinfo(
+		{},
+		*m_image,
+		vk::ImageViewType::e2D,
+		vk::Format::eR8G8B8A8Unorm,
+		{},
+		vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
+		);
+	m_view = make_unique<vk::raii::ImageView>(*g_vkComputeDevice, vinfo);
+
+	m_texture = ImGui_ImplVulkan_AddTexture(**mgr->GetSampler(), **m_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	SetName(name);
+}
+
 void Texture::SetName(const string& name)
 {
 	if(g_hasDebugUtils && !name.empty())
@@ -229,16 +268,7 @@ void Texture::LayoutTransition(
 	vk::ImageLayout from,
 	vk::ImageLayout to)
 {
-	vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
-	vk::ImageMemoryBarrier barrier(
-		src,
-		dst,
-		from,
-		to,
-		VK_QUEUE_FAMILY_IGNORED,
-		VK_QUEUE_FAMILY_IGNORED,
-		*m_image,
-		range);
+	auto barrier = MakeBarrier(*m_image, src, dst, from, to);
 
 	if(dst == vk::AccessFlagBits::eShaderRead)
 	{
@@ -262,6 +292,44 @@ void Texture::LayoutTransition(
 	}
 }
 
+/**
+	@brief Makes a barrier for a layout transition of the whole of a single-level color image
+ */
+vk::ImageMemoryBarrier Texture::MakeBarrier(
+	vk::Image image,
+	vk::AccessFlags src,
+	vk::AccessFlags dst,
+	vk::ImageLayout from,
+	vk::ImageLayout to)
+{
+	vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	return vk::ImageMemoryBarrier(
+		src,
+		dst,
+		from,
+		to,
+		VK_QUEUE_FAMILY_IGNORED,
+		VK_QUEUE_FAMILY_IGNORED,
+		image,
+		range);
+}
+
+/**
+	@brief Finds the first memory type which is allowed by a memory requirements mask and has the requested flags
+
+	@return The memory type index, or 0 if none match
+ */
+uint32_t Texture::FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags flags)
+{
+	auto memProperties = g_vkComputePhysicalDevice->getMemoryProperties();
+	for(uint32_t i=0; i<32; i++)
+	{
+		if( (typeBits & (1 << i)) && ( (memProperties.memoryTypes[i].propertyFlags & flags) == flags) )
+			return i;
+	}
+	return 0;
+}
+
 Texture::~Texture()
 {
 	ImGui_ImplVulkan_RemoveTexture(reinterpret_cast<VkDescriptorSet>(m_texture));
@@ -271,7 +339,8 @@ Texture::~Texture()
 // Construction / destruction
 
 TextureManager::TextureManager(shared_ptr<QueueHandle> queue)
-	: m_queue(queue)
+	: m_batchDepth(0)
+	, m_queue(queue)
 {
 	//Make a sampler using configuration that matches imgui
 	vk::SamplerCreateInfo sinfo(
@@ -314,17 +383,37 @@ TextureManager::~TextureManager()
 // File loading
 
 /**
-	@brief Loads a texture from a file into a named resource
-
-	If an existing texture by the same name already exists, it is overwritten.
+	@brief Decoded contents of a texture file
  */
-void TextureManager::LoadTexture(
-	const string& name,
-	const string& path)
+class DecodedImage
 {
-	LogTrace("Loading texture \"%s\" from file \"%s\"\n", name.c_str(), path.c_str());
-	LogIndenter li;
+public:
+	DecodedImage()
+	: m_ok(false)
+	, m_width(0)
+	, m_height(0)
+	{}
+
+	///@brief True if the file was loaded successfully
+	bool m_ok;
+
+	///@brief Width of the image, in pixels
+	int m_width;
+
+	///@brief Height of the image, in pixels
+	int m_height;
+
+	///@brief RGBA8888 pixel data, rows packed with no padding
+	vector<uint8_t> m_pixels;
+};
 
+/**
+	@brief Decodes a PNG file to RGBA8888 pixels
+
+	Only uses thread-safe libpng state, so may be called from several threads at once.
+ */
+static void DecodePNG(const string& path, DecodedImage& image)
+{
 	//Initialize libpng
 	auto png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
 	if(!png)
@@ -352,18 +441,21 @@ void TextureManager::LoadTexture(
 	if(!fp)
 	{
 		LogError("Failed to open texture file \"%s\"\n", path.c_str());
+		png_destroy_read_struct(&png, &info, &end);
 		return;
 	}
 	uint8_t sig[8];
 	if(sizeof(sig) != fread(sig, 1, sizeof(sig), fp))
 	{
 		LogError("Failed to read signature of PNG file \"%s\"\n", path.c_str());
+		png_destroy_read_struct(&png, &info, &end);
 		fclose(fp);
 		return;
 	}
 	if(0 != png_sig_cmp(sig, 0, sizeof(sig)))
 	{
 		LogError("Bad magic number in PNG file \"%s\"\n", path.c_str());
+		png_destroy_read_struct(&png, &info, &end);
 		fclose(fp);
 		return;
 	}
@@ -392,65 +484,236 @@ void TextureManager::LoadTexture(
 		fclose(fp);
 		return;
 	}
-	int bytesPerComponent = 1;
-	int bytesPerPixel = 4*bytesPerComponent;
-	LogTrace("Image is %d x %d pixels, RGBA8888\n", width, height);
-	VkDeviceSize size = width * height * bytesPerPixel;
 
-	//Allocate temporary staging buffer
-	vk::BufferCreateInfo bufinfo({}, size, vk::BufferUsageFlagBits::eTransferSrc);
-	vk::raii::Buffer stagingBuf(*g_vkComputeDevice, bufinfo);
+	//Copy out the pixels
+	size_t rowSize = width * 4;
+	image.m_width = width;
+	image.m_height = height;
+	image.m_pixels.resize(rowSize * height);
+	for(int y=0; y<height; y++)
+		memcpy(&image.m_pixels[y*rowSize], rowPtrs[y], rowSize);
+	image.m_ok = true;
 
-	//Figure out memory requirements of the buffer and decide what physical memory type to use
-	//For now, default to using the first type in the mask that is host visible
-	auto req = stagingBuf.getMemoryRequirements();
-	auto memProperties = g_vkComputePhysicalDevice->getMemoryProperties();
-	uint32_t memType = 0;
-	for(uint32_t i=0; i<32; i++)
+	//Clean up
+	png_destroy_read_struct(&png, &info, &end);
+	fclose(fp);
+}
+
+/**
+	@brief Loads a texture from a file into a named resource
+
+	If an existing texture by the same name already exists, it is overwritten.
+
+	Between BeginBatch() and EndBatch(), the texture isn't loaded until the batch ends.
+ */
+void TextureManager::LoadTexture(
+	const string& name,
+	const string& path)
+{
+	if(m_batchDepth > 0)
+		m_batch.push_back(pair<string, string>(name, path));
+	else
+		LoadTextures({ pair<string, string>(name, path) });
+}
+
+/**
+	@brief Starts collecting textures to load together
+
+	Batches may be nested, textures are loaded when the outermost batch ends.
+ */
+void TextureManager::BeginBatch()
+{
+	m_batchDepth ++;
+}
+
+/**
+	@brief Ends a batch started by BeginBatch(), loading all of its textures if it's the outermost one
+ */
+void TextureManager::EndBatch()
+{
+	m_batchDepth --;
+	if( (m_batchDepth == 0) && !m_batch.empty())
 	{
-		//Skip anything not host visible since we have to be able to write to it
-		if(!(memProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible))
+		vector<pair<string, string>> batch;
+		batch.swap(m_batch);
+		LoadTextures(batch);
+	}
+}
+
+/**
+	@brief Loads several textures from files
+
+	Files are decoded in parallel. All of the images share a single device memory allocation, and are uploaded from a
+	single staging buffer with one command buffer submission, rather than one of each per texture.
+
+	If an existing texture has the same name as one being loaded, it is overwritten. Files which fail to load are
+	skipped (with an error logged).
+
+	@param files	List of (name, path) pairs
+ */
+void TextureManager::LoadTextures(const vector<pair<string, string>>& files)
+{
+	if(files.empty())
+		return;
+
+	double tstart = GetTime();
+
+	//Decode everything, spreading files across threads
+	vector<DecodedImage> images(files.size());
+	atomic<size_t> next(0);
+	auto decodeTask = [&]()
+	{
+		size_t i;
+		while( (i = next++) < files.size())
+			DecodePNG(files[i].second, images[i]);
+	};
+	size_t nthreads = min(static_cast<size_t>(max(thread::hardware_concurrency(), 1u)), files.size());
+	vector<thread> threads;
+	for(size_t i=1; i<nthreads; i++)
+		threads.push_back(thread(decodeTask));
+	decodeTask();
+	for(auto& t : threads)
+		t.join();
+
+	double tdecode = GetTime();
+
+	//Create images and lay them out in memory
+	vector<vk::raii::Image> vkImages;
+	vector<size_t> imageIndexes;
+	vector<vk::DeviceSize> memOffsets;
+	vector<vk::DeviceSize> bufOffsets;
+	vk::DeviceSize memSize = 0;
+	vk::DeviceSize bufSize = 0;
+	uint32_t memTypeBits = 0xffffffff;
+	for(size_t i=0; i<images.size(); i++)
+	{
+		auto& img = images[i];
+		if(!img.m_ok)
 			continue;
+		LogTrace("Image \"%s\" is %d x %d pixels, RGBA8888\n", files[i].first.c_str(), img.m_width, img.m_height);
 
-		//Stop if buffer is compatible
-		if(req.memoryTypeBits & (1 << i) )
-		{
-			memType = i;
-			break;
-		}
+		vk::ImageCreateInfo imageInfo(
+			{},
+			vk::ImageType::e2D,
+			vk::Format::eR8G8B8A8Unorm,
+			vk::Extent3D(img.m_width, img.m_height, 1),
+			1,
+			1,
+			VULKAN_HPP_NAMESPACE::SampleCountFlagBits::e1,
+			VULKAN_HPP_NAMESPACE::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+			vk::SharingMode::eExclusive,
+			{},
+			vk::ImageLayout::eUndefined
+			);
+		vkImages.push_back(vk::raii::Image(*g_vkComputeDevice, imageInfo));
+
+		auto req = vkImages.back().getMemoryRequirements();
+		memSize = (memSize + req.alignment - 1) / req.alignment * req.alignment;
+		memOffsets.push_back(memSize);
+		memSize += req.size;
+		memTypeBits &= req.memoryTypeBits;
+
+		bufOffsets.push_back(bufSize);
+		bufSize += img.m_pixels.size();
+
+		imageIndexes.push_back(i);
 	}
-	LogTrace("Using memory type %u for staging buffer\n", memType);
+	if(vkImages.empty())
+		return;
+	if(memTypeBits == 0)
+	{
+		//Should never happen for identically formatted images, but don't crash if it does
+		LogError("Textures have no memory type in common, loading one at a time\n");
+		for(auto i : imageIndexes)
+			LoadTextures({ files[i] });
+		return;
+	}
+
+	//Allocate device memory for all of the images
+	auto memType = Texture::FindMemoryType(memTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	LogTrace("Using memory type %u for %zu textures (%zu bytes)\n", memType, vkImages.size(), (size_t)memSize);
+	auto deviceMemory = make_shared<vk::raii::DeviceMemory>(
+		*g_vkComputeDevice, vk::MemoryAllocateInfo(memSize, memType));
 
-	//Allocate the memory and bind to the buffer
-	vk::MemoryAllocateInfo minfo(req.size, memType);
-	vk::raii::DeviceMemory physMem(*g_vkComputeDevice, minfo);
+	//Allocate staging buffer and fill it with all of the pixel data
+	vk::BufferCreateInfo bufinfo({}, bufSize, vk::BufferUsageFlagBits::eTransferSrc);
+	vk::raii::Buffer stagingBuf(*g_vkComputeDevice, bufinfo);
+	auto req = stagingBuf.getMemoryRequirements();
+	auto stagingType = Texture::FindMemoryType(req.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible);
+	LogTrace("Using memory type %u for staging buffer\n", stagingType);
+	vk::raii::DeviceMemory physMem(*g_vkComputeDevice, vk::MemoryAllocateInfo(req.size, stagingType));
 	auto mappedPtr = reinterpret_cast<uint8_t*>(physMem.mapMemory(0, req.size));
 	stagingBuf.bindMemory(*physMem, 0);
-
-	//Fill the mapped buffer with image data from the PNG
-	size_t rowSize = width * bytesPerPixel;
-	for(int y=0; y<height; y++)
-		memcpy(mappedPtr + (y*rowSize), rowPtrs[y], rowSize);
+	for(size_t j=0; j<imageIndexes.size(); j++)
+	{
+		auto& pixels = images[imageIndexes[j]].m_pixels;
+		memcpy(mappedPtr + bufOffsets[j], pixels.data(), pixels.size());
+	}
 	physMem.unmapMemory();
 
-	//Make the texture object
-	vk::ImageCreateInfo imageInfo(
+	//Make the texture objects
+	vector<shared_ptr<Texture>> textures;
+	vector<vk::ImageMemoryBarrier> toTransfer;
+	vector<vk::ImageMemoryBarrier> toShader;
+	for(size_t j=0; j<vkImages.size(); j++)
+	{
+		auto& name = files[imageIndexes[j]].first;
+		auto tex = make_shared<Texture>(std::move(vkImages[j]), deviceMemory, memOffsets[j], this, name);
+		textures.push_back(tex);
+
+		toTransfer.push_back(Texture::MakeBarrier(
+			tex->GetImage(),
+			vk::AccessFlagBits::eNone,
+			vk::AccessFlagBits::eTransferWrite,
+			vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eTransferDstOptimal));
+		toShader.push_back(Texture::MakeBarrier(
+			tex->GetImage(),
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eTransferDstOptimal,
+			vk::ImageLayout::eShaderReadOnlyOptimal));
+	}
+
+	//Upload everything in one go
+	auto& cmdBuf = GetCmdBuffer();
+	cmdBuf.begin({});
+	cmdBuf.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTopOfPipe,
+		vk::PipelineStageFlagBits::eTransfer,
 		{},
-		vk::ImageType::e2D,
-		vk::Format::eR8G8B8A8Unorm,
-		vk::Extent3D(width, height, 1),
-		1,
-		1,
-		VULKAN_HPP_NAMESPACE::SampleCountFlagBits::e1,
-		VULKAN_HPP_NAMESPACE::ImageTiling::eOptimal,
-		vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-		vk::SharingMode::eExclusive,
 		{},
-		vk::ImageLayout::eUndefined
-		);
-	m_textures[name] = make_shared<Texture>(*g_vkComputeDevice, imageInfo, stagingBuf, width, height, this, name);
-
-	//Clean up
-	png_destroy_read_struct(&png, &info, &end);
-	fclose(fp);
+		{},
+		toTransfer);
+	for(size_t j=0; j<textures.size(); j++)
+	{
+		auto& img = images[imageIndexes[j]];
+		vk::ImageSubresourceLayers subresource(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+		vk::BufferImageCopy region(
+			bufOffsets[j], 0, 0, subresource, vk::Offset3D(0, 0, 0), vk::Extent3D(img.m_width, img.m_height, 1) );
+		cmdBuf.copyBufferToImage(*stagingBuf, textures[j]->GetImage(), vk::ImageLayout::eTransferDstOptimal, region);
+	}
+	cmdBuf.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,
+		vk::PipelineStageFlagBits::eFragmentShader,
+		{},
+		{},
+		{},
+		toShader);
+	cmdBuf.end();
+	m_queue->SubmitAndBlock(cmdBuf);
+
+	//Only publish them once the upload is complete
+	for(size_t j=0; j<textures.size(); j++)
+		m_textures[files[imageIndexes[j]].first] = textures[j];
+
+	double tend = GetTime();
+	LogDebug("Loaded %zu textures (%.1f kB) in %.2f ms: decode %.2f ms (%zu threads), upload %.2f ms\n",
+		textures.size(),
+		bufSize / 1024.0,
+		(tend - tstart) * 1000,
+		(tdecode - tstart) * 1000,
+		nthreads,
+		(tend - tdecode) * 1000);
 }
@@ -62,6 +62,14 @@ public:
 		const std::string& name = ""
 		);
 
+	Texture(
+		vk::raii::Image&& image,
+		std::shared_ptr<vk::raii::DeviceMemory> memory,
+		vk::DeviceSize offset,
+		TextureManager* mgr,
+		const std::string& name = ""
+		);
+
 	~Texture();
 
 	ImTextureID GetTexture()
@@ -75,6 +83,15 @@ public:
 
 	void SetName(const std::string& name);
 
+	static vk::ImageMemoryBarrier MakeBarrier(
+		vk::Image image,
+		vk::AccessFlags src,
+		vk::AccessFlags dst,
+		vk::ImageLayout from,
+		vk::ImageLayout to);
+
+	static uint32_t FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags flags);
+
 protected:
 	void LayoutTransition(
 		vk::raii::CommandBuffer& cmdBuf,
@@ -91,8 +108,8 @@ protected:
 
 	ImTextureID m_texture;
 
-	///@brief Device memory backing the image
-	std::unique_ptr<vk::raii::DeviceMemory> m_deviceMemory;
+	///@brief Device memory backing the image (may be shared with other textures loaded in the same batch)
+	std::shared_ptr<vk::raii::DeviceMemory> m_deviceMemory;
 };
 
 /**
@@ -108,6 +125,11 @@ public:
 		const std::string& name,
 		const std::string& path);
 
+	void LoadTextures(const std::vector<std::pair<std::string, std::string>>& files);
+
+	void BeginBatch();
+	void EndBatch();
+
 	ImTextureID GetTexture(const std::string& name)
 	{
 		auto it = m_textures.find(name);
@@ -139,6 +161,12 @@ public:
 protected:
 	std::map<std::string, std::shared_ptr<Texture> > m_textures;
 
+	///@brief Nesting depth of BeginBatch() calls
+	int m_batchDepth;
+
+	///@brief Textures (name, path) waiting to be loaded when the outermost batch ends
+	std::vector<std::pair<std::string, std::string>> m_batch;
+
 	///@brief Sampler for textures
 	std::unique_ptr<vk::raii::Sampler> m_sampler;
 
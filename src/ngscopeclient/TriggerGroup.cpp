@@ -30,9 +30,16 @@
 #include "ngscopeclient.h"
 #include "TriggerGroup.h"
 #include "Session.h"
+#include "FilterProfiler.h"
 
 using namespace std;
 
+///@brief Default limit on pending waveform data per instrument
+static const int64_t g_defaultMaxPendingBytes = 1024LL * 1024LL * 1024LL;
+
+///@brief Pending waveform limit for instruments we haven't downloaded anything from yet, so don't know the size of
+static const size_t g_maxPendingWaveformsUnknownSize = 5;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
@@ -41,6 +48,10 @@ TriggerGroup::TriggerGroup(shared_ptr<Oscilloscope> primary, Session* session)
 	, m_default(true)
 	, m_session(session)
 	, m_multiScopeFreeRun(false)
+	, m_acquisitionPolicy(POLICY_BLOCK)
+	, m_maxPendingBytes(g_defaultMaxPendingBytes)
+	, m_processedTriggers(0)
+	, m_droppedTriggers(0)
 {
 }
 
@@ -95,6 +106,11 @@ void TriggerGroup::AddSecondary(shared_ptr<Oscilloscope> scope)
 
 void TriggerGroup::RemoveScope(shared_ptr<Oscilloscope> scope)
 {
+	{
+		lock_guard<mutex> lock(m_waveformBytesMutex);
+		m_waveformBytes.erase(scope.get());
+	}
+
 	if(m_primary == scope)
 	{
 		//If we have any secondaries, promote the first secondary to primary
@@ -350,19 +366,49 @@ bool TriggerGroup::CheckForPendingWaveforms()
 
 /**
 	@brief Grab waveforms from the group
+
+	Must be called with the waveform data mutex held.
+
+	@return True if every scope in the group had a waveform ready, false if there was nothing to download
  */
-void TriggerGroup::DownloadWaveforms()
+bool TriggerGroup::DownloadWaveforms()
 {
+	//Don't let the instrument threads trim the pending queues while we're popping from them
+	lock_guard<mutex> lock(m_pendingQueueMutex);
+	if(!CheckForPendingWaveforms())
+		return false;
+
+	m_processedTriggers ++;
+
+	//If we're falling behind, skip ahead to the most recent trigger if configured to do so
+	if(m_acquisitionPolicy == POLICY_DROP_OLDEST)
+		m_droppedTriggers += DropOldestPendingWaveforms();
+
 	//Grab the data from the primary
 	if(!m_primary->IsAppendingToWaveform())
 		DetachAllWaveforms(m_primary);
 	m_primary->PopPendingWaveform();
+	UpdateWaveformSize(m_primary);
 
-	//All good if we're a single-scope trigger group.
-	//If not, we have more work to do
-	if(m_secondaries.empty())
-		return;
+	//Multi-scope groups have more work to do
+	if(!m_secondaries.empty())
+		DownloadSecondaryWaveforms();
 
+	//If we're falling behind, throw away everything that came in after this trigger if configured to do so.
+	//Every scope has to pop its part of this trigger first, or the secondaries would lose it.
+	if(m_acquisitionPolicy == POLICY_DROP_NEWEST)
+		m_droppedTriggers += DropNewestPendingWaveforms();
+
+	return true;
+}
+
+/**
+	@brief Grabs the current trigger from every secondary and patches its timestamps to match the primary's
+
+	Must be called after popping the primary's waveform.
+ */
+void TriggerGroup::DownloadSecondaryWaveforms()
+{
 	LogTrace("Multi scope: patching timestamps\n");
 
 	//Get the timestamp of the primary scope's first waveform
@@ -395,6 +441,7 @@ void TriggerGroup::DownloadWaveforms()
 		if(!scope->IsAppendingToWaveform())
 			DetachAllWaveforms(scope);
 		scope->PopPendingWaveform();
+		UpdateWaveformSize(scope);
 
 		for(size_t j=0; j<scope->GetChannelCount(); j++)
 		{
@@ -434,3 +481,293 @@ void TriggerGroup::RearmIfMultiScope()
 	if(m_multiScopeFreeRun)
 		Arm(TRIGGER_TYPE_NORMAL);
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Backpressure
+
+/**
+	@brief Deletes the current waveforms on all channels of a scope, without saving them to history
+ */
+void TriggerGroup::DeleteAllWaveforms(shared_ptr<Oscilloscope> scope)
+{
+	for(size_t i=0; i<scope->GetChannelCount(); i++)
+	{
+		auto chan = scope->GetOscilloscopeChannel(i);
+		if(!chan)
+			continue;
+
+		for(size_t j=0; j<chan->GetStreamCount(); j++)
+		{
+			auto data = chan->GetData(j);
+			chan->Detach(j);
+			delete data;
+		}
+	}
+}
+
+/**
+	@brief Records the size of the waveform most recently downloaded from a scope
+
+	This is used to estimate how much memory the rest of the scope's pending queue is taking up.
+ */
+void TriggerGroup::UpdateWaveformSize(shared_ptr<Oscilloscope> scope)
+{
+	int64_t bytes = 0;
+	for(size_t i=0; i<scope->GetChannelCount(); i++)
+	{
+		auto chan = scope->GetOscilloscopeChannel(i);
+		if(!chan)
+			continue;
+
+		for(size_t j=0; j<chan->GetStreamCount(); j++)
+			bytes += FilterProfiler::GetSampleBytes(chan->GetData(j));
+	}
+
+	lock_guard<mutex> lock(m_waveformBytesMutex);
+	m_waveformBytes[scope.get()] = bytes;
+}
+
+/**
+	@brief Gets the estimated size of a scope's pending waveform queue, in bytes
+
+	@return Estimated queue size, or -1 if we haven't seen a waveform from this scope yet so can't tell
+ */
+int64_t TriggerGroup::GetPendingBytes(shared_ptr<Oscilloscope> scope)
+{
+	int64_t npending = scope->GetPendingWaveformCount();
+
+	lock_guard<mutex> lock(m_waveformBytesMutex);
+	auto it = m_waveformBytes.find(scope.get());
+	if(it == m_waveformBytes.end())
+		return -1;
+	return npending * it->second;
+}
+
+/**
+	@brief Checks if a scope in this group has enough waveforms queued that we should stop pulling more from it
+
+	There is always room for at least one waveform, no matter how big it is.
+ */
+bool TriggerGroup::IsQueueFull(shared_ptr<Oscilloscope> scope)
+{
+	size_t npending = scope->GetPendingWaveformCount();
+	if(npending == 0)
+		return false;
+
+	auto bytes = GetPendingBytes(scope);
+	if(bytes < 0)
+		return npending >= g_maxPendingWaveformsUnknownSize;
+	return bytes >= m_maxPendingBytes;
+}
+
+/**
+	@brief If the queue is full, discard all but the most recent pending waveform on every scope in the group
+
+	Must be called with the waveform data mutex held, before popping the waveform to be processed.
+
+	@return Number of triggers discarded
+ */
+size_t TriggerGroup::DropOldestPendingWaveforms()
+{
+	//Can't drop part of a waveform that's still being assembled
+	//and the backlog isn't a problem until we've hit our limit
+	if(m_primary->IsAppendingToWaveform() || !IsQueueFull(m_primary))
+		return 0;
+
+	//Drop the same number of triggers from every scope so the group stays aligned
+	size_t ndrop = m_primary->GetPendingWaveformCount() - 1;
+	for(auto scope : m_secondaries)
+	{
+		if(scope->IsAppendingToWaveform())
+			return 0;
+		ndrop = min(ndrop, scope->GetPendingWaveformCount() - 1);
+	}
+	if(ndrop == 0)
+		return 0;
+
+	LogTrace("Processing is falling behind, dropping %zu oldest pending waveforms\n", ndrop);
+
+	//The current waveform belongs to history, so don't delete it.
+	//Pop each stale waveform onto the channels, then delete it
+	DetachAllWaveforms(m_primary);
+	for(auto scope : m_secondaries)
+		DetachAllWaveforms(scope);
+	for(size_t i=0; i<ndrop; i++)
+	{
+		m_primary->PopPendingWaveform();
+		DeleteAllWaveforms(m_primary);
+
+		for(auto scope : m_secondaries)
+		{
+			scope->PopPendingWaveform();
+			DeleteAllWaveforms(scope);
+		}
+	}
+
+	return ndrop;
+}
+
+/**
+	@brief If the queue is full, discard every pending waveform newer than the one we just popped
+
+	Must be called with the waveform data mutex held, after popping the waveform to be processed on every scope.
+
+	@return Number of triggers discarded
+ */
+size_t TriggerGroup::DropNewestPendingWaveforms()
+{
+	//Check the limit including the waveform we just popped, since that's what we're about to be busy with
+	size_t npending = m_primary->GetPendingWaveformCount();
+	if(m_primary->IsAppendingToWaveform() || (npending == 0) )
+		return 0;
+
+	auto bytes = GetPendingBytes(m_primary);
+	if(bytes < 0)
+	{
+		if( (npending + 1) < g_maxPendingWaveformsUnknownSize)
+			return 0;
+	}
+	else
+	{
+		lock_guard<mutex> lock(m_waveformBytesMutex);
+		if( (bytes + m_waveformBytes[m_primary.get()]) < m_maxPendingBytes)
+			return 0;
+	}
+
+	LogTrace("Processing is falling behind, dropping %zu newest pending waveforms\n", npending);
+
+	m_primary->ClearPendingWaveforms();
+	for(auto scope : m_secondaries)
+		scope->ClearPendingWaveforms();
+
+	return npending;
+}
+
+/**
+	@brief Makes room in a full pending queue so the instrument thread can keep pulling data
+
+	Everything pending is newer than the waveform currently being processed, so under either drop policy the backlog
+	is what gets discarded.
+
+	The driver appends to each scope's queue from that scope's own instrument thread, under a lock private to the
+	driver, so other queues in the group may grow while we work. We therefore drop the same number of triggers from
+	the front of every queue, no more than the shortest queue holds. Pushes only ever make queues longer, so that
+	many triggers are present on every scope and the group stays aligned. Each pop is atomic with respect to the
+	driver's push.
+
+	@param scope	The scope whose queue is full
+
+	@return True if the queue was trimmed, false if the instrument thread should stop pulling data until the
+			backlog has been processed (POLICY_BLOCK, a waveform is still being appended to, or the waveform data
+			is busy)
+ */
+bool TriggerGroup::TrimPendingWaveforms(shared_ptr<Oscilloscope> scope)
+{
+	if(m_acquisitionPolicy == POLICY_BLOCK)
+		return false;
+
+	//Popping waveforms touches the channels, so we need the same locks as DownloadWaveforms(), in the same order.
+	//Don't stall the instrument thread waiting for the filter graph, just try again next time around.
+	unique_lock<shared_mutex> dataLock(m_session->GetWaveformDataMutex(), try_to_lock);
+	if(!dataLock.owns_lock())
+		return false;
+	lock_guard<mutex> lock(m_pendingQueueMutex);
+	if(!IsQueueFull(scope))
+		return true;
+
+	//Can't drop part of a waveform that's still being assembled
+	size_t ndrop = m_primary->GetPendingWaveformCount();
+	if(m_primary->IsAppendingToWaveform())
+		return false;
+	for(auto s : m_secondaries)
+	{
+		if(s->IsAppendingToWaveform())
+			return false;
+		ndrop = min(ndrop, s->GetPendingWaveformCount());
+	}
+
+	//Another scope hasn't caught up yet, wait for it
+	if(ndrop == 0)
+		return false;
+
+	LogTrace("Processing is falling behind, dropping %zu pending waveforms\n", ndrop);
+
+	DiscardPendingWaveforms(m_primary, ndrop);
+	for(auto s : m_secondaries)
+		DiscardPendingWaveforms(s, ndrop);
+
+	m_droppedTriggers += ndrop;
+	return true;
+}
+
+/**
+	@brief Deletes the oldest pending waveforms from a scope, leaving the waveforms currently on its channels alone
+
+	Must be called with the waveform data mutex held exclusively.
+
+	@param scope	The scope to trim
+	@param ndrop	Number of pending waveforms to delete
+ */
+void TriggerGroup::DiscardPendingWaveforms(shared_ptr<Oscilloscope> scope, size_t ndrop)
+{
+	//Set the current waveforms aside while we pop the stale ones onto the channels
+	vector<pair<OscilloscopeChannel*, size_t> > streams;
+	vector<WaveformBase*> current;
+	for(size_t i=0; i<scope->GetChannelCount(); i++)
+	{
+		auto chan = scope->GetOscilloscopeChannel(i);
+		if(!chan)
+			continue;
+
+		for(size_t j=0; j<chan->GetStreamCount(); j++)
+		{
+			streams.push_back(pair<OscilloscopeChannel*, size_t>(chan, j));
+			current.push_back(chan->GetData(j));
+			chan->Detach(j);
+		}
+	}
+
+	for(size_t i=0; i<ndrop; i++)
+	{
+		scope->PopPendingWaveform();
+		DeleteAllWaveforms(scope);
+	}
+
+	//Put them back
+	for(size_t i=0; i<streams.size(); i++)
+		streams[i].first->SetData(current[i], streams[i].second);
+}
+
+/**
+	@brief Gets the human readable name of an acquisition policy
+ */
+string TriggerGroup::GetPolicyName(AcquisitionPolicy policy)
+{
+	switch(policy)
+	{
+		case POLICY_DROP_OLDEST:
+			return "Drop oldest";
+
+		case POLICY_DROP_NEWEST:
+			return "Drop newest";
+
+		case POLICY_BLOCK:
+		default:
+			return "Block";
+	}
+}
+
+/**
+	@brief Looks up an acquisition policy by its human readable name
+
+	Unrecognized names map to POLICY_BLOCK.
+ */
+TriggerGroup::AcquisitionPolicy TriggerGroup::GetPolicyByName(const string& name)
+{
+	if(name == "Drop oldest")
+		return POLICY_DROP_OLDEST;
+	else if(name == "Drop newest")
+		return POLICY_DROP_NEWEST;
+	else
+		return POLICY_BLOCK;
+}
@@ -62,6 +62,19 @@ public:
 		TRIGGER_TYPE_NORMAL
 	};
 
+	///@brief What to do with the pending waveform queue if processing can't keep up with the instruments
+	enum AcquisitionPolicy
+	{
+		///@brief Stop pulling data from the instruments until the backlog has been processed
+		POLICY_BLOCK,
+
+		///@brief Skip straight to the most recent pending waveform, discarding everything older
+		POLICY_DROP_OLDEST,
+
+		///@brief Process the oldest pending waveform and discard everything newer
+		POLICY_DROP_NEWEST
+	};
+
 	TriggerGroup(std::shared_ptr<Oscilloscope> primary, Session* session);
 	virtual ~TriggerGroup();
 
@@ -75,9 +88,43 @@ public:
 	void Arm(TriggerType type);
 	void Stop();
 	bool CheckForPendingWaveforms();
-	void DownloadWaveforms();
+	bool DownloadWaveforms();
 	void RearmIfMultiScope();
 
+	bool IsQueueFull(std::shared_ptr<Oscilloscope> scope);
+	bool TrimPendingWaveforms(std::shared_ptr<Oscilloscope> scope);
+	int64_t GetPendingBytes(std::shared_ptr<Oscilloscope> scope);
+
+	static std::string GetPolicyName(AcquisitionPolicy policy);
+	static AcquisitionPolicy GetPolicyByName(const std::string& name);
+
+	AcquisitionPolicy GetAcquisitionPolicy()
+	{ return m_acquisitionPolicy; }
+
+	void SetAcquisitionPolicy(AcquisitionPolicy policy)
+	{ m_acquisitionPolicy = policy; }
+
+	/**
+		@brief Gets the maximum amount of pending waveform data, in bytes, queued per instrument
+	 */
+	int64_t GetMaxPendingBytes()
+	{ return m_maxPendingBytes; }
+
+	void SetMaxPendingBytes(int64_t bytes)
+	{ m_maxPendingBytes = bytes; }
+
+	/**
+		@brief Gets the number of triggers processed since the group was created
+	 */
+	uint64_t GetProcessedTriggerCount()
+	{ return m_processedTriggers; }
+
+	/**
+		@brief Gets the number of triggers discarded by the acquisition policy since the group was created
+	 */
+	uint64_t GetDroppedTriggerCount()
+	{ return m_droppedTriggers; }
+
 	bool empty()
 	{ return m_secondaries.empty() && (m_primary == nullptr) && m_filters.empty(); }
 
@@ -99,11 +146,38 @@ public:
 
 protected:
 	void DetachAllWaveforms(std::shared_ptr<Oscilloscope> scope);
+	void DeleteAllWaveforms(std::shared_ptr<Oscilloscope> scope);
+	void DiscardPendingWaveforms(std::shared_ptr<Oscilloscope> scope, size_t ndrop);
+	void UpdateWaveformSize(std::shared_ptr<Oscilloscope> scope);
+	void DownloadSecondaryWaveforms();
+	size_t DropOldestPendingWaveforms();
+	size_t DropNewestPendingWaveforms();
 
 	Session* m_session;
 
 	///@brief True if we have multiple scopes and are in normal trigger mode
 	bool m_multiScopeFreeRun;
+
+	///@brief Backlog handling when processing falls behind
+	std::atomic<AcquisitionPolicy> m_acquisitionPolicy;
+
+	///@brief Maximum size of the pending waveform queue for each instrument in the group
+	std::atomic<int64_t> m_maxPendingBytes;
+
+	///@brief Number of triggers processed
+	std::atomic<uint64_t> m_processedTriggers;
+
+	///@brief Number of triggers discarded by the acquisition policy
+	std::atomic<uint64_t> m_droppedTriggers;
+
+	///@brief Serializes trimming of the pending queues by instrument threads against DownloadWaveforms()
+	std::mutex m_pendingQueueMutex;
+
+	///@brief Mutex protecting m_waveformBytes
+	std::mutex m_waveformBytesMutex;
+
+	///@brief Size of the most recent waveform downloaded from each instrument, used to size its pending queue
+	std::map<Oscilloscope*, int64_t> m_waveformBytes;
 };
 
 #endif
@@ -59,6 +59,10 @@ DisplayedChannel::DisplayedChannel(StreamDescriptor stream, Session& session)
 		, m_rasterizedY(0)
 		, m_cachedX(0)
 		, m_cachedY(0)
+		, m_pendingFilterWidth(0)
+		, m_pendingFilterHeight(0)
+		, m_pendingFilterResizeTime(0)
+		, m_filterResizePending(false)
 		, m_persistenceEnabled(false)
 		, m_yButtonPos(0)
 {
@@ -75,32 +79,38 @@ DisplayedChannel::DisplayedChannel(StreamDescriptor stream, Session& session)
 	m_indexBuffer.SetCpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
 	m_indexBuffer.SetGpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_UNLIKELY);
 
-	//Create tone map pipeline depending on waveform type
+	//Select tone map shader depending on waveform type
+	//(the pipeline itself comes from the session's registry, shared with other channels of the same type)
 	switch(m_stream.GetType())
 	{
 		case Stream::STREAM_TYPE_EYE:
-			m_toneMapPipe = make_shared<ComputePipeline>(
-				"shaders/EyeToneMap.spv", 1, sizeof(EyeToneMapArgs), 1, 1);
+			m_toneMapShader = "shaders/EyeToneMap.spv";
+			m_toneMapPushConstantSize = sizeof(EyeToneMapArgs);
+			m_toneMapSampledImages = 1;
 			break;
 
 		case Stream::STREAM_TYPE_CONSTELLATION:
-			m_toneMapPipe = make_shared<ComputePipeline>(
-				"shaders/ConstellationToneMap.spv", 1, sizeof(ConstellationToneMapArgs), 1, 1);
+			m_toneMapShader = "shaders/ConstellationToneMap.spv";
+			m_toneMapPushConstantSize = sizeof(ConstellationToneMapArgs);
+			m_toneMapSampledImages = 1;
 			break;
 
 		case Stream::STREAM_TYPE_WATERFALL:
-			m_toneMapPipe = make_shared<ComputePipeline>(
-				"shaders/WaterfallToneMap.spv", 1, sizeof(WaterfallToneMapArgs), 1, 1);
+			m_toneMapShader = "shaders/WaterfallToneMap.spv";
+			m_toneMapPushConstantSize = sizeof(WaterfallToneMapArgs);
+			m_toneMapSampledImages = 1;
 			break;
 
 		case Stream::STREAM_TYPE_SPECTROGRAM:
-			m_toneMapPipe = make_shared<ComputePipeline>(
-				"shaders/SpectrogramToneMap.spv", 1, sizeof(SpectrogramToneMapArgs), 1, 1);
+			m_toneMapShader = "shaders/SpectrogramToneMap.spv";
+			m_toneMapPushConstantSize = sizeof(SpectrogramToneMapArgs);
+			m_toneMapSampledImages = 1;
 			break;
 
 		default:
-			m_toneMapPipe = make_shared<ComputePipeline>(
-				"shaders/WaveformToneMap.spv", 1, sizeof(WaveformToneMapArgs), 1);
+			m_toneMapShader = "shaders/WaveformToneMap.spv";
+			m_toneMapPushConstantSize = sizeof(WaveformToneMapArgs);
+			m_toneMapSampledImages = 0;
 	}
 }
 
@@ -122,6 +132,89 @@ DisplayedChannel::~DisplayedChannel()
 	}
 }
 
+/**
+	@brief Gets the pipeline for drawing uniform analog waveforms into a command buffer
+ */
+shared_ptr<ComputePipeline> DisplayedChannel::GetUniformAnalogPipeline(vk::raii::CommandBuffer& cmdbuf)
+{
+	string base = "shaders/waveform-compute.";
+	string suffix;
+	if(ZeroHoldFlagSet())
+		suffix += ".zerohold";
+	if(g_hasShaderInt64)
+		suffix += ".int64";
+	return m_session.GetPipelineRegistry().Acquire(
+		cmdbuf, base + "analog" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
+}
+
+/**
+	@brief Gets the pipeline for drawing histogram waveforms into a command buffer
+ */
+shared_ptr<ComputePipeline> DisplayedChannel::GetHistogramPipeline(vk::raii::CommandBuffer& cmdbuf)
+{
+	string base = "shaders/waveform-compute.";
+	string suffix;
+	if(g_hasShaderInt64)
+		suffix += ".int64";
+	return m_session.GetPipelineRegistry().Acquire(
+		cmdbuf, base + "histogram" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
+}
+
+/**
+	@brief Gets the pipeline for drawing sparse analog waveforms into a command buffer
+ */
+shared_ptr<ComputePipeline> DisplayedChannel::GetSparseAnalogPipeline(vk::raii::CommandBuffer& cmdbuf)
+{
+	string base = "shaders/waveform-compute.";
+	string suffix;
+	int durationSSBOs = 0;
+	if(ZeroHoldFlagSet())
+	{
+		suffix += ".zerohold";
+		durationSSBOs++;
+	}
+	if(g_hasShaderInt64)
+		suffix += ".int64";
+	return m_session.GetPipelineRegistry().Acquire(
+		cmdbuf, base + "analog" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants));
+}
+
+/**
+	@brief Gets the pipeline for drawing uniform digital waveforms into a command buffer
+ */
+shared_ptr<ComputePipeline> DisplayedChannel::GetUniformDigitalPipeline(vk::raii::CommandBuffer& cmdbuf)
+{
+	string base = "shaders/waveform-compute.";
+	string suffix;
+	if(g_hasShaderInt64)
+		suffix += ".int64";
+	return m_session.GetPipelineRegistry().Acquire(
+		cmdbuf, base + "digital" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
+}
+
+/**
+	@brief Gets the pipeline for drawing sparse digital waveforms into a command buffer
+ */
+shared_ptr<ComputePipeline> DisplayedChannel::GetSparseDigitalPipeline(vk::raii::CommandBuffer& cmdbuf)
+{
+	string base = "shaders/waveform-compute.";
+	string suffix;
+	int durationSSBOs = 0;	//TODO: support gaps
+	if(g_hasShaderInt64)
+		suffix += ".int64";
+	return m_session.GetPipelineRegistry().Acquire(
+		cmdbuf, base + "digital" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants));
+}
+
+/**
+	@brief Gets the pipeline for tone mapping this channel into a command buffer
+ */
+shared_ptr<ComputePipeline> DisplayedChannel::GetToneMapPipeline(vk::raii::CommandBuffer& cmdbuf)
+{
+	return m_session.GetPipelineRegistry().Acquire(
+		cmdbuf, m_toneMapShader, 1, m_toneMapPushConstantSize, 1, m_toneMapSampledImages);
+}
+
 /**
 	@brief Handles a change in size of the displayed waveform
 
@@ -149,6 +242,20 @@ bool DisplayedChannel::UpdateSize(ImVec2 newSize, MainWindow* top)
 			LogTrace("Hardware eye resolution changed, processing resize\n");
 	}
 
+	//Waterfalls and constellations have to re-run the filter to change resolution, which is far too slow to do
+	//during layout. Hand it off to the waveform thread once the plot size has settled.
+	if(waterfall || constellation)
+		RequestFilterResize(x, y);
+
+	//Constellations are tone mapped 1:1 from the filter output, so the texture tracks the output resolution and not
+	//the plot size. The old texture gets stretched to fit until the resized output is ready.
+	auto cdata = dynamic_cast<DensityFunctionWaveform*>(data);
+	if(constellation && cdata)
+	{
+		x = cdata->GetWidth();
+		y = cdata->GetHeight();
+	}
+
 	if( (m_cachedX != x) || (m_cachedY != y) )
 	{
 		m_cachedX = x;
@@ -186,38 +293,8 @@ bool DisplayedChannel::UpdateSize(ImVec2 newSize, MainWindow* top)
 			}
 		}
 
-		//Waterfalls only care about height
-		else if(waterfall)
-		{
-			if(waterfall->GetHeight() != roundedY)
-			{
-				waterfall->SetHeight(roundedY);
-
-				FilterGraphExecutor ex;
-				set<FlowGraphNode*> nodesToUpdate;
-				nodesToUpdate.emplace(waterfall);
-				ex.RunBlocking(nodesToUpdate);
-			}
-
-			//Rendered image should be the actual plot size
-		}
-
-		else if(constellation)
-		{
-			if( (constellation->GetWidth() != roundedX) || (constellation->GetHeight() != roundedY) )
-			{
-				constellation->SetWidth(roundedX);
-				constellation->SetHeight(roundedY);
-
-				FilterGraphExecutor ex;
-				set<FlowGraphNode*> nodesToUpdate;
-				nodesToUpdate.emplace(constellation);
-				ex.RunBlocking(nodesToUpdate);
-			}
-
-			x = roundedX;
-			y = roundedY;
-		}
+		//Waterfalls are resampled to the actual plot size by the tone mapper, so the texture can be resized
+		//right away even if the filter output is still at the old height
 
 		LogTrace("Displayed channel resized (to %zu x %zu), reallocating texture\n", x, y);
 
@@ -275,6 +352,58 @@ bool DisplayedChannel::UpdateSize(ImVec2 newSize, MainWindow* top)
 	return false;
 }
 
+/**
+	@brief Requests that a waterfall or constellation filter re-run at a resolution matching the plot size
+
+	Called every frame. Requests are debounced so that dragging a splitter doesn't re-run the filter at every
+	intermediate size: nothing is sent to the session until the rounded size has been stable for a short while.
+
+	@param width	Plot width, in pixels
+	@param height	Plot height, in pixels
+ */
+void DisplayedChannel::RequestFilterResize(size_t width, size_t height)
+{
+	//How long the rounded size has to stay put before we act on it
+	const double settleTime = 0.15;
+
+	auto waterfall = dynamic_cast<Waterfall*>(m_stream.m_channel);
+	auto constellation = dynamic_cast<ConstellationFilter*>(m_stream.m_channel);
+	if( (width == 0) || (height == 0) || (!waterfall && !constellation) )
+		return;
+
+	//To avoid constantly re-running the filter if we slightly resize stuff, round up to next power of 2
+	size_t roundedX = pow(2, ceil(log2(width)));
+	size_t roundedY = pow(2, ceil(log2(height)));
+
+	//Size changed? Restart the timer
+	if( (roundedX != m_pendingFilterWidth) || (roundedY != m_pendingFilterHeight) )
+	{
+		m_pendingFilterWidth = roundedX;
+		m_pendingFilterHeight = roundedY;
+		m_pendingFilterResizeTime = GetTime();
+		m_filterResizePending = true;
+		return;
+	}
+
+	if(!m_filterResizePending || ( (GetTime() - m_pendingFilterResizeTime) < settleTime) )
+		return;
+	m_filterResizePending = false;
+
+	//Nothing to do if the filter is already at the right size
+	if(waterfall)
+	{
+		if(waterfall->GetHeight() == roundedY)
+			return;
+		m_session.QueueFilterResize(waterfall, 0, roundedY);
+	}
+	else
+	{
+		if( (constellation->GetWidth() == roundedX) && (constellation->GetHeight() == roundedY) )
+			return;
+		m_session.QueueFilterResize(constellation, roundedX, roundedY);
+	}
+}
+
 /**
 	@brief Prepares to rasterize the waveform at the specified resolution
  */
@@ -337,6 +466,7 @@ WaveformArea::WaveformArea(StreamDescriptor stream, shared_ptr<WaveformGroup> gr
 	, m_triggerDuringDrag(nullptr)
 	, m_bertChannelDuringDrag(nullptr)
 	, m_lastRightClickOffset(0)
+	, m_lastWaveformTimestamp(0, 0)
 	, m_channelButtonHeight(0)
 	, m_dragPeakLabel(nullptr)
 	, m_mouseOverButton(false)
@@ -636,7 +766,10 @@ bool WaveformArea::Render(int iArea, int numAreas, ImVec2 clientArea)
 		PlotContextMenu();
 
 		//Draw actual waveforms (and protocol decode overlays)
-		RenderWaveforms(pos, csize);
+		if(m_parent->IsDrawingStaleWaveforms())
+			RenderStaleWaveforms(pos, csize);
+		else
+			RenderWaveforms(pos, csize);
 
 		ImGui::SetItemKeyOwner(ImGuiKey_MouseWheelY);
 		ImGui::SetItemKeyOwner(ImGuiKey_MouseWheelX);
@@ -817,6 +950,55 @@ void WaveformArea::RenderWaveforms(ImVec2 start, ImVec2 size)
 	}
 }
 
+/**
+	@brief Renders the last tone mapped textures for our waveforms, without touching waveform data
+
+	Used while the filter graph is rewriting its outputs. Protocol decodes and overlays that are drawn directly from
+	the waveform data are left out until the new outputs are published.
+ */
+void WaveformArea::RenderStaleWaveforms(ImVec2 start, ImVec2 size)
+{
+	auto list = ImGui::GetWindowDrawList();
+
+	for(auto& chan : m_displayedChannels)
+	{
+		auto tex = chan->GetTexture();
+		if(tex == nullptr)
+			continue;
+
+		switch(chan->GetStream().GetType())
+		{
+			case Stream::STREAM_TYPE_ANALOG:
+			case Stream::STREAM_TYPE_EYE:
+			case Stream::STREAM_TYPE_CONSTELLATION:
+			case Stream::STREAM_TYPE_WATERFALL:
+			case Stream::STREAM_TYPE_SPECTROGRAM:
+				list->AddImage(
+					tex->GetTexture(),
+					start,
+					ImVec2(start.x+size.x, start.y+size.y),
+					ImVec2(0, 1),
+					ImVec2(1, 0) );
+				break;
+
+			case Stream::STREAM_TYPE_DIGITAL:
+				{
+					auto ypos = (chan->GetYButtonPos() * ImGui::GetWindowDpiScale()) + start.y;
+					list->AddImage(
+						tex->GetTexture(),
+						ImVec2(start.x, ypos - m_channelButtonHeight),
+						ImVec2(start.x+size.x, ypos),
+						ImVec2(0, 1),
+						ImVec2(1, 0) );
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
 /**
 	@brief Renders a single analog waveform
  */
@@ -1795,16 +1977,16 @@ void WaveformArea::RasterizeAnalogOrDigitalWaveform(
 	if(uadata)
 	{
 		if(channel->ShouldFillUnder())
-			comp = channel->GetHistogramPipeline();
+			comp = channel->GetHistogramPipeline(cmdbuf);
 		else
-			comp = channel->GetUniformAnalogPipeline();
+			comp = channel->GetUniformAnalogPipeline(cmdbuf);
 	}
 	else if(uddata)
-		comp = channel->GetUniformDigitalPipeline();
+		comp = channel->GetUniformDigitalPipeline(cmdbuf);
 	else if(sadata)
-		comp = channel->GetSparseAnalogPipeline();
+		comp = channel->GetSparseAnalogPipeline(cmdbuf);
 	else if(sddata)
-		comp = channel->GetSparseDigitalPipeline();
+		comp = channel->GetSparseDigitalPipeline(cmdbuf);
 	if(!comp)
 	{
 		LogWarning("no pipeline found\n");
@@ -1913,7 +2095,7 @@ void WaveformArea::ToneMapAnalogOrDigitalWaveform(shared_ptr<DisplayedChannel> c
 		return;
 
 	//Run the actual compute shader
-	auto pipe = channel->GetToneMapPipeline();
+	auto pipe = channel->GetToneMapPipeline(cmdbuf);
 	pipe->BindBufferNonblocking(0, channel->GetRasterizedWaveform(), cmdbuf);
 	pipe->BindStorageImage(
 		1,
@@ -1964,7 +2146,7 @@ void WaveformArea::ToneMapWaterfallWaveform(std::shared_ptr<DisplayedChannel> ch
 		return;
 
 	//Run the actual compute shader
-	auto pipe = channel->GetToneMapPipeline();
+	auto pipe = channel->GetToneMapPipeline(cmdbuf);
 	const auto& texmgr = m_parent->GetTextureManager();
 	pipe->BindBufferNonblocking(0, data->GetOutData(), cmdbuf);
 	pipe->BindStorageImage(
@@ -2027,7 +2209,7 @@ void WaveformArea::ToneMapSpectrogramWaveform(std::shared_ptr<DisplayedChannel>
 		return;
 
 	//Run the actual compute shader
-	auto pipe = channel->GetToneMapPipeline();
+	auto pipe = channel->GetToneMapPipeline(cmdbuf);
 	const auto& texmgr = m_parent->GetTextureManager();
 	pipe->BindBufferNonblocking(0, data->GetOutData(), cmdbuf);
 	pipe->BindStorageImage(
@@ -2100,7 +2282,7 @@ void WaveformArea::ToneMapEyeWaveform(std::shared_ptr<DisplayedChannel> channel,
 		return;
 
 	//Run the actual compute shader
-	auto pipe = channel->GetToneMapPipeline();
+	auto pipe = channel->GetToneMapPipeline(cmdbuf);
 	const auto& texmgr = m_parent->GetTextureManager();
 	pipe->BindBufferNonblocking(0, data->GetOutData(), cmdbuf);
 	pipe->BindStorageImage(
@@ -2157,7 +2339,7 @@ void WaveformArea::ToneMapConstellationWaveform(std::shared_ptr<DisplayedChannel
 		return;
 
 	//Run the actual compute shader
-	auto pipe = channel->GetToneMapPipeline();
+	auto pipe = channel->GetToneMapPipeline(cmdbuf);
 	const auto& texmgr = m_parent->GetTextureManager();
 	pipe->BindBufferNonblocking(0, data->GetOutData(), cmdbuf);
 	pipe->BindStorageImage(
@@ -2433,7 +2615,7 @@ void WaveformArea::RenderYAxis(ImVec2 size, map<float, float>& gridmap, float vb
 			m_dragState = DRAG_STATE_Y_AXIS;
 		}
 
-		if(ImGui::IsMouseClicked(ImGuiMouseButton_Middle))
+		if(ImGui::IsMouseClicked(ImGuiMouseButton_Middle) && !m_parent->IsDrawingStaleWaveforms())
 		{
 			//Find the min and max of all currently displayed analog channels
 			//TODO: do we want to not allow autoscale on instrument inputs?
@@ -2574,6 +2756,10 @@ void WaveformArea::RenderBERSamplingPoint(ImVec2 /*start*/, ImVec2 /*size*/)
  */
 void WaveformArea::RenderEyePatternTooltip(ImVec2 start, ImVec2 size)
 {
+	//Can't look at the eye while the filter graph is updating it
+	if(m_parent->IsDrawingStaleWaveforms())
+		return;
+
 	//If no waveform or data, we can't get a BER
 	auto firstStream = GetFirstEyeStream();
 	if(!firstStream)
@@ -3357,7 +3543,10 @@ void WaveformArea::ChannelButton(shared_ptr<DisplayedChannel> chan, size_t index
 {
 	auto stream = chan->GetStream();
 	auto rchan = stream.m_channel;
-	auto data = stream.GetData();
+
+	//Don't look at the data if the filter graph is partway through rewriting it
+	bool stale = m_parent->IsDrawingStaleWaveforms();
+	auto data = stale ? nullptr : stream.GetData();
 	auto edata = dynamic_cast<EyeWaveform*>(data);
 	auto cdata = dynamic_cast<ConstellationWaveform*>(data);
 	auto ddata = dynamic_cast<DensityFunctionWaveform*>(data);
@@ -3508,7 +3697,12 @@ void WaveformArea::ChannelButton(shared_ptr<DisplayedChannel> chan, size_t index
 		ImGui::Separator();
 
 		//Color ramp if it's a density plot
-		if(ddata)
+		auto type = stream.GetType();
+		bool density =
+			(type == Stream::STREAM_TYPE_EYE) ||
+			(type == Stream::STREAM_TYPE_CONSTELLATION) ||
+			(type == Stream::STREAM_TYPE_WATERFALL);
+		if(ddata || (stale && density))
 		{
 			if(ImGui::BeginMenu("Color ramp"))
 			{
@@ -3583,16 +3777,16 @@ void WaveformArea::FilterMenu(shared_ptr<DisplayedChannel> chan)
  */
 void WaveformArea::FilterSubmenu(shared_ptr<DisplayedChannel> chan, const string& name, Filter::Category cat)
 {
-	auto& refs = m_parent->GetSession().GetReferenceFilters();
+	auto& session = m_parent->GetSession();
 	auto stream = chan->GetStream();
 
 	if(ImGui::BeginMenu(name.c_str()))
 	{
 		//Find all filters in this category and sort them alphabetically
 		vector<string> sortedNames;
-		for(auto it : refs)
+		for(auto& it : session.GetFilterCategories())
 		{
-			if(it.second->GetCategory() == cat)
+			if(it.second == cat)
 				sortedNames.push_back(it.first);
 		}
 		std::sort(sortedNames.begin(), sortedNames.end());
@@ -3600,19 +3794,22 @@ void WaveformArea::FilterSubmenu(shared_ptr<DisplayedChannel> chan, const string
 		//Do all of the menu items
 		for(auto fname : sortedNames)
 		{
-			auto it = refs.find(fname);
-			bool valid = false;
-			if(it->second->GetInputCount() == 0)		//No inputs? Always valid
-				valid = true;
-			else
-				valid = it->second->ValidateChannel(0, stream);
-
 			//Hide import filters to avoid cluttering the UI
 			if( (cat == Filter::CAT_GENERATION) && (fname.find("Import") != string::npos))
 				continue;
 
+			//Only entries actually shown need a reference filter
+			auto ref = session.GetReferenceFilter(fname);
+			if(!ref)
+				continue;
+			bool valid = false;
+			if(ref->GetInputCount() == 0)		//No inputs? Always valid
+				valid = true;
+			else
+				valid = ref->ValidateChannel(0, stream);
+
 			//Measurements should have summary option and not show properties by default
-			if( (cat == Filter::CAT_MEASUREMENT) && (it->second->GetStreamCount() > 1) )
+			if( (cat == Filter::CAT_MEASUREMENT) && (ref->GetStreamCount() > 1) )
 			{
 				if(ImGui::BeginMenu(fname.c_str(), valid))
 				{
@@ -3897,14 +4094,22 @@ void WaveformArea::OnMouseWheelYAxis(float delta)
  */
 TimePoint WaveformArea::GetWaveformTimestamp()
 {
+	//Filter graph is updating, use the timestamp of what's still on screen
+	if(m_parent->IsDrawingStaleWaveforms())
+		return m_lastWaveformTimestamp;
+
 	for(auto d : m_displayedChannels)
 	{
 		auto data = d->GetStream().GetData();
 		if(data != nullptr)
-			return TimePoint(data->m_startTimestamp, data->m_startFemtoseconds);
+		{
+			m_lastWaveformTimestamp = TimePoint(data->m_startTimestamp, data->m_startFemtoseconds);
+			return m_lastWaveformTimestamp;
+		}
 	}
 
-	return TimePoint(0, 0);
+	m_lastWaveformTimestamp = TimePoint(0, 0);
+	return m_lastWaveformTimestamp;
 }
 
 /**
@@ -210,6 +210,7 @@ public:
 	void PrepareToRasterize(size_t x, size_t y);
 
 	bool UpdateSize(ImVec2 newSize, MainWindow* top);
+	void RequestFilterResize(size_t width, size_t height);
 
 	AcceleratorBuffer<float>& GetRasterizedWaveform()
 	{ return m_rasterizedWaveform; }
@@ -226,112 +227,12 @@ public:
 	size_t GetRasterizedY()
 	{ return m_rasterizedY; }
 
-	/**
-		@brief Gets the pipeline for drawing uniform analog waveforms, creating it if necessary
-	*/
-	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetUniformAnalogPipeline()
-	{
-		if(m_uniformAnalogComputePipeline == nullptr)
-		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			if(ZeroHoldFlagSet())
-				suffix += ".zerohold";
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_uniformAnalogComputePipeline = std::make_shared<ComputePipeline>(
-				base + "analog" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
-		}
-
-		return m_uniformAnalogComputePipeline;
-	}
-
-	/**
-		@brief Gets the pipeline for drawing histogram waveforms, creating it if necessary
-	*/
-	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetHistogramPipeline()
-	{
-		if(m_histogramComputePipeline == nullptr)
-		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_histogramComputePipeline = std::make_shared<ComputePipeline>(
-				base + "histogram" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
-		}
-
-		return m_histogramComputePipeline;
-	}
-
-	/**
-		@brief Gets the pipeline for drawing sparse analog waveforms, creating it if necessary
-	*/
-	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetSparseAnalogPipeline()
-	{
-		if(m_sparseAnalogComputePipeline == nullptr)
-		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			int durationSSBOs = 0;
-			if(ZeroHoldFlagSet())
-			{
-				suffix += ".zerohold";
-				durationSSBOs++;
-			}
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_sparseAnalogComputePipeline = std::make_shared<ComputePipeline>(
-				base + "analog" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants));
-		}
-
-		return m_sparseAnalogComputePipeline;
-	}
-
-	/**
-		@brief Gets the pipeline for drawing uniform digital waveforms, creating it if necessary
-	*/
-	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetUniformDigitalPipeline()
-	{
-		if(m_uniformDigitalComputePipeline == nullptr)
-		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_uniformDigitalComputePipeline = std::make_shared<ComputePipeline>(
-				base + "digital" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
-		}
-
-		return m_uniformDigitalComputePipeline;
-	}
-
-	/**
-		@brief Gets the pipeline for drawing sparse digital waveforms, creating it if necessary
-	*/
-	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetSparseDigitalPipeline()
-	{
-		if(m_sparseDigitalComputePipeline == nullptr)
-		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			int durationSSBOs = 0;	//TODO: support gaps
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_sparseDigitalComputePipeline = std::make_shared<ComputePipeline>(
-				base + "digital" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants));
-		}
-
-		return m_sparseDigitalComputePipeline;
-	}
-
-	std::shared_ptr<ComputePipeline> GetToneMapPipeline()
-	{ return m_toneMapPipe; }
+	std::shared_ptr<ComputePipeline> GetUniformAnalogPipeline(vk::raii::CommandBuffer& cmdbuf);
+	std::shared_ptr<ComputePipeline> GetHistogramPipeline(vk::raii::CommandBuffer& cmdbuf);
+	std::shared_ptr<ComputePipeline> GetSparseAnalogPipeline(vk::raii::CommandBuffer& cmdbuf);
+	std::shared_ptr<ComputePipeline> GetUniformDigitalPipeline(vk::raii::CommandBuffer& cmdbuf);
+	std::shared_ptr<ComputePipeline> GetSparseDigitalPipeline(vk::raii::CommandBuffer& cmdbuf);
+	std::shared_ptr<ComputePipeline> GetToneMapPipeline(vk::raii::CommandBuffer& cmdbuf);
 
 	bool ZeroHoldFlagSet()
 	{
@@ -409,26 +310,29 @@ protected:
 	///@brief Y axis size of the texture as of last UpdateSize() call
 	size_t m_cachedY;
 
-	///@brief Persistence enable flag
-	bool m_persistenceEnabled;
+	///@brief Filter output width we want, once the plot size has settled
+	size_t m_pendingFilterWidth;
+
+	///@brief Filter output height we want, once the plot size has settled
+	size_t m_pendingFilterHeight;
 
-	///@brief Compute pipeline for tone mapping fp32 images to RGBA
-	std::shared_ptr<ComputePipeline> m_toneMapPipe;
+	///@brief Time at which m_pendingFilterWidth / m_pendingFilterHeight last changed
+	double m_pendingFilterResizeTime;
 
-	///@brief Compute pipeline for rendering uniform analog waveforms
-	std::shared_ptr<ComputePipeline> m_uniformAnalogComputePipeline;
+	///@brief True if m_pendingFilterWidth / m_pendingFilterHeight have not yet been sent to the session
+	bool m_filterResizePending;
 
-	///@brief Compute pipeline for rendering histogram waveforms
-	std::shared_ptr<ComputePipeline> m_histogramComputePipeline;
+	///@brief Persistence enable flag
+	bool m_persistenceEnabled;
 
-	///@brief Compute pipeline for rendering sparse analog waveforms
-	std::shared_ptr<ComputePipeline> m_sparseAnalogComputePipeline;
+	///@brief Shader for tone mapping fp32 images to RGBA
+	std::string m_toneMapShader;
 
-	///@brief Compute pipeline for rendering uniform digital waveforms
-	std::shared_ptr<ComputePipeline> m_uniformDigitalComputePipeline;
+	///@brief Size of the tone map shader's push constants
+	size_t m_toneMapPushConstantSize;
 
-	///@brief Compute pipeline for rendering sparse digital waveforms
-	std::shared_ptr<ComputePipeline> m_sparseDigitalComputePipeline;
+	///@brief Number of sampled images (color ramps) used by the tone map shader
+	size_t m_toneMapSampledImages;
 
 	///@brief Y axis position of our button within the view
 	float m_yButtonPos;
@@ -496,6 +400,7 @@ protected:
 	void CheckForScaleMismatch(ImVec2 start, ImVec2 size);
 	void RenderEyePatternTooltip(ImVec2 start, ImVec2 size);
 	void RenderWaveforms(ImVec2 start, ImVec2 size);
+	void RenderStaleWaveforms(ImVec2 start, ImVec2 size);
 	void RenderAnalogWaveform(std::shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size);
 	void RenderEyeWaveform(std::shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size);
 	void RenderConstellationWaveform(std::shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size);
@@ -639,6 +544,9 @@ protected:
 	///@brief X axis position of the mouse at the most recent right click
 	int64_t m_lastRightClickOffset;
 
+	///@brief Timestamp of the waveform we most recently displayed, for use while the filter graph is running
+	TimePoint m_lastWaveformTimestamp;
+
 	///@brief True if clearing persistence next render
 	std::atomic<bool> m_clearPersistence;
 
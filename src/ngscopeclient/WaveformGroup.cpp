@@ -169,7 +169,8 @@ bool WaveformGroup::Render()
 	float plotWidth = clientArea.x - yAxisWidthSpaced;
 
 	//Update X axis unit
-	if(!areas.empty())
+	//(but keep the previous eye scaling if the filter graph is busy rewriting the eye)
+	if(!areas.empty() && !m_parent->IsDrawingStaleWaveforms())
 	{
 		m_displayingEye = false;
 		m_xAxisUnit = areas[0]->GetStream(0).GetXAxisUnits();
@@ -257,6 +258,9 @@ void WaveformGroup::DoCursorReadouts()
 {
 	auto areas = GetWaveformAreas();
 
+	//Don't read out anything if the filter graph is partway through rewriting the waveforms
+	bool stale = m_parent->IsDrawingStaleWaveforms();
+
 	bool hasSecondCursor = (m_xAxisCursorMode == X_CURSOR_DUAL);
 
 	string name = string("Cursors (") + m_title + ")";
@@ -299,10 +303,11 @@ void WaveformGroup::DoCursorReadouts()
 					auto sname = stream.GetName();
 
 					//Prepare to pretty print
-					auto data = stream.GetData();
-					string sv1 = "(no data)";
-					string sv2 = "(no data)";
-					string svd = "(no data)";
+					auto data = stale ? nullptr : stream.GetData();
+					string nodata = stale ? "(updating)" : "(no data)";
+					string sv1 = nodata;
+					string sv2 = nodata;
+					string svd = nodata;
 
 					switch(stream.GetType())
 					{
@@ -394,6 +399,27 @@ void WaveformGroup::DoCursorReadouts()
 						ImGui::TableSetColumnIndex(3);
 						RightJustifiedText(svd);
 
+						//Statistics between the cursors
+						WaveformRangeStats stats;
+						if( (stream.GetType() == Stream::STREAM_TYPE_ANALOG) &&
+							ImGui::IsItemHovered(ImGuiHoveredFlags_DelayShort) &&
+							GetRangeStats(
+								data,
+								WaveformRangeCache::SUM_LINEAR,
+								m_xAxisCursorPositions[0],
+								m_xAxisCursorPositions[1],
+								stats) )
+						{
+							auto yunit = stream.GetYAxisUnits();
+							ImGui::BeginTooltip();
+							ImGui::Text("Between cursors (%zu samples)", stats.m_count);
+							ImGui::Text("Mean: %s", yunit.PrettyPrint(stats.GetMean()).c_str());
+							ImGui::Text("Min:  %s", yunit.PrettyPrint(stats.m_min).c_str());
+							ImGui::Text("Max:  %s", yunit.PrettyPrint(stats.m_max).c_str());
+							ImGui::Text("Peak to peak: %s", yunit.PrettyPrint(stats.m_max - stats.m_min).c_str());
+							ImGui::EndTooltip();
+						}
+
 						//In-band power
 						Unit punit(Unit::UNIT_COUNTS);
 						bool ok = true;
@@ -411,7 +437,7 @@ void WaveformGroup::DoCursorReadouts()
 								ok = false;
 						}
 
-						if(ok)
+						if(ok && data)
 						{
 							auto power = GetInBandPower(
 								data,
@@ -431,6 +457,11 @@ void WaveformGroup::DoCursorReadouts()
 		}
 	}
 	ImGui::End();
+
+	//Forget about waveforms we're no longer reading out
+	//(nothing was read out this frame if the graph is running, so keep the indexes for when it's done)
+	if(!stale)
+		m_rangeCache.Prune();
 }
 
 /**
@@ -438,17 +469,39 @@ void WaveformGroup::DoCursorReadouts()
  */
 float WaveformGroup::GetInBandPower(WaveformBase* wfm, Unit yunit, int64_t t1, int64_t t2)
 {
-	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
-	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
-
-	//Make sure we have data
-	if(!swfm && !uwfm)
-		return 0;
-	if(!wfm->size())
+	//Sum the in-band power
+	//Note that if it's in dBm we have to go to linear units and back
+	auto mode = WaveformRangeCache::SUM_LINEAR;
+	if(yunit == Unit::UNIT_DBM)
+		mode = WaveformRangeCache::SUM_DBM;
+	else if(yunit == Unit::UNIT_W_M2_NM)
+		mode = WaveformRangeCache::SUM_IRRADIANCE;
+
+	WaveformRangeStats stats;
+	if(!GetRangeStats(wfm, mode, t1, t2, stats))
 		return 0;
 
-	//Get the samples and start/end indexex
-	auto& samples = swfm ? swfm->m_samples : uwfm->m_samples;
+	if(mode == WaveformRangeCache::SUM_DBM)
+		return 10 * log10(stats.m_sum) + 30;
+	return stats.m_sum;
+}
+
+/**
+	@brief Summarizes the samples of an analog waveform between two X axis positions
+
+	@return True if the waveform has analog data, false otherwise
+ */
+bool WaveformGroup::GetRangeStats(
+	WaveformBase* wfm,
+	WaveformRangeCache::SumMode mode,
+	int64_t t1,
+	int64_t t2,
+	WaveformRangeStats& stats)
+{
+	if(!wfm || !wfm->size())
+		return false;
+
+	//Get the start/end indexes
 	bool err1;
 	bool err2;
 	auto ileft = GetIndexNearestAtOrBeforeTimestamp(wfm, t1, err1);
@@ -458,25 +511,7 @@ float WaveformGroup::GetInBandPower(WaveformBase* wfm, Unit yunit, int64_t t1, i
 	if(err2)
 		iright = wfm->size() - 1;
 
-	//Sum the in-band power
-	//Note that if it's in dBm we have to go to linear units and back
-	bool is_log = (yunit == Unit::UNIT_DBM);
-	bool is_irradiance = (yunit == Unit::UNIT_W_M2_NM);
-	float total = 0;
-	for(size_t i=ileft; i <= iright; i++)
-	{
-		float f = samples[i];
-		if(is_log)
-			total += pow(10, (f - 30) / 10);	//assume
-		else if(is_irradiance)
-			total += f * GetDurationScaled(swfm, uwfm, i) * 1e-3;	//scale by pm to nm
-		else
-			total += f;
-	}
-	if(is_log)
-		total = 10 * log10(total) + 30;
-
-	return total;
+	return m_rangeCache.Query(wfm, mode, ileft, iright, stats);
 }
 
 /**
@@ -879,8 +914,8 @@ void WaveformGroup::RenderTimeline(float width, float height)
 				m_dragState = DRAG_STATE_TIMELINE;
 		}
 
-		//Autoscale on middle mouse
-		if(ImGui::IsMouseClicked(ImGuiMouseButton_Middle))
+		//Autoscale on middle mouse (but not while the filter graph is rewriting the waveforms)
+		if(ImGui::IsMouseClicked(ImGuiMouseButton_Middle) && !m_parent->IsDrawingStaleWaveforms())
 		{
 			LogTrace("middle mouse autoscale\n");
 
@@ -36,6 +36,7 @@
 #define WaveformGroup_h
 
 #include "WaveformArea.h"
+#include "WaveformRangeCache.h"
 
 /**
 	@brief A WaveformGroup is a container for one or more WaveformArea's.
@@ -146,6 +147,8 @@ protected:
 	void TitleHoverHelp();
 
 	float GetInBandPower(WaveformBase* wfm, Unit yunit, int64_t t1, int64_t t2);
+	bool GetRangeStats(WaveformBase* wfm, WaveformRangeCache::SumMode mode, int64_t t1, int64_t t2,
+		WaveformRangeStats& stats);
 
 	bool IsMouseOverButtonInWaveformArea();
 
@@ -236,6 +239,9 @@ public:
 
 	///@brief Position (in X axis units) of each cursor
 	int64_t m_xAxisCursorPositions[2];
+
+	///@brief Index of the waveforms being read out, for fast queries over the range between the cursors
+	WaveformRangeCache m_rangeCache;
 };
 
 #endif
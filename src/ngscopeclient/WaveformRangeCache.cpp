@@ -0,0 +1,283 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of WaveformRangeCache
+ */
+#include "../scopehal/scopehal.h"
+#include "WaveformRangeCache.h"
+
+using namespace std;
+
+/**
+	@brief Converts one sample for summing
+ */
+static inline double ConvertSample(
+	WaveformRangeCache::SumMode mode,
+	SparseAnalogWaveform* swfm,
+	UniformAnalogWaveform* uwfm,
+	size_t i,
+	float f)
+{
+	switch(mode)
+	{
+		//10^((f - 30) / 10), without the overhead of a general pow()
+		case WaveformRangeCache::SUM_DBM:
+			return exp((f - 30) * (M_LN10 / 10));
+
+		//scale by pm to nm
+		case WaveformRangeCache::SUM_IRRADIANCE:
+			return f * GetDurationScaled(swfm, uwfm, i) * 1e-3;
+
+		case WaveformRangeCache::SUM_LINEAR:
+		default:
+			return f;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+WaveformRangeCache::WaveformRangeCache()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queries
+
+/**
+	@brief Summarizes the samples in a range of a waveform
+
+	The waveform must be resident in CPU memory.
+
+	@param wfm		The waveform (must be a sparse or uniform analog waveform)
+	@param mode		How to convert samples before summing them
+	@param istart	Index of the first sample in the range
+	@param iend		Index of the last sample in the range (inclusive)
+	@param stats	Summary of the range
+
+	@return True on success, false if the waveform is empty or not analog
+ */
+bool WaveformRangeCache::Query(WaveformBase* wfm, SumMode mode, size_t istart, size_t iend, WaveformRangeStats& stats)
+{
+	stats = WaveformRangeStats();
+
+	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	if(!swfm && !uwfm)
+		return false;
+	size_t len = wfm->size();
+	if(len == 0)
+		return false;
+
+	if(iend < istart)
+		swap(istart, iend);
+	istart = min(istart, len - 1);
+	iend = min(iend, len - 1);
+
+	//Not worth indexing
+	if(iend - istart + 1 <= DIRECT_SCAN_LIMIT)
+	{
+		Scan(wfm, mode, istart, iend, stats);
+		return true;
+	}
+
+	auto& index = m_indexes[pair<WaveformBase*, SumMode>(wfm, mode)];
+	if(!index.IsCurrent(wfm))
+		index.Build(wfm, mode);
+	index.m_used = true;
+
+	//Range is long enough that there's always at least one whole block in the middle
+	size_t bstart = (istart + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	size_t bend = (iend + 1) / BLOCK_SIZE;
+
+	//Whole blocks
+	stats.m_count = (bend - bstart) * BLOCK_SIZE;
+	stats.m_sum = index.m_sums[bend] - index.m_sums[bstart];
+	stats.m_valueSum = index.m_valueSums[bend] - index.m_valueSums[bstart];
+	size_t level = 0;
+	while( (2ull << level) <= (bend - bstart) )
+		level ++;
+	size_t last = bend - (1ull << level);
+	stats.m_min = min(index.m_mins[level][bstart], index.m_mins[level][last]);
+	stats.m_max = max(index.m_maxes[level][bstart], index.m_maxes[level][last]);
+
+	//Partial blocks at either end
+	WaveformRangeStats head;
+	WaveformRangeStats tail;
+	if(istart < bstart * BLOCK_SIZE)
+		Scan(wfm, mode, istart, bstart*BLOCK_SIZE - 1, head);
+	if(bend * BLOCK_SIZE <= iend)
+		Scan(wfm, mode, bend*BLOCK_SIZE, iend, tail);
+	for(auto& part : {head, tail})
+	{
+		if(!part.m_count)
+			continue;
+		stats.m_count += part.m_count;
+		stats.m_sum += part.m_sum;
+		stats.m_valueSum += part.m_valueSum;
+		stats.m_min = min(stats.m_min, part.m_min);
+		stats.m_max = max(stats.m_max, part.m_max);
+	}
+
+	return true;
+}
+
+/**
+	@brief Summarizes a range of samples by looking at each one
+
+	@param wfm		The waveform (must be a sparse or uniform analog waveform)
+	@param mode		How to convert samples before summing them
+	@param istart	Index of the first sample in the range
+	@param iend		Index of the last sample in the range (inclusive)
+	@param stats	Summary of the range
+ */
+void WaveformRangeCache::Scan(WaveformBase* wfm, SumMode mode, size_t istart, size_t iend, WaveformRangeStats& stats)
+{
+	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto& samples = swfm ? swfm->m_samples : uwfm->m_samples;
+
+	stats.m_count = iend - istart + 1;
+	stats.m_min = samples[istart];
+	stats.m_max = samples[istart];
+	for(size_t i=istart; i<=iend; i++)
+	{
+		float f = samples[i];
+		stats.m_sum += ConvertSample(mode, swfm, uwfm, i, f);
+		stats.m_valueSum += f;
+		stats.m_min = min(stats.m_min, f);
+		stats.m_max = max(stats.m_max, f);
+	}
+}
+
+/**
+	@brief Discards indexes which haven't been used since the last call
+
+	Call once per frame (or whatever the natural update period is) so indexes of deleted waveforms don't pile up.
+ */
+void WaveformRangeCache::Prune()
+{
+	for(auto it = m_indexes.begin(); it != m_indexes.end(); )
+	{
+		if(it->second.m_used)
+		{
+			it->second.m_used = false;
+			it++;
+		}
+		else
+			it = m_indexes.erase(it);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Index
+
+/**
+	@brief Checks if the index was built from the current contents of a waveform
+ */
+bool WaveformRangeCache::Index::IsCurrent(WaveformBase* wfm)
+{
+	return
+		(m_revision == wfm->m_revision) &&
+		(m_size == wfm->size()) &&
+		(m_startTimestamp == wfm->m_startTimestamp) &&
+		(m_startFemtoseconds == wfm->m_startFemtoseconds) &&
+		!m_sums.empty();
+}
+
+/**
+	@brief Builds the index from the current contents of a waveform
+ */
+void WaveformRangeCache::Index::Build(WaveformBase* wfm, SumMode mode)
+{
+	auto swfm = dynamic_cast<SparseAnalogWaveform*>(wfm);
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto& samples = swfm ? swfm->m_samples : uwfm->m_samples;
+
+	m_revision = wfm->m_revision;
+	m_size = wfm->size();
+	m_startTimestamp = wfm->m_startTimestamp;
+	m_startFemtoseconds = wfm->m_startFemtoseconds;
+
+	//Only whole blocks are indexed, any partial block at the end is always scanned
+	size_t nblocks = m_size / BLOCK_SIZE;
+	m_sums.resize(nblocks + 1);
+	m_valueSums.resize(nblocks + 1);
+	m_mins.resize(1);
+	m_maxes.resize(1);
+	m_mins[0].resize(nblocks);
+	m_maxes[0].resize(nblocks);
+
+	//Per-block totals and extrema
+	m_sums[0] = 0;
+	m_valueSums[0] = 0;
+	for(size_t b=0; b<nblocks; b++)
+	{
+		size_t base = b*BLOCK_SIZE;
+		double sum = 0;
+		double valueSum = 0;
+		float vmin = samples[base];
+		float vmax = samples[base];
+		for(size_t i=base; i<base + BLOCK_SIZE; i++)
+		{
+			float f = samples[i];
+			sum += ConvertSample(mode, swfm, uwfm, i, f);
+			valueSum += f;
+			vmin = min(vmin, f);
+			vmax = max(vmax, f);
+		}
+
+		m_sums[b+1] = m_sums[b] + sum;
+		m_valueSums[b+1] = m_valueSums[b] + valueSum;
+		m_mins[0][b] = vmin;
+		m_maxes[0][b] = vmax;
+	}
+
+	//Each level of the sparse table covers twice as many blocks as the one below it
+	for(size_t level=1; (1ull << level) <= nblocks; level++)
+	{
+		size_t half = 1ull << (level - 1);
+		size_t count = nblocks - (1ull << level) + 1;
+		auto& pmin = m_mins[level-1];
+		auto& pmax = m_maxes[level-1];
+
+		vector<float> mins(count);
+		vector<float> maxes(count);
+		for(size_t i=0; i<count; i++)
+		{
+			mins[i] = min(pmin[i], pmin[i + half]);
+			maxes[i] = max(pmax[i], pmax[i + half]);
+		}
+		m_mins.push_back(move(mins));
+		m_maxes.push_back(move(maxes));
+	}
+}
@@ -0,0 +1,167 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformRangeCache
+ */
+#ifndef WaveformRangeCache_h
+#define WaveformRangeCache_h
+
+#include <map>
+#include <vector>
+
+/**
+	@brief Summary of the samples in a range of a waveform
+ */
+class WaveformRangeStats
+{
+public:
+	WaveformRangeStats()
+	: m_count(0)
+	, m_sum(0)
+	, m_valueSum(0)
+	, m_min(0)
+	, m_max(0)
+	{}
+
+	///@brief Mean sample value
+	double GetMean() const
+	{ return m_count ? (m_valueSum / m_count) : 0; }
+
+	///@brief Number of samples in the range
+	size_t m_count;
+
+	///@brief Sum of the samples, converted as requested by the sum mode (e.g. dBm to mW)
+	double m_sum;
+
+	///@brief Sum of the raw sample values
+	double m_valueSum;
+
+	///@brief Smallest sample value
+	float m_min;
+
+	///@brief Largest sample value
+	float m_max;
+};
+
+/**
+	@brief Answers sum, mean, min and max queries over arbitrary sample ranges of analog waveforms
+
+	Ranges longer than a few blocks of samples are answered from a per-waveform index, built the first time each
+	revision of a waveform is queried. The index holds prefix sums of per-block totals, plus a sparse table of
+	per-block minimum and maximum values. A query only touches the partial blocks at each end plus O(1) table
+	entries, no matter how far apart the ends are. Indexing blocks rather than individual samples keeps the index
+	small (a few bytes per hundred samples) even for waveforms with hundreds of millions of points.
+
+	Short ranges are simply scanned, since that's cheaper than building an index for a waveform which may be
+	replaced on the next trigger.
+ */
+class WaveformRangeCache
+{
+public:
+	WaveformRangeCache();
+
+	///@brief How samples are converted before summing
+	enum SumMode
+	{
+		///@brief Sum sample values as-is
+		SUM_LINEAR,
+
+		///@brief Samples are in dBm, sum in mW
+		SUM_DBM,
+
+		///@brief Samples are spectral irradiance (W/m^2/nm), integrate over sample width (in pm) to W/m^2
+		SUM_IRRADIANCE
+	};
+
+	bool Query(WaveformBase* wfm, SumMode mode, size_t istart, size_t iend, WaveformRangeStats& stats);
+	void Prune();
+
+	///@brief Number of samples summarized by each entry in an index
+	static const size_t BLOCK_SIZE = 256;
+
+	///@brief Ranges up to this many samples are scanned directly, rather than building an index
+	static const size_t DIRECT_SCAN_LIMIT = 65536;
+
+protected:
+
+	/**
+		@brief Index for one waveform
+	 */
+	class Index
+	{
+	public:
+		Index()
+		: m_revision(0)
+		, m_size(0)
+		, m_startTimestamp(0)
+		, m_startFemtoseconds(0)
+		, m_used(false)
+		{}
+
+		bool IsCurrent(WaveformBase* wfm);
+		void Build(WaveformBase* wfm, SumMode mode);
+
+		///@brief Revision of the waveform this index was built from
+		uint64_t m_revision;
+
+		///@brief Size of the waveform this index was built from
+		size_t m_size;
+
+		///@brief Timestamp of the waveform this index was built from (waveforms are reused by the pool)
+		time_t m_startTimestamp;
+
+		///@brief Fractional timestamp of the waveform this index was built from
+		int64_t m_startFemtoseconds;
+
+		///@brief Prefix sums of converted sample values, by block (entry i is the total of blocks 0...i-1)
+		std::vector<double> m_sums;
+
+		///@brief Prefix sums of raw sample values, by block
+		std::vector<double> m_valueSums;
+
+		///@brief Sparse table of block minimums (level k, entry i is the min of blocks i...i + 2^k - 1)
+		std::vector<std::vector<float>> m_mins;
+
+		///@brief Sparse table of block maximums
+		std::vector<std::vector<float>> m_maxes;
+
+		///@brief True if the index was used since the last call to Prune()
+		bool m_used;
+	};
+
+	static void Scan(WaveformBase* wfm, SumMode mode, size_t istart, size_t iend, WaveformRangeStats& stats);
+
+	///@brief Indexes for each waveform and sum mode
+	std::map<std::pair<WaveformBase*, SumMode>, Index> m_indexes;
+};
+
+#endif
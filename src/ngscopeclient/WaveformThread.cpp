@@ -167,6 +167,7 @@ void RenderAllWaveforms(vk::raii::CommandBuffer& cmdbuf, Session* session, share
 	session->RenderWaveformTextures(cmdbuf, channels);
 	cmdbuf.end();
 	queue->SubmitAndBlock(cmdbuf);
+	session->GetPipelineRegistry().Release(cmdbuf);
 
 	g_lastWaveformRenderTime = (GetTime() - tstart) * FS_PER_SECOND;
 }
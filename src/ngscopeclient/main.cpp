@@ -35,6 +35,7 @@
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "ngscopeclient.h"
 #include "MainWindow.h"
+#include "PacketExporter.h"
 #include "../scopeprotocols/scopeprotocols.h"
 #include "imgui_internal.h"
 
@@ -44,15 +45,32 @@ unique_ptr<MainWindow> g_mainWindow;
 
 GuiLogSink* g_guiLog;
 
+StartupProfiler g_startupProfiler;
+
 #ifndef _WIN32
 void Relaunch(int argc, char* argv[]);
 #endif
 
+int ExportPacketsHeadless(const string& sessionPath, const string& decoderName, const string& outPath);
+int RunStartupBenchmark(const string& sessionPath, size_t startupPhase);
+
 int main(int argc, char* argv[])
 {
+	g_startupProfiler.Start();
+	size_t startupPhase = g_startupProfiler.Begin("Startup");
+
 	//Global settings
 	Severity console_verbosity = Severity::NOTICE;
 
+	//Startup profiling and benchmarking
+	bool startupProfile = false;
+	string benchmarkSession;
+
+	//Headless packet export
+	string exportSession;
+	string exportDecoder;
+	string exportPath;
+
 	for(int i=1; i<argc; i++)
 	{
 		string s(argv[i]);
@@ -61,6 +79,35 @@ int main(int argc, char* argv[])
 		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
 			continue;
 
+		if(s == "--export-packets")
+		{
+			if(i+3 >= argc)
+			{
+				fprintf(stderr,
+					"Usage: --export-packets session.scopesession decodername output.[csv|pcapng]\n"
+					"(no window is shown, but a display is still required)\n");
+				return 1;
+			}
+			exportSession = argv[++i];
+			exportDecoder = argv[++i];
+			exportPath = argv[++i];
+		}
+
+		else if(s == "--startup-profile")
+			startupProfile = true;
+
+		else if(s == "--benchmark")
+		{
+			if(i+1 >= argc)
+			{
+				fprintf(stderr,
+					"Usage: --benchmark session.scopesession\n"
+					"(renders to a hidden window, so a display is still required)\n");
+				return 1;
+			}
+			benchmarkSession = argv[++i];
+		}
+
 		//TODO: other arguments
 
 	}
@@ -100,21 +147,78 @@ int main(int argc, char* argv[])
 		}
 	#endif
 
+	g_startupProfiler.SetPrintOnComplete(startupProfile || !benchmarkSession.empty());
+
 	//Initialize object creation tables for predefined libraries
-	if(!VulkanInit())
-		return 1;
-	TransportStaticInit();
-	DriverStaticInit();
-	ScopeProtocolStaticInit();
-	InitializePlugins();
+	{
+		StartupProfileScope scope("Vulkan init");
+		if(!VulkanInit())
+			return 1;
+	}
+	{
+		StartupProfileScope scope("Transport static init");
+		TransportStaticInit();
+	}
+	{
+		StartupProfileScope scope("Driver static init");
+		DriverStaticInit();
+	}
+	{
+		StartupProfileScope scope("Protocol static init");
+		ScopeProtocolStaticInit();
+	}
+	{
+		StartupProfileScope scope("Plugins");
+		InitializePlugins();
+	}
 
+	//Export mode: nothing is shown, but the session still belongs to a MainWindow, which creates a (hidden) GLFW
+	//window and Vulkan surface. So this still needs a display to connect to; on a CI machine without one, run
+	//under a virtual display server such as Xvfb.
+	if(!exportSession.empty())
 	{
-		//Make the top level window
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
 		shared_ptr<QueueHandle> queue(g_vkQueueManager->GetRenderQueue("g_mainWindow.render"));
 		g_mainWindow = make_unique<MainWindow>(queue);
+		int ret = ExportPacketsHeadless(exportSession, exportDecoder, exportPath);
+		g_mainWindow->GetSession().ClearBackgroundThreads();
+
+		g_mainWindow = nullptr;
+		ScopehalStaticCleanup();
+		return ret;
+	}
+
+	//Benchmark mode: same hidden window (so a display is needed here too), but render frames until the
+	//session's waveforms are on screen
+	if(!benchmarkSession.empty())
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		{
+			StartupProfileScope scope("Create main window");
+			shared_ptr<QueueHandle> queue(g_vkQueueManager->GetRenderQueue("g_mainWindow.render"));
+			g_mainWindow = make_unique<MainWindow>(queue);
+		}
+		int ret = RunStartupBenchmark(benchmarkSession, startupPhase);
+		g_mainWindow->GetSession().ClearBackgroundThreads();
+
+		g_mainWindow = nullptr;
+		ScopehalStaticCleanup();
+		return ret;
+	}
+
+	{
+		//Make the top level window
+		{
+			StartupProfileScope scope("Create main window");
+			shared_ptr<QueueHandle> queue(g_vkQueueManager->GetRenderQueue("g_mainWindow.render"));
+			g_mainWindow = make_unique<MainWindow>(queue);
+		}
 
 		//Main event loop
 		auto& session = g_mainWindow->GetSession();
+		bool firstFrame = true;
 		while(!glfwWindowShouldClose(g_mainWindow->GetWindow()))
 		{
 			//Check which event loop model to use
@@ -124,7 +228,18 @@ int main(int argc, char* argv[])
 				glfwPollEvents();
 
 			//Draw the main window
-			g_mainWindow->Render();
+			if(firstFrame)
+			{
+				{
+					StartupProfileScope scope("First frame");
+					g_mainWindow->Render();
+				}
+				g_startupProfiler.End(startupPhase);
+				g_startupProfiler.Mark("First frame");
+				firstFrame = false;
+			}
+			else
+				g_mainWindow->Render();
 		}
 
 		session.ClearBackgroundThreads();
@@ -150,6 +265,125 @@ void Relaunch(int argc, char* argv[])
 }
 #endif
 
+/**
+	@brief Loads a session offline, decodes it, and exports one protocol decoder's packets without running the GUI
+
+	The main window must already exist (hidden). It still needs a display, real or virtual, to be created.
+
+	@param sessionPath	Path to the .scopesession file
+	@param decoderName	Display name (or hardware name) of the protocol decoder to export
+	@param outPath		Output file; format is chosen by extension (.pcapng, otherwise CSV)
+
+	@return	Process exit code
+ */
+int ExportPacketsHeadless(const string& sessionPath, const string& decoderName, const string& outPath)
+{
+	g_mainWindow->DoOpenFile(sessionPath, false);
+	if(g_mainWindow->GetSessionFileName().empty())
+	{
+		LogError("Failed to load session \"%s\"\n", sessionPath.c_str());
+		return 1;
+	}
+
+	//Loading runs the filter graph for each historical waveform, but filter-only sessions are refreshed lazily
+	auto& session = g_mainWindow->GetSession();
+	session.RefreshAllFilters();
+
+	//Find the decoder
+	PacketDecoder* decoder = nullptr;
+	auto filters = Filter::GetAllInstances();
+	for(auto f : filters)
+	{
+		auto pd = dynamic_cast<PacketDecoder*>(f);
+		if(!pd)
+			continue;
+		if( (pd->GetDisplayName() == decoderName) || (pd->GetHwname() == decoderName) )
+		{
+			decoder = pd;
+			break;
+		}
+	}
+	if(!decoder)
+	{
+		LogError("No protocol decoder named \"%s\" in session \"%s\"\n", decoderName.c_str(), sessionPath.c_str());
+		return 1;
+	}
+
+	auto mgr = session.GetPacketManager(decoder);
+	if(!mgr)
+	{
+		LogError("No packet data for \"%s\"\n", decoderName.c_str());
+		return 1;
+	}
+
+	PacketExporter exporter(decoder, mgr, outPath, PacketExporter::GuessFormat(outPath));
+	if(!exporter.Run())
+	{
+		LogError("%s\n", exporter.GetError().c_str());
+		return 1;
+	}
+
+	LogNotice("Exported packets from \"%s\" to \"%s\"\n", decoderName.c_str(), outPath.c_str());
+	return 0;
+}
+
+/**
+	@brief Measures time to first frame and time to first waveform for a session, then exits
+
+	The session is loaded offline into a hidden window, and the results are printed to stdout in a fixed format
+	regardless of log verbosity, so they're easy to collect from scripts.
+
+	This is not headless: the window is real (just not shown) and frames are rendered through Vulkan, so it needs a
+	display and a Vulkan capable GPU (or software renderer). On a CI machine without a display, run it under a
+	virtual display server such as Xvfb.
+
+	@param sessionPath	Path to the .scopesession file
+	@param startupPhase	Profiler phase covering startup, ended once the first frame is drawn
+
+	@return	Process exit code (nonzero if the session failed to load or never displayed a waveform)
+ */
+int RunStartupBenchmark(const string& sessionPath, size_t startupPhase)
+{
+	const double timeout = 60;
+
+	//First frame with the default session
+	{
+		StartupProfileScope scope("First frame");
+		g_mainWindow->Render();
+	}
+	g_startupProfiler.End(startupPhase);
+	g_startupProfiler.Mark("First frame");
+
+	//Load the session, then keep drawing until something has been tone mapped to the screen
+	g_mainWindow->DoOpenFile(sessionPath, false);
+	if(g_mainWindow->GetSessionFileName().empty())
+	{
+		LogError("Failed to load session \"%s\"\n", sessionPath.c_str());
+		return 1;
+	}
+
+	double deadline = GetTime() + timeout;
+	while(!g_startupProfiler.HasMark("First waveform") && (GetTime() < deadline) )
+	{
+		glfwPollEvents();
+		g_mainWindow->Render();
+	}
+	g_startupProfiler.Mark("Benchmark complete");
+
+	printf("\n");
+	g_startupProfiler.PrintMarks(stdout);
+
+	printf("\ntime_to_first_frame_ms=%.2f\n", g_startupProfiler.GetMark("First frame") * 1000);
+	if(!g_startupProfiler.HasMark("First waveform"))
+	{
+		printf("time_to_first_waveform_ms=timeout\n");
+		LogError("No waveform was displayed within %.0f seconds\n", timeout);
+		return 1;
+	}
+	printf("time_to_first_waveform_ms=%.2f\n", g_startupProfiler.GetMark("First waveform") * 1000);
+	return 0;
+}
+
 /**
 	@brief Helper function for right justified text in a table
  */
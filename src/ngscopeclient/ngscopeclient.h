@@ -43,12 +43,17 @@
 #include <atomic>
 #include <shared_mutex>
 
+#include "TelemetryRecorder.h"
+#include "BERTScanQueue.h"
 #include "BERTState.h"
 #include "PowerSupplyState.h"
 #include "MultimeterState.h"
 #include "LoadState.h"
 #include "GuiLogSink.h"
 #include "Event.h"
+#include "InstrumentCommandQueue.h"
+#include "PollScheduler.h"
+#include "StartupProfiler.h"
 
 class Session;
 
@@ -64,6 +69,12 @@ public:
 	std::atomic<bool>* shuttingDown;
 	Session* session;
 
+	//Driver calls queued by dialogs to run in the instrument thread
+	std::shared_ptr<InstrumentCommandQueue> cmdqueue;
+
+	//Decides when to poll non-scope instruments
+	std::shared_ptr<PollScheduler> scheduler;
+
 	//Additional per-instrument-type state we can add
 	std::shared_ptr<LoadState> loadstate;
 	std::shared_ptr<MultimeterState> meterstate;
@@ -0,0 +1,200 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Timing tests for BERTScanQueue against a mock BERT
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "BERTScan.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+
+/**
+	@brief Mock BERT with slow scans and fast real-time BER reads
+
+	Like the real drivers, a scan is one blocking call which only returns once the whole measurement is done.
+ */
+class MockBERT
+{
+public:
+	MockBERT(size_t nchans, chrono::milliseconds scanTime)
+	: m_scanTime(scanTime)
+	, m_scanStart(nchans)
+	, m_scanEnd(nchans)
+	, m_berReads(0)
+	{
+	}
+
+	///@brief Runs a scan, blocking until it's complete
+	void MeasureEye(size_t chan)
+	{
+		m_scanStart[chan] = GetTime();
+		this_thread::sleep_for(m_scanTime);
+		m_scanEnd[chan] = GetTime();
+	}
+
+	///@brief Reads real-time BER (one quick round trip)
+	void AcquireData()
+	{
+		this_thread::sleep_for(1ms);
+		m_berReads ++;
+	}
+
+	chrono::milliseconds m_scanTime;
+	vector<double> m_scanStart;
+	vector<double> m_scanEnd;
+	atomic<int> m_berReads;
+};
+
+TEST_CASE("BERTScan_LoopContinues")
+{
+	//One 500 ms scan, while looping at 100 Hz and polling real-time BER whenever the driver is free,
+	//as InstrumentThread() does
+	MockBERT bert(1, 500ms);
+	BERTScanQueue queue;
+	REQUIRE(queue.Submit(0, BERTScanQueue::SCAN_EYE, [&]{ bert.MeasureEye(0); }));
+
+	double start = GetTime();
+	double maxGap = 0;
+	double lastPass = start;
+	double tdone = 0;
+	vector<double> readTimes;
+	bool done = false;
+	while(!done && (GetTime() - start) < 5)
+	{
+		{
+			unique_lock<mutex> driverLock(queue.GetDriverMutex(), try_to_lock);
+			if(driverLock.owns_lock())
+			{
+				bert.AcquireData();
+				readTimes.push_back(GetTime());
+			}
+		}
+		double now = GetTime();
+		maxGap = max(maxGap, now - lastPass);
+		lastPass = now;
+
+		done = !queue.PopCompleted().empty();
+		if(done)
+			tdone = GetTime();
+		this_thread::sleep_for(10ms);
+	}
+
+	//Poll a few more times once the scan is done
+	for(int i=0; i<5; i++)
+	{
+		lock_guard<mutex> driverLock(queue.GetDriverMutex());
+		bert.AcquireData();
+		readTimes.push_back(GetTime());
+	}
+
+	LogVerbose("%zu BER reads, longest gap between loop passes %.1f ms\n", readTimes.size(), maxGap * 1000);
+
+	REQUIRE(done);
+
+	//The loop carried on throughout, never stalled for the scan
+	REQUIRE(maxGap < 0.1);
+
+	//but never touched the driver while the scan had it
+	for(auto t : readTimes)
+		REQUIRE( (t <= bert.m_scanStart[0] || t >= bert.m_scanEnd[0]) );
+
+	//and wasn't told there was data to look at until the driver call had returned
+	REQUIRE(tdone >= bert.m_scanEnd[0]);
+}
+
+TEST_CASE("BERTScan_Pipelining")
+{
+	//Scans requested on four channels at once run back to back, in order
+	const size_t nchans = 4;
+	MockBERT bert(nchans, 100ms);
+	BERTScanQueue queue;
+	for(size_t i=0; i<nchans; i++)
+		REQUIRE(queue.Submit(i, BERTScanQueue::SCAN_EYE, [&bert, i]{ bert.MeasureEye(i); }));
+
+	//Asking again for a scan which hasn't started yet doesn't queue a second one
+	REQUIRE(!queue.Submit(nchans-1, BERTScanQueue::SCAN_EYE, [&bert]{ bert.MeasureEye(nchans-1); }));
+	REQUIRE(queue.IsQueued(nchans-1, BERTScanQueue::SCAN_EYE));
+
+	vector<BERTScanQueue::ScanID> completed;
+	double start = GetTime();
+	while( (completed.size() < nchans) && (GetTime() - start) < 5)
+	{
+		for(auto id : queue.PopCompleted())
+			completed.push_back(id);
+		this_thread::sleep_for(10ms);
+	}
+
+	REQUIRE(completed.size() == nchans);
+	for(size_t i=0; i<nchans; i++)
+	{
+		REQUIRE(completed[i].first == i);
+		REQUIRE(completed[i].second == BERTScanQueue::SCAN_EYE);
+	}
+
+	//Each scan started as soon as the previous one finished, without waiting for the consumer to poll
+	for(size_t i=1; i<nchans; i++)
+	{
+		double gap = bert.m_scanStart[i] - bert.m_scanEnd[i-1];
+		LogVerbose("Gap between scans %zu and %zu: %.3f ms\n", i-1, i, gap * 1000);
+		REQUIRE(gap < 0.005);
+	}
+
+	REQUIRE(queue.GetDepth() == 0);
+	BERTScanQueue::ScanID id;
+	REQUIRE(!queue.GetRunningScan(id));
+}
+
+TEST_CASE("BERTScan_ShutdownDiscardsPending")
+{
+	//Destroying the queue waits for the running scan but skips the rest
+	MockBERT bert(3, 100ms);
+	atomic<int> scansRun(0);
+	{
+		BERTScanQueue queue;
+		for(size_t i=0; i<3; i++)
+			queue.Submit(i, BERTScanQueue::SCAN_HBATHTUB, [&bert, &scansRun, i]{ bert.MeasureEye(i); scansRun ++; });
+
+		//Wait for the first scan to start
+		BERTScanQueue::ScanID id;
+		double start = GetTime();
+		while(!queue.GetRunningScan(id) && (GetTime() - start) < 1)
+			this_thread::sleep_for(1ms);
+	}
+
+	REQUIRE(scansRun == 1);
+}
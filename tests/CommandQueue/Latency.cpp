@@ -0,0 +1,210 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for InstrumentCommandQueue, including GUI frame time against a slow instrument
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "CommandQueue.h"
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono_literals;
+
+/**
+	@brief Stand-in for a driver talking to an instrument over a slow link
+
+	Every call takes one full round trip.
+ */
+class SlowInstrument
+{
+public:
+	SlowInstrument(chrono::milliseconds latency)
+	: m_latency(latency)
+	, m_value(0)
+	, m_writes(0)
+	{}
+
+	void SetValue(int value)
+	{
+		this_thread::sleep_for(m_latency);
+		m_value = value;
+		m_writes ++;
+	}
+
+	int GetValue()
+	{
+		this_thread::sleep_for(m_latency);
+		return m_value;
+	}
+
+	chrono::milliseconds m_latency;
+	atomic<int> m_value;
+	atomic<int> m_writes;
+};
+
+TEST_CASE("CommandQueue_Ordering")
+{
+	InstrumentCommandQueue queue;
+	vector<int> order;
+
+	queue.SubmitWrite("a", [&]{ order.push_back(1); });
+	auto f = queue.Submit<int>([&]{ order.push_back(2); return 42; });
+	queue.SubmitWrite("a", [&]{ order.push_back(3); });
+
+	//Nothing runs until serviced
+	REQUIRE(order.empty());
+	REQUIRE(queue.GetDepth() == 3);
+
+	REQUIRE(queue.Service() == 3);
+	REQUIRE(order == vector<int>({1, 2, 3}));
+	REQUIRE(f.get() == 42);
+	REQUIRE(queue.GetDepth() == 0);
+}
+
+TEST_CASE("CommandQueue_Coalescing")
+{
+	InstrumentCommandQueue queue;
+	int value = 0;
+	int writes = 0;
+
+	//Repeated writes to the same setting collapse into one, keeping the last value
+	for(int i=0; i<100; i++)
+		queue.SubmitWrite("value", [&value, &writes, i]{ value = i; writes ++; });
+
+	//Writes to other settings are independent
+	int other = 0;
+	queue.SubmitWrite("other", [&]{ other = 1; });
+	queue.SubmitWrite("value", [&value, &writes]{ value = 1000; writes ++; });
+
+	REQUIRE(queue.GetDepth() == 2);
+	REQUIRE(queue.GetCoalescedCount() == 100);
+	queue.Service();
+	REQUIRE(value == 1000);
+	REQUIRE(writes == 1);
+	REQUIRE(other == 1);
+
+	//A read is a barrier: writes before it must not be moved after it
+	queue.SubmitWrite("value", [&]{ value = 1; });
+	auto f = queue.Submit<int>([&]{ return value; });
+	queue.SubmitWrite("value", [&]{ value = 2; });
+	REQUIRE(queue.GetDepth() == 3);
+	queue.Service();
+	REQUIRE(f.get() == 1);
+	REQUIRE(value == 2);
+}
+
+TEST_CASE("CommandQueue_CoalescingKeepsOrder")
+{
+	InstrumentCommandQueue queue;
+	vector<int> order;
+
+	//The coalesced write moves to the tail, so it still lands after the write it was submitted after
+	queue.SubmitWrite("a", [&]{ order.push_back(1); });
+	queue.SubmitWrite("b", [&]{ order.push_back(2); });
+	queue.SubmitWrite("a", [&]{ order.push_back(3); });
+
+	REQUIRE(queue.GetDepth() == 2);
+	REQUIRE(queue.GetCoalescedCount() == 1);
+	queue.Service();
+	REQUIRE(order == vector<int>({2, 3}));
+}
+
+TEST_CASE("CommandQueue_FrameTime")
+{
+	//Simulated instrument with 20 ms round trip time (slow LAN or USBTMC)
+	auto latency = 20ms;
+	SlowInstrument inst(latency);
+	InstrumentCommandQueue queue;
+
+	//Instrument thread, as in InstrumentThread()
+	atomic<bool> done(false);
+	thread worker([&]
+		{
+			while(!done)
+			{
+				queue.Service();
+				this_thread::sleep_for(1ms);
+			}
+			queue.Service();
+		});
+
+	//GUI thread: drag a slider for 100 frames, reading back the value each time a readback completes
+	const int nframes = 100;
+	vector<double> frameTimes;
+	future<int> readback;
+	int readbacks = 0;
+	for(int i=0; i<nframes; i++)
+	{
+		double start = GetTime();
+
+		queue.SubmitWrite("value", [&inst, i]{ inst.SetValue(i); });
+
+		if(readback.valid() && (readback.wait_for(0s) == future_status::ready) )
+		{
+			readback.get();
+			readbacks ++;
+		}
+		if(!readback.valid())
+			readback = queue.Submit<int>([&inst]{ return inst.GetValue(); });
+
+		frameTimes.push_back(GetTime() - start);
+
+		//Simulate vsync at ~200 Hz so the instrument falls behind
+		this_thread::sleep_for(5ms);
+	}
+
+	done = true;
+	worker.join();
+
+	sort(frameTimes.begin(), frameTimes.end());
+	double p99 = frameTimes[frameTimes.size() * 99 / 100];
+	LogVerbose("GUI frame time p99: %.3f ms (instrument latency %d ms)\n",
+		p99 * 1000, static_cast<int>(latency.count()));
+	LogVerbose("%d slider writes reached the instrument, %d readbacks completed, %" PRIu64 " writes coalesced\n",
+		inst.m_writes.load(), readbacks, queue.GetCoalescedCount());
+
+	//A blocking call from the GUI thread would take at least one round trip per frame
+	REQUIRE(p99 < 0.005);
+
+	//The instrument can't keep up with one write per frame, so writes must have been coalesced
+	REQUIRE(inst.m_writes < nframes);
+	REQUIRE(queue.GetCoalescedCount() > 0);
+
+	//The final slider position always makes it to the instrument
+	REQUIRE(inst.m_value == nframes - 1);
+}
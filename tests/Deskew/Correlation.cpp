@@ -0,0 +1,264 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for DeskewCorrelator
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Deskew.h"
+#include <cinttypes>
+
+using namespace std;
+
+//Small enough that the brute force reference runs in reasonable time
+const size_t g_depth = 200000;
+const int64_t g_maxSkew = 1000;
+
+/**
+	@brief Creates a pair of uniform waveforms sampling the same random signal, the secondary delayed by delayFs
+
+	The signal is a random value held for 10 ps, the primary samples at 100 Gsps.
+ */
+static void MakeUniformPair(
+	UniformAnalogWaveform& pri,
+	UniformAnalogWaveform& sec,
+	int64_t secTimescale,
+	int64_t secPhase,
+	int64_t delayFs)
+{
+	const int64_t signalTimescale = 10000;
+	const int64_t margin = 2 * g_maxSkew * signalTimescale;
+	vector<float> signal;
+	FillRandomSamples(signal, g_depth + 4*g_maxSkew);
+
+	pri.m_timescale = signalTimescale;
+	pri.m_triggerPhase = 0;
+	pri.Resize(g_depth);
+	for(size_t i=0; i<g_depth; i++)
+		pri.m_samples[i] = signal[(i*pri.m_timescale + margin) / signalTimescale];
+	pri.MarkModifiedFromCpu();
+
+	size_t slen = g_depth * pri.m_timescale / secTimescale;
+	sec.m_timescale = secTimescale;
+	sec.m_triggerPhase = secPhase;
+	sec.Resize(slen);
+	for(size_t i=0; i<slen; i++)
+		sec.m_samples[i] = signal[(i*sec.m_timescale + secPhase - delayFs + margin) / signalTimescale];
+	sec.MarkModifiedFromCpu();
+}
+
+TEST_CASE("Deskew_UniformEqualRate")
+{
+	for(int64_t delay : {-437, 0, 1, 123, 999})
+	{
+		SECTION(string("Delay ") + to_string(delay))
+		{
+			UniformAnalogWaveform pri;
+			UniformAnalogWaveform sec;
+			MakeUniformPair(pri, sec, 10000, 0, delay * 10000);
+
+			auto fft = DeskewCorrelator::Correlate(&pri, &sec, g_maxSkew, *g_cmdBuf, g_queue);
+			auto ref = DeskewCorrelator::CorrelateBruteForce(&pri, &sec, g_maxSkew);
+
+			REQUIRE(ref.m_offset == delay);
+			REQUIRE(fft.m_offset == ref.m_offset);
+			REQUIRE(fabs(fft.m_correlation - ref.m_correlation) < 1e-3 * ref.m_correlation);
+			REQUIRE(fabs(fft.m_fraction) < 0.01);
+		}
+	}
+}
+
+TEST_CASE("Deskew_UniformUnequalRate")
+{
+	//Secondary at 1/2, 1/2.5, and 1/4 the primary rate, with assorted trigger phases
+	for(int64_t secTimescale : {20000, 25000, 40000})
+	{
+		for(int64_t secPhase : {0, 3000, -4000})
+		{
+			SECTION(to_string(secTimescale) + " fs / phase " + to_string(secPhase))
+			{
+				const int64_t delayFs = 1234567;
+
+				UniformAnalogWaveform pri;
+				UniformAnalogWaveform sec;
+				MakeUniformPair(pri, sec, secTimescale, secPhase, delayFs);
+
+				auto fft = DeskewCorrelator::Correlate(&pri, &sec, g_maxSkew, *g_cmdBuf, g_queue);
+				auto ref = DeskewCorrelator::CorrelateBruteForce(&pri, &sec, g_maxSkew);
+
+				//Slow secondary samples make the peak a plateau, so allow the FFT to land on a neighboring sample.
+				//Either way the interpolated position should be within a sample (of each waveform) of the true delay.
+				REQUIRE(llabs(fft.m_offset - ref.m_offset) <= 1);
+				REQUIRE(fabs(fft.m_correlation - ref.m_correlation) < 1e-3 * ref.m_correlation);
+				REQUIRE(llabs(fft.GetSkew(pri.m_timescale) - delayFs) <= pri.m_timescale + sec.m_timescale);
+			}
+		}
+	}
+}
+
+TEST_CASE("Deskew_Sparse")
+{
+	const int64_t delay = -77;
+	vector<float> signal;
+	FillRandomSamples(signal, g_depth + 2*g_maxSkew);
+
+	SparseAnalogWaveform pri;
+	SparseAnalogWaveform sec;
+	pri.m_timescale = 5000;
+	sec.m_timescale = 5000;
+	pri.Resize(g_depth);
+	sec.Resize(g_depth);
+	for(size_t i=0; i<g_depth; i++)
+	{
+		pri.m_offsets[i] = i;
+		pri.m_durations[i] = 1;
+		pri.m_samples[i] = signal[g_maxSkew + i];
+
+		sec.m_offsets[i] = i;
+		sec.m_durations[i] = 1;
+		sec.m_samples[i] = signal[g_maxSkew + i - delay];
+	}
+	pri.MarkModifiedFromCpu();
+	sec.MarkModifiedFromCpu();
+
+	auto fft = DeskewCorrelator::Correlate(&pri, &sec, g_maxSkew, *g_cmdBuf, g_queue);
+	auto ref = DeskewCorrelator::CorrelateBruteForce(&pri, &sec, g_maxSkew);
+
+	REQUIRE(ref.m_offset == delay);
+	REQUIRE(fft.m_offset == ref.m_offset);
+	REQUIRE(fabs(fft.m_correlation - ref.m_correlation) < 1e-3 * ref.m_correlation);
+}
+
+TEST_CASE("Deskew_SubSample")
+{
+	//Smooth signal delayed by a fractional number of samples
+	const double delay = 12.3;
+	auto signal = [](double x)
+		{ return sin(x * 0.05) + 0.5*sin(x * 0.013 + 1) + 0.3*sin(x * 0.0071); };
+
+	UniformAnalogWaveform pri;
+	UniformAnalogWaveform sec;
+	pri.m_timescale = 10000;
+	sec.m_timescale = 10000;
+	pri.Resize(g_depth);
+	sec.Resize(g_depth);
+	for(size_t i=0; i<g_depth; i++)
+	{
+		pri.m_samples[i] = signal(i);
+		sec.m_samples[i] = signal(i - delay);
+	}
+	pri.MarkModifiedFromCpu();
+	sec.MarkModifiedFromCpu();
+
+	auto fft = DeskewCorrelator::Correlate(&pri, &sec, g_maxSkew, *g_cmdBuf, g_queue);
+
+	REQUIRE(fft.m_offset == 12);
+	REQUIRE(fabs(fft.m_offset + fft.m_fraction - delay) < 0.05);
+}
+
+TEST_CASE("Deskew_Performance")
+{
+	//Full size capture at the wizard's default search range, to keep an eye on run time
+	const size_t depth = 10000000;
+	const int64_t maxSkew = 30000;
+	const int64_t delay = 12345;
+
+	vector<float> signal;
+	FillRandomSamples(signal, depth + 2*maxSkew);
+
+	UniformAnalogWaveform pri;
+	UniformAnalogWaveform sec;
+	pri.m_timescale = 10000;
+	sec.m_timescale = 10000;
+	pri.Resize(depth);
+	sec.Resize(depth);
+	for(size_t i=0; i<depth; i++)
+	{
+		pri.m_samples[i] = signal[maxSkew + i];
+		sec.m_samples[i] = signal[maxSkew + i - delay];
+	}
+	pri.MarkModifiedFromCpu();
+	sec.MarkModifiedFromCpu();
+
+	double start = GetTime();
+	auto fft = DeskewCorrelator::Correlate(&pri, &sec, maxSkew, *g_cmdBuf, g_queue);
+	double dt = GetTime() - start;
+	LogVerbose("Correlated %zu points at +/- %" PRId64 " samples in %.3f sec\n", depth, maxSkew, dt);
+
+	REQUIRE(fft.m_offset == delay);
+
+	//Brute force takes minutes at this size. Leave lots of headroom for slow CI machines and software Vulkan.
+	REQUIRE(dt < 20);
+}
+
+TEST_CASE("Deskew_MedianConfidence")
+{
+	int64_t lo;
+	int64_t hi;
+
+	SECTION("Empty")
+	{
+		REQUIRE(DeskewCorrelator::GetMedianSkew({}, lo, hi) == 0);
+		REQUIRE(lo == 0);
+		REQUIRE(hi == 0);
+	}
+
+	SECTION("Small sets use the full range")
+	{
+		REQUIRE(DeskewCorrelator::GetMedianSkew({50, 10, 40, 20, 30}, lo, hi) == 30);
+		REQUIRE(lo == 10);
+		REQUIRE(hi == 50);
+
+		REQUIRE(DeskewCorrelator::GetMedianSkew({40, 10, 30, 20}, lo, hi) == 25);
+		REQUIRE(lo == 10);
+		REQUIRE(hi == 40);
+	}
+
+	SECTION("Outliers do not move the interval")
+	{
+		//30 good measurements around 1000 fs plus two false alignments
+		vector<int64_t> skews;
+		for(int i=0; i<30; i++)
+			skews.push_back(990 + (i % 5) * 5);
+		skews.push_back(-500000);
+		skews.push_back(750000);
+
+		auto median = DeskewCorrelator::GetMedianSkew(skews, lo, hi);
+		REQUIRE(median == 1000);
+		REQUIRE(lo >= 990);
+		REQUIRE(hi <= 1010);
+	}
+}
@@ -1,8 +1,8 @@
 /***********************************************************************************************************************
 *                                                                                                                      *
-* glscopeclient                                                                                                        *
+* ngscopeclient                                                                                                        *
 *                                                                                                                      *
-* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
 * All rights reserved.                                                                                                 *
 *                                                                                                                      *
 * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
@@ -27,44 +27,17 @@
 *                                                                                                                      *
 ***********************************************************************************************************************/
 
-/**
-	@file
-	@author Andrew D. Zonenberg
-	@brief Declaration of RollingBuffer
- */
-#ifndef RollingBuffer_h
-#define RollingBuffer_h
+#ifndef Deskew_h
+#define Deskew_h
 
-/**
-	@brief Realtime plot helper (based on implot_demo)
- */
-struct RollingBuffer
-{
-	float Span;
-	ImVector<ImVec2> Data;
+#include "../../lib/scopehal/scopehal.h"
+#include "../../src/ngscopeclient/DeskewCorrelator.h"
+#include <random>
 
-	RollingBuffer()
-	{
-		Span = 10.0f;
-		Data.reserve(2000);
-	}
+extern std::minstd_rand g_rng;
+extern std::shared_ptr<QueueHandle> g_queue;
+extern std::unique_ptr<vk::raii::CommandBuffer> g_cmdBuf;
 
-	void Clear()
-	{ Data.clear(); }
-
-	void AddPoint(float x, float y)
-	{
-		Data.push_back(ImVec2(x, y));
-
-		while(!Data.empty())
-		{
-			float tfirst = Data.begin()->x;
-			if(tfirst < (x - Span))
-				Data.erase(Data.begin());
-			else
-				break;
-		}
-	}
-};
+void FillRandomSamples(std::vector<float>& samples, size_t size);
 
 #endif
@@ -0,0 +1,104 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Main code for Deskew test case
+ */
+
+#define CATCH_CONFIG_RUNNER
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#define EventListenerBase TestEventListenerBase
+#endif
+#include "Deskew.h"
+
+using namespace std;
+
+minstd_rand g_rng;
+shared_ptr<QueueHandle> g_queue;
+unique_ptr<vk::raii::CommandPool> g_pool;
+unique_ptr<vk::raii::CommandBuffer> g_cmdBuf;
+
+// Global initialization
+class testRunListener : public Catch::EventListenerBase
+{
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    void testRunStarting(Catch::TestRunInfo const&) override
+    {
+		g_log_sinks.emplace(g_log_sinks.begin(), new ColoredSTDLogSink(Severity::VERBOSE));
+
+		if(!VulkanInit(true))
+			exit(1);
+
+		//Command buffer for the FFT correlator
+		g_queue = g_vkQueueManager->GetComputeQueue("Deskew.queue");
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			g_queue->m_family );
+		g_pool = make_unique<vk::raii::CommandPool>(*g_vkComputeDevice, poolInfo);
+		vk::CommandBufferAllocateInfo bufinfo(**g_pool, vk::CommandBufferLevel::ePrimary, 1);
+		g_cmdBuf = make_unique<vk::raii::CommandBuffer>(
+			std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+		//Initialize the RNG
+		g_rng.seed(0);
+	}
+
+    void testRunEnded([[maybe_unused]] Catch::TestRunStats const& testRunStats) override
+    {
+		g_cmdBuf = nullptr;
+		g_pool = nullptr;
+		g_queue = nullptr;
+		ScopehalStaticCleanup();
+	}
+};
+CATCH_REGISTER_LISTENER(testRunListener)
+
+int main(int argc, char* argv[])
+{
+	return Catch::Session().run(argc, argv);
+}
+
+/**
+	@brief Fills a buffer with uniformly distributed random samples from -1 to +1
+ */
+void FillRandomSamples(vector<float>& samples, size_t size)
+{
+	auto rdist = uniform_real_distribution<float>(-1, 1);
+
+	samples.resize(size);
+	for(size_t i=0; i<size; i++)
+		samples[i] = rdist(g_rng);
+}
@@ -0,0 +1,231 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Tests of FlowGraphIndex against a brute force reference on a synthetic 500-filter graph
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "FlowGraph.h"
+
+using namespace std;
+
+/**
+	@brief Synthetic session: instrument channels feeding a layered graph of filters
+ */
+class TestGraph
+{
+public:
+	TestGraph(size_t nchans, size_t nfilters)
+	{
+		//Instrument channels
+		for(size_t i=0; i<nchans; i++)
+			m_nodes.push_back(new TestNode(string("CH") + to_string(i+1)));
+
+		//Each filter takes one or two inputs from the 40 nodes created just before it
+		for(size_t i=0; i<nfilters; i++)
+		{
+			auto f = new TestNode(string("F") + to_string(i+1));
+			size_t lo = (m_nodes.size() > 40) ? m_nodes.size() - 40 : 0;
+			size_t ninputs = 1 + g_rng() % 2;
+			for(size_t j=0; j<ninputs; j++)
+				f->Connect(m_nodes[lo + g_rng() % (m_nodes.size() - lo)]);
+			m_nodes.push_back(f);
+		}
+
+		//A channel nothing consumes, like a power supply or multimeter
+		m_idle = new TestNode("Idle");
+		m_nodes.push_back(m_idle);
+
+		m_nodeSet = set<FlowGraphNode*>(m_nodes.begin(), m_nodes.end());
+	}
+
+	~TestGraph()
+	{
+		//Consumers go first so nothing is left pointing at a deleted node
+		for(auto it = m_nodes.rbegin(); it != m_nodes.rend(); it++)
+			delete *it;
+	}
+
+	///@brief Every node, in creation order
+	vector<TestNode*> m_nodes;
+
+	///@brief Every node, as the set the session hands to the index
+	set<FlowGraphNode*> m_nodeSet;
+
+	///@brief The channel with no consumers
+	TestNode* m_idle;
+};
+
+/**
+	@brief Reference check for whether a node is downstream of any node in a set, by walking its inputs recursively
+ */
+static bool IsDownstreamOf(FlowGraphNode* node, const set<FlowGraphNode*>& roots)
+{
+	for(size_t i=0; i<node->GetInputCount(); i++)
+	{
+		FlowGraphNode* src = node->GetInput(i).m_channel;
+		if(!src)
+			continue;
+		if(roots.count(src) || IsDownstreamOf(src, roots))
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Reference cone lookup, the way the session did it before it had an index: ask every node
+ */
+static void GetReferenceCone(TestGraph& graph, const set<FlowGraphNode*>& roots, set<FlowGraphNode*>& cone)
+{
+	set<FlowGraphNode*> nodes(graph.m_nodes.begin(), graph.m_nodes.end());
+	for(auto node : nodes)
+	{
+		if(IsDownstreamOf(node, roots))
+			cone.emplace(node);
+	}
+}
+
+TEST_CASE("FlowGraph_ConeMatchesReference")
+{
+	TestGraph graph(32, 500);
+
+	FlowGraphIndex index;
+	REQUIRE(!index.IsValid(500));
+	index.Rebuild(graph.m_nodeSet, 500);
+	REQUIRE(index.IsValid(500));
+	REQUIRE(!index.IsValid(501));
+
+	SECTION("Single dirty node")
+	{
+		//Every channel, plus a sample of filters from all depths of the graph
+		for(size_t i=0; i<graph.m_nodes.size(); i++)
+		{
+			if( (i >= 32) && (i % 8) )
+				continue;
+
+			set<FlowGraphNode*> roots{graph.m_nodes[i]};
+			set<FlowGraphNode*> expected;
+			set<FlowGraphNode*> actual;
+			GetReferenceCone(graph, roots, expected);
+			index.GetDownstreamCone(roots, actual);
+			REQUIRE(actual == expected);
+		}
+	}
+
+	SECTION("Several dirty channels")
+	{
+		set<FlowGraphNode*> roots(graph.m_nodes.begin(), graph.m_nodes.begin() + 4);
+		set<FlowGraphNode*> expected;
+		set<FlowGraphNode*> actual;
+		GetReferenceCone(graph, roots, expected);
+		index.GetDownstreamCone(roots, actual);
+		REQUIRE(!actual.empty());
+		REQUIRE(actual == expected);
+	}
+
+	SECTION("Invalidation")
+	{
+		index.Invalidate();
+		REQUIRE(!index.IsValid(500));
+	}
+}
+
+TEST_CASE("FlowGraph_ConeBenchmark")
+{
+	TestGraph graph(32, 500);
+	const size_t niter = 20;
+
+	double start = GetTime();
+	FlowGraphIndex index;
+	index.Rebuild(graph.m_nodeSet, 500);
+	double trebuild = GetTime() - start;
+	LogVerbose("Index rebuild: %.3f ms\n", trebuild * 1000);
+
+	SECTION("Dirty channel with no consumers")
+	{
+		set<FlowGraphNode*> roots{graph.m_idle};
+
+		start = GetTime();
+		for(size_t i=0; i<niter; i++)
+		{
+			set<FlowGraphNode*> cone;
+			GetReferenceCone(graph, roots, cone);
+			REQUIRE(cone.empty());
+		}
+		double tref = (GetTime() - start) / niter;
+
+		start = GetTime();
+		for(size_t i=0; i<niter; i++)
+		{
+			set<FlowGraphNode*> cone;
+			index.GetDownstreamCone(roots, cone);
+			REQUIRE(cone.empty());
+		}
+		double tindex = (GetTime() - start) / niter;
+
+		LogVerbose("No consumers: reference %.3f ms, index %.4f ms\n", tref * 1000, tindex * 1000);
+		REQUIRE(tindex < tref);
+	}
+
+	SECTION("Four dirty channels")
+	{
+		set<FlowGraphNode*> roots(graph.m_nodes.begin(), graph.m_nodes.begin() + 4);
+
+		size_t nref = 0;
+		start = GetTime();
+		for(size_t i=0; i<niter; i++)
+		{
+			set<FlowGraphNode*> cone;
+			GetReferenceCone(graph, roots, cone);
+			nref = cone.size();
+		}
+		double tref = (GetTime() - start) / niter;
+
+		size_t nindex = 0;
+		start = GetTime();
+		for(size_t i=0; i<niter; i++)
+		{
+			set<FlowGraphNode*> cone;
+			index.GetDownstreamCone(roots, cone);
+			nindex = cone.size();
+		}
+		double tindex = (GetTime() - start) / niter;
+
+		LogVerbose("%zu node cone: reference %.3f ms, index %.4f ms\n", nindex, tref * 1000, tindex * 1000);
+		REQUIRE(nindex == nref);
+		REQUIRE(tindex < tref);
+	}
+}
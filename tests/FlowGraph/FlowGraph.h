@@ -0,0 +1,65 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declarations for FlowGraph test case
+ */
+#ifndef FlowGraph_h
+#define FlowGraph_h
+
+#include "../../lib/scopehal/scopehal.h"
+#include "../../src/ngscopeclient/FlowGraphIndex.h"
+#include <random>
+
+extern std::minstd_rand g_rng;
+
+/**
+	@brief Minimal graph node which accepts any number of inputs from anything
+ */
+class TestNode : public OscilloscopeChannel
+{
+public:
+	TestNode(const std::string& name)
+		: OscilloscopeChannel(nullptr, name, "#ffffffff", Unit(Unit::UNIT_FS), Unit(Unit::UNIT_VOLTS))
+	{}
+
+	virtual bool ValidateChannel(size_t /*i*/, StreamDescriptor /*stream*/) override
+	{ return true; }
+
+	void Connect(TestNode* src)
+	{
+		size_t i = GetInputCount();
+		CreateInput(std::string("in") + std::to_string(i));
+		SetInput(i, StreamDescriptor(src, 0));
+	}
+};
+
+#endif
@@ -0,0 +1,89 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Tests of the upstream cone used to decide which filters demand-driven evaluation can skip
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "FlowGraph.h"
+
+using namespace std;
+
+TEST_CASE("FlowGraph_UpstreamCone")
+{
+	//CH1 -> F1 -> F2 -> trigger (not displayed anywhere)
+	//CH2 -> F3 (displayed)
+	//CH2 -> F4 (not used by anything)
+	//Declared sources first, so consumers are destroyed before anything they point to
+	TestNode ch1("CH1");
+	TestNode ch2("CH2");
+	TestNode f1("F1");
+	TestNode f2("F2");
+	TestNode f3("F3");
+	TestNode f4("F4");
+	f1.Connect(&ch1);
+	f2.Connect(&f1);
+	f3.Connect(&ch2);
+	f4.Connect(&ch2);
+
+	//Triggers aren't part of the graph we evaluate, they just read from it
+	TestNode trigger("Trigger");
+	trigger.Connect(&f2);
+
+	set<FlowGraphNode*> nodes{&ch1, &ch2, &f1, &f2, &f3, &f4};
+	set<FlowGraphNode*> sinks{&f3};
+
+	SECTION("Displayed outputs only")
+	{
+		auto cone = FlowGraphIndex::GetUpstreamCone(nodes, sinks, {});
+		REQUIRE(cone == set<FlowGraphNode*>({&ch2, &f3}));
+	}
+
+	SECTION("Filter feeding a trigger still runs when it isn't displayed")
+	{
+		auto cone = FlowGraphIndex::GetUpstreamCone(nodes, sinks, {&trigger});
+		REQUIRE(cone == set<FlowGraphNode*>({&ch1, &ch2, &f1, &f2, &f3}));
+		REQUIRE(cone.find(&trigger) == cone.end());
+		REQUIRE(cone.find(&f4) == cone.end());
+	}
+
+	SECTION("Sinks outside the graph are ignored")
+	{
+		TestNode other("Other");
+		auto cone = FlowGraphIndex::GetUpstreamCone(nodes, {&other}, {});
+		REQUIRE(cone.empty());
+	}
+}
@@ -0,0 +1,142 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Concurrent logging throughput and correctness tests for GuiLogSink
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "LogSink.h"
+#include <thread>
+
+using namespace std;
+
+/**
+	@brief Logs from several threads at once, returning the aggregate rate in lines per second
+ */
+static double LogFromThreads(GuiLogSink& sink, size_t nthreads, size_t linesPerThread)
+{
+	vector<thread> threads;
+	double start = GetTime();
+	for(size_t t=0; t<nthreads; t++)
+	{
+		threads.push_back(thread([&sink, t, linesPerThread]
+			{
+				for(size_t i=0; i<linesPerThread; i++)
+					sink.Log(Severity::DEBUG, "thread " + to_string(t) + " line " + to_string(i) + "\n");
+			}));
+	}
+	for(auto& t : threads)
+		t.join();
+	return (nthreads * linesPerThread) / (GetTime() - start);
+}
+
+TEST_CASE("LogSink_Throughput")
+{
+	const size_t linesPerThread = 100000;
+	for(size_t nthreads : {1, 2, 4, 8})
+	{
+		GuiLogSink sink(Severity::DEBUG, 16384);
+		double rate = LogFromThreads(sink, nthreads, linesPerThread);
+		LogVerbose("%zu threads: %.2f M lines/sec\n", nthreads, rate * 1e-6);
+
+		//Memory stays bounded no matter how much was logged
+		vector<LogRecord> records;
+		size_t lost = sink.Drain(records);
+		REQUIRE(records.size() <= sink.GetCapacity());
+		REQUIRE(records.size() + lost == nthreads * linesPerThread);
+		REQUIRE(sink.GetLineCount() == nthreads * linesPerThread);
+	}
+}
+
+TEST_CASE("LogSink_Ordering")
+{
+	//Big enough to keep everything
+	const size_t nthreads = 4;
+	const size_t linesPerThread = 10000;
+	GuiLogSink sink(Severity::DEBUG, nthreads * linesPerThread);
+	LogFromThreads(sink, nthreads, linesPerThread);
+
+	vector<LogRecord> records;
+	REQUIRE(sink.Drain(records) == 0);
+	REQUIRE(records.size() == nthreads * linesPerThread);
+
+	//Lines come out in the order they were logged, and each thread's lines are intact and in sequence
+	map<uint32_t, size_t> nextLine;
+	map<uint32_t, string> threadPrefix;
+	for(size_t i=0; i<records.size(); i++)
+	{
+		auto& rec = records[i];
+		if(i > 0)
+			REQUIRE(rec.m_seq > records[i-1].m_seq);
+
+		auto pos = rec.m_message.find(" line ");
+		REQUIRE(pos != string::npos);
+		auto prefix = rec.m_message.substr(0, pos);
+		if(threadPrefix.find(rec.m_thread) == threadPrefix.end())
+			threadPrefix[rec.m_thread] = prefix;
+		REQUIRE(threadPrefix[rec.m_thread] == prefix);
+		REQUIRE(stoul(rec.m_message.substr(pos + 6)) == nextLine[rec.m_thread]);
+		nextLine[rec.m_thread] ++;
+	}
+	REQUIRE(nextLine.size() == nthreads);
+
+	//Nothing new since the last drain, but rewinding gets everything back
+	records.clear();
+	REQUIRE(sink.Drain(records) == 0);
+	REQUIRE(records.empty());
+	sink.Rewind();
+	sink.Drain(records);
+	REQUIRE(records.size() == nthreads * linesPerThread);
+}
+
+TEST_CASE("LogSink_PartialLines")
+{
+	GuiLogSink sink(Severity::VERBOSE);
+
+	//Fragments without a newline are joined into one line, per thread
+	sink.Log(Severity::NOTICE, "hello ");
+	thread([&]{ sink.Log(Severity::NOTICE, "other thread\n"); }).join();
+	sink.Log(Severity::NOTICE, "world\n");
+
+	//Messages below the minimum severity are dropped
+	sink.Log(Severity::DEBUG, "noisy\n");
+
+	vector<LogRecord> records;
+	sink.Drain(records);
+	REQUIRE(records.size() == 2);
+	REQUIRE(records[0].m_message == "other thread");
+	REQUIRE(records[1].m_message == "hello world");
+}
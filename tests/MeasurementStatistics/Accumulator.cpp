@@ -0,0 +1,124 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Accuracy tests for MeasurementAccumulator and QuantileSketch
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "MeasurementStatistics.h"
+#include <random>
+
+using namespace std;
+
+TEST_CASE("MeasurementStatistics_Moments")
+{
+	//Large offset with a tiny spread, which a naive sum of squares can't handle in double precision
+	minstd_rand rng(1234);
+	normal_distribution<double> dist(1e9, 1e-3);
+
+	MeasurementAccumulator acc;
+	vector<double> values;
+	for(size_t i=0; i<100000; i++)
+	{
+		double v = dist(rng);
+		values.push_back(v);
+		acc.Add(v);
+	}
+
+	//Compare against a two-pass reference
+	double mean = 0;
+	for(auto v : values)
+		mean += v;
+	mean /= values.size();
+	double var = 0;
+	for(auto v : values)
+		var += (v - mean) * (v - mean);
+	double stddev = sqrt(var / (values.size() - 1));
+
+	REQUIRE(acc.GetCount() == values.size());
+	//(the reference mean itself is only good to a few ulps of 1e9)
+	REQUIRE(fabs(acc.GetMean() - mean) < 0.01 * stddev);
+	REQUIRE(fabs(acc.GetStdDev() - stddev) / stddev < 1e-3);
+	REQUIRE(acc.GetMin() == *min_element(values.begin(), values.end()));
+	REQUIRE(acc.GetMax() == *max_element(values.begin(), values.end()));
+
+	//Non-finite values are ignored
+	acc.Add(NAN);
+	acc.Add(INFINITY);
+	REQUIRE(acc.GetCount() == values.size());
+}
+
+TEST_CASE("MeasurementStatistics_Quantiles")
+{
+	minstd_rand rng(5678);
+	uniform_real_distribution<double> dist(-5, 15);
+
+	//Exact until the range is fixed
+	QuantileSketch small;
+	for(int i=1; i<=5; i++)
+		small.Add(i);
+	REQUIRE(small.GetQuantile(0.5) == 3);
+
+	//Feed values in increasing order of spread, so the range has to grow in both directions several times
+	QuantileSketch sketch;
+	vector<double> values;
+	for(size_t i=0; i<50000; i++)
+	{
+		double scale = 1 + i / 10000.0;
+		double v = dist(rng) * scale;
+		values.push_back(v);
+		sketch.Add(v);
+	}
+	sort(values.begin(), values.end());
+
+	//Estimates should be within one bin width of the true quantiles
+	double binWidth = (sketch.GetUpperBound() - sketch.GetLowerBound()) / QuantileSketch::NUM_BINS;
+	for(double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99})
+	{
+		double expected = values[static_cast<size_t>(q * (values.size() - 1))];
+		double actual = sketch.GetQuantile(q);
+		LogVerbose("q=%.2f: expected %.4f, got %.4f\n", q, expected, actual);
+		REQUIRE(fabs(actual - expected) <= binWidth);
+	}
+
+	//Histogram accounts for every value
+	vector<float> counts;
+	sketch.GetHistogram(counts, 32);
+	double total = 0;
+	for(auto c : counts)
+		total += c;
+	REQUIRE(total == values.size());
+}
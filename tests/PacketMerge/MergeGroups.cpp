@@ -0,0 +1,224 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Correctness and performance tests for packet merge group detection
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "PacketMerge.h"
+#include <random>
+
+using namespace std;
+
+/**
+	@brief Stand-in for a decoded packet: a type code and a sequence number
+ */
+struct TestPacket
+{
+	uint32_t m_type;
+	uint32_t m_seq;
+};
+
+/**
+	@brief Merge rule exercising all three CanMerge() arguments
+
+	Packets of the same nonzero type merge if their sequence numbers are consecutive, up to 16 packets per group.
+ */
+static bool CanMerge(const TestPacket& first, const TestPacket& prev, const TestPacket& next, size_t& calls)
+{
+	calls ++;
+	return
+		(next.m_type != 0) &&
+		(next.m_type == first.m_type) &&
+		(next.m_seq == prev.m_seq + 1) &&
+		(next.m_seq - first.m_seq < 16);
+}
+
+/**
+	@brief The merge state machine PacketManager::Update() used before groups were found in one pass
+ */
+static void ReferenceMergeGroups(
+	const vector<TestPacket>& packets,
+	vector<pair<size_t, size_t> >& groups,
+	size_t& calls)
+{
+	size_t npackets = packets.size();
+	bool inGroup = false;
+	size_t groupStart = 0;
+	size_t last = 0;
+	for(size_t i=0; i<npackets; i++)
+	{
+		auto& p = packets[i];
+
+		bool startingNewGroup;
+		if(i+1 >= npackets)
+			startingNewGroup = false;
+		else if(!CanMerge(p, p, packets[i+1], calls))
+			startingNewGroup = false;
+		else if(!inGroup)
+			startingNewGroup = true;
+		else
+			startingNewGroup = !CanMerge(packets[groupStart], packets[last], p, calls);
+
+		if(startingNewGroup)
+		{
+			if(inGroup)
+				groups.push_back(pair<size_t, size_t>(groupStart, i));
+			inGroup = true;
+			groupStart = i;
+		}
+		else if(inGroup && !CanMerge(packets[groupStart], packets[last], p, calls))
+		{
+			groups.push_back(pair<size_t, size_t>(groupStart, i));
+			inGroup = false;
+		}
+
+		last = i;
+	}
+	if(inGroup)
+		groups.push_back(pair<size_t, size_t>(groupStart, npackets));
+}
+
+/**
+	@brief Makes a random packet stream with a mix of mergeable runs, singletons and sequence gaps
+ */
+static void MakePackets(vector<TestPacket>& packets, size_t count, uint32_t seed)
+{
+	minstd_rand rng(seed);
+	packets.resize(count);
+
+	uint32_t seq = 0;
+	uint32_t type = 1;
+	for(size_t i=0; i<count; i++)
+	{
+		//Change type now and then, and occasionally skip a sequence number
+		if( (rng() % 8) == 0)
+			type = rng() % 3;
+		if( (rng() % 32) == 0)
+			seq ++;
+
+		packets[i].m_type = type;
+		packets[i].m_seq = seq++;
+	}
+}
+
+TEST_CASE("PacketMerge_MatchesReference")
+{
+	for(uint32_t seed = 1; seed <= 50; seed ++)
+	{
+		vector<TestPacket> packets;
+		MakePackets(packets, 1 + (seed * 37) % 500, seed);
+
+		vector<pair<size_t, size_t> > expected;
+		size_t refCalls = 0;
+		ReferenceMergeGroups(packets, expected, refCalls);
+
+		vector<pair<size_t, size_t> > groups;
+		size_t calls = 0;
+		FindPacketMergeGroups(
+			packets,
+			[&](const TestPacket& a, const TestPacket& b, const TestPacket& c)
+			{ return CanMerge(a, b, c, calls); },
+			groups);
+
+		REQUIRE(groups == expected);
+	}
+}
+
+TEST_CASE("PacketMerge_EdgeCases")
+{
+	vector<pair<size_t, size_t> > groups;
+	size_t calls = 0;
+	auto test = [&](const TestPacket& a, const TestPacket& b, const TestPacket& c)
+		{ return CanMerge(a, b, c, calls); };
+
+	//Nothing to merge in an empty or single packet stream
+	vector<TestPacket> packets;
+	FindPacketMergeGroups(packets, test, groups);
+	REQUIRE(groups.empty());
+
+	packets.push_back({1, 0});
+	FindPacketMergeGroups(packets, test, groups);
+	REQUIRE(groups.empty());
+
+	//A run longer than the group limit splits into back-to-back groups
+	packets.clear();
+	for(uint32_t i=0; i<40; i++)
+		packets.push_back({1, i});
+	FindPacketMergeGroups(packets, test, groups);
+	REQUIRE(groups.size() == 3);
+	REQUIRE(groups[0].first == 0);
+	REQUIRE(groups[0].second == 16);
+	REQUIRE(groups[1].first == 16);
+	REQUIRE(groups[1].second == 32);
+	REQUIRE(groups[2].first == 32);
+	REQUIRE(groups[2].second == 40);
+}
+
+TEST_CASE("PacketMerge_MillionPackets")
+{
+	const size_t count = 1000000;
+
+	vector<TestPacket> packets;
+	MakePackets(packets, count, 12345);
+
+	vector<pair<size_t, size_t> > expected;
+	expected.reserve(count / 2);
+	size_t refCalls = 0;
+	double start = GetTime();
+	ReferenceMergeGroups(packets, expected, refCalls);
+	double refTime = GetTime() - start;
+
+	vector<pair<size_t, size_t> > groups;
+	groups.reserve(count / 2);
+	size_t calls = 0;
+	start = GetTime();
+	FindPacketMergeGroups(
+		packets,
+		[&](const TestPacket& a, const TestPacket& b, const TestPacket& c)
+		{ return CanMerge(a, b, c, calls); },
+		groups);
+	double dt = GetTime() - start;
+
+	LogNotice("%zu packets, %zu groups\n", count, groups.size());
+	LogNotice("Reference: %zu CanMerge() calls, %.2f ms\n", refCalls, refTime * 1000);
+	LogNotice("One pass:  %zu CanMerge() calls, %.2f ms\n", calls, dt * 1000);
+
+	REQUIRE(groups == expected);
+
+	//Every packet is tested against its group at most once
+	REQUIRE(calls <= count);
+	REQUIRE(calls < refCalls);
+}
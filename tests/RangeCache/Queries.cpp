@@ -0,0 +1,102 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Tests of WaveformRangeCache against a brute force reference
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "RangeCache.h"
+
+using namespace std;
+
+TEST_CASE("RangeCache_Queries")
+{
+	//Odd length so the last block is partial
+	const size_t depth = 1000003;
+
+	UniformAnalogWaveform wfm;
+	wfm.m_timescale = 1;
+	wfm.PrepareForCpuAccess();
+	wfm.Resize(depth);
+	uniform_real_distribution<float> dist(-80, -20);
+	for(size_t i=0; i<depth; i++)
+		wfm.m_samples[i] = dist(g_rng);
+	wfm.MarkModifiedFromCpu();
+
+	WaveformRangeCache cache;
+	uniform_int_distribution<size_t> idist(0, depth - 1);
+	for(int iter=0; iter<50; iter++)
+	{
+		//Mix of short (scanned) and long (indexed) ranges
+		size_t istart = idist(g_rng);
+		size_t iend = (iter & 1) ? idist(g_rng) : min(istart + iter*100, depth - 1);
+
+		WaveformRangeStats stats;
+		REQUIRE(cache.Query(&wfm, WaveformRangeCache::SUM_DBM, istart, iend, stats));
+
+		//Reference
+		if(iend < istart)
+			swap(istart, iend);
+		double power = 0;
+		double sum = 0;
+		float vmin = wfm.m_samples[istart];
+		float vmax = wfm.m_samples[istart];
+		for(size_t i=istart; i<=iend; i++)
+		{
+			float f = wfm.m_samples[i];
+			power += pow(10, (f - 30.0) / 10);
+			sum += f;
+			vmin = min(vmin, f);
+			vmax = max(vmax, f);
+		}
+
+		REQUIRE(stats.m_count == (iend - istart + 1));
+		REQUIRE(fabs(stats.m_sum - power) <= 1e-6 * power);
+		REQUIRE(fabs(stats.GetMean() - sum / stats.m_count) < 1e-6);
+		REQUIRE(stats.m_min == vmin);
+		REQUIRE(stats.m_max == vmax);
+	}
+
+	//Index is rebuilt when the waveform changes
+	WaveformRangeStats before;
+	REQUIRE(cache.Query(&wfm, WaveformRangeCache::SUM_LINEAR, 0, depth - 1, before));
+	wfm.m_samples[depth / 2] = 1000;
+	wfm.MarkModifiedFromCpu();
+	WaveformRangeStats after;
+	REQUIRE(cache.Query(&wfm, WaveformRangeCache::SUM_LINEAR, 0, depth - 1, after));
+	REQUIRE(after.m_max == 1000);
+	REQUIRE(after.m_sum > before.m_sum);
+}
@@ -0,0 +1,160 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Tests for StartupProfiler phase nesting and milestones
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "StartupProfiler.h"
+#include <thread>
+
+using namespace std;
+
+TEST_CASE("StartupProfiler_Nesting")
+{
+	StartupProfiler prof;
+	prof.Start();
+
+	size_t root = prof.Begin("root");
+	size_t a = prof.Begin("a");
+	size_t a1 = prof.Begin("a1");
+	prof.End(a1);
+	prof.End(a);
+	size_t b = prof.Begin("b");
+	size_t b1 = prof.Begin("b1");
+
+	//Ending b should also end b1, which was left open
+	prof.End(b);
+	prof.End(root);
+
+	auto phases = prof.GetPhases();
+	REQUIRE(phases.size() == 5);
+
+	REQUIRE(phases[root].m_parent == SIZE_MAX);
+	REQUIRE(phases[a].m_parent == root);
+	REQUIRE(phases[a1].m_parent == a);
+	REQUIRE(phases[b].m_parent == root);
+	REQUIRE(phases[b1].m_parent == b);
+
+	REQUIRE(phases[root].m_depth == 0);
+	REQUIRE(phases[a1].m_depth == 2);
+	REQUIRE(phases[b1].m_depth == 2);
+
+	for(auto& p : phases)
+	{
+		REQUIRE(p.m_duration >= 0);
+		if(p.m_parent != SIZE_MAX)
+		{
+			auto& parent = phases[p.m_parent];
+			REQUIRE(p.m_start >= parent.m_start);
+			REQUIRE(p.m_start + p.m_duration <= parent.m_start + parent.m_duration);
+		}
+	}
+
+	//A new phase after everything closed is top level again
+	size_t next = prof.Begin("next");
+	prof.End(next);
+	REQUIRE(prof.GetPhases()[next].m_parent == SIZE_MAX);
+}
+
+TEST_CASE("StartupProfiler_Threads")
+{
+	StartupProfiler prof;
+	prof.Start();
+
+	size_t outer = prof.Begin("outer");
+
+	//Phases on another thread don't nest inside phases open on this one
+	size_t other = SIZE_MAX;
+	thread t([&]
+	{
+		other = prof.Begin("other");
+		prof.End(other);
+	});
+	t.join();
+
+	size_t inner = prof.Begin("inner");
+	prof.End(inner);
+	prof.End(outer);
+
+	auto phases = prof.GetPhases();
+	REQUIRE(phases[other].m_parent == SIZE_MAX);
+	REQUIRE(phases[inner].m_parent == outer);
+	REQUIRE(phases[outer].m_duration >= 0);
+}
+
+TEST_CASE("StartupProfiler_Marks")
+{
+	StartupProfiler prof;
+	prof.Start();
+
+	REQUIRE(!prof.HasMark("First frame"));
+	REQUIRE(prof.GetMark("First frame") < 0);
+
+	prof.Mark("First frame");
+	double t = prof.GetMark("First frame");
+	REQUIRE(t >= 0);
+	REQUIRE(t <= prof.GetElapsed());
+
+	//Only the first time a milestone is reached counts
+	this_thread::sleep_for(chrono::milliseconds(5));
+	prof.Mark("First frame");
+	REQUIRE(prof.GetMark("First frame") == t);
+}
+
+TEST_CASE("StartupProfiler_Cap")
+{
+	//Repeated session loads don't grow the phase list forever
+	StartupProfiler prof(16);
+	prof.Start();
+
+	for(int i=0; i<100; i++)
+	{
+		size_t outer = prof.Begin("Load session");
+		size_t inner = prof.Begin("Parse YAML");
+		prof.End(inner);
+		prof.End(outer);
+	}
+
+	REQUIRE(prof.GetPhases().size() == 16);
+	REQUIRE(prof.GetDroppedPhaseCount() == 184);
+
+	//Phases which weren't recorded can still be ended safely
+	size_t id = prof.Begin("Load session");
+	REQUIRE(id == SIZE_MAX);
+	prof.End(id);
+	for(auto& p : prof.GetPhases())
+		REQUIRE(p.m_duration >= 0);
+}